@@ -39,6 +39,9 @@ struct RuntimeSymbolInfo {
   size_t size{0};
   /// Offset in bytes from the base address.
   size_t offset{0};
+  /// For Placeholders, the position of the symbol in allocation order. Used by
+  /// backends that address each Placeholder through its own base pointer.
+  size_t index{0};
   /// Type of symbol.
   Type type;
   /// Is the symbol an input for the function.
@@ -66,6 +69,8 @@ class RuntimeBundle {
   size_t activationsMemSize_{0};
   /// True if the RuntimeBundle is valid, false if not.
   bool isValid_{false};
+  /// True if constants_ is a block of the ConstantStore.
+  bool sharedConstants_{false};
 
 public:
   /// Get Constant Weights memory size.
@@ -74,6 +79,12 @@ public:
   size_t getMutableWeightSize() const { return mutableWeightVarsMemSize_; }
   /// Get Activations Weights memory size.
   size_t getActivationsSize() const { return activationsMemSize_; }
+  /// Get the memory size used on a device running one request at a time: the
+  /// constant and mutable weights and the activations.
+  size_t getDeviceMemorySize() const {
+    return constantWeightVarsMemSize_ + mutableWeightVarsMemSize_ +
+           activationsMemSize_;
+  }
   /// Get pointer to memory block of constants.
   uint8_t *getConstants() const { return constants_; }
   /// Set pointer to memory block of constants.
@@ -91,7 +102,12 @@ public:
   /// by offsets contained in symbolTable_.
   void collectConstants(const IRFunction *F);
   void collectConstants(const Module *M);
-  /// Free constants.
+  /// Condense the constants of \p M like collectConstants, sharing the block
+  /// with the bundles holding identical constants through SharedConstants().
+  /// The block is only shared on NUMA node \p numaNode if it is not negative.
+  /// The block must not be written to.
+  void collectSharedConstants(const Module *M, int numaNode = -1);
+  /// Free constants, or release the shared block.
   void freeConstants();
 
   /// Sets the input and output flags for each symbol in the symbolBundle.
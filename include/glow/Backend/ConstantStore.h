@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GLOW_BACKENDS_CONSTANTSTORE_H
+#define GLOW_BACKENDS_CONSTANTSTORE_H
+
+#include "glow/Backend/BackendUtils.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace glow {
+
+class Module;
+
+namespace runtime {
+
+/// Host-wide store of the constant weights of RuntimeBundles. The constants
+/// of a bundle are condensed to a single read-only block, identical blocks are
+/// stored once and reference counted, so that the replicas of a network on
+/// several devices of the host share a single copy of its weights. Blocks are
+/// identified by a hash of their contents and compared byte by byte on a hash
+/// match. A block may be bound to a NUMA node, it is then only shared with the
+/// bundles of the same node. All the methods are thread-safe.
+class ConstantStore final {
+public:
+  /// \returns a block of \p size bytes holding the constants of \p M at the
+  /// offsets of \p symbolTable, and takes a reference to it. An identical
+  /// block of NUMA node \p node, or of no node if \p node is negative, is
+  /// reused if stored already. Otherwise one is allocated and filled by the
+  /// calling thread.
+  uint8_t *acquire(const SymbolTableTy &symbolTable, size_t size,
+                   const Module *M, int node = -1);
+
+  /// Drops a reference to \p block returned by acquire(), freeing it with the
+  /// last reference.
+  void release(uint8_t *block);
+
+  /// \returns the number of blocks stored.
+  size_t getNumBlocks();
+
+  /// \returns the total size in bytes of the blocks stored.
+  size_t getStoredBytes();
+
+private:
+  /// A block of constants.
+  struct Block {
+    /// The constants, allocated with alignedAlloc.
+    uint8_t *data;
+    /// The size of the block in bytes.
+    size_t size;
+    /// The hash of the contents of the block.
+    size_t hash;
+    /// The NUMA node of the block, negative if none.
+    int node;
+    /// Number of references to the block.
+    unsigned refcount;
+  };
+
+  /// \returns a block of \p size bytes, hash \p hash and NUMA node \p node
+  /// holding the constants of \p M at the offsets of \p symbolTable, or
+  /// nullptr if there is none. Must be called with lock_ held.
+  Block *find(const SymbolTableTy &symbolTable, size_t size, size_t hash,
+              int node, const Module *M);
+
+  /// The blocks, by address of their data.
+  std::unordered_map<uint8_t *, std::unique_ptr<Block>> blocks_;
+
+  /// The blocks, by hash of their contents.
+  std::unordered_multimap<size_t, Block *> blocksByHash_;
+
+  /// Guards the blocks.
+  std::mutex lock_;
+};
+
+/// Global singleton ConstantStore.
+ConstantStore *SharedConstants();
+
+} // namespace runtime
+} // namespace glow
+
+#endif // GLOW_BACKENDS_CONSTANTSTORE_H
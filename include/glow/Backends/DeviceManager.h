@@ -23,6 +23,7 @@
 #include "glow/Runtime/RuntimeTypes.h"
 #include "glow/Support/Error.h"
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <string>
@@ -47,6 +48,10 @@ protected:
   /// Configuration object for the device.
   DeviceConfig config_;
 
+  /// Number of runs dispatched to the device by the Executor and not finished
+  /// yet.
+  std::atomic<unsigned> numInflightRuns_{0};
+
 public:
   DeviceManager(const DeviceConfig &config) : config_(config) {}
   virtual ~DeviceManager() {}
@@ -112,12 +117,28 @@ public:
   /// fit on the device.
   virtual bool isMemoryAvailable(uint64_t estimate) const = 0;
 
+  /// \returns the memory (in bytes) that a function with the runtime \p bundle
+  /// uses once it is added to the device.
+  virtual uint64_t getFunctionMemorySize(const RuntimeBundle &bundle) const {
+    return bundle.getDeviceMemorySize();
+  }
+
   /// \returns the DeviceConfig which initialized this device.
   const DeviceConfig &getDeviceConfig() { return config_; }
 
   /// \returns the DeviceInfo for this device containing peak limits for
   /// compute and bandwidths (used in partitioning).
   virtual DeviceInfo getDeviceInfo() const { return DeviceInfo(); }
+
+  /// \returns the number of runs dispatched to the device by the Executor and
+  /// not finished yet, which measures the load of the device.
+  unsigned getNumInflightRuns() const { return numInflightRuns_.load(); }
+
+  /// Counts one more run dispatched to the device.
+  void addInflightRun() { numInflightRuns_++; }
+
+  /// Counts the end of a run dispatched to the device.
+  void removeInflightRun() { numInflightRuns_--; }
 };
 
 } // namespace runtime
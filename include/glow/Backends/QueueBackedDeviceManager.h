@@ -26,7 +26,9 @@ namespace glow {
 namespace runtime {
 class QueueBackedDeviceManager : public DeviceManager {
 protected:
-  /// Thread which interfaces with the device.
+  /// Thread which interfaces with the device. Its work runs in submission
+  /// order within a priority class, the work items with a lower priority run
+  /// when it has none of the default priority.
   ThreadPool workThread_;
 
   /// Identifier for next run.
@@ -47,10 +49,11 @@ public:
   /// ready to use
   void addNetwork(const Module *module, FunctionMapTy functions,
                   ReadyCBTy callback) override {
-    workThread_.submit([this, module, f = std::move(functions),
-                        c = std::move(callback)]() mutable {
-      addNetworkImpl(module, std::move(f), std::move(c));
-    });
+    workThread_.submit(
+        [this, module, f = std::move(functions),
+         c = std::move(callback)]() mutable {
+          addNetworkImpl(module, std::move(f), std::move(c));
+        });
   }
 
   /// Remove (and delete) the provided network and all it's functions, freeing
@@ -67,16 +70,29 @@ public:
   /// The ExecutionContext's PlaceholderBindings should have all Placeholders
   /// allocated. resultCB will be called with the ExecutionContext containing
   /// output tensors filled, and any generated TraceEvents.
+  /// Runs are queued by the priority class and deadline of their context, the
+  /// runs whose deadline passed while queued fail with a
+  /// RUNTIME_DEADLINE_EXCEEDED error without being executed.
   RunIdentifierTy runFunction(std::string functionName,
                               std::unique_ptr<ExecutionContext> context,
                               ResultCBTy callback) override {
     RunIdentifierTy id = nextIdentifier_++;
-    workThread_.submit([this, id, functionName = std::move(functionName),
-                        context = std::move(context),
-                        callback = std::move(callback)]() mutable {
-      runFunctionImpl(id, std::move(functionName), std::move(context),
-                      std::move(callback));
-    });
+    auto key = context->getWorkPriority();
+    workThread_.submit(
+        [this, id, functionName = std::move(functionName),
+         context = std::move(context),
+         callback = std::move(callback)]() mutable {
+          if (context->isDeadlineExceeded()) {
+            callback(id,
+                     MAKE_ERR(GlowErr::ErrorCode::RUNTIME_DEADLINE_EXCEEDED,
+                              "The deadline of the run passed while queued"),
+                     std::move(context));
+            return;
+          }
+          runFunctionImpl(id, std::move(functionName), std::move(context),
+                          std::move(callback));
+        },
+        key);
     return id;
   }
 
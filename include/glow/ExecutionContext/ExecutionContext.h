@@ -18,11 +18,23 @@
 
 #include "glow/ExecutionContext/TraceEvents.h"
 #include "glow/Graph/PlaceholderBindings.h"
+#include "glow/Support/ThreadPool.h"
 
 #include "llvm/ADT/STLExtras.h"
 
+#include <chrono>
+
 namespace glow {
 
+/// Priority class of a request. The runtime queues run the work of the
+/// requests by class, then by earliest deadline, so that latency sensitive
+/// requests are not stuck behind bulk ones.
+enum class RequestPriority : unsigned {
+  High = 0,
+  Normal = 1,
+  Low = 2,
+};
+
 /// Sub-classed per backend, this holds Device specific per-function information
 /// if that is necessary on that particular backend.
 class DeviceBindings {
@@ -47,7 +59,23 @@ class ExecutionContext {
   std::unique_ptr<DeviceBindings> deviceBindings_;
   std::unique_ptr<TraceContext> traceContext_;
 
-  /// Trace Events recorded during this run.
+  /// Priority class of the run.
+  RequestPriority priority_{RequestPriority::Normal};
+
+  /// Time after which the run is useless and is dropped by the runtime instead
+  /// of being executed. No deadline by default.
+  std::chrono::steady_clock::time_point deadline_{
+      std::chrono::steady_clock::time_point::max()};
+
+  /// Time the backend spent copying the inputs of the run to the device and
+  /// its outputs back. Zero if the backend does not report it.
+  std::chrono::nanoseconds inputCopyTime_{0};
+  std::chrono::nanoseconds outputCopyTime_{0};
+
+  /// Time the device spent executing the function of the run, without the
+  /// time the run waited in its queue. Zero if the backend does not report
+  /// it.
+  std::chrono::nanoseconds executionTime_{0};
 
 public:
   ExecutionContext()
@@ -104,15 +132,78 @@ public:
     return traceContext;
   }
 
+  /// \returns the priority class of the run.
+  RequestPriority getPriority() const { return priority_; }
+
+  /// Sets the priority class of the run to \p priority.
+  void setPriority(RequestPriority priority) { priority_ = priority; }
+
+  /// \returns the deadline of the run.
+  std::chrono::steady_clock::time_point getDeadline() const {
+    return deadline_;
+  }
+
+  /// Sets the deadline of the run to \p deadline.
+  void setDeadline(std::chrono::steady_clock::time_point deadline) {
+    deadline_ = deadline;
+  }
+
+  /// \returns true if the run has a deadline and it has passed.
+  bool isDeadlineExceeded() const {
+    return deadline_ != std::chrono::steady_clock::time_point::max() &&
+           std::chrono::steady_clock::now() > deadline_;
+  }
+
+  /// \returns the time the backend spent copying the inputs of the run.
+  std::chrono::nanoseconds getInputCopyTime() const { return inputCopyTime_; }
+
+  /// \returns the time the backend spent copying the outputs of the run.
+  std::chrono::nanoseconds getOutputCopyTime() const { return outputCopyTime_; }
+
+  /// Sets the times the backend spent copying the inputs and the outputs of
+  /// the run to \p input and \p output.
+  void setCopyTimes(std::chrono::nanoseconds input,
+                    std::chrono::nanoseconds output) {
+    inputCopyTime_ = input;
+    outputCopyTime_ = output;
+  }
+
+  /// \returns the time the device spent executing the function of the run.
+  std::chrono::nanoseconds getExecutionTime() const { return executionTime_; }
+
+  /// Sets the time the device spent executing the function of the run to
+  /// \p time.
+  void setExecutionTime(std::chrono::nanoseconds time) {
+    executionTime_ = time;
+  }
+
+  /// Copies the priority class and the deadline of \p other.
+  void copySchedulingFrom(const ExecutionContext &other) {
+    priority_ = other.priority_;
+    deadline_ = other.deadline_;
+  }
+
+  /// \returns the key scheduling the work of the run in the runtime queues.
+  WorkPriority getWorkPriority() const {
+    WorkPriority key;
+    key.priority = static_cast<unsigned>(priority_);
+    key.deadline = deadline_;
+    return key;
+  }
+
   /// Clones this ExecutionContext, but does not clone underlying Tensors.
   ExecutionContext clone() {
     if (deviceBindings_) {
-      return ExecutionContext(
+      ExecutionContext ctx(
           llvm::make_unique<PlaceholderBindings>(placeholderBindings_->clone()),
           deviceBindings_->clone());
+      ctx.copySchedulingFrom(*this);
+      return ctx;
     } else {
-      return ExecutionContext(llvm::make_unique<PlaceholderBindings>(
+      ExecutionContext ctx(llvm::make_unique<PlaceholderBindings>(
           placeholderBindings_->clone()));
+      ctx.copySchedulingFrom(*this);
+      return ctx;
     }
   }
 
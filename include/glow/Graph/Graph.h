@@ -28,6 +28,7 @@
 #include "llvm/ADT/ilist_node.h"
 
 #include <list>
+#include <mutex>
 #include <vector>
 
 namespace glow {
@@ -62,6 +63,9 @@ class Module final {
   /// A uniqued list of types. Types in this list can be equated by comparing
   /// their addresses.
   TypesList types_{};
+  /// Guards types_, which the backends extend while they compile several
+  /// functions of the module concurrently.
+  std::mutex typesLock_;
   /// Stores a list of unique variable names that were used by the module at
   /// some point.
   llvm::StringSet<> uniqueVariableNames_{};
@@ -91,7 +95,7 @@ public:
   /// Inserts the placeholder node \p ph to the list of variables.
   Placeholder *addPlaceholder(Placeholder *ph);
 
-  /// Return a pointer to a uniqued type \p T.
+  /// Return a pointer to a uniqued type \p T. May be called concurrently.
   TypeRef uniqueType(const Type &T);
 
   /// Return a pointer to a uniqued type \p T.
@@ -45,6 +45,9 @@ struct AllocationsInfo {
 
   /// Maps Values in the module to their offsets.
   llvm::DenseMap<const Value *, uint64_t> allocatedAddress_;
+  /// Maps mutable WeightVars to their slot in the table of Placeholder base
+  /// addresses. Slots follow the allocation order of the Placeholders.
+  llvm::DenseMap<const Value *, size_t> placeholderSlots_;
   /// Amount of memory to be allocated for constant WeightVars.
   size_t constantWeightVarsMemSize_{0};
   /// Amount of memory to be allocated for mutable WeightVars.
@@ -73,6 +73,14 @@ public:
 
   ModuleHandle addModule(std::unique_ptr<Module> M);
 
+  /// Adds the object file \p object, which must have been compiled for the
+  /// target of the JIT, e.g. by compileModule.
+  ModuleHandle addObject(std::unique_ptr<MemoryBuffer> object);
+
+  /// \returns the object file of \p M compiled for the target of the JIT,
+  /// without adding it to the JIT.
+  std::unique_ptr<MemoryBuffer> compileModule(Module &M);
+
   void removeModule(ModuleHandle H);
 };
 
@@ -27,6 +27,7 @@
 namespace glow {
 
 struct AllocationsInfo;
+class CompileCache;
 class PlaceholderBindings;
 class LLVMIRGen;
 
@@ -98,8 +99,45 @@ protected:
   /// \returns libjit bitcode for the current backend.
   virtual llvm::StringRef getLibjitBitcode() const = 0;
 
+  /// \returns true if the kernels of the compiled functions may call the
+  /// intra-op parallel runtime of the host process, which the backend must
+  /// then register with the JIT. Otherwise they use the serial fallback of
+  /// libjit.
+  virtual bool useHostParallelRuntime() const { return false; }
+
+  /// Writes the command line options of the backend which change the code it
+  /// generates to \p os, which is hashed in the key of the compile cache.
+  virtual void describeCodegenOptions(llvm::raw_ostream &os) const {}
+
   /// Emit the jitmain function.
   virtual void emitJitMain(LLVMIRGen &irgen) const;
+
+private:
+  /// Compiles \p IR without collecting its constants. If \p cache is not
+  /// null, the result is also stored in it as entry \p cacheKey.
+  std::unique_ptr<CompiledFunction>
+  compileIRToFunction(IRFunction *IR, const CompileCache *cache,
+                      llvm::StringRef cacheKey) const;
+
+  /// Compiles \p F with \p opts through the on-disk cache of compiled
+  /// functions, loading the machine code and RuntimeBundle of the function
+  /// if they were cached, and compiling and caching them otherwise.
+  std::unique_ptr<CompiledFunction>
+  compileWithCache(Function *F, const BackendOptions &opts) const;
+
+  /// \returns the key of \p F compiled with \p opts for \p TM in the cache
+  /// of compiled functions. The key hashes the graph of \p F, the types of
+  /// its storage and the payloads of its constants, the backend options, the
+  /// command line options changing the IR and the generated code, the target,
+  /// CPU and features of \p TM and the libjit bitcode.
+  std::string getCompileCacheKey(const Function *F, const BackendOptions &opts,
+                                 const llvm::TargetMachine &TM) const;
+
+  /// Stats keys for the cache of compiled functions.
+  static constexpr const char *kCompileCacheHits =
+      "glow.llvm.compile_cache.hits";
+  static constexpr const char *kCompileCacheMisses =
+      "glow.llvm.compile_cache.misses";
 };
 
 } // namespace glow
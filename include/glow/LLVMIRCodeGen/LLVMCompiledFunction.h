@@ -21,6 +21,11 @@
 #include "glow/Backend/BackendUtils.h"
 #include "glow/Backend/CompiledFunction.h"
 
+#include "llvm/ADT/DenseMap.h"
+
+#include <mutex>
+#include <vector>
+
 namespace glow {
 /// A Glow IR function compiled using LLVM.
 class LLVMCompiledFunction : public CompiledFunction {
@@ -28,6 +33,9 @@ public:
   LLVMCompiledFunction(std::unique_ptr<llvm::orc::GlowJIT> JIT,
                        runtime::RuntimeBundle &&runtimeBundle);
 
+  /// Dtor. Releases the buffers kept alive by the buffer pool.
+  virtual ~LLVMCompiledFunction() override;
+
   /// \name CompiledFunction interface
   ///@{
   virtual llvm::Error execute(ExecutionContext *context) override;
@@ -39,20 +47,102 @@ public:
   ///@}
   //
 
+  /// Map the Placeholders of \p module to their slot in the Placeholder
+  /// address table, so that runs can bind tensors without looking up the
+  /// symbol table by name. The Module may later erase or free them, so a
+  /// Placeholder found in the map is only used if it still has the name of
+  /// its slot. Must be called before the function is executed.
+  void resolvePlaceholders(const Module *module);
+
 protected:
-  /// Load constant tensors from \p bindings into \p weightsAddress, as defined
-  /// by the RuntimeBundle (pre-run).
+  /// The memory blocks needed by a single execution of the function.
+  struct ExecutionBuffers {
+    /// Base address for the activations memory block.
+    uint8_t *activations{nullptr};
+    /// Base address for Mutable weights memory block, Inputs and Outputs.
+    /// Holds the Placeholders which are not bound in place.
+    uint8_t *mutableWeights{nullptr};
+    /// Base address of each Placeholder, indexed by the Placeholder index in
+    /// the RuntimeBundle. This table is what "jitmain" receives as its mutable
+    /// weights argument.
+    std::vector<uint8_t *> placeholderAddrs;
+  };
+
+  /// \returns a set of activation and mutable weight buffers for a run. The
+  /// buffers are taken from the pool if one is available and allocated
+  /// otherwise.
+  ExecutionBuffers acquireBuffers();
+
+  /// Return \p buffers to the pool so that they can be reused by later runs.
+  void releaseBuffers(ExecutionBuffers buffers);
+
+  /// Bind the tensors in \p bindings to the Placeholders of the function
+  /// (pre-run). Tensors are used in place when possible by storing their
+  /// address in the address table of \p buffers, and are copied into the
+  /// mutable weights block of \p buffers otherwise.
   virtual void loadPlaceholders(PlaceholderBindings *bindings,
-                                uint8_t *weightsAddress);
+                                ExecutionBuffers &buffers);
 
-  /// Load weights from \p weightsAddress into applicable backing tensors in
-  /// \p bindings, as defined by the RuntimeBundle (post-run).
+  /// Copy the Placeholders which were not bound in place from \p buffers back
+  /// into the backing tensors in \p bindings, and reset the address table of
+  /// \p buffers (post-run).
   virtual void updatePlaceholders(PlaceholderBindings *bindings,
-                                  uint8_t *weightsAddress);
+                                  ExecutionBuffers &buffers);
 
   /// The LLVM JIT engine. The jit must be initialized after the ctor
   /// initializes the LLVM backends.
   std::unique_ptr<llvm::orc::GlowJIT> JIT_;
+
+private:
+  /// Signature of the "jitmain" entry point.
+  using JitFuncType = void (*)(uint8_t *constantWeightVars,
+                               uint8_t **placeholderAddrs,
+                               uint8_t *activations);
+
+  /// Location of a Placeholder in the mutable weights block, and its name in
+  /// the symbol table.
+  struct PlaceholderSlot {
+    size_t offset{0};
+    size_t size{0};
+    llvm::StringRef name;
+  };
+
+  /// \returns the index of \p PH in the Placeholder address table in \p
+  /// index, or false if \p PH is not used by the function. Placeholders which
+  /// were not resolved, such as the ones of another Module, or whose address
+  /// was reused by another Placeholder are looked up by name.
+  bool getPlaceholderIndex(const Placeholder *PH, size_t &index) const;
+
+  /// The "jitmain" entry point, resolved once at construction. nullptr if the
+  /// symbol could not be resolved.
+  JitFuncType jitmain_{nullptr};
+
+  /// Offset and size of each Placeholder, indexed by the Placeholder index in
+  /// the RuntimeBundle. The size of this table is the size of the Placeholder
+  /// address table.
+  std::vector<PlaceholderSlot> placeholderSlots_;
+
+  /// Maps each Placeholder used by the function to its compile-time index in
+  /// placeholderSlots_. Filled by resolvePlaceholders, the entries are checked
+  /// against the name of the slot.
+  llvm::DenseMap<const Placeholder *, size_t> placeholderIndices_;
+
+  /// Whether placeholderIndices_ has been filled. If not, all the
+  /// Placeholders are looked up by name in the symbol table.
+  bool placeholdersResolved_{false};
+
+  /// Buffers that were used by previous runs and are ready to be reused. The
+  /// pool grows up to the maximum number of concurrent executions.
+  std::vector<ExecutionBuffers> bufferPool_;
+
+  /// Mutex protecting bufferPool_, execute may be called concurrently.
+  std::mutex bufferPoolLock_;
+
+  /// Stats keys for the buffer pool.
+  static constexpr const char *kBufferPoolHits = "glow.llvm.buffer_pool.hits";
+  static constexpr const char *kBufferPoolMisses =
+      "glow.llvm.buffer_pool.misses";
+  static constexpr const char *kBufferPoolBytes = "glow.llvm.buffer_pool.bytes";
 };
 } // end namespace glow
 
@@ -119,6 +119,17 @@ protected:
   llvm::Value *baseMutableWeightVarsAddr_{nullptr};
   /// Value holding the address of the offsets array.
   llvm::Value *offsetsArray_{nullptr};
+  /// If true, the mutable WeightVars argument of the entry function is a table
+  /// holding one base address per Placeholder instead of a single memory block.
+  /// This lets a JIT bind caller-owned tensors without copying them.
+  bool usePlaceholderAddressTable_{false};
+  /// If true, the intra-op parallel runtime of libjit (libjit_parallel_for and
+  /// friends) is provided by the host process instead of the serial fallback
+  /// compiled into libjit.
+  bool useHostParallelRuntime_{false};
+  /// If true, independent instructions of the same ParallelSchedule stage are
+  /// emitted as a parallel region dispatched through libjit_parallel_for.
+  bool useInterOpParallelism_{false};
   /// Maps constant arrays to the constant expressions representing size_t
   /// pointers to these arrays. This is done to ensure the proper uniqueness
   /// semantics of such pointers just like it is done for llvm::Constants.
@@ -248,6 +259,15 @@ public:
   explicit LLVMIRGen(const IRFunction *M, AllocationsInfo &allocationsInfo,
                      std::string mainEntryName, llvm::StringRef libjitBC);
 
+  /// \returns a TargetMachine for a given \p target, \p arch, \p cpu, \p
+  /// targetFeatures and code model \p CM. An empty \p target selects the
+  /// host CPU and its features.
+  static std::unique_ptr<llvm::TargetMachine>
+  createTargetMachine(llvm::StringRef target, llvm::StringRef arch,
+                      llvm::StringRef cpu,
+                      const llvm::SmallVectorImpl<std::string> &targetFeatures,
+                      llvm::CodeModel::Model CM);
+
   /// Init the TargetMachine using a given \p target, \p arch, \p cpu, \p
   /// targetFeatures and code model.
   virtual void
@@ -265,6 +285,13 @@ public:
                                       const glow::Instruction *I);
   /// Emit LLVM-IR for the whole IRFunction.
   virtual void generateLLVMIRForModule(llvm::IRBuilder<> &builder);
+  /// Emit LLVM-IR for the whole IRFunction, running the independent
+  /// instructions of each ParallelSchedule stage concurrently.
+  virtual void generateParallelLLVMIRForModule(llvm::IRBuilder<> &builder);
+  /// Emit a parallel region running the instructions \p stage concurrently.
+  /// Each instruction becomes a task of a libjit_parallel_for call.
+  virtual void emitParallelStage(llvm::IRBuilder<> &builder,
+                                 llvm::ArrayRef<const Instruction *> stage);
   /// Helper function to create a new CallInst, with the specified \p builder,
   /// \p callee, and \p args. Verifies that the function signature is correct,
   /// and then creates and \returns the CallInst.
@@ -296,6 +323,24 @@ public:
   std::string getMainEntryName() const;
   /// Set the name of the main entry point.
   void setMainEntryName(std::string name);
+  /// Set whether mutable WeightVars are addressed through a table of per
+  /// Placeholder base addresses, see usePlaceholderAddressTable_.
+  void setUsePlaceholderAddressTable(bool use) {
+    usePlaceholderAddressTable_ = use;
+  }
+  /// \returns true if mutable WeightVars are addressed through a table of per
+  /// Placeholder base addresses.
+  bool usesPlaceholderAddressTable() const {
+    return usePlaceholderAddressTable_;
+  }
+  /// Set whether the intra-op parallel runtime of libjit is provided by the
+  /// host process, see useHostParallelRuntime_. Must be set before
+  /// initCodeGen.
+  void setUseHostParallelRuntime(bool use) { useHostParallelRuntime_ = use; }
+  /// Set whether independent instructions are run concurrently, see
+  /// useInterOpParallelism_. The instructions of the IRFunction are expected
+  /// to be ordered by ParallelSchedule::reorder.
+  void setUseInterOpParallelism(bool use) { useInterOpParallelism_ = use; }
   /// Creates an LLVM module, the entry function, etc.
   virtual void initCodeGen();
   /// Emits the code of the entry function, performs optimizations, etc.
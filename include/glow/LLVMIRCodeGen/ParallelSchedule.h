@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GLOW_LLVMIRCODEGEN_PARALLELSCHEDULE_H
+#define GLOW_LLVMIRCODEGEN_PARALLELSCHEDULE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include <vector>
+
+namespace glow {
+
+class IRFunction;
+class Instruction;
+
+/// Splits the instructions of an IRFunction in stages. Instructions of the
+/// same stage do not access a common buffer, unless they all only read it, so
+/// they can run concurrently once all of the previous stages have completed.
+/// Memory management instructions (allocations, deallocations and tensor
+/// views) are not part of the stages, they are only assigned the stage where
+/// they take effect.
+class ParallelSchedule {
+public:
+  /// The instructions of a stage, in program order.
+  using StageTy = std::vector<const Instruction *>;
+
+  /// Computes the stages of \p F.
+  explicit ParallelSchedule(const IRFunction &F);
+
+  /// \returns the stages in execution order.
+  llvm::ArrayRef<StageTy> getStages() const { return stages_; }
+
+  /// Reorders the instructions of \p F stage by stage. The allocations of a
+  /// stage are hoisted to its beginning and its deallocations are sunk to its
+  /// end. A memory allocator walking the instructions in order then never
+  /// assigns the same memory to buffers used concurrently by a stage.
+  static void reorder(IRFunction *F);
+
+private:
+  /// The stages of the function.
+  std::vector<StageTy> stages_;
+
+  /// Stage of the allocations, deallocations and tensor views.
+  llvm::DenseMap<const Instruction *, size_t> memoryInstrStages_;
+};
+
+} // namespace glow
+
+#endif // GLOW_LLVMIRCODEGEN_PARALLELSCHEDULE_H
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GLOW_RUNTIME_EXECUTOR_DEVICESELECTOR_H
+#define GLOW_RUNTIME_EXECUTOR_DEVICESELECTOR_H
+
+#include "glow/Backends/DeviceManager.h"
+#include "glow/Runtime/RuntimeTypes.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace glow {
+namespace runtime {
+
+/// Latencies of the runs of one DAGNode on each of its devices, by position
+/// in its deviceIDs. Each latency is an exponential moving average of the
+/// time the device spent executing the function of the node, the time the
+/// run waited in the queue of the device excluded. Zero until the first run
+/// on the device is measured. All the methods are thread-safe.
+class DeviceLatencies final {
+public:
+  /// Creates the latencies of a node running on \p numDevices devices.
+  explicit DeviceLatencies(size_t numDevices)
+      : latencyNs_(new std::atomic<uint64_t>[numDevices]),
+        numDevices_(numDevices) {
+    for (size_t i = 0; i < numDevices; i++) {
+      latencyNs_[i] = 0;
+    }
+  }
+
+  /// \returns the average latency in nanoseconds of the device at position
+  /// \p index.
+  uint64_t get(size_t index) const { return latencyNs_[index].load(); }
+
+  /// Adds the execution time \p latency of a run on the device at position
+  /// \p index to its average.
+  void record(size_t index, std::chrono::nanoseconds latency);
+
+  /// \returns the number of devices.
+  size_t size() const { return numDevices_; }
+
+private:
+  std::unique_ptr<std::atomic<uint64_t>[]> latencyNs_;
+  size_t numDevices_;
+};
+
+/// Picks the device running a DAGNode among its deviceIDs according to a
+/// DeviceSelectionPolicy. The runs in flight are counted by the
+/// DeviceManagers themselves and the latencies by node, the selector only
+/// reads atomics and takes no lock. The Executor reports the runs with
+/// acquire() and release(). All the methods are thread-safe.
+class DeviceSelector final {
+public:
+  /// Creates a selector of the devices of \p deviceManagers applying
+  /// \p policy.
+  DeviceSelector(const DeviceManagerMapTy &deviceManagers,
+                 DeviceSelectionPolicy policy)
+      : deviceManagers_(deviceManagers), policy_(policy) {}
+
+  /// \returns the position in the deviceIDs of \p node of the device which
+  /// should run it, counting one more run in flight on it. \p latencies are
+  /// the latencies of \p node, used by the LatencyWeighted policy.
+  size_t acquire(DAGNode *node, const DeviceLatencies &latencies);
+
+  /// Counts the end of a run of \p node on the device at position \p index
+  /// in its deviceIDs. \p executionTime is the time the device spent
+  /// executing a successful run, which is added to \p latencies, or zero if
+  /// the run should not be measured.
+  void release(const DAGNode *node, size_t index, DeviceLatencies &latencies,
+               std::chrono::nanoseconds executionTime =
+                   std::chrono::nanoseconds::zero());
+
+  /// \returns the policy of the selector.
+  DeviceSelectionPolicy getPolicy() const { return policy_; }
+
+private:
+  /// \returns the DeviceManager of device \p id, or nullptr if there is none.
+  DeviceManager *getDevice(DeviceIDTy id) const;
+
+  /// \returns the number of runs in flight on device \p id.
+  unsigned getInflight(DeviceIDTy id) const;
+
+  /// The devices, the map is not modified while the Executor runs.
+  const DeviceManagerMapTy &deviceManagers_;
+
+  /// The policy of the selector.
+  const DeviceSelectionPolicy policy_;
+};
+
+} // namespace runtime
+} // namespace glow
+
+#endif // GLOW_RUNTIME_EXECUTOR_DEVICESELECTOR_H
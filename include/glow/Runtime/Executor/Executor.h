@@ -48,6 +48,15 @@ public:
                    std::unique_ptr<ExecutionContext> context,
                    RunIdentifierTy runId, ResultCBTy cb) = 0;
 
+  /// Prepares the runs of the DAG specified by \p root, reserving the
+  /// resources of \p concurrentRuns concurrent runs ahead of time so that they
+  /// are not allocated by the first runs. Does nothing by default.
+  virtual void prepare(const DAGNode *root, size_t concurrentRuns) {}
+
+  /// Releases the resources of the runs of the DAG specified by \p root, which
+  /// has no runs left and is about to be destroyed. Does nothing by default.
+  virtual void release(const DAGNode *root) {}
+
   /// Shutdown the Executor. Should block until all active requests are complete
   /// and prevent new requests from being initiated.
   virtual void shutdown() = 0;
@@ -16,11 +16,19 @@
 #ifndef GLOW_RUNTIME_THREAD_POOL_EXECUTOR_H
 #define GLOW_RUNTIME_THREAD_POOL_EXECUTOR_H
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <limits>
 #include <mutex>
+#include <memory>
+#include <shared_mutex>
 #include <unordered_map>
+#include <vector>
 
+#include "glow/Runtime/Executor/DeviceSelector.h"
 #include "glow/Runtime/Executor/Executor.h"
+#include "glow/Runtime/StatsExporter.h"
 #include "glow/Support/TensorPool.h"
 #include "glow/Support/ThreadPool.h"
 
@@ -53,23 +61,128 @@ private:
   std::condition_variable cv_;
 };
 
+class ExecutionState;
+
+/// Dense description of the DAG of a network, computed when it is prepared or
+/// first run and shared by all of its runs. The nodes are numbered in
+/// breadth-first order from the root so that the state of a run is indexed by
+/// node number. The plan also pools the ExecutionStates of the runs.
+class ExecutionPlan final
+    : public std::enable_shared_from_this<ExecutionPlan> {
+public:
+  /// A node of the DAG.
+  struct Node {
+    DAGNode *node;
+    /// Number of parents of the node, the root excluded.
+    unsigned numParents;
+    /// Numbers of the children of the node.
+    std::vector<unsigned> children;
+    /// The Placeholders of the node's symbol table, from the Module.
+    std::vector<Placeholder *> placeholders;
+    /// Latencies of the runs of the node on its devices, which weigh the
+    /// devices for the DeviceSelector.
+    std::unique_ptr<DeviceLatencies> latencies;
+    /// Latencies in microseconds of the runs of the node on its devices and
+    /// of the copies of its inputs and outputs reported by the backend.
+    Histogram *deviceTime;
+    Histogram *inputCopyTime;
+    Histogram *outputCopyTime;
+  };
+
+  /// Builds the plan of the DAG whose root is \p root.
+  explicit ExecutionPlan(const DAGNode *root);
+
+  ~ExecutionPlan();
+
+  /// \returns the nodes of the DAG.
+  const std::vector<Node> &getNodes() const { return nodes_; }
+
+  /// \returns the numbers of the children of the root.
+  const std::vector<unsigned> &getRootNodes() const { return rootNodes_; }
+
+  /// \returns the Module of the network.
+  Module *getModule() const { return module_; }
+
+  /// \returns an ExecutionState for a new run, which returns to the pool of
+  /// this plan once released.
+  std::shared_ptr<ExecutionState> acquireState();
+
+  /// \returns the pool of the tensors passed between the nodes, shared by
+  /// all the runs.
+  TensorPool &getIntermediateTensorPool() { return intermediateTensorPool_; }
+
+  /// Adds to the pool the intermediate tensors of \p runs more concurrent
+  /// runs.
+  void reserveIntermediates(size_t runs);
+
+  /// Exports the statistics of the intermediate tensor pool if it allocated
+  /// tensors since the last export. Cheap enough to be called by every run.
+  void exportStats();
+
+  /// \returns the histogram of the time in microseconds between a node being
+  /// ready to run and its submission to a device.
+  Histogram *getDispatchTime() const { return dispatchTime_; }
+
+  /// Releases the histograms of the plan from the registry, once no run of
+  /// the plan is in flight.
+  void releaseHistograms();
+
+private:
+  /// The nodes of the DAG.
+  std::vector<Node> nodes_;
+  /// The numbers of the children of the root.
+  std::vector<unsigned> rootNodes_;
+  /// Module of the network.
+  Module *module_{nullptr};
+  /// The Placeholders output by a node and input of another one.
+  std::vector<Placeholder *> intermediates_;
+  /// Object pool for intermediate tensors.
+  TensorPool intermediateTensorPool_;
+  /// Names of the statistics of intermediateTensorPool_.
+  std::string poolBuffersKey_;
+  std::string poolAllocsKey_;
+  std::string poolInlineAllocsKey_;
+  /// Number of allocations of intermediateTensorPool_ at the last export of
+  /// its statistics.
+  std::atomic<uint64_t> exportedAllocs_{std::numeric_limits<uint64_t>::max()};
+  /// See getDispatchTime().
+  Histogram *dispatchTime_;
+  /// Names of the histograms of the plan and of its nodes.
+  std::vector<std::string> histogramKeys_;
+  /// The ExecutionStates which are not used by a run.
+  std::vector<std::unique_ptr<ExecutionState>> freeStates_;
+  /// Mutex for freeStates_.
+  std::mutex freeStatesLock_;
+};
+
 /// This class keeps track of the state of execution for a run (identified
-/// by the runId).
+/// by the runId). States are reused across the runs of a DAG so that setting
+/// up a run does not allocate, except for the bindings of its tensors.
 class ExecutionState final {
 public:
-  /// Constructor.
-  explicit ExecutionState(RunIdentifierTy id, const DAGNode *root,
-                          ThreadExecutor *executor,
-                          std::unique_ptr<ExecutionContext> resultContext,
-                          ResultCBTy doneCb);
+  /// Constructor of a state for the runs of \p plan.
+  explicit ExecutionState(ExecutionPlan &plan);
+
+  /// Prepares the state for the run \p id, whose results go in
+  /// \p resultContext and which calls \p doneCb with them. Binds the inputs
+  /// of all the nodes, allocating the intermediate tensors from the pool of
+  /// the plan.
+  void init(RunIdentifierTy id, std::unique_ptr<ExecutionContext> resultContext,
+            ResultCBTy doneCb);
+
+  /// Drops the references of the finished run before the state is reused.
+  void reset();
 
-  /// Does the BFS traversal and initializes the ExecutionState.
-  void init();
+  /// \returns the plan of the DAG.
+  const ExecutionPlan &getPlan() const { return plan_; }
 
-  /// \returns a unique pointer to an input bindings for \p node. This should
-  /// not be called at the same time as insertIntoNodeCtx().
-  std::unique_ptr<ExecutionContext>
-  getUniqueNodeContextPtr(const DAGNode *node);
+  /// \returns a unique pointer to an input bindings for node \p node. This
+  /// should not be called at the same time as insertIntoNodeCtx().
+  std::unique_ptr<ExecutionContext> getUniqueNodeContextPtr(unsigned node);
+
+  /// Gives back \p ctx, the context of node \p node returned by the
+  /// DeviceManager, to be reused by the next run.
+  void recycleNodeContext(unsigned node, std::unique_ptr<ExecutionContext> ctx);
 
   /// Increment the count of inflight nodes by \p increment (default is 1).
   void incrementInflightNodes(unsigned increment = 1);
@@ -79,10 +192,10 @@ public:
   /// operation.
   bool decrementInflightNodes(unsigned decrement = 1);
 
-  /// Increment the count of completed parent nodes for \p node. \returns
+  /// Increment the count of completed parent nodes for node \p node. \returns
   /// true if all parents are done after the increment operation, false
   /// otherwise.
-  bool incrementNodeParentsDone(const DAGNode *node, unsigned increment = 1);
+  bool incrementNodeParentsDone(unsigned node, unsigned increment = 1);
 
   /// Move all events from the provided vector into the top level resultContxt.
   void insertIntoTraceContext(TraceContext *runCtx);
@@ -108,83 +221,103 @@ public:
   /// \returns the run ID for the execution.
   RunIdentifierTy getRunId() const { return runId_; }
 
-  /// \returns the Executor used for this run.
-  ThreadExecutor *getExecutor() { return executor_; }
-
   /// Whether or not this node has been initialized.
   bool initialized_{false};
 
 private:
+  /// The plan of the DAG.
+  ExecutionPlan &plan_;
   /// The run identifier for this execution of a DAG.
-  RunIdentifierTy runId_;
+  RunIdentifierTy runId_{0};
   /// The callback that should be called when execution is done.
   ResultCBTy cb_;
   /// The ExecutionContext object containing the results of the execution
   /// (i.e. the outputs of the DAGNodes that have no children).
   std::unique_ptr<ExecutionContext> resultCtx_;
-  /// Counters for how many of each nodes parents are done. These are needed
-  /// in order to determine when a node is ready to be executed.
-  std::unordered_map<const DAGNode *, std::atomic<unsigned>> nodeParentsDone_;
-  /// Input contexts for all of the nodes. These are gradually
-  /// populated as a node's parents finish.
-  std::unordered_map<const DAGNode *, std::unique_ptr<ExecutionContext>>
-      inputCtxs_;
+  /// Counters for how many of each nodes parents are done, by node number.
+  /// These are needed in order to determine when a node is ready to be
+  /// executed.
+  std::unique_ptr<std::atomic<unsigned>[]> nodeParentsDone_;
+  /// Input contexts for all of the nodes, by node number. They are kept
+  /// across runs with their bindings and TraceContexts, which each run points
+  /// to its own tensors and events.
+  std::vector<std::unique_ptr<ExecutionContext>> inputCtxs_;
   /// Placeholders for tensors generated by DAG nodes that aren't the final
   /// output (i.e. they have children). The owning pointer for these tensors
   /// exists in the resultCtx and are removed before the ResultCB is called.
   std::vector<Placeholder *> intermediatePlaceholders_;
   /// This is populated with the roots when a run starts, and does not become
   /// empty until execution finishes.
-  std::atomic<unsigned> inflightNodes_;
+  std::atomic<unsigned> inflightNodes_{0};
   /// Value that is used to track if an Error was received.
   OneErrOnly errContainer_;
-  /// Module for the network. This contains the PHs used by the functions in
-  /// this network.
-  Module *module_{nullptr};
-  /// Root node of the DAG for this run.
-  const DAGNode *root_;
-  /// Object pool for intermediate tensors.
-  TensorPool intermediateTensorPool_;
-  /// Thread Executor used for this run.
-  ThreadExecutor *executor_;
 };
 
 /// This implementation of the Executor interface uses a thread pool to
 /// handle and process multiple concurrent execution runs.
 class ThreadPoolExecutor final : public Executor {
 public:
-  /// Constructor.
+  /// Constructor. The runs of a node are balanced over its devices with
+  /// \p policy.
   explicit ThreadPoolExecutor(const DeviceManagerMapTy &deviceManagers,
-                              unsigned numWorkers = kNumWorkers)
-      : threadPool_(numWorkers), deviceManagers_(deviceManagers) {}
+                              unsigned numWorkers = kNumWorkers,
+                              DeviceSelectionPolicy policy =
+                                  DeviceSelectionPolicy::LeastOutstanding)
+      : threadPool_(numWorkers), deviceManagers_(deviceManagers),
+        deviceSelector_(deviceManagers, policy) {}
 
   /// See Executor::run. A particular invocation is specified completely by
   /// the triple (roots, bindings, runId).
   void run(const DAGNode *root, std::unique_ptr<ExecutionContext> context,
            RunIdentifierTy runId, ResultCBTy cb) override;
 
+  /// See Executor::prepare. Builds the plan of the DAG and reserves its
+  /// intermediate tensors.
+  void prepare(const DAGNode *root, size_t concurrentRuns) override;
+
+  /// See Executor::release. Drops the plan of the DAG.
+  void release(const DAGNode *root) override;
+
+  /// \returns the plan of the DAG whose root is \p root, building it on the
+  /// first run.
+  std::shared_ptr<ExecutionPlan> getPlan(const DAGNode *root);
+
   ~ThreadPoolExecutor() override { shutdown(); }
 
   void shutdown() override;
 
 private:
-  /// Execute the DAG node specified by \p node within the run corresponding to
-  /// \p executionState.
+  /// Execute the DAG node number \p node within the run corresponding to
+  /// \p executionState. The node became ready to run at \p readyTime.
   void executeDAGNode(std::shared_ptr<ExecutionState> executionState,
-                      DAGNode *node);
+                      unsigned node,
+                      std::chrono::steady_clock::time_point readyTime);
+
+  /// Ends the node of the run of \p executionState which is not run because
+  /// of \p err, or because the run already failed if \p err is success.
+  /// Finishes the run if it was the last node in flight.
+  void finishNodeWithoutRun(std::shared_ptr<ExecutionState> executionState,
+                            llvm::Error err);
+
+  /// Removes the intermediate Placeholders of the run of \p executionState,
+  /// whose nodes are all done, and calls its callback.
+  void finishRun(ExecutionState &executionState);
 
   /// Handle the result returned asynchronously by the DeviceManager.
   /// \p executionState is tracks the state of the run that the node that
   /// finished executing belongs to, \p err is the llvm::Error returned by the
   /// DeviceManager, \p ctx is the ExecutionContext that contains the outputs
-  /// produced by \p node during the run.
+  /// produced by node number \p node during the run, returned by the
+  /// DeviceManager at \p doneTime.
   ///
   /// The main purpose of this function is to help move computation off of the
   /// DeviceManager thread pool on onto the one owned by this class.
-  void handleDeviceManagerResult(std::shared_ptr<ExecutionState> executionState,
-                                 llvm::Error err,
-                                 std::unique_ptr<ExecutionContext> ctx,
-                                 const DAGNode *node);
+  void
+  handleDeviceManagerResult(std::shared_ptr<ExecutionState> executionState,
+                            llvm::Error err,
+                            std::unique_ptr<ExecutionContext> ctx,
+                            unsigned node,
+                            std::chrono::steady_clock::time_point doneTime);
 
   /// The default number of workers in the thread pool.
   constexpr static unsigned kNumWorkers = 3;
@@ -192,11 +325,18 @@ private:
   ThreadPool threadPool_;
   /// Map of available DeviceManagers.
   const DeviceManagerMapTy &deviceManagers_;
+  /// Picks the devices running the nodes.
+  DeviceSelector deviceSelector_;
   /// Barrier for making sure all asynchronous requests made to the
   /// DeviceManager return before allowing destruction of the executor.
   InflightBarrier inflightBarrier_;
   /// Whether the executor is currently shutting down or not.
   std::atomic<bool> shuttingDown_{false};
+  /// The plans of the DAGs, by root. The runs in flight keep their plan
+  /// alive once it is released.
+  std::unordered_map<const DAGNode *, std::shared_ptr<ExecutionPlan>> plans_;
+  /// Guards plans_, which is only written by the first run of a DAG.
+  std::shared_timed_mutex plansLock_;
 };
 
 } // namespace runtime
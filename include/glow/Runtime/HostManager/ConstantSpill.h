@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GLOW_RUNTIME_HOSTMANAGER_CONSTANTSPILL_H
+#define GLOW_RUNTIME_HOSTMANAGER_CONSTANTSPILL_H
+
+#include "glow/Graph/Graph.h"
+#include "glow/Support/Error.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace glow {
+namespace runtime {
+
+/// Keeps the payloads of the Constants of a Module in a file, so that the
+/// Module can be stripped while the networks evicted by the residency manager
+/// can still be loaded back on their devices.
+class ConstantSpill final {
+public:
+  /// Writes the payloads of the Constants of \p module to a new file in
+  /// directory \p dir, or in the system temporary directory if \p dir is
+  /// empty. \returns the spill or an error if the file can not be written.
+  static llvm::Expected<std::unique_ptr<ConstantSpill>>
+  create(const Module &module, llvm::StringRef dir);
+
+  /// Removes the file.
+  ~ConstantSpill();
+
+  /// Reads the payloads of \p constants back from the file. The Constants
+  /// must have been spilled and then stripped. \returns an error if the file
+  /// can not be read.
+  llvm::Error restore(llvm::ArrayRef<Constant *> constants) const;
+
+  /// \returns the path of the file.
+  llvm::StringRef getPath() const { return path_; }
+
+private:
+  ConstantSpill() = default;
+
+  /// Path of the file.
+  std::string path_;
+
+  /// Offset of the payload of every spilled Constant in the file.
+  std::unordered_map<const Constant *, uint64_t> offsets_;
+};
+
+} // namespace runtime
+} // namespace glow
+
+#endif // GLOW_RUNTIME_HOSTMANAGER_CONSTANTSPILL_H
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GLOW_RUNTIME_HOSTMANAGER_DYNAMICBATCHER_H
+#define GLOW_RUNTIME_HOSTMANAGER_DYNAMICBATCHER_H
+
+#include "glow/ExecutionContext/ExecutionContext.h"
+#include "glow/Runtime/RuntimeTypes.h"
+
+#include "llvm/ADT/StringMap.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace glow {
+namespace runtime {
+
+/// Coalesces concurrent requests of the same network into a single request.
+/// A request is batchable when every tensor of its PlaceholderBindings has the
+/// shape of its Placeholder except for dimension 0, and all of them have the
+/// same number of rows k, no larger than the Placeholders' common dimension 0
+/// N. Requests binding the same Placeholders are concatenated along dimension
+/// 0 into one ExecutionContext of N rows, padded with zeros, which is
+/// dispatched once full or once its first request waited for the network's
+/// maximum delay. When the batch finishes, the rows of each request are copied
+/// back to its output tensors, and its callback is called with its own copy of
+/// the error of the batch.
+class DynamicBatcher final {
+public:
+  /// The Placeholders written by a network.
+  using OutputsTy = std::unordered_set<const Placeholder *>;
+
+  /// Function running the batched request \p context of network \p name and
+  /// calling \p callback when done.
+  using DispatchFnTy =
+      std::function<void(llvm::StringRef name,
+                         std::unique_ptr<ExecutionContext> context,
+                         ResultCBTy callback)>;
+
+  /// Names of the statistics exported through Stats().
+  static constexpr const char *kBatchRows = "glow.hostmanager.batching.rows";
+  static constexpr const char *kBatchRequests =
+      "glow.hostmanager.batching.requests";
+
+  /// Creates a batcher running its batches with \p dispatch.
+  explicit DynamicBatcher(DispatchFnTy dispatch);
+
+  /// Dispatches the pending batches and stops the batching thread.
+  ~DynamicBatcher();
+
+  /// Batches the requests of network \p name, whose outputs are \p outputs,
+  /// waiting at most \p maxDelay for requests to join a batch.
+  void enable(llvm::StringRef name, std::chrono::microseconds maxDelay,
+              OutputsTy outputs);
+
+  /// Stops batching the requests of network \p name, dispatching its pending
+  /// batch.
+  void disable(llvm::StringRef name);
+
+  /// \returns true if the requests of network \p name are batched.
+  bool isEnabled(llvm::StringRef name);
+
+  /// Adds the request \p runID of network \p name to its pending batch.
+  /// \returns true and takes \p context and \p callback if the request is
+  /// batchable, \returns false and leaves them untouched otherwise.
+  bool submit(llvm::StringRef name, RunIdentifierTy runID,
+              std::unique_ptr<ExecutionContext> &context,
+              ResultCBTy &callback);
+
+  /// Dispatches all the pending batches immediately, and waits for the
+  /// batching thread to dispatch the ones it is handling.
+  void flush();
+
+private:
+  /// A request waiting in a batch.
+  struct Request {
+    RunIdentifierTy runID;
+    std::unique_ptr<ExecutionContext> context;
+    ResultCBTy callback;
+    /// Offset of the rows of the request in the batch.
+    size_t offset;
+  };
+
+  /// The requests batched together.
+  struct Batch {
+    std::vector<Request> requests;
+    /// The rows used by the requests, and the rows of the batch.
+    size_t rows{0};
+    size_t batchSize{0};
+    /// When the batch must be dispatched.
+    std::chrono::steady_clock::time_point deadline;
+    /// The outputs of the network, copied back to the requests.
+    std::shared_ptr<const OutputsTy> outputs;
+  };
+
+  /// The batching state of a network.
+  struct NetworkState {
+    std::chrono::microseconds maxDelay;
+    std::shared_ptr<const OutputsTy> outputs;
+    Batch pending;
+  };
+
+  /// Runs the batches.
+  DispatchFnTy dispatch_;
+
+  /// The networks whose requests are batched, by name.
+  llvm::StringMap<NetworkState> networks_;
+
+  /// Set while the batching thread dispatches expired batches.
+  size_t dispatching_{0};
+
+  /// Guards networks_, dispatching_ and stop_.
+  std::mutex lock_;
+
+  /// Signaled when a batch is created, when the batching thread is done
+  /// dispatching and when the batcher stops.
+  std::condition_variable cv_;
+
+  /// Dispatches the batches whose deadline passed.
+  std::thread thread_;
+
+  /// Set when the batching thread must exit.
+  bool stop_{false};
+
+  /// Body of thread_.
+  void run();
+
+  /// \returns the pending batch of \p state, leaving an empty one in its place.
+  /// Must be called with lock_ held.
+  static Batch takeBatch(NetworkState &state);
+
+  /// Concatenates the requests of \p batch of network \p name and runs them.
+  void dispatchBatch(llvm::StringRef name, Batch batch);
+};
+
+} // namespace runtime
+} // namespace glow
+
+#endif // GLOW_RUNTIME_HOSTMANAGER_DYNAMICBATCHER_H
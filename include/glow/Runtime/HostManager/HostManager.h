@@ -18,9 +18,14 @@
 #include "glow/Backend/Backend.h"
 #include "glow/Backends/DeviceManager.h"
 #include "glow/Graph/Graph.h"
+#include "glow/Runtime/HostManager/ConstantSpill.h"
 #include "glow/Runtime/RuntimeTypes.h"
+#include "glow/Runtime/StatsExporter.h"
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <mutex>
 #include <unordered_map>
@@ -29,6 +34,8 @@
 namespace glow {
 namespace runtime {
 
+class DynamicBatcher;
+
 class Executor;
 
 class Provisioner;
@@ -45,10 +52,84 @@ class HostManager final {
     // Module that was used to create this network. Everything except
     // placeholders and types have been removed from it.
     std::shared_ptr<Module> module;
+    /// The constants of module, from which the residency manager reloads the
+    /// network once evicted. Null if residency is disabled.
+    std::shared_ptr<ConstantSpill> constants;
 
     /// use an atomic refcount rather than just store a shared_ptr for thread
     /// safety.
-    std::atomic<size_t> refcount;
+    std::atomic<size_t> refcount{0};
+
+    /// Number of requests of this network in the admission queue. Guarded by
+    /// queueLock_.
+    size_t queuedRequests{0};
+
+    /// Version of the network, 0 for the one added by addNetwork.
+    unsigned version{0};
+
+    /// Name of the statistic receiving the latencies of the runs of this
+    /// version.
+    std::string latencyKey;
+
+    /// Whether the latencies of the runs are exported, which is the case
+    /// while a candidate version of the network is staged.
+    std::atomic<bool> measureLatency{false};
+
+    /// Set once the version stopped receiving requests and waits for its
+    /// runs to finish before being evicted.
+    std::atomic<bool> retired{false};
+
+    /// Whether the functions of the network are loaded on its devices. Only
+    /// cleared by the residency manager, see
+    /// HostConfig::enableNetworkResidency. Written under networkLock_.
+    std::atomic<bool> resident{true};
+
+    /// Value of useClock_ at the last request of the network, the least
+    /// recently used networks are evicted first. Guarded by networkLock_.
+    uint64_t lastUsed{0};
+
+    /// Latencies in microseconds of the requests of the network from their
+    /// arrival to their callback, and of their wait in the admission queue.
+    /// Shared by the versions of the network.
+    Histogram *requestLatency{nullptr};
+    Histogram *queueWait{nullptr};
+  };
+
+  /// The versions of a network. Requests are run by the active version, and
+  /// a percentage of them is mirrored to the candidate version while one is
+  /// staged. Guarded by networkLock_.
+  struct NetworkVersions {
+    /// The version running the requests of the network.
+    std::unique_ptr<NetworkData> active;
+
+    /// The version staged by addNetworkVersion, only running the mirrored
+    /// requests until it is promoted.
+    std::unique_ptr<NetworkData> candidate;
+
+    /// Set while addNetworkVersion compiles a new version of the network.
+    bool compilingVersion{false};
+
+    /// Version number of the next version of the network.
+    unsigned nextVersion{1};
+
+    /// Percentage of the requests mirrored to the candidate version.
+    unsigned mirrorPercent{0};
+
+    /// Number of requests of the network, picks the mirrored ones.
+    uint64_t requestCount{0};
+  };
+
+  /// A request waiting in the admission queue for an active request slot.
+  struct QueuedRequest {
+    NetworkData *network;
+    std::string networkName;
+    std::unique_ptr<ExecutionContext> context;
+    ResultCBTy callback;
+    RunIdentifierTy runID;
+    /// When the request entered the queue.
+    std::chrono::steady_clock::time_point enqueueTime;
+    /// When the request was received by runNetwork().
+    std::chrono::steady_clock::time_point arrivalTime;
   };
 
   /// Count of current in-flight networks being run. Atomic to allow
@@ -59,16 +140,41 @@ class HostManager final {
   /// concurrency in runNetwork.
   std::atomic<size_t> totalRequestCount_{0};
 
+  /// FIFO of the requests waiting for activeRequestCount_ to drop below
+  /// HostConfig::maxActiveRequests, in arrival order.
+  std::deque<QueuedRequest> queue_;
+
+  /// Mutex for queue_. activeRequestCount_ is only incremented while holding
+  /// it, so that a new request can not overtake the queued ones.
+  std::mutex queueLock_;
+
   /// Configuration parameters for this Runtime Host.
   const HostConfig config_{};
 
-  /// A map from a networkName to a network, which is represented by struct DAG.
-  std::unordered_map<std::string, NetworkData> networks_;
+  /// A map from a networkName to the versions of the network, each one
+  /// represented by struct DAG.
+  std::unordered_map<std::string, NetworkVersions> networks_;
 
   /// Mutex for networks_ since runNetwork, addNetwork, and
   /// removeNetwork can all be called concurrently, a guard is needed.
   std::mutex networkLock_;
 
+  /// Signaled when a retired network version has no more runs. Used with
+  /// networkLock_.
+  std::condition_variable drainCV_;
+
+  /// Mutex for provisioner_, which addNetworkVersion uses without holding
+  /// networkLock_. Always acquired after networkLock_ when both are held.
+  std::mutex provisionLock_;
+
+  /// Serializes the evictions and reloads of networks by the residency
+  /// manager. Always acquired before networkLock_.
+  std::mutex residencyLock_;
+
+  /// Counts the requests of all the networks, orders their last uses.
+  /// Guarded by networkLock_.
+  uint64_t useClock_{0};
+
   /// A map of DeviceManagers by deviceID. An ordered map is used here to allow
   /// a stable iteration order over devices.
   DeviceManagerMapTy devices_;
@@ -81,7 +187,120 @@ class HostManager final {
   /// onto the devices.
   std::unique_ptr<Provisioner> provisioner_;
 
+  /// Coalesces the concurrent requests of the networks with dynamic batching
+  /// enabled.
+  std::unique_ptr<DynamicBatcher> batcher_;
+
+  /// Implementation of runNetwork. The request is handed to the dynamic
+  /// batcher if \p allowBatching is set, which is not the case for the
+  /// requests built by the batcher itself.
+  RunIdentifierTy runNetworkImpl(llvm::StringRef networkName,
+                                 std::unique_ptr<ExecutionContext> context,
+                                 ResultCBTy callback, bool allowBatching);
+
+  /// Hands the request \p runID of \p network to the executor. The caller
+  /// must have reserved an active request slot for it. The latency of the
+  /// request is measured from \p arrivalTime, unless it is
+  /// time_point::max() for a run which is not a request of a client.
+  void dispatchRun(NetworkData *network, llvm::StringRef networkName,
+                   std::unique_ptr<ExecutionContext> context,
+                   RunIdentifierTy runID, ResultCBTy callback,
+                   std::chrono::steady_clock::time_point arrivalTime);
+
+  /// Sets the histograms of \p network, a version of network \p name.
+  static void initNetworkStats(NetworkData &network, llvm::StringRef name);
+
+  /// Releases the histograms of network \p name, once all of its versions
+  /// are removed. The histograms of the runs of every version are released
+  /// by the executor when the version is retired or removed.
+  static void releaseNetworkStats(llvm::StringRef name);
+
+  /// Runs request \p runID on the candidate version \p network with
+  /// \p context, a copy of the context of the request, discarding the
+  /// results. The run is skipped if no active request slot is free.
+  void mirrorRun(NetworkData *network, llvm::StringRef networkName,
+                 std::unique_ptr<ExecutionContext> context,
+                 RunIdentifierTy runID);
+
+  /// Drops a reference on \p network taken by a request, waking up
+  /// retireNetwork() if it was the last run of a retired version.
+  void releaseNetwork(NetworkData *network);
+
+  /// Optimizes and partitions the functions of \p module for the devices of
+  /// the host, see addNetwork.
+  llvm::Expected<DAGListTy> partitionNetwork(Module &module,
+                                             CompilationContext &cctx,
+                                             bool saturateHost);
+
+  /// Evicts the functions of \p network from the devices and the
+  /// provisioner. \p network must not have runs in flight.
+  llvm::Error evictNetwork(NetworkData &network);
+
+  /// Waits for the runs of \p network, a version which does not receive
+  /// requests anymore, to finish and evicts it. Blocks the calling thread, so
+  /// it must not be called from a result callback of \p network.
+  llvm::Error retireNetwork(std::unique_ptr<NetworkData> network);
+
+  /// Evicts the least recently used idle networks from the devices until
+  /// every device in \p required has the memory given for it available, and
+  /// the devices together have \p totalRequired bytes available. Must be
+  /// called with residencyLock_ held. \returns an error if no idle network
+  /// is left to evict.
+  llvm::Error
+  evictIdleNetworks(const std::map<DeviceIDTy, uint64_t> &required,
+                    uint64_t totalRequired);
+
+  /// Loads the functions of \p network, which was evicted by the residency
+  /// manager, back on their devices, making room for them first.
+  llvm::Error reloadNetwork(NetworkData *network);
+
+  /// Strips the constants of \p module once its networks are on their
+  /// devices. With HostConfig::enableNetworkResidency they are kept in a file
+  /// first, \returns that file or nullptr. If the file can not be written the
+  /// module keeps its constants.
+  std::shared_ptr<ConstantSpill> stripModule(Module &module);
+
+  /// Evicts the functions of \p network from its devices, keeping them in
+  /// the provisioner for reloadNetwork().
+  llvm::Error unloadNetwork(NetworkData &network);
+
+  /// Refuses \p request with an error of code RUNTIME_REQUEST_REFUSED and
+  /// message \p msg.
+  void refuseRequest(QueuedRequest request, llvm::StringRef msg);
+
+  /// Removes from the queue the requests which waited longer than
+  /// HostConfig::maxQueueWaitMs, appending them to \p expired. Must be called
+  /// with queueLock_ held.
+  void popExpiredRequests(std::vector<QueuedRequest> &expired);
+
+  /// Admits the queued requests while there are free active request slots and
+  /// refuses the ones which waited for too long.
+  void drainQueue();
+
+  /// Removes \p request from the queue bookkeeping and reports the time it
+  /// spent in the queue. Must be called with queueLock_ held.
+  void dequeued(const QueuedRequest &request);
+
 public:
+  /// Names of the HostManager statistics exported through Stats().
+  static constexpr const char *kQueueDepth = "glow.hostmanager.queue.depth";
+  static constexpr const char *kQueueWaitUs = "glow.hostmanager.queue.wait_us";
+  static constexpr const char *kQueueTimeouts =
+      "glow.hostmanager.queue.timeouts";
+  static constexpr const char *kRequestsRefused =
+      "glow.hostmanager.requests_refused";
+  static constexpr const char *kMirroredRequests =
+      "glow.hostmanager.mirror.requests";
+  static constexpr const char *kMirrorsSkipped =
+      "glow.hostmanager.mirror.skipped";
+  static constexpr const char *kMirrorErrors = "glow.hostmanager.mirror.errors";
+  static constexpr const char *kNetworkEvictions =
+      "glow.hostmanager.residency.evictions";
+  static constexpr const char *kNetworkReloads =
+      "glow.hostmanager.residency.reloads";
+  static constexpr const char *kReloadLatencyUs =
+      "glow.hostmanager.residency.reload_us";
+
   /// Default constructor.
   HostManager() = default;
 
@@ -102,10 +321,46 @@ public:
   /// operation. This function consumes the \p module so any pointers to data
   /// contained within the module should be considered invalid. The function is
   /// optimized based on \p cctx. If \p saturateHost is set to true the
-  /// HostManager will try to use all available devices on the host.
+  /// HostManager will try to use all available devices on the host. With
+  /// HostConfig::enableNetworkResidency the least recently used idle networks
+  /// are evicted from the devices to make room for the network.
   llvm::Error addNetwork(std::unique_ptr<Module> module,
                          CompilationContext &cctx, bool saturateHost = false);
 
+  /// Compiles the functions of \p module as new versions of the networks of
+  /// the same names, which must have been added before. The new versions are
+  /// partitioned and provisioned while the current ones keep running the
+  /// requests, and are staged as candidates until promoteNetworkVersion is
+  /// called. They must keep the names of the Placeholders of the networks, by
+  /// which the requests are bound. Consumes \p module like addNetwork.
+  /// \returns an error if a network is not found or already has a candidate.
+  llvm::Error addNetworkVersion(std::unique_ptr<Module> module,
+                                CompilationContext &cctx,
+                                bool saturateHost = false);
+
+  /// Mirrors \p percent percent of the requests of network \p networkName to
+  /// its candidate version. The mirrored requests run on a copy of their
+  /// context, their results are discarded and the latencies of both versions
+  /// are exported as glow.hostmanager.<networkName>.v<version>.latency_us.
+  /// \returns an error if the network has no candidate version.
+  llvm::Error setNetworkMirrorPercent(llvm::StringRef networkName,
+                                      unsigned percent);
+
+  /// Atomically switches the requests of network \p networkName to its
+  /// candidate version, then waits for the runs of the previous version to
+  /// finish and evicts it. \returns an error if the network has no candidate
+  /// version. Must not be called from the result callback of a request of
+  /// the network, which would wait for its own run and deadlock.
+  llvm::Error promoteNetworkVersion(llvm::StringRef networkName);
+
+  /// Evicts the candidate version of network \p networkName, if any, once
+  /// its mirrored runs finished. Like promoteNetworkVersion, must not be
+  /// called from the result callback of a request of the network.
+  llvm::Error discardNetworkVersion(llvm::StringRef networkName);
+
+  /// \returns the version of network \p networkName running its requests.
+  llvm::Expected<unsigned> getNetworkVersion(llvm::StringRef networkName);
+
   /// Given \p networkName removes that network from the host. This also
   /// removes the network from any backends setup to execute it.
   /// \returns an llvm::Error indicating success or failure of the operation.
@@ -123,11 +378,33 @@ public:
   /// inference is done.
   /// Note: This method is intended to be thread-safe, it will be called
   /// concurrently from multiple threads.
+  /// When HostConfig::maxActiveRequests requests are in flight the request
+  /// waits in the admission queue, if enabled by HostConfig::maxQueuedRequests
+  /// and not full, and runs once an active request finishes. Requests which
+  /// can not be queued or wait longer than HostConfig::maxQueueWaitMs are
+  /// refused with a RUNTIME_REQUEST_REFUSED error.
+  /// If dynamic batching is enabled for the network the request may be run
+  /// together with other concurrent requests, see enableDynamicBatching.
+  /// A network evicted by the residency manager is loaded back on its devices
+  /// before the request runs.
   /// Returns -1 if networkName not found or too many active requests.
   RunIdentifierTy runNetwork(llvm::StringRef networkName,
                              std::unique_ptr<ExecutionContext> context,
                              ResultCBTy callback);
 
+  /// Enables dynamic batching of the requests of network \p networkName.
+  /// Concurrent requests whose tensors hold fewer rows than the batch
+  /// dimension 0 of the network's Placeholders are concatenated along
+  /// dimension 0 and run as one request, waiting at most \p maxDelayUs for
+  /// the batch to fill. Requests which do not fit this scheme run unbatched.
+  /// \returns an error if the network is not found.
+  llvm::Error enableDynamicBatching(llvm::StringRef networkName,
+                                    size_t maxDelayUs);
+
+  /// Disables dynamic batching of the requests of network \p networkName,
+  /// running its pending batch.
+  void disableDynamicBatching(llvm::StringRef networkName);
+
   /// A wrapper around runNetwork that provides a blocking interface for an
   /// inference request. Runs the network provided in \p networkName using \p
   /// bindings for placeholder bindings. \returns an llvm::Error indicating
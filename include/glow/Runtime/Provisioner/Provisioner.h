@@ -31,11 +31,16 @@ namespace runtime {
 /// device.
 class Provisioner final {
 public:
-  Provisioner(DeviceManagerMapTy &devices);
+  /// Constructor provisioning \p devices, compiling the partitions of a
+  /// network on up to \p maxCompileThreads threads, or one per core if zero.
+  Provisioner(DeviceManagerMapTy &devices, unsigned maxCompileThreads = 0);
 
   /// Traverses the DAG \p networks and:
   ///   1. Retrieves each node's Function from the provided \p module.
-  ///   2. Compiles it using the provided CompilationContext \p cctx.
+  ///   2. Compiles it using the provided CompilationContext \p cctx. The
+  ///      functions are compiled concurrently. If several of them fail to
+  ///      compile, the error of the first one in the order of the logical
+  ///      devices is returned.
   ///   3. Assigns a device and calls addNetwork on the chosen device(s).
   /// \returns a GlowErr indicating if the operation was a success.
   llvm::Error provision(DAGListTy &networks, Module &module,
@@ -44,6 +49,17 @@ public:
   /// Remove stored compiledFunction.
   void removeFunction(llvm::StringRef name);
 
+  /// Adds the compiled function \p name back to device \p device, which
+  /// collects its constants from \p module. \returns an error if the
+  /// function is not found or the device cannot add it.
+  llvm::Error loadFunction(llvm::StringRef name, DeviceIDTy device,
+                           const Module &module);
+
+  /// Frees the constants of the compiled function \p name, which must have
+  /// been evicted from all its devices. They are collected again when the
+  /// function is loaded back.
+  void freeConstants(llvm::StringRef name);
+
 private:
   /// Pointer to backend used for compilation. This currently gets reset per
   /// device to ensure the correct backed per device.
@@ -55,6 +71,12 @@ private:
 
   /// List of available DeviceManagers added during initialization.
   std::vector<DeviceManager *> devices_;
+
+  /// Maximum number of threads compiling functions, zero for one per core.
+  unsigned maxCompileThreads_;
+
+  /// \returns the number of threads compiling functions.
+  unsigned getCompileThreads() const;
 };
 } // namespace runtime
 } // namespace glow
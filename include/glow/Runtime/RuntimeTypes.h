@@ -22,6 +22,7 @@
 #include "glow/Graph/Graph.h"
 #include "glow/Support/Error.h"
 
+#include <atomic>
 #include <map>
 #include <string>
 #include <unordered_map>
@@ -91,8 +92,8 @@ struct DAGNode {
   /// indicates the network should be duplicated.
   std::vector<DeviceIDTy> logicalDevices;
   /// Index of the current deviceID in deviceIDs. This is used by the Executor
-  /// when picking a device to request a network run.
-  unsigned currentDeviceIdx{0};
+  /// when picking a device to request a network run, concurrently.
+  std::atomic<unsigned> currentDeviceIdx{0};
   /// Name assigned to the sub-network, this is the id that will be passed to
   /// the DeviceManager when requesting a run of the network.
   std::string name;
@@ -110,8 +111,7 @@ struct DAGNode {
   Module *module{nullptr};
 
   DeviceIDTy getNextDevice() {
-    currentDeviceIdx++;
-    return deviceIDs[currentDeviceIdx % deviceIDs.size()];
+    return deviceIDs[(currentDeviceIdx.fetch_add(1) + 1) % deviceIDs.size()];
   }
 };
 
@@ -168,13 +168,54 @@ struct DeviceConfig {
   }
 };
 
+/// How the Executor picks the device running a DAGNode among its deviceIDs.
+enum class DeviceSelectionPolicy {
+  /// Rotate over the devices.
+  RoundRobin,
+  /// The device with the fewest runs in flight.
+  LeastOutstanding,
+  /// The device with the fewer runs in flight of two picked at random.
+  PowerOfTwoChoices,
+  /// The device with the lowest runs in flight, plus the new one, times the
+  /// measured execution time of the node on the device.
+  LatencyWeighted,
+};
+
 /// Options configuring Host components of the Runtime, such as the Partitioner
 /// and Executor.
 struct HostConfig {
   /// Number of outstanding or concurrent networks before rate limiting.
   size_t maxActiveRequests{100};
+  /// Number of requests which may wait in the admission queue for an active
+  /// request to finish once maxActiveRequests are in flight. Requests arriving
+  /// when the queue is full are refused. Zero disables the queue.
+  size_t maxQueuedRequests{0};
+  /// Number of queued requests allowed for a single network, so that a burst
+  /// on one network can not fill the whole queue. Zero means no limit other
+  /// than maxQueuedRequests.
+  size_t maxQueuedRequestsPerNetwork{0};
+  /// Time in milliseconds a request may wait in the admission queue before it
+  /// is refused. Expired requests are refused the next time a request arrives
+  /// or finishes.
+  size_t maxQueueWaitMs{100};
   /// Number of threads to allocate to the Executor.
   size_t executorThreads{3};
+  /// Maximum number of threads compiling the partitions of a network, zero
+  /// for one per core.
+  size_t maxCompileThreads{0};
+  /// How the Executor balances the runs of a node over its devices.
+  DeviceSelectionPolicy deviceSelectionPolicy{
+      DeviceSelectionPolicy::LeastOutstanding};
+  /// Number of concurrent runs of each network for which the intermediate
+  /// tensors are allocated when the network is added.
+  size_t expectedConcurrentRuns{1};
+  /// Evict the least recently used idle networks from the devices when they
+  /// lack the memory for a network, and reload them on their next run. The
+  /// constants of the networks are then kept in a file to reload them.
+  bool enableNetworkResidency{false};
+  /// Directory of the files keeping the constants of the networks with
+  /// enableNetworkResidency, the system temporary directory if empty.
+  std::string networkResidencyDir;
 };
 
 /// This is struct for user defined partition.
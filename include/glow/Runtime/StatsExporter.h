@@ -16,12 +16,21 @@
 #ifndef GLOW_RUNTIME_STATSEXPORTER_H
 #define GLOW_RUNTIME_STATSEXPORTER_H
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 namespace glow {
 
+class Histogram;
+
 /// Interface for exporting runtime statistics.  The base implementation
 /// delegates to any subclass registered via `registerStatsExporter`.
 class StatsExporter {
@@ -37,6 +46,68 @@ public:
 
   /// Set a counter.  May be called concurrently.
   virtual void setCounter(llvm::StringRef key, int64_t value) = 0;
+
+  /// Export the values recorded so far by the histogram \p key. Called by
+  /// StatsExporterRegistry::exportHistograms and once more when the histogram
+  /// is released. May be called concurrently with the recording of values.
+  virtual void exportHistogram(llvm::StringRef key,
+                               const Histogram &histogram) {}
+};
+
+/// Histogram of non-negative integer values, typically latencies in
+/// microseconds. Values below 16 are counted exactly, larger ones in
+/// log-linear buckets eight per power of two, so that percentiles are within
+/// 12.5% of the exact value. Recording is lock-free and may run concurrently
+/// with the getters, which then see some of the concurrent values.
+class Histogram final {
+public:
+  Histogram() { clear(); }
+
+  /// Counts \p value.
+  void record(uint64_t value);
+
+  /// Counts \p duration in microseconds.
+  void recordMicroseconds(std::chrono::nanoseconds duration) {
+    record(std::chrono::duration_cast<std::chrono::microseconds>(duration)
+               .count());
+  }
+
+  /// \returns the number of values recorded.
+  uint64_t getCount() const { return count_; }
+
+  /// \returns the sum of the values recorded.
+  uint64_t getSum() const { return sum_; }
+
+  /// \returns the largest value recorded.
+  uint64_t getMax() const { return max_; }
+
+  /// \returns an upper bound of the \p percentile percentile, in [0, 100], of
+  /// the values recorded, for instance 99.9 for p999. \returns 0 if no value
+  /// was recorded.
+  uint64_t getPercentile(double percentile) const;
+
+  /// Drops the values recorded. Values recorded concurrently may be lost.
+  void clear();
+
+private:
+  /// Values below this bound have their own bucket.
+  static constexpr unsigned kNumExactBuckets = 16;
+  /// Number of buckets per power of two above kNumExactBuckets.
+  static constexpr unsigned kSubBuckets = 8;
+  /// Total number of buckets, enough for all the 64-bit values.
+  static constexpr unsigned kNumBuckets = kNumExactBuckets + 60 * kSubBuckets;
+
+  /// \returns the bucket counting \p value.
+  static unsigned getBucket(uint64_t value);
+
+  /// \returns the largest value counted by \p bucket.
+  static uint64_t getBucketUpperBound(unsigned bucket);
+
+  /// Number of values recorded in every bucket.
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
 };
 
 /// Registry of StatsExporters.
@@ -54,9 +125,32 @@ public:
   /// Register a StatsExporter.
   void registerStatsExporter(StatsExporter *exporter);
 
+  /// \returns the histogram named \p key, created empty on first use. The
+  /// histograms live until released, so hot paths look them up once and
+  /// record into them without locking.
+  Histogram *getHistogram(llvm::StringRef key);
+
+  /// Add value to the histogram named \p key.
+  void addHistogramValue(llvm::StringRef key, uint64_t value) {
+    getHistogram(key)->record(value);
+  }
+
+  /// Export every histogram to all registered StatsExporters.
+  void exportHistograms();
+
+  /// Export the histogram named \p key a last time and delete it. The owner
+  /// of the histogram calls this once nothing records into it anymore.
+  void releaseHistogram(llvm::StringRef key);
+
 private:
   /// Registered StatsExporters.
   std::vector<StatsExporter *> exporters_;
+
+  /// The histograms by name.
+  llvm::StringMap<std::unique_ptr<Histogram>> histograms_;
+
+  /// Guards histograms_ itself, the histograms are lock-free.
+  std::mutex histogramsLock_;
 };
 
 /// Global singleton StatsExporter.
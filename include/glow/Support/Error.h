@@ -81,6 +81,8 @@ public:
     RUNTIME_DEVICE_NOT_FOUND,
     // Runtime error, network busy to perform any operation on it.
     RUNTIME_NET_BUSY,
+    // Runtime error, request dropped as its deadline passed before it ran.
+    RUNTIME_DEADLINE_EXCEEDED,
     // Compilation error; node unsupported after optimizations.
     COMPILE_UNSUPPORTED_NODE_AFTER_OPTIMIZE,
     // Compilation error; Compilation context not correctly setup.
@@ -110,6 +112,18 @@ public:
     }
   }
 
+  /// \returns the error code of the GlowErr.
+  ErrorCode getErrorCode() const { return ec_; }
+
+  /// \returns the message of the GlowErr.
+  llvm::StringRef getMessage() const { return message_; }
+
+  /// \returns the name of the file the GlowErr was created in.
+  llvm::StringRef getFileName() const { return fileName_; }
+
+  /// \returns the line the GlowErr was created on.
+  size_t getLineNumber() const { return lineNumber_; }
+
   GlowErr(llvm::StringRef fileName, size_t lineNumber, llvm::StringRef message,
           ErrorCode ec)
       : lineNumber_(lineNumber), fileName_(fileName), message_(message),
@@ -156,6 +170,8 @@ private:
       return "RUNTIME_DEVICE_NOT_FOUND";
     case ErrorCode::RUNTIME_NET_BUSY:
       return "RUNTIME_NET_BUSY";
+    case ErrorCode::RUNTIME_DEADLINE_EXCEEDED:
+      return "RUNTIME_DEADLINE_EXCEEDED";
     case ErrorCode::COMPILE_UNSUPPORTED_NODE_AFTER_OPTIMIZE:
       return "COMPILE_UNSUPPORTED_NODE_AFTER_OPTIMIZE";
     case ErrorCode::COMPILE_CONTEXT_MALFORMED:
@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GLOW_SUPPORT_THREADAFFINITY_H
+#define GLOW_SUPPORT_THREADAFFINITY_H
+
+#include "glow/Support/Error.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <vector>
+
+namespace glow {
+
+class ThreadPool;
+
+/// Parses \p list, a comma separated list of CPUs and ranges of CPUs such as
+/// "0-3,8,10-11" as found in the cpulist files of Linux. \returns the CPUs in
+/// increasing order.
+llvm::Expected<std::vector<unsigned>> parseCPUList(llvm::StringRef list);
+
+/// \returns the CPUs of NUMA node \p node of the host.
+llvm::Expected<std::vector<unsigned>> getNUMANodeCPUs(unsigned node);
+
+/// \returns the number of NUMA nodes of the host, 1 if it is unknown.
+unsigned getNUMANodeCount();
+
+/// Restricts the calling thread to run on \p cpus. Memory the thread touches
+/// first is then allocated on the NUMA node of these CPUs.
+llvm::Error setCurrentThreadAffinity(llvm::ArrayRef<unsigned> cpus);
+
+/// Restricts every thread of \p pool to run on \p cpus.
+llvm::Error setThreadPoolAffinity(ThreadPool &pool,
+                                  llvm::ArrayRef<unsigned> cpus);
+
+} // namespace glow
+
+#endif // GLOW_SUPPORT_THREADAFFINITY_H
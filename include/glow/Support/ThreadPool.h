@@ -17,9 +17,12 @@
 #define GLOW_SUPPORT_THREADPOOL_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -27,6 +30,8 @@
 
 namespace glow {
 
+class ThreadPool;
+
 #ifdef WIN32
 /// A copyable wrapper for a lambda function that has non-copyable objects in
 /// its lambda capture.
@@ -50,36 +55,128 @@ shared_function<std::decay_t<F>> make_shared_function(F &&f) {
 }
 #endif
 
+/// Scheduling key of a work item. Pending work items run by increasing
+/// priority, then by earliest deadline, then in submission order. The default
+/// key runs first and keeps the FIFO order among the items using it.
+struct WorkPriority {
+  /// Priority class, lower values run first.
+  unsigned priority{0};
+  /// Time by which the work item should have run.
+  std::chrono::steady_clock::time_point deadline{
+      std::chrono::steady_clock::time_point::max()};
+};
+
+/// A bounded lock-free FIFO of \p T supporting concurrent producers and
+/// consumers. Each slot carries a sequence number telling whether it is ready
+/// to be written or read for a given position, so producers and consumers
+/// only contend on the atomic head and tail positions (D. Vyukov's bounded
+/// MPMC queue).
+template <typename T> class LockFreeRing final {
+  /// A slot of the ring.
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  /// The slots, their number is a power of two.
+  std::unique_ptr<Cell[]> cells_;
+
+  /// Mask turning a position into a slot index.
+  const size_t mask_;
+
+  /// Next positions to write and read, on separate cache lines.
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) std::atomic<size_t> head_{0};
+
+public:
+  /// Creates a ring of \p capacity elements, which must be a power of two.
+  explicit LockFreeRing(size_t capacity)
+      : cells_(new Cell[capacity]), mask_(capacity - 1) {
+    for (size_t i = 0; i < capacity; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /// Appends \p value. \returns false and leaves \p value untouched if the
+  /// ring is full.
+  bool push(T &value) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(seq) - intptr_t(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Removes the oldest element into \p value. \returns false if the ring is
+  /// empty.
+  bool pop(T &value) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->data);
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+};
+
 /// An executor that runs Tasks on a single thread.
 class ThreadExecutor final {
 public:
   /// Constructor. Initializes one thread backed by the workQueue_.
   ThreadExecutor();
 
+  /// Constructor of the worker \p index of \p pool. Besides its own
+  /// workQueue_, the thread runs the shared work items of the pool.
+  ThreadExecutor(ThreadPool *pool, unsigned index);
+
   /// Destructor. Signals the thread to stop and waits for exit.
   ~ThreadExecutor();
 
-  /// Submit \p fn as a work item for the thread pool.
+  /// Submit \p fn as a work item for the thread pool, scheduled by \p key.
   /// \p fn must be a lambda with void return type and arguments.
-  template <typename F> std::future<void> submit(F &&fn) {
-    // Add fn to the work queue.
-    std::unique_lock<std::mutex> lock(workQueueMtx_);
-
+  template <typename F>
+  std::future<void> submit(F &&fn, const WorkPriority &key = WorkPriority()) {
 #ifdef WIN32
     std::packaged_task<void(void)> task(make_shared_function(std::move(fn)));
 #else
     std::packaged_task<void(void)> task(std::move(fn));
 #endif
 
-    auto future = task.get_future();
-    workQueue_.push(std::move(task));
-    lock.unlock();
-    queueNotEmpty_.notify_one();
-    return future;
+    return submit(std::move(task), key);
   }
 
-  /// Submit \p task as a work item for the thread pool.
-  std::future<void> submit(std::packaged_task<void(void)> &&task);
+  /// Submit \p task as a work item for the thread pool, scheduled by \p key.
+  std::future<void> submit(std::packaged_task<void(void)> &&task,
+                           const WorkPriority &key = WorkPriority());
 
   void stop(bool block = false);
 
@@ -91,8 +188,43 @@ protected:
   /// exit.
   std::atomic<bool> shouldStop_{false};
 
+  /// Set while the thread waits for work, read by ThreadPool to find an idle
+  /// worker to wake up.
+  std::atomic<bool> sleeping_{false};
+
+  /// The pool this executor is a worker of, if any, and its index in it.
+  ThreadPool *pool_{nullptr};
+  unsigned index_{0};
+
+  friend class ThreadPool;
+
+  /// A pending work item.
+  struct WorkItem {
+    WorkPriority key;
+    /// Submission order, breaks the ties between equal keys.
+    uint64_t sequence;
+    /// Mutable so that it can be moved out of the top of workQueue_.
+    mutable std::packaged_task<void(void)> task;
+  };
+
+  /// Orders workQueue_ so that its top is the work item to run next.
+  struct RunsAfter {
+    bool operator()(const WorkItem &a, const WorkItem &b) const {
+      if (a.key.priority != b.key.priority) {
+        return a.key.priority > b.key.priority;
+      }
+      if (a.key.deadline != b.key.deadline) {
+        return a.key.deadline > b.key.deadline;
+      }
+      return a.sequence > b.sequence;
+    }
+  };
+
   /// Queue of work items.
-  std::queue<std::packaged_task<void(void)>> workQueue_;
+  std::priority_queue<WorkItem, std::vector<WorkItem>, RunsAfter> workQueue_;
+
+  /// Sequence number of the next work item. Guarded by workQueueMtx_.
+  uint64_t nextSequence_{0};
 
   /// Mutex to coordinate access to the work queue.
   std::mutex workQueueMtx_;
@@ -106,6 +238,15 @@ protected:
 };
 
 /// Thread pool for asynchronous execution of generic functions.
+/// Work items submitted to the pool are appended to the lock-free ring of a
+/// worker: the submitting worker's own ring, or the next one in round-robin
+/// order. Workers run their own work items first and steal from the other
+/// rings when idle, so that a slow work item does not strand the ones queued
+/// behind it. When all the rings are full, the threads outside of the pool
+/// wait for them to drain so that the work items keep their submission order.
+/// Prioritized work items and the ones submitted through getExecutor() or
+/// runOnAllThreads() stay on the queue of their thread, whose work items of
+/// a lower priority than the default run after the shared work items.
 class ThreadPool final {
 public:
   /// Constructor. Initializes a thread pool with \p numWorkers
@@ -119,20 +260,24 @@ public:
   /// Stop all threads and optionally wait for them to join.
   void stop(bool block = false);
 
-  /// Submit \p fn as a work item for the thread pool.
+  /// Submit \p fn as a work item for the thread pool, scheduled by \p key.
   /// \p fn must be a lambda with void return type and arguments.
-  template <typename F> std::future<void> submit(F &&fn) {
+  template <typename F>
+  std::future<void> submit(F &&fn, const WorkPriority &key = WorkPriority()) {
 #ifdef WIN32
     std::packaged_task<void(void)> task(make_shared_function(std::move(fn)));
 #else
     std::packaged_task<void(void)> task(std::move(fn));
 #endif
 
-    return submit(std::move(task));
+    return submit(std::move(task), key);
   }
 
-  /// Submit \p task as a work item for the thread pool.
-  std::future<void> submit(std::packaged_task<void(void)> &&task);
+  /// Submit \p task as a work item for the thread pool, scheduled by \p key.
+  /// Work items with a non default key are queued by priority on a worker
+  /// and are not stolen.
+  std::future<void> submit(std::packaged_task<void(void)> &&task,
+                           const WorkPriority &key = WorkPriority());
 
   /// Returns a ThreadExecutor that can be accessed directly, allowing
   /// submitting multiple tasks to the same thread.
@@ -164,6 +309,41 @@ private:
   /// The default number of workers in the thread pool (overridable).
   constexpr static unsigned kNumWorkers = 10;
 
+  /// Capacity of the ring of each worker.
+  constexpr static size_t kRingCapacity = 1024;
+
+  /// The shared work items of a worker.
+  struct WorkerRing {
+    WorkerRing() : ring(kRingCapacity) {}
+
+    LockFreeRing<std::packaged_task<void(void)>> ring;
+
+    /// Number of work items in ring. Incremented before a push and
+    /// decremented after a pop, so a worker seeing the counts of all the
+    /// rings at zero can sleep. Each count has its own cache line, the
+    /// workers submitting and taking work do not contend on a shared one.
+    alignas(64) std::atomic<size_t> pendingWork{0};
+  };
+
+  /// The work items shared by the workers, one ring per worker. Created
+  /// before and destroyed after the workers.
+  std::vector<std::unique_ptr<WorkerRing>> rings_;
+
+  /// Round robin index for the next ring.
+  std::atomic<size_t> nextRing_{0};
+
+  /// Pops a work item for worker \p index into \p task, from its own ring
+  /// first. \returns false if there is none.
+  bool takeWork(unsigned index, std::packaged_task<void(void)> &task);
+
+  /// \returns true if rings_ may hold work items.
+  bool hasWork() const;
+
+  /// Wakes up worker \p index if it sleeps, or else another sleeping worker.
+  void wakeWorker(unsigned index);
+
+  friend class ThreadExecutor;
+
   /// Vector of worker thread objects.
   /// It is safe to access this without a lock as it is const after
   /// construction.
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #include "glow/Backend/BackendUtils.h"
+#include "glow/Backend/ConstantStore.h"
 #include "glow/IR/IRUtils.h"
 #include "glow/IR/Instrs.h"
 #include "glow/Support/Debug.h"
@@ -32,7 +33,8 @@ using llvm::isa;
 
 static llvm::cl::OptionCategory BackendUtilsCat("Glow Backend Utils Options");
 
-static llvm::cl::opt<bool> reuseActivationsMemory(
+/// Hashed by the LLVM backends in the key of their compile cache.
+llvm::cl::opt<bool> reuseActivationsMemory(
     "reuse-activation-memory-allocations",
     llvm::cl::desc("Should activation memory allocations be reused"),
     llvm::cl::init(true), llvm::cl::cat(BackendUtilsCat));
@@ -55,6 +57,7 @@ operator=(glow::runtime::RuntimeBundle &&rhs) {
   std::swap(mutableWeightVarsMemSize_, rhs.mutableWeightVarsMemSize_);
   std::swap(activationsMemSize_, rhs.activationsMemSize_);
   std::swap(isValid_, rhs.isValid_);
+  std::swap(sharedConstants_, rhs.sharedConstants_);
   // rhs is not valid now that all of its contents have been stolen.
   rhs.isValid_ = false;
   return *this;
@@ -69,9 +72,30 @@ void glow::runtime::RuntimeBundle::freeConstants() {
   DCHECK(isValid_);
 
   if (constants_) {
-    glow::alignedFree(constants_);
+    if (sharedConstants_) {
+      SharedConstants()->release(constants_);
+    } else {
+      glow::alignedFree(constants_);
+    }
+    constants_ = nullptr;
+  }
+  sharedConstants_ = false;
+}
+
+void glow::runtime::RuntimeBundle::collectSharedConstants(const Module *M,
+                                                          int numaNode) {
+  DCHECK(isValid_);
+
+  if (constantWeightVarsMemSize_ == 0) {
     constants_ = nullptr;
+    return;
   }
+
+  assert(constants_ == nullptr && "constants already allocated");
+  constants_ = SharedConstants()->acquire(symbolTable_,
+                                          constantWeightVarsMemSize_, M,
+                                          numaNode);
+  sharedConstants_ = true;
 }
 void glow::runtime::RuntimeBundle::collectConstants(const Module *M) {
   DCHECK(isValid_);
@@ -313,6 +337,7 @@ runtime::RuntimeBundle runtime::RuntimeBundle::create(const Function &F) {
     symbol.type = *V->getType();
     symbol.output = it->isOutput;
     symbol.input = it->isInput;
+    symbol.index = it - contiguousPlaceholders.begin();
     symbol.symbolCategory = SymbolCategory::Placeholder;
     symbolTable.emplace(V->getName(), symbol);
   }
@@ -376,6 +401,7 @@ runtime::RuntimeBundle::create(const IRFunction &F,
     symbol.type = *w->getType();
     symbol.output = it->isOutput;
     symbol.input = it->isInput;
+    symbol.index = it - contiguousPlaceholders.begin();
     symbol.symbolCategory = SymbolCategory::Placeholder;
     symbolTable.emplace(std::string(v->getName()), symbol);
     DEBUG_GLOW(LOG(INFO) << strFormat(
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "glow/Backend/ConstantStore.h"
+#include "glow/Graph/Graph.h"
+#include "glow/Support/Memory.h"
+
+#include "llvm/ADT/Hashing.h"
+
+#include <glog/logging.h>
+
+#include <cstring>
+
+using namespace glow;
+using namespace glow::runtime;
+
+namespace {
+/// Calls \p fn with the symbol info and the payload of every constant of \p M
+/// in \p symbolTable.
+template <typename FnTy>
+void forEachConstant(const SymbolTableTy &symbolTable, const Module *M,
+                     FnTy fn) {
+  for (const auto &symbol : symbolTable) {
+    Constant *c = M->getConstantByName(symbol.first);
+    if (!c) {
+      continue;
+    }
+    const auto &info = symbol.second;
+    DCHECK_EQ(info.size, c->getPayload().getSizeInBytes())
+        << "Mismatched constant size";
+    fn(info, c->getPayload().getUnsafePtr());
+  }
+}
+} // namespace
+
+ConstantStore::Block *ConstantStore::find(const SymbolTableTy &symbolTable,
+                                          size_t size, size_t hash,
+                                          int node, const Module *M) {
+  auto range = blocksByHash_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    Block *block = it->second;
+    if (block->size != size || block->node != node) {
+      continue;
+    }
+    bool equal = true;
+    forEachConstant(symbolTable, M,
+                    [&](const RuntimeSymbolInfo &info, const char *payload) {
+                      equal = equal && std::memcmp(block->data + info.offset,
+                                                   payload, info.size) == 0;
+                    });
+    if (equal) {
+      return block;
+    }
+  }
+  return nullptr;
+}
+
+uint8_t *ConstantStore::acquire(const SymbolTableTy &symbolTable, size_t size,
+                                const Module *M, int node) {
+  // Hash the constants in place, the blocks of replicas are not allocated.
+  llvm::hash_code hash = llvm::hash_value(size);
+  forEachConstant(symbolTable, M,
+                  [&](const RuntimeSymbolInfo &info, const char *payload) {
+                    hash = llvm::hash_combine(
+                        hash, info.offset,
+                        llvm::hash_value(llvm::StringRef(payload, info.size)));
+                  });
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (Block *block = find(symbolTable, size, hash, node, M)) {
+      block->refcount++;
+      return block->data;
+    }
+  }
+
+  // Copy the constants without holding the lock, a concurrent acquire of the
+  // same constants may store its block first. The pages of the block are
+  // touched first by this thread, so allocated on its NUMA node.
+  auto *data = static_cast<uint8_t *>(alignedAlloc(size, TensorAlignment));
+  forEachConstant(symbolTable, M,
+                  [&](const RuntimeSymbolInfo &info, const char *payload) {
+                    std::memcpy(data + info.offset, payload, info.size);
+                  });
+
+  std::lock_guard<std::mutex> lock(lock_);
+  if (Block *block = find(symbolTable, size, hash, node, M)) {
+    alignedFree(data);
+    block->refcount++;
+    return block->data;
+  }
+  auto block = llvm::make_unique<Block>(Block{data, size, hash, node, 1});
+  blocksByHash_.emplace(hash, block.get());
+  blocks_.emplace(data, std::move(block));
+  return data;
+}
+
+void ConstantStore::release(uint8_t *data) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = blocks_.find(data);
+  DCHECK(it != blocks_.end()) << "Releasing a block not in the store";
+  Block *block = it->second.get();
+  if (--block->refcount > 0) {
+    return;
+  }
+  auto range = blocksByHash_.equal_range(block->hash);
+  for (auto hashIt = range.first; hashIt != range.second; ++hashIt) {
+    if (hashIt->second == block) {
+      blocksByHash_.erase(hashIt);
+      break;
+    }
+  }
+  alignedFree(block->data);
+  blocks_.erase(it);
+}
+
+size_t ConstantStore::getNumBlocks() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return blocks_.size();
+}
+
+size_t ConstantStore::getStoredBytes() {
+  std::lock_guard<std::mutex> lock(lock_);
+  size_t bytes = 0;
+  for (const auto &block : blocks_) {
+    bytes += block.second->size;
+  }
+  return bytes;
+}
+
+namespace glow {
+namespace runtime {
+ConstantStore *SharedConstants() {
+  static auto *store = new ConstantStore();
+  return store;
+}
+} // namespace runtime
+} // namespace glow
@@ -17,9 +17,11 @@
 #include "CPUBackend.h"
 #include "CPUFunction.h"
 #include "CPULLVMIRGen.h"
+#include "CPUParallelRuntime.h"
 
 #include "glow/Backend/BackendUtils.h"
 #include "glow/Graph/Graph.h"
+#include "glow/IR/IRGen.h"
 #include "glow/IR/Instrs.h"
 #include "glow/LLVMIRCodeGen/LLVMIRGen.h"
 #include "glow/Support/Debug.h"
@@ -28,9 +30,15 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <thread>
 
 using namespace glow;
 
+/// Defined by the CPU transforms.
+extern llvm::cl::opt<unsigned> cpuWinogradMinChannels;
+
 /// We compile the standard library (libjit) to LLVM bitcode, and then convert
 /// that binary data to an include file using an external utility (include-bin).
 /// The resulting file is included here to compile the bitcode image into our
@@ -40,6 +48,11 @@ static const unsigned char libjit_bc[] = {
 };
 static const size_t libjit_bc_size = sizeof(libjit_bc);
 
+CPUBackend::CPUBackend() {
+  // JIT'ed kernels call back into the intra-op parallel runtime.
+  runtime::CPUParallelRuntime::registerJITSymbols();
+}
+
 bool CPUBackend::isOpSupported(const NodeInfo &NI) const {
   // Note: For brevity below, "X ==> Y, Z" signifes that Node X is IRGen'd into
   // Instructions Y and Z.
@@ -163,6 +176,7 @@ bool CPUBackend::isOpSupported(const NodeInfo &NI) const {
   case Kinded::Kind::AvgPoolGradNodeKind:
   case Kinded::Kind::QuantizationProfileNodeKind:
   case Kinded::Kind::CPUConvDKKC8NodeKind:
+  case Kinded::Kind::CPUConvWinogradNodeKind:
   case Kinded::Kind::LocalResponseNormalizationNodeKind:
   case Kinded::Kind::LocalResponseNormalizationGradNodeKind:
   case Kinded::Kind::LogNodeKind:
@@ -195,6 +209,19 @@ bool CPUBackend::isOpSupported(const NodeInfo &NI) const {
                                                   {ConvolutionNode::BiasIdx}) &&
            (NI.getInElemTy(ConvolutionNode::BiasIdx) == ElemKind::Int32QTy);
 
+  case Kinded::Kind::CPUConvDepthwiseNodeKind:
+    if (!NI.getInTy(CPUConvDepthwiseNode::InputIdx)->isQuantizedType()) {
+      return NI.allInputsAndOutputsHaveSameElemKind({ElemKind::FloatTy});
+    }
+    // The weights of the filter are widened to 32 bits.
+    return NI.allInputsAndOutputsHaveSameElemKind(
+               {ElemKind::Int8QTy}, {CPUConvDepthwiseNode::FilterIdx,
+                                     CPUConvDepthwiseNode::BiasIdx}) &&
+           (NI.getInElemTy(CPUConvDepthwiseNode::FilterIdx) ==
+            ElemKind::Int32QTy) &&
+           (NI.getInElemTy(CPUConvDepthwiseNode::BiasIdx) ==
+            ElemKind::Int32QTy);
+
   case Kinded::Kind::BatchedAddNodeKind:
     if (!NI.getInTy(BatchedAddNode::BatchIdx)->isQuantizedType()) {
       return NI.allInputsAndOutputsHaveSameElemKind({ElemKind::FloatTy});
@@ -357,6 +384,53 @@ bool CPUBackend::shouldLower(const Node *N) const {
   }
 }
 
+/// The number of output tiles transformed together by libjit_conv_winograd_f,
+/// see winogradTileBlock in libjit_conv.cpp.
+static constexpr size_t winogradTileBlock = 32;
+
+bool CPUBackend::generateInst(Node *N, IRGenVisitor &irgen) const {
+  auto *CN = llvm::dyn_cast<CPUConvWinogradNode>(N);
+  if (!CN) {
+    return false;
+  }
+
+  // Each task of libjit_conv_winograd_f transforms a block of tiles in its own
+  // slot of scratch memory: the transformed input and products of the block,
+  // the temporaries of the transforms and a row of zeros for the padding. The
+  // slots are allocated with the activations of the bundle, one per thread
+  // that can run a task, instead of being allocated on every run.
+  ShapeNHWC idim(CN->getInput().dims());
+  ShapeNHWC odim(CN->getResult().dims());
+  size_t tileSize = CN->getTileSize();
+  size_t alpha = tileSize + 2;
+  size_t tilesH = (odim.h + tileSize - 1) / tileSize;
+  size_t tilesW = (odim.w + tileSize - 1) / tileSize;
+  size_t numBlocks =
+      (tilesH * tilesW + winogradTileBlock - 1) / winogradTileBlock;
+  size_t slots = std::max<size_t>(
+      1, std::min<size_t>(numBlocks, std::thread::hardware_concurrency()));
+  size_t slotSize = alpha * alpha * winogradTileBlock * (idim.c + odim.c) +
+                    2 * alpha * alpha * std::max(idim.c, odim.c) + idim.c;
+
+  auto *builder = irgen.getBuilder();
+  auto *src = irgen.valueForNode(CN->getInput());
+  auto *filter = irgen.valueForNode(CN->getFilter());
+  auto *bias = irgen.valueForNode(CN->getBias());
+  auto *dest = builder->createAllocActivationInst(
+      CN->getName().str() + ".res", CN->getResult().getType());
+  auto *scratch = builder->createAllocActivationInst(
+      CN->getName().str() + ".scratch", ElemKind::FloatTy, {slots, slotSize});
+  auto *V = builder->createCPUConvWinogradInst(CN->getName(), dest, src,
+                                               filter, bias, scratch,
+                                               CN->getPads(), tileSize);
+  if (N->hasPredicate()) {
+    V->setPredicate(irgen.valueForNode(N->getPredicate()));
+  }
+  irgen.registerIR(CN->getResult(), V->getDest());
+  irgen.setNodeToIR(N, V);
+  return true;
+}
+
 std::unique_ptr<CompiledFunction> CPUBackend::createCompiledFunction(
     std::unique_ptr<llvm::orc::GlowJIT> JIT,
     runtime::RuntimeBundle &&runtimeBundle) const {
@@ -376,3 +450,7 @@ llvm::StringRef CPUBackend::getLibjitBitcode() const {
   return llvm::StringRef(reinterpret_cast<const char *>(libjit_bc),
                          libjit_bc_size);
 }
+
+void CPUBackend::describeCodegenOptions(llvm::raw_ostream &os) const {
+  os << "cpu-winograd-min-channels=" << cpuWinogradMinChannels << "\n";
+}
@@ -29,7 +29,7 @@ class NodeInfo;
 
 class CPUBackend : public LLVMBackend {
 public:
-  CPUBackend() = default;
+  CPUBackend();
 
   /// @name Backend methods.
   /// This is the implementation of the Backend interface.
@@ -45,6 +45,10 @@ public:
   bool isOpSupported(const NodeInfo &NI) const override;
 
   bool shouldLower(const Node *N) const override;
+
+  /// Generates the CPUConvWinograd instructions, whose transform scratch
+  /// memory is allocated as an activation of the bundle.
+  bool generateInst(Node *N, IRGenVisitor &irgen) const override;
   /// @}
 
 public:
@@ -61,6 +65,11 @@ protected:
                          runtime::RuntimeBundle &&runtimeBundle) const override;
 
   virtual llvm::StringRef getLibjitBitcode() const override;
+
+  /// The constructor registers the CPUParallelRuntime with the JIT.
+  bool useHostParallelRuntime() const override { return true; }
+
+  void describeCodegenOptions(llvm::raw_ostream &os) const override;
   /// @}
 };
 
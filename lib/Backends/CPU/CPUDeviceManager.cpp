@@ -16,9 +16,13 @@
 #include "CPUDeviceManager.h"
 #include "CPUFunction.h"
 
+#include "glow/Support/ThreadAffinity.h"
+
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+
 namespace glow {
 namespace runtime {
 
@@ -39,6 +43,86 @@ DeviceManager *createCPUDeviceManager(const DeviceConfig &config) {
   return new CPUDeviceManager(config);
 }
 
+/// Helper method to parse a string parameter to an unsigned. \returns
+/// llvm::Expected with either the value or an error.
+static llvm::Expected<unsigned> parseInputAsUnsigned(std::string input) {
+  char *end;
+  auto parsed = strtol(input.c_str(), &end, 10);
+  if (end == input.c_str() || *end != '\0' || parsed < 0) {
+    return MAKE_ERR(GlowErr::ErrorCode::RUNTIME_ERROR,
+                    "Invalid input expected unsigned integer got: " + input);
+  }
+  return parsed;
+}
+
+llvm::Error CPUDeviceManager::parseAffinity() {
+  auto it = config_.parameters.find("numaNode");
+  if (it != config_.parameters.end()) {
+    unsigned node;
+    ASSIGN_VALUE_OR_RETURN_ERR(node, parseInputAsUnsigned(it->second));
+    ASSIGN_VALUE_OR_RETURN_ERR(cpus_, getNUMANodeCPUs(node));
+    numaNode_ = node;
+  }
+
+  it = config_.parameters.find("cpuAffinity");
+  if (it == config_.parameters.end()) {
+    return llvm::Error::success();
+  }
+  std::vector<unsigned> cpus;
+  ASSIGN_VALUE_OR_RETURN_ERR(cpus, parseCPUList(it->second));
+  // The cores must belong to the NUMA node of the device if there is one.
+  for (auto cpu : cpus) {
+    RETURN_ERR_IF_NOT(
+        numaNode_ < 0 || std::binary_search(cpus_.begin(), cpus_.end(), cpu),
+        llvm::formatv("CPU {0} is not on NUMA node {1}", cpu, numaNode_)
+            .str());
+  }
+  cpus_ = std::move(cpus);
+  return llvm::Error::success();
+}
+
+llvm::Error CPUDeviceManager::init() {
+  RETURN_IF_ERR(parseAffinity());
+
+  unsigned intraOpThreads = 1;
+  auto it = config_.parameters.find("intraOpThreads");
+  if (it != config_.parameters.end()) {
+    ASSIGN_VALUE_OR_RETURN_ERR(intraOpThreads,
+                               parseInputAsUnsigned(it->second));
+  }
+  parallelRuntime_ = llvm::make_unique<CPUParallelRuntime>(intraOpThreads);
+
+  it = config_.parameters.find("executionSlots");
+  if (it != config_.parameters.end()) {
+    ASSIGN_VALUE_OR_RETURN_ERR(executionSlots_,
+                               parseInputAsUnsigned(it->second));
+    RETURN_ERR_IF_NOT(executionSlots_ > 0,
+                      "Invalid executionSlots, expected at least 1");
+  }
+  freeSlots_ = executionSlots_;
+  if (executionSlots_ > 1) {
+    slotPool_ = llvm::make_unique<ThreadPool>(executionSlots_);
+  }
+
+  if (!cpus_.empty()) {
+    RETURN_IF_ERR(setThreadPoolAffinity(workThread_, cpus_));
+    RETURN_IF_ERR(parallelRuntime_->setAffinity(cpus_));
+    if (slotPool_) {
+      RETURN_IF_ERR(setThreadPoolAffinity(*slotPool_, cpus_));
+    }
+  }
+  return QueueBackedDeviceManager::init();
+}
+
+llvm::Error CPUDeviceManager::stop(bool block) {
+  // Stop dispatching runs before stopping the slots running them.
+  auto err = QueueBackedDeviceManager::stop(block);
+  if (slotPool_) {
+    slotPool_->stop(block);
+  }
+  return err;
+}
+
 uint64_t CPUDeviceManager::getMaximumMemory() const { return maxMemoryBytes_; }
 
 uint64_t CPUDeviceManager::getAvailableMemory() const {
@@ -61,6 +145,13 @@ DeviceInfo CPUDeviceManager::getDeviceInfo() const {
   return info;
 }
 
+uint64_t
+CPUDeviceManager::getFunctionMemorySize(const RuntimeBundle &bundle) const {
+  return bundle.getConstantWeightSize() +
+         executionSlots_ *
+             (bundle.getMutableWeightSize() + bundle.getActivationsSize());
+}
+
 void CPUDeviceManager::addNetworkImpl(const Module *module,
                                       FunctionMapTy functions,
                                       ReadyCBTy readyCB) {
@@ -91,7 +182,11 @@ void CPUDeviceManager::addNetworkImpl(const Module *module,
     }
   }
 
-  if (usedMemoryBytes_ + functionCost_ > maxMemoryBytes_) {
+  uint64_t allocationSize = 0;
+  for (const auto &func : functions) {
+    allocationSize += getFunctionMemorySize(func.second->getRuntimeBundle());
+  }
+  if (usedMemoryBytes_ + allocationSize > maxMemoryBytes_) {
     readyCB(module, MAKE_ERR(GlowErr::ErrorCode::RUNTIME_OUT_OF_DEVICE_MEMORY,
                              "Failed to add network: not enough memory"));
     return;
@@ -100,11 +195,14 @@ void CPUDeviceManager::addNetworkImpl(const Module *module,
   // Add to the function name lookup map.
   for (const auto &func : functions) {
     if (func.second->getRuntimeBundle().getConstants() == nullptr) {
-      func.second->getRuntimeBundle().collectConstants(module);
+      // Replicas of the function on other devices of the NUMA node share its
+      // constants. They are copied by this thread, so allocated on the node.
+      func.second->getRuntimeBundle().collectSharedConstants(module,
+                                                             numaNode_);
     }
     functions_.emplace(func.first, func.second);
-    usedMemoryBytes_ += functionCost_; // TODO:: static moduleSize
   }
+  usedMemoryBytes_ += allocationSize;
 
   assert(usedMemoryBytes_ <= maxMemoryBytes_);
 
@@ -116,15 +214,28 @@ void CPUDeviceManager::evictNetworkImpl(std::string functionName,
                                         EvictFunctionCBTy evictCB) {
   DCHECK(evictCB != nullptr);
 
-  if (functions_.erase(functionName)) {
-    usedMemoryBytes_ -= functionCost_; // TODO: static moduleSize
-  } else {
+  auto it = functions_.find(functionName);
+  if (it == functions_.end()) {
     evictCB(functionName,
             MAKE_ERR(GlowErr::ErrorCode::RUNTIME_NET_NOT_FOUND,
                      strFormat("Could not find function with name %s to evict",
                                functionName.c_str())));
     return;
   }
+  CompiledFunction *func = it->second;
+  functions_.erase(it);
+
+  // The function is freed once evicted, so wait for the runs the execution
+  // slots still have of it.
+  {
+    std::lock_guard<std::mutex> lock(slotsLock_);
+    if (slotRuns_.count(func)) {
+      deferredEvictions_.emplace(
+          func, DeferredEviction{std::move(functionName), std::move(evictCB)});
+      return;
+    }
+  }
+  usedMemoryBytes_ -= getFunctionMemorySize(func->getRuntimeBundle());
   evictCB(functionName, llvm::Error::success());
 }
 
@@ -147,12 +258,93 @@ void CPUDeviceManager::runFunctionImpl(
   }
 
   CompiledFunction *func = funcIt->second;
+  TRACE_EVENT_SCOPE_END_NAMED(dmRun);
+
+  if (!slotPool_) {
+    executeFunction(id, func, std::move(context), std::move(resultCB));
+    return;
+  }
+
+  // Hand the run to a free slot, or queue it for the next slot to finish,
+  // so that the runs start in the order of the queue of the work thread
+  // without blocking it.
+  SlotRun run{id, func, std::move(context), std::move(resultCB)};
+  {
+    std::lock_guard<std::mutex> lock(slotsLock_);
+    slotRuns_[func]++;
+    if (freeSlots_ == 0) {
+      waitingRuns_.push_back(std::move(run));
+      return;
+    }
+    freeSlots_--;
+  }
+  slotPool_->submit([this, run = std::move(run)]() mutable {
+    runOnSlot(std::move(run));
+  });
+}
 
-  // Run that function.
-  auto executeErr = func->execute(context.get());
+void CPUDeviceManager::runOnSlot(SlotRun run) {
+  bool hasRun = true;
+  while (hasRun) {
+    // The deadline may have passed while waiting for the slot.
+    CompiledFunction *func = run.func;
+    if (run.context->isDeadlineExceeded()) {
+      run.resultCB(run.id,
+                   MAKE_ERR(GlowErr::ErrorCode::RUNTIME_DEADLINE_EXCEEDED,
+                            "The deadline of the run passed while queued"),
+                   std::move(run.context));
+    } else {
+      executeFunction(run.id, func, std::move(run.context),
+                      std::move(run.resultCB));
+    }
+
+    // Finish the eviction of the function after its last run.
+    DeferredEviction eviction;
+    bool evicted = false;
+    {
+      std::lock_guard<std::mutex> lock(slotsLock_);
+      auto it = slotRuns_.find(func);
+      if (--it->second == 0) {
+        slotRuns_.erase(it);
+        auto evictionIt = deferredEvictions_.find(func);
+        if (evictionIt != deferredEvictions_.end()) {
+          eviction = std::move(evictionIt->second);
+          deferredEvictions_.erase(evictionIt);
+          evicted = true;
+        }
+      }
+      hasRun = !waitingRuns_.empty();
+      if (!hasRun) {
+        freeSlots_++;
+      } else {
+        run = std::move(waitingRuns_.front());
+        waitingRuns_.pop_front();
+      }
+    }
+    if (evicted) {
+      usedMemoryBytes_ -= getFunctionMemorySize(func->getRuntimeBundle());
+      eviction.evictCB(eviction.functionName, llvm::Error::success());
+    }
+  }
+}
+
+void CPUDeviceManager::executeFunction(
+    RunIdentifierTy id, CompiledFunction *func,
+    std::unique_ptr<ExecutionContext> context, ResultCBTy resultCB) {
+  TRACE_EVENT_SCOPE_NAMED(context->getTraceContext(), TraceLevel::RUNTIME,
+                          "DeviceManager::execute", dmExecute);
+
+  // Run that function, letting its kernels use the intra-op threads. The
+  // slots share them, CPUParallelRuntime accepts concurrent callers.
+  auto executeStart = std::chrono::steady_clock::now();
+  auto executeErr = [&] {
+    CPUParallelRuntime::Scope parallelScope(parallelRuntime_.get());
+    return func->execute(context.get());
+  }();
+  context->setExecutionTime(std::chrono::steady_clock::now() - executeStart);
 
   // End the TraceEvent early to avoid time in the CB.
-  TRACE_EVENT_SCOPE_END_NAMED(dmRun);
+  TRACE_EVENT_SCOPE_END_NAMED(dmExecute);
 
   // Fire the resultCB.
   resultCB(id, std::move(executeErr), std::move(context));
@@ -16,15 +16,24 @@
 #ifndef GLOW_BACKENDS_CPU_CPUDEVICEMANAGER_H
 #define GLOW_BACKENDS_CPU_CPUDEVICEMANAGER_H
 
+#include "CPUParallelRuntime.h"
+
 #include "glow/Backends/QueueBackedDeviceManager.h"
 #include "glow/Runtime/StatsExporter.h"
 
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 namespace glow {
 namespace runtime {
 
 /// A class controlling a single CPU thread of execution driving the JIT
-/// backend. Many CPUFunctions may be added, but only one inference is executed
-/// at a time.
+/// backend. Many CPUFunctions may be added. By default one inference is
+/// executed at a time, the "executionSlots" parameter of the DeviceConfig
+/// allows that many inferences to run concurrently on the loaded constants.
 class CPUDeviceManager : public QueueBackedDeviceManager {
   /// Compiled function list by name.
   FunctionMapTy functions_;
@@ -33,12 +42,65 @@ class CPUDeviceManager : public QueueBackedDeviceManager {
   /// constant.
   uint64_t maxMemoryBytes_{0};
 
-  /// Amount of memory used by all models.
-  uint64_t usedMemoryBytes_{0};
-
-  /// Static memory cost of the CPU Function.
-  /// This is very arbitrary for the CPU backend.
-  const uint64_t functionCost_{1};
+  /// Amount of memory used by all models, the sum of the memory sizes of the
+  /// RuntimeBundles of their functions. Atomic as it is read from any thread.
+  std::atomic<uint64_t> usedMemoryBytes_{0};
+
+  /// Threads used by the kernels to split a single operator. Created by init
+  /// with the number of threads given by the "intraOpThreads" parameter of the
+  /// DeviceConfig, 1 by default.
+  std::unique_ptr<CPUParallelRuntime> parallelRuntime_;
+
+  /// CPUs the threads of the device run on, from the "cpuAffinity" and
+  /// "numaNode" parameters of the DeviceConfig. Empty if the threads are not
+  /// pinned.
+  std::vector<unsigned> cpus_;
+
+  /// NUMA node of the device from the "numaNode" parameter, -1 if unset. The
+  /// pinned threads touch the constants and activations first, so that they
+  /// are allocated on the node.
+  int numaNode_{-1};
+
+  /// Number of inferences which may run concurrently, given by the
+  /// "executionSlots" parameter of the DeviceConfig, 1 by default. Every slot
+  /// uses its own mutable weights and activations, the constants are shared.
+  unsigned executionSlots_{1};
+
+  /// Threads running the inferences when there are several execution slots.
+  /// The work thread hands a run to a free slot or queues it, and a slot runs
+  /// the queued runs in order before it is freed.
+  std::unique_ptr<ThreadPool> slotPool_;
+
+  /// A run waiting for an execution slot.
+  struct SlotRun {
+    RunIdentifierTy id;
+    CompiledFunction *func;
+    std::unique_ptr<ExecutionContext> context;
+    ResultCBTy resultCB;
+  };
+
+  /// An eviction waiting for the runs of its function to finish.
+  struct DeferredEviction {
+    std::string functionName;
+    EvictFunctionCBTy evictCB;
+  };
+
+  /// Number of execution slots not running an inference.
+  unsigned freeSlots_{0};
+
+  /// The runs waiting for an execution slot, in queue order.
+  std::deque<SlotRun> waitingRuns_;
+
+  /// Number of runs of each function waiting for or running on a slot.
+  std::unordered_map<const CompiledFunction *, unsigned> slotRuns_;
+
+  /// The evicted functions which still have runs in slotRuns_. Their memory is
+  /// released and their eviction callback called after the last run.
+  std::unordered_map<const CompiledFunction *, DeferredEviction>
+      deferredEvictions_;
+
+  /// Guards freeSlots_, waitingRuns_, slotRuns_ and deferredEvictions_.
+  std::mutex slotsLock_;
 
   /// String constant for logging number of in-use devices.
   static constexpr const char *kDevicesUsedCPU = "glow.devices_used.cpu";
@@ -51,9 +113,18 @@ public:
   }
 
   ~CPUDeviceManager() override {
+    // Join the threads before the slots they use are destroyed.
+    llvm::toString(stop(true));
     Stats()->incrementCounter(kDevicesUsedCPU, -1);
   }
 
+  /// Initialize the device, creating the intra-op and execution slot thread
+  /// pools and pinning the threads of the device to its CPUs.
+  llvm::Error init() override;
+
+  /// Stops execution and shuts down the Device.
+  llvm::Error stop(bool block = true) override;
+
   /// Returns the amount of memory in bytes available on the device when no
   /// models are loaded.
   uint64_t getMaximumMemory() const override;
@@ -66,11 +137,27 @@ public:
   /// etc.
   bool isMemoryAvailable(uint64_t estimate) const override;
 
+  /// \returns the memory used on the device by a function of \p bundle: its
+  /// constants and the mutable weights and activations of every slot.
+  uint64_t getFunctionMemorySize(const RuntimeBundle &bundle) const override;
+
   /// Returns the DeviceInfo for this device containing peak limits for
   /// compute and bandwidths (used in partitioning).
   DeviceInfo getDeviceInfo() const override;
 
 protected:
+  /// Reads the CPUs and NUMA node of the device from its DeviceConfig.
+  llvm::Error parseAffinity();
+
+  /// Runs \p func on \p context and fires \p resultCB with the result.
+  void executeFunction(RunIdentifierTy id, CompiledFunction *func,
+                       std::unique_ptr<ExecutionContext> context,
+                       ResultCBTy resultCB);
+
+  /// Runs \p run on the calling execution slot, then the runs waiting for a
+  /// slot, and frees the slot once there are none left.
+  void runOnSlot(SlotRun run);
+
   void addNetworkImpl(const Module *module, FunctionMapTy functions,
                       ReadyCBTy cb) override;
   void evictNetworkImpl(std::string functionName,
@@ -20,6 +20,9 @@
 #include "glow/LLVMIRCodeGen/LLVMBackend.h"
 #include "glow/Quantization/Base/Base.h"
 
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/Target/TargetMachine.h"
+
 using namespace glow;
 using llvm::cast;
 
@@ -33,6 +36,37 @@ void CPULLVMIRGen::generateLLVMIRForModule(llvm::IRBuilder<> &builder) {
   LLVMIRGen::generateLLVMIRForModule(builder);
 }
 
+/// \returns the suffix of the libjit_matmul_f variant whose microkernel fits
+/// the vector extensions of \p TM, or an empty string for the portable kernel.
+/// The kernels built on the float GEMM, like libjit_conv_winograd_f, have the
+/// same variants.
+static llvm::StringRef getMatMulVariant(const llvm::TargetMachine &TM) {
+  auto arch = TM.getTargetTriple().getArch();
+  if (arch != llvm::Triple::x86_64 && arch != llvm::Triple::x86) {
+    return "";
+  }
+  const auto *STI = TM.getMCSubtargetInfo();
+  if (STI->checkFeatures("+avx512f")) {
+    return "_avx512";
+  }
+  if (STI->checkFeatures("+avx2,+fma")) {
+    return "_avx2";
+  }
+  return "";
+}
+
+llvm::Function *CPULLVMIRGen::getFunction(const std::string &name,
+                                          glow::ElemKind elemTy) {
+  if ((name == "matmul" || name == "conv_winograd") &&
+      elemTy == ElemKind::FloatTy) {
+    auto variant = getMatMulVariant(getTargetMachine());
+    if (!variant.empty()) {
+      return LLVMIRGen::getFunction(name + "_f" + variant.str());
+    }
+  }
+  return LLVMIRGen::getFunction(name, elemTy);
+}
+
 void CPULLVMIRGen::generateLLVMIRForInstr(llvm::IRBuilder<> &builder,
                                           const glow::Instruction *I) {
   setCurrentDebugLocation(builder, I);
@@ -111,6 +145,96 @@ void CPULLVMIRGen::generateLLVMIRForInstr(llvm::IRBuilder<> &builder,
                 depthStripsVal});
     break;
   }
+
+  case Kinded::Kind::CPUConvWinogradInstKind: {
+    auto *CI = cast<CPUConvWinogradInst>(I);
+    auto *dest = CI->getDest();
+    auto *src = CI->getSrc();
+    auto *filter = CI->getFilter();
+    auto *bias = CI->getBias();
+    auto *scratch = CI->getScratch();
+    auto *destPtr = emitValueAddress(builder, dest);
+    auto *srcPtr = emitValueAddress(builder, src);
+    auto *filterPtr = emitValueAddress(builder, filter);
+    auto *biasPtr = emitValueAddress(builder, bias);
+    auto *scratchPtr = emitValueAddress(builder, scratch);
+
+    auto *destDims = emitValueDims(builder, dest);
+    auto *srcDims = emitValueDims(builder, src);
+    auto *filterDims = emitValueDims(builder, filter);
+    auto *scratchDims = emitValueDims(builder, scratch);
+
+    auto *pads = emitConstSizeTArray(builder, CI->getPads());
+    auto *tileSize = emitConstSizeT(builder, CI->getTileSize());
+
+    auto *F = getFunction("conv_winograd", dest->getElementType());
+    createCall(builder, F,
+               {destPtr, srcPtr, filterPtr, biasPtr, scratchPtr, destDims,
+                srcDims, filterDims, scratchDims, pads, tileSize});
+    break;
+  }
+
+  case Kinded::Kind::CPUConvDepthwiseInstKind: {
+    auto *CI = cast<CPUConvDepthwiseInst>(I);
+    auto *dest = CI->getDest();
+    auto *src = CI->getSrc();
+    auto *filter = CI->getFilter();
+    auto *bias = CI->getBias();
+    auto *destPtr = emitValueAddress(builder, dest);
+    auto *srcPtr = emitValueAddress(builder, src);
+    auto *filterPtr = emitValueAddress(builder, filter);
+    auto *biasPtr = emitValueAddress(builder, bias);
+
+    auto *destDims = emitValueDims(builder, dest);
+    auto *srcDims = emitValueDims(builder, src);
+    auto *biasDims = emitValueDims(builder, bias);
+
+    auto *kernels = emitConstSizeTArray(builder, CI->getKernels());
+    auto *strides = emitConstSizeTArray(builder, CI->getStrides());
+    auto *pads = emitConstSizeTArray(builder, CI->getPads());
+    auto *dilation = emitConstSizeT(builder, CI->getDilation());
+
+    auto *F = getFunction("conv_depthwise", dest->getElementType());
+
+    if (!src->getType()->isQuantizedType()) {
+      createCall(builder, F,
+                 {destPtr, srcPtr, filterPtr, biasPtr, destDims, srcDims,
+                  biasDims, kernels, strides, pads, dilation});
+      break;
+    }
+
+    // The filter was widened with its offset subtracted, it keeps its scale.
+    auto *destTy = dest->getType();
+    auto *srcTy = src->getType();
+    auto *biasTy = bias->getType();
+
+    auto *destOffset = emitConstI32(builder, destTy->getOffset());
+    auto *srcOffset = emitConstI32(builder, srcTy->getOffset());
+    auto *biasOffset = emitConstI32(builder, biasTy->getOffset());
+
+    // Calculate the scale of the values that come out of the multiplications.
+    float matMulScale = srcTy->getScale() * filter->getType()->getScale();
+
+    // Calculate the scaling parameters for the bias and output.
+    auto biasScaleParam = quantization::quantizeScaleOffset32To8(
+        biasTy->getScale() / matMulScale, biasTy->getOffset());
+    auto outScaleParam = quantization::quantizeScaleOffset32To8(
+        matMulScale / destTy->getScale(), 0);
+
+    auto *biasPre = emitConstI32(builder, biasScaleParam.pre);
+    auto *biasPost = emitConstI32(builder, biasScaleParam.post);
+    auto *biasScale = emitConstI32(builder, biasScaleParam.scale);
+    auto *outPre = emitConstI32(builder, outScaleParam.pre);
+    auto *outPost = emitConstI32(builder, outScaleParam.post);
+    auto *outScale = emitConstI32(builder, outScaleParam.scale);
+
+    createCall(builder, F,
+               {destPtr, srcPtr, filterPtr, biasPtr, destDims, srcDims,
+                biasDims, kernels, strides, pads, destOffset, srcOffset,
+                biasOffset, biasPre, biasPost, biasScale, outPre, outPost,
+                outScale, dilation});
+    break;
+  }
   default:
     LLVMIRGen::generateLLVMIRForInstr(builder, I);
   }
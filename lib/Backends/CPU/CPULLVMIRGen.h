@@ -44,6 +44,12 @@ public:
       llvm::Value *loopCount) override;
   /// Emit LLVM-IR for the whole IRFunction.
   virtual void generateLLVMIRForModule(llvm::IRBuilder<> &builder) override;
+  using LLVMIRGen::getFunction;
+  /// \returns a libjit API function by name and tensor element type. Float
+  /// matrix multiplications and Winograd convolutions use the microkernel
+  /// tuned for the widest vector extension of the target machine.
+  virtual llvm::Function *getFunction(const std::string &name,
+                                      glow::ElemKind elemTy) override;
 };
 
 } // namespace glow
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "CPUParallelRuntime.h"
+
+#include "glow/Support/ThreadAffinity.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/DynamicLibrary.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace glow {
+namespace runtime {
+
+/// The runtime used by the libjit kernels running on this thread.
+static thread_local CPUParallelRuntime *activeRuntime = nullptr;
+
+/// Host implementation of libjit_parallel_num_threads.
+static size_t hostParallelNumThreads() {
+  return activeRuntime ? activeRuntime->getNumThreads() : 1;
+}
+
+/// Host implementation of libjit_parallel_for.
+static void hostParallelFor(size_t numIterations,
+                            CPUParallelRuntime::TaskTy task, void *ctx) {
+  // Workers have no active runtime, nested calls run serially.
+  if (!activeRuntime) {
+    task(ctx, 0, numIterations);
+    return;
+  }
+  activeRuntime->parallelFor(numIterations, task, ctx);
+}
+
+CPUParallelRuntime::CPUParallelRuntime(unsigned numThreads)
+    : numThreads_(numThreads > 1 ? numThreads : 1) {
+  if (numThreads_ > 1) {
+    workers_ = llvm::make_unique<ThreadPool>(numThreads_ - 1);
+  }
+}
+
+llvm::Error CPUParallelRuntime::setAffinity(llvm::ArrayRef<unsigned> cpus) {
+  if (!workers_) {
+    return llvm::Error::success();
+  }
+  return setThreadPoolAffinity(*workers_, cpus);
+}
+
+void CPUParallelRuntime::parallelFor(size_t numIterations, TaskTy task,
+                                     void *ctx) {
+  size_t numChunks = std::min<size_t>(numThreads_, numIterations);
+  if (numChunks < 2) {
+    task(ctx, 0, numIterations);
+    return;
+  }
+
+  // Hand all but the first chunk to the workers and process the first chunk on
+  // the calling thread.
+  std::vector<std::future<void>> pending;
+  pending.reserve(numChunks - 1);
+  for (size_t i = 1; i < numChunks; i++) {
+    size_t begin = numIterations * i / numChunks;
+    size_t end = numIterations * (i + 1) / numChunks;
+    pending.push_back(
+        workers_->submit([task, ctx, begin, end]() { task(ctx, begin, end); }));
+  }
+  {
+    // The workers are busy with this loop, parallel loops nested in the first
+    // chunk run serially like the ones nested in the other chunks.
+    Scope serial(nullptr);
+    task(ctx, 0, numIterations / numChunks);
+  }
+  for (auto &future : pending) {
+    future.wait();
+  }
+}
+
+CPUParallelRuntime::Scope::Scope(CPUParallelRuntime *runtime)
+    : previous_(activeRuntime) {
+  activeRuntime = runtime;
+}
+
+CPUParallelRuntime::Scope::~Scope() { activeRuntime = previous_; }
+
+void CPUParallelRuntime::registerJITSymbols() {
+  static bool registered = [] {
+    llvm::sys::DynamicLibrary::AddSymbol(
+        "libjit_parallel_num_threads",
+        reinterpret_cast<void *>(&hostParallelNumThreads));
+    llvm::sys::DynamicLibrary::AddSymbol(
+        "libjit_parallel_for", reinterpret_cast<void *>(&hostParallelFor));
+    return true;
+  }();
+  (void)registered;
+}
+
+} // namespace runtime
+} // namespace glow
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GLOW_BACKENDS_CPU_CPUPARALLELRUNTIME_H
+#define GLOW_BACKENDS_CPU_CPUPARALLELRUNTIME_H
+
+#include "glow/Support/Error.h"
+#include "glow/Support/ThreadPool.h"
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <memory>
+
+namespace glow {
+namespace runtime {
+
+/// Intra-op parallel runtime of a CPU device. JIT'ed libjit kernels call
+/// libjit_parallel_for to split a single operator across the threads of the
+/// runtime active on the calling thread. The calling thread takes part in the
+/// work, so a runtime with N threads owns N - 1 workers.
+class CPUParallelRuntime final {
+public:
+  /// A task processing the iterations [begin, end) of a loop, \p ctx holds the
+  /// arguments of the kernel. See libjit_parallel_task.
+  using TaskTy = void (*)(void *ctx, size_t begin, size_t end);
+
+  /// Creates a runtime splitting work across \p numThreads threads.
+  explicit CPUParallelRuntime(unsigned numThreads);
+
+  /// \returns the number of threads work is split across.
+  unsigned getNumThreads() const { return numThreads_; }
+
+  /// Restricts the workers of the runtime to run on \p cpus.
+  llvm::Error setAffinity(llvm::ArrayRef<unsigned> cpus);
+
+  /// Run \p task with \p ctx over [0, \p numIterations), split in one
+  /// contiguous range per thread. Returns once all ranges are processed.
+  void parallelFor(size_t numIterations, TaskTy task, void *ctx);
+
+  /// RAII helper activating a runtime for the libjit kernels executed by the
+  /// current thread. Kernels run serially when no runtime is active.
+  class Scope final {
+  public:
+    explicit Scope(CPUParallelRuntime *runtime);
+    ~Scope();
+
+  private:
+    /// The runtime active before this scope, restored on exit.
+    CPUParallelRuntime *previous_;
+  };
+
+  /// Bind the libjit_parallel_num_threads and libjit_parallel_for symbols of
+  /// JIT'ed code to the runtime active on the calling thread. Must be called
+  /// before the code is JIT'ed, calling it again has no effect.
+  static void registerJITSymbols();
+
+private:
+  /// Number of threads work is split across, including the calling thread.
+  const unsigned numThreads_;
+
+  /// The workers helping the calling thread. nullptr if numThreads_ is 1.
+  std::unique_ptr<ThreadPool> workers_;
+};
+
+} // namespace runtime
+} // namespace glow
+
+#endif // GLOW_BACKENDS_CPU_CPUPARALLELRUNTIME_H
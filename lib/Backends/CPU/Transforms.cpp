@@ -19,10 +19,23 @@
 #include "glow/Graph/Graph.h"
 #include "glow/Graph/Nodes.h"
 
+#include "llvm/Support/CommandLine.h"
+
 using namespace glow;
 using llvm::dyn_cast;
 using llvm::isa;
 
+/// The minimum number of input and output channels of a convolution computed
+/// by the Winograd algorithm. Below it the transforms of the tiles cost more
+/// than the channel GEMMs save, and the low-channel convolutions whose output
+/// depth is a multiple of 64 are left to CPUConvDKKC8, which scans the pixels
+/// first for them.
+llvm::cl::opt<unsigned> cpuWinogradMinChannels(
+    "cpu-winograd-min-channels",
+    llvm::cl::desc("Minimum number of input and output channels of the "
+                   "convolutions computed by the Winograd algorithm on CPU."),
+    llvm::cl::init(16));
+
 /// Try to optimize the regular Convolution into a target-specific convolution
 /// with a different filter memory layout. This optimization adds a new kind of
 /// cpu-specific convolution that operates on filter weight data in a
@@ -84,6 +97,163 @@ static Node *optimizeCPUConv(ConvolutionNode *CN, Function *F) {
       CN->getBias(), CN->getKernels(), CN->getStrides(), CN->getPads(), group));
 }
 
+/// The filter transform G of Winograd F(2x2, 3x3).
+static const double winograd2G[4][3] = {
+    {1, 0, 0}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}, {0, 0, 1}};
+
+/// The filter transform G of Winograd F(4x4, 3x3).
+static const double winograd4G[6][3] = {
+    {1.0 / 4, 0, 0},
+    {-1.0 / 6, -1.0 / 6, -1.0 / 6},
+    {-1.0 / 6, 1.0 / 6, -1.0 / 6},
+    {1.0 / 24, 1.0 / 12, 1.0 / 6},
+    {1.0 / 24, -1.0 / 12, 1.0 / 6},
+    {0, 0, 1},
+};
+
+/// Try to optimize the regular Convolution into a convolution computed by the
+/// Winograd F(MxM, 3x3) algorithm, which trades the multiplications of the
+/// direct convolution for cheap transforms of the input and output tiles: per
+/// output pixel F(2x2, 3x3) performs 2.25 times and F(4x4, 3x3) 4 times fewer
+/// multiplications. The filter is transformed into the Winograd domain, G * g
+/// * G^T, at compile time and stored with the layout [M + 2, M + 2, C, D].
+/// This is only done for float 3x3 convolutions with unit strides, no dilation
+/// and a single group, whose channel counts reach cpuWinogradMinChannels so
+/// that the channel GEMMs dominate the cost of the transforms.
+static Node *optimizeCPUConvWinograd(ConvolutionNode *CN, Function *F) {
+  llvm::ArrayRef<unsigned_t> kernels = CN->getKernels();
+  llvm::ArrayRef<unsigned_t> strides = CN->getStrides();
+  if (kernels[0] != 3 || kernels[1] != 3 || strides[0] != 1 ||
+      strides[1] != 1 || CN->getDilation() != 1 || CN->getGroup() != 1) {
+    return nullptr;
+  }
+
+  Constant *filter = dyn_cast<Constant>(CN->getFilter());
+  if (!filter || filter->getNumUsers() != 1) {
+    // Can't mutate the filter.
+    return nullptr;
+  }
+
+  // We only support Floats for now.
+  if (filter->getElementType() != ElemKind::FloatTy ||
+      CN->getResult().getElementType() != ElemKind::FloatTy) {
+    return nullptr;
+  }
+
+  // With few channels the transforms cost more than what the algorithm saves,
+  // leave the convolution to CPUConvDKKC8 or the generic kernel.
+  auto dims = filter->getType()->dims();
+  size_t outChannels = dims[0];
+  size_t inChannels = dims[3];
+  if (inChannels < cpuWinogradMinChannels ||
+      outChannels < cpuWinogradMinChannels) {
+    return nullptr;
+  }
+
+  // Large tiles save more multiplications but are less accurate and waste
+  // more work on the borders of small images.
+  ShapeNHWC odim(CN->getResult().dims());
+  unsigned_t tileSize = (odim.h >= 8 && odim.w >= 8) ? 4 : 2;
+  size_t alpha = tileSize + 2;
+  const double *G = (tileSize == 2) ? &winograd2G[0][0] : &winograd4G[0][0];
+
+  // Compute U[xi][nu][c][d] = sum(G[xi][i] * g[d][i][j][c] * G[nu][j]).
+  auto *M = F->getParent();
+  auto *filterW = M->createConstant(ElemKind::FloatTy,
+                                    {alpha, alpha, inChannels, outChannels},
+                                    filter->getName());
+  auto FH = filter->getHandle();
+  auto FWH = filterW->getHandle();
+  for (size_t d = 0; d < outChannels; d++) {
+    for (size_t c = 0; c < inChannels; c++) {
+      // tmp = G * g, for the (d, c) slice of the filter.
+      double tmp[6][3];
+      for (size_t xi = 0; xi < alpha; xi++) {
+        for (size_t j = 0; j < 3; j++) {
+          tmp[xi][j] = 0;
+          for (size_t i = 0; i < 3; i++) {
+            tmp[xi][j] += G[xi * 3 + i] * FH.at({d, i, j, c});
+          }
+        }
+      }
+      for (size_t xi = 0; xi < alpha; xi++) {
+        for (size_t nu = 0; nu < alpha; nu++) {
+          double sum = 0;
+          for (size_t j = 0; j < 3; j++) {
+            sum += tmp[xi][j] * G[nu * 3 + j];
+          }
+          FWH.at({xi, nu, c, d}) = sum;
+        }
+      }
+    }
+  }
+
+  return F->addNode(new CPUConvWinogradNode(
+      CN->getName(), CN->getResult().getType(), CN->getInput(), filterW,
+      CN->getBias(), CN->getPads(), tileSize));
+}
+
+/// Try to optimize a depthwise Convolution, whose groups each have a single
+/// input channel, into a CPU-specific convolution whose filter is transposed
+/// from [D, K, K, 1] to [K, K, D]. The weights applied to neighbouring output
+/// channels are then contiguous, like the channels of the input and output in
+/// NHWC, and the kernel vectorizes over the channels. The weights of a
+/// quantized filter are widened to Int32QTy with their offset subtracted, the
+/// form the kernel accumulates.
+static Node *optimizeCPUConvDepthwise(ConvolutionNode *CN, Function *F) {
+  auto group = CN->getGroup();
+  if (group <= 1 || group != CN->getInput().dims()[3]) {
+    return nullptr;
+  }
+
+  Constant *filter = dyn_cast<Constant>(CN->getFilter());
+  if (!filter || filter->getNumUsers() != 1) {
+    // Can't mutate the filter.
+    return nullptr;
+  }
+
+  ElemKind kind = filter->getElementType();
+  if (kind != ElemKind::FloatTy && kind != ElemKind::Int8QTy) {
+    return nullptr;
+  }
+
+  auto dims = filter->getType()->dims();
+  size_t outChannels = dims[0];
+  size_t kernelSize = dims[1] * dims[2];
+  auto *M = F->getParent();
+  Constant *filterT;
+  if (kind == ElemKind::FloatTy) {
+    filterT = M->createConstant(ElemKind::FloatTy,
+                                {dims[1], dims[2], outChannels},
+                                filter->getName());
+    auto FH = filter->getHandle();
+    auto FTH = filterT->getHandle();
+    for (size_t d = 0; d < outChannels; d++) {
+      for (size_t k = 0; k < kernelSize; k++) {
+        FTH.raw(k * outChannels + d) = FH.raw(d * kernelSize + k);
+      }
+    }
+  } else {
+    filterT = M->createConstant(ElemKind::Int32QTy,
+                                {dims[1], dims[2], outChannels},
+                                filter->getType()->getScale(), 0,
+                                filter->getName());
+    int32_t offset = filter->getType()->getOffset();
+    auto FH = filter->getHandle<int8_t>();
+    auto FTH = filterT->getHandle<int32_t>();
+    for (size_t d = 0; d < outChannels; d++) {
+      for (size_t k = 0; k < kernelSize; k++) {
+        FTH.raw(k * outChannels + d) = FH.raw(d * kernelSize + k) - offset;
+      }
+    }
+  }
+
+  return F->addNode(new CPUConvDepthwiseNode(
+      CN->getName(), CN->getResult().getType(), CN->getInput(), filterT,
+      CN->getBias(), CN->getKernels(), CN->getStrides(), CN->getPads(),
+      CN->getDilation()));
+}
+
 /// Merge Max and Splat nodes into target-specific CPUMaxSplat node.
 /// For quantized network, sinkRescaleQuantizedNode transformation might have
 /// merged Rescale into Max node. In this case we need to pull it out, since
@@ -127,7 +297,14 @@ bool CPUBackend::transformPostLowering(Function *F,
   for (auto &node : F->getNodes()) {
     // Try to replace generic convolution with cpu-optimized version.
     if (auto *CN = dyn_cast<ConvolutionNode>(&node)) {
-      if (Node *NCN = optimizeCPUConv(CN, F)) {
+      Node *NCN = optimizeCPUConvDepthwise(CN, F);
+      if (!NCN) {
+        NCN = optimizeCPUConvWinograd(CN, F);
+      }
+      if (!NCN) {
+        NCN = optimizeCPUConv(CN, F);
+      }
+      if (NCN) {
         CN->getResult().replaceAllUsesOfWith(NCN);
         changed = true;
         continue;
@@ -1901,6 +1901,15 @@ void libjit_write_timestamp(uint64_t *tensor, size_t offset) {
   memcpy(tensor + offset, &ts, sizeof(uint64_t));
 }
 
+/// Serial fallback of the intra-op parallel runtime, used by bundles. The JIT
+/// replaces these with the thread pool of the CPU device.
+size_t libjit_parallel_num_threads() { return 1; }
+
+void libjit_parallel_for(size_t numIterations, libjit_parallel_task task,
+                         void *ctx) {
+  task(ctx, 0, numIterations);
+}
+
 /// Update min/max values \p compInfo and histogram \p existingHistogram with
 /// data collected from tensor \p inputTensor.
 /// Note: code ported from Profile.cpp: generateTensorHistogram
@@ -24,6 +24,23 @@
 
 #include "libjit_defs.h"
 
+extern "C" {
+void libjit_matmul_f(float *c, const float *a, const float *b,
+                     const size_t *cDims, const size_t *aDims,
+                     const size_t *bDims);
+void libjit_matmul_f_avx2(float *c, const float *a, const float *b,
+                          const size_t *cDims, const size_t *aDims,
+                          const size_t *bDims);
+void libjit_matmul_f_avx512(float *c, const float *a, const float *b,
+                            const size_t *cDims, const size_t *aDims,
+                            const size_t *bDims);
+}
+
+/// Signature of the libjit_matmul_f variants.
+typedef void (*libjit_matmul_f_fn)(float *c, const float *a, const float *b,
+                                   const size_t *cDims, const size_t *aDims,
+                                   const size_t *bDims);
+
 namespace {
 // Initialize the convolution output frame for slice \p N with the bias \p
 // biasW.
@@ -251,9 +268,699 @@ void libjit_convDKKC8_foreach_xy_pixels_filter(
   }       // For each X in the output.
 }
 
+/// Arguments of libjit_convDKKC8_f, shared by its parallel tasks.
+struct ConvDKKC8Args {
+  float *outW;
+  const float *inW;
+  const float *filterW;
+  const float *biasW;
+  const size_t *outWdims;
+  const size_t *inWdims;
+  const size_t *filterWdims;
+  const size_t *biasWdims;
+  const size_t *kernelSizes;
+  const size_t *strides;
+  const size_t *pads;
+  size_t group;
+  unsigned pixelScanFirst;
+  unsigned numDepthRegs;
+  unsigned sizeGroupY;
+  unsigned depthStrips;
+  /// The sample in the batch being processed.
+  size_t n;
+};
+
+/// Convolves the blocks of output channels [\p begin, \p end) of the sample
+/// described by \p ctx. Each group of channels is split in blocks of
+/// [8 * numDepthRegs * depthStrips] channels.
+void libjit_convDKKC8_f_task(void *ctx, size_t begin, size_t end) {
+  const ConvDKKC8Args &args = *static_cast<const ConvDKKC8Args *>(ctx);
+  size_t inCperG = args.inWdims[3] / args.group;
+  size_t outCperG = args.outWdims[3] / args.group;
+  size_t blockSize = 8 * args.numDepthRegs * args.depthStrips;
+  size_t blocksPerG = (outCperG + blockSize - 1) / blockSize;
+
+  // Select the order in which we iterate over the pixels in the picture.
+  auto eachPixelConv =
+      (args.pixelScanFirst ? &libjit_convDKKC8_foreach_xy_pixels_filter
+                           : &libjit_convDKKC8_foreach_xy_filter_pixels);
+
+  // For each block of output channels, process [numDepthRegs x float8]
+  // elements.
+  for (size_t b = begin; b < end; b++) {
+    size_t g = b / blocksPerG;
+    size_t d = g * outCperG + (b % blocksPerG) * blockSize;
+    size_t endChannelIndex = (g + 1) * outCperG;
+
+    // Perform the convolution for each pixel.
+    eachPixelConv(args.n, d, args.numDepthRegs, args.depthStrips,
+                  args.sizeGroupY, inCperG, args.outW, args.inW, args.filterW,
+                  args.biasW, args.outWdims, args.inWdims, args.filterWdims,
+                  args.biasWdims, args.kernelSizes, args.strides, args.pads, g,
+                  endChannelIndex);
+  }
+}
+
+/// Arguments of libjit_convolution_f, shared by its parallel tasks.
+struct ConvolutionArgs {
+  float *outW;
+  const float *inW;
+  const float *filterW;
+  const size_t *outWdims;
+  const size_t *inWdims;
+  const size_t *filterWdims;
+  const size_t *kernelSizes;
+  const size_t *strides;
+  const size_t *pads;
+  size_t group;
+  unsigned depthUnroll;
+  size_t dilation;
+  /// The sample in the batch being processed.
+  size_t n;
+};
+
+/// Convolves the blocks of output channels [\p begin, \p end) of the sample
+/// described by \p ctx. Output channels are processed in blocks of
+/// 'depthUnroll' channels.
+void libjit_convolution_f_task(void *ctx, size_t begin, size_t end) {
+  const ConvolutionArgs &args = *static_cast<const ConvolutionArgs *>(ctx);
+  const size_t *outWdims = args.outWdims;
+  const size_t *inWdims = args.inWdims;
+  const size_t *filterWdims = args.filterWdims;
+  const float *inW = args.inW;
+  const float *filterW = args.filterW;
+  float *outW = args.outW;
+  size_t n = args.n;
+  size_t dilation = args.dilation;
+  unsigned depthUnroll = args.depthUnroll;
+  size_t inCperG = inWdims[3] / args.group;
+  size_t outCperG = outWdims[3] / args.group;
+
+  // The output dims are calculated already from all of the pads,
+  // therefore we only need the top and left pads here to control the starting
+  // position.
+  size_t pad_t = args.pads[0];
+  size_t pad_l = args.pads[1];
+  size_t stride_h = args.strides[0];
+  size_t stride_w = args.strides[1];
+  size_t kernel_h = args.kernelSizes[0];
+  size_t kernel_w = args.kernelSizes[1];
+  // The size of the input-channel tile. High channel count allow for SIMD
+  // parallelism but create register pressure. Low channel count reduces the
+  // memory pressure and allows things to fit in cache, but require additional
+  // compute (horizontal add) to sum the values in the block. This value is a
+  // compromise between the two.
+  constexpr unsigned cbSize = 512;
+
+  // For each block of 'depthUnroll' output channels:
+  for (size_t b = begin; b < end; b++) {
+    size_t d = b * depthUnroll;
+    size_t g = d / outCperG;
+
+    // Process the body of the loop in tiles of "channel-block".
+    for (size_t cb = 0; cb < inCperG; cb += cbSize) {
+
+      // For each element in the convolution-filter:
+      for (size_t fx = 0; fx < kernel_h; fx++) {
+        for (size_t fy = 0; fy < kernel_w; fy++) {
+
+          // For each convolution 'jump' in the input tensor:
+          for (size_t outx = 0; outx < outWdims[1]; outx++) {
+            for (size_t outy = 0; outy < outWdims[2]; outy++) {
+
+              // Process 'depthUnroll' output pixels at once. Each scalar here
+              // represents the convolution sum for one (x,y) point in the
+              // output. We process the same pixel for different output channel
+              // (D) values. The compiler should perform scalar replacement of
+              // aggregates and split this tiny array to registers.
+              float sum[depthUnroll];
+              for (unsigned i = 0; i < depthUnroll; i++) {
+                sum[i] = 0;
+              }
+
+              // Calculate the specific input x,y that we process in this
+              // iteration.
+              ssize_t inx = (ssize_t)outx * stride_h - pad_t + fx * dilation;
+              ssize_t iny = (ssize_t)outy * stride_w - pad_l + fy * dilation;
+
+              // Ignore index access below zero (this is due to padding).
+              if (inx < 0 || iny < 0 || inx >= (ssize_t)inWdims[1] ||
+                  iny >= (ssize_t)inWdims[2]) {
+                continue;
+              }
+
+              // Calculate the indices into the Filter and Input buffers.
+              size_t inIdx = libjit_getXYZW(inWdims, n, (size_t)inx,
+                                            (size_t)iny, g * inCperG);
+              size_t filterIdx = libjit_getXYZW(filterWdims, d, fx, fy, 0);
+              size_t sliceSize =
+                  filterWdims[1] * filterWdims[2] * filterWdims[3];
+
+              // Perform the heart of the convolution, 4 elements at a time to
+              // reduce register pressure.
+              for (size_t fd = cb, e = MIN(cb + cbSize, inCperG); fd < e;
+                   fd++) {
+                float in = inW[inIdx + fd];
+                for (unsigned i = 0; i < MIN(4, depthUnroll); i++) {
+                  sum[i] += filterW[filterIdx + (sliceSize * i) + fd] * in;
+                }
+              }
+
+              // And run the innermost loop again for the second group of depth
+              // slices:
+              if (depthUnroll > 4) {
+                for (size_t fd = cb, e = MIN(cb + cbSize, inCperG); fd < e;
+                     fd++) {
+                  float in = inW[inIdx + fd];
+                  for (unsigned i = 4; i < MIN(8, depthUnroll); i++) {
+                    sum[i] += filterW[filterIdx + (sliceSize * i) + fd] * in;
+                  }
+                }
+              }
+
+              // Store the results to the output buffer.
+              for (unsigned i = 0; i < depthUnroll; i++) {
+                outW[libjit_getXYZW(outWdims, n, outx, outy, d + i)] += sum[i];
+              }
+            }
+          }
+        } // For each Y in the filter.
+      }   // For each X in the filter.
+    }     // For each block in the input channel.
+  }       // For each D (the depth, or the output channel).
+}
+
+/// Arguments of libjit_convolution_i8, shared by its parallel tasks.
+struct ConvolutionI8Args {
+  int8_t *outW;
+  const int8_t *inW;
+  const int8_t *filterW;
+  const int32_t *biasW;
+  const size_t *outWdims;
+  const size_t *inWdims;
+  const size_t *filterWdims;
+  const size_t *kernelSizes;
+  const size_t *strides;
+  const size_t *pads;
+  size_t group;
+  int32_t outOffset;
+  int32_t inOffset;
+  int32_t filterOffset;
+  int32_t biasOffset;
+  int32_t biasPre;
+  int32_t biasPost;
+  int32_t biasScale;
+  int32_t outPre;
+  int32_t outPost;
+  int32_t outScale;
+  unsigned depthUnroll;
+  size_t dilation;
+  /// The sample in the batch being processed.
+  size_t n;
+};
+
+/// Convolves the blocks of output channels [\p begin, \p end) of the sample
+/// described by \p ctx. Output channels are processed in blocks of
+/// 'depthUnroll' channels.
+void libjit_convolution_i8_task(void *ctx, size_t begin, size_t end) {
+  const ConvolutionI8Args &args = *static_cast<const ConvolutionI8Args *>(ctx);
+  const size_t *outWdims = args.outWdims;
+  const size_t *inWdims = args.inWdims;
+  const size_t *filterWdims = args.filterWdims;
+  const int8_t *inW = args.inW;
+  const int8_t *filterW = args.filterW;
+  size_t n = args.n;
+  size_t dilation = args.dilation;
+  unsigned depthUnroll = args.depthUnroll;
+  size_t inCperG = inWdims[3] / args.group;
+  size_t outCperG = outWdims[3] / args.group;
+  size_t pad_t = args.pads[0];
+  size_t pad_l = args.pads[1];
+  size_t stride_h = args.strides[0];
+  size_t stride_w = args.strides[1];
+  size_t kernel_h = args.kernelSizes[0];
+  size_t kernel_w = args.kernelSizes[1];
+
+  // For each block of 'depthUnroll' output channels:
+  for (size_t b = begin; b < end; b++) {
+    size_t d = b * depthUnroll;
+    size_t g = d / outCperG;
+
+    // For each convolution 'jump' in the input tensor:
+    ssize_t x = -(ssize_t)pad_t;
+    for (size_t ax = 0; ax < outWdims[1]; x += stride_h, ax++) {
+      ssize_t y = -(ssize_t)pad_l;
+      for (size_t ay = 0; ay < outWdims[2]; y += stride_w, ay++) {
+        int32_t sum[depthUnroll];
+
+        for (unsigned i = 0; i < depthUnroll; i++) {
+          // Scale the bias to match the scale of the matrix multiplication.
+          sum[i] = libjit_scale_i32i8((int32_t)args.biasW[d + i] -
+                                          args.biasOffset,
+                                      args.biasPre, args.biasPost,
+                                      args.biasScale, 0);
+        }
+
+        // For each element in the convolution-filter:
+        for (size_t fx = 0; fx < kernel_h; fx++) {
+          for (size_t fy = 0; fy < kernel_w; fy++) {
+            ssize_t ox = x + fx * dilation;
+            ssize_t oy = y + fy * dilation;
+
+            // Ignore index access below zero (this is due to padding).
+            if (ox < 0 || oy < 0 || ox >= (ssize_t)inWdims[1] ||
+                oy >= (ssize_t)inWdims[2]) {
+              continue;
+            }
+
+            // Calculate the indices into the Filter and Input buffers.
+            size_t inIdx = libjit_getXYZW(inWdims, n, (size_t)ox, (size_t)oy,
+                                          g * inCperG);
+            size_t filterIdx = libjit_getXYZW(filterWdims, d, fx, fy, 0);
+            size_t sliceSize = filterWdims[1] * filterWdims[2] * filterWdims[3];
+
+            // Perform the innermost loop of the convolution using 4 vector
+            // registers.
+            for (size_t fd = 0; fd < inCperG; fd++) {
+              int32_t in = inW[inIdx + fd] - args.inOffset;
+              for (unsigned i = 0; i < MIN(4, depthUnroll); i++) {
+                sum[i] += (filterW[filterIdx + (sliceSize * i) + fd] -
+                           args.filterOffset) *
+                          in;
+              }
+            }
+
+            // And perform the innermost loop again with 4 more registers.
+            if (depthUnroll > 4)
+              for (size_t fd = 0; fd < inCperG; fd++) {
+                int32_t in = inW[inIdx + fd] - args.inOffset;
+                for (unsigned i = 4; i < MIN(8, depthUnroll); i++) {
+                  sum[i] += (filterW[filterIdx + (sliceSize * i) + fd] -
+                             args.filterOffset) *
+                            in;
+                }
+              }
+          }
+        }
+
+        for (unsigned i = 0; i < depthUnroll; i++) {
+          // Scale the result back to the expected destination scale.
+          int32_t scaledSum = libjit_scale_i32i8(
+              sum[i], args.outPre, args.outPost, args.outScale, args.outOffset);
+          args.outW[libjit_getXYZW(outWdims, n, ax, ay, d + i)] =
+              libjit_clip(scaledSum);
+        }
+      } // W
+    }   // H
+  }     // C
+}
+
+/// Input transform B^T of Winograd F(2x2, 3x3).
+const float libjit_winograd2_BT[4][4] = {
+    {1, 0, -1, 0}, {0, 1, 1, 0}, {0, -1, 1, 0}, {0, 1, 0, -1}};
+
+/// Output transform A^T of Winograd F(2x2, 3x3).
+const float libjit_winograd2_AT[2][4] = {{1, 1, 1, 0}, {0, 1, -1, -1}};
+
+/// Input transform B^T of Winograd F(4x4, 3x3).
+const float libjit_winograd4_BT[6][6] = {
+    {4, 0, -5, 0, 1, 0},  {0, -4, -4, 1, 1, 0}, {0, 4, -4, -1, 1, 0},
+    {0, -2, -1, 2, 1, 0}, {0, 2, -1, -2, 1, 0}, {0, 4, 0, -5, 0, 1}};
+
+/// Output transform A^T of Winograd F(4x4, 3x3).
+const float libjit_winograd4_AT[4][6] = {{1, 1, 1, 1, 1, 0},
+                                         {0, 1, -1, 2, -2, 0},
+                                         {0, 1, 1, 4, 4, 0},
+                                         {0, 1, -1, 8, -8, 1}};
+
+/// The number of output tiles transformed together. The transformed tiles of a
+/// block form the rows of the matrices multiplied with the filter.
+constexpr size_t winogradTileBlock = 32;
+
+/// Arguments of libjit_conv_winograd_f, shared by its parallel tasks.
+struct ConvWinogradArgs {
+  float *outW;
+  const float *inW;
+  const float *filterW;
+  const float *biasW;
+  const size_t *outWdims;
+  const size_t *inWdims;
+  /// Scratch memory of the tasks, one slot of slotSize floats per task.
+  float *scratchW;
+  size_t slotSize;
+  size_t padT;
+  size_t padL;
+  /// The number of output tiles along the height and the width.
+  size_t tilesH;
+  size_t tilesW;
+  /// The number of blocks of winogradTileBlock tiles, split in numTasks
+  /// contiguous ranges.
+  size_t numBlocks;
+  size_t numTasks;
+  /// The sample in the batch being processed.
+  size_t n;
+};
+
+/// Computes y += a * x over \p size channels.
+void libjit_winograd_axpy(float *y, const float *x, float a, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    y[i] += a * x[i];
+  }
+}
+
+/// Computes the transform T * X * T^T of a \p K x \p K tile X whose rows are
+/// the vectors of \p size channels \p x[i][j], where T is the R x K matrix \p
+/// T. The result is stored as R x R vectors of \p size channels, the vector
+/// (i, j) starting at \p out + (i * R + j) * \p outStride. \p tmp is scratch
+/// memory of R x K vectors. Multiplications by zero are skipped, the
+/// transforms are sparse.
+template <size_t R, size_t K>
+void libjit_winograd_transform(float *out, size_t outStride,
+                               const float *x[K][K], const float T[R][K],
+                               float *tmp, size_t size) {
+  memset(tmp, 0, R * K * size * sizeof(float));
+  for (size_t i = 0; i < R; i++) {
+    for (size_t k = 0; k < K; k++) {
+      if (T[i][k] == 0) {
+        continue;
+      }
+      for (size_t j = 0; j < K; j++) {
+        libjit_winograd_axpy(&tmp[(i * K + j) * size], x[k][j], T[i][k], size);
+      }
+    }
+  }
+  for (size_t i = 0; i < R; i++) {
+    for (size_t j = 0; j < R; j++) {
+      float *o = &out[(i * R + j) * outStride];
+      memset(o, 0, size * sizeof(float));
+      for (size_t k = 0; k < K; k++) {
+        if (T[j][k] != 0) {
+          libjit_winograd_axpy(o, &tmp[(i * K + k) * size], T[j][k], size);
+        }
+      }
+    }
+  }
+}
+
+/// Computes the tasks [\p begin, \p end) of the Winograd F(MxM, 3x3)
+/// convolution described by \p ctx, whose input and output transforms are \p
+/// BT and \p AT. Task i processes the i-th range of blocks of
+/// winogradTileBlock tiles with the i-th slot of scratch memory: each block is
+/// transformed into the Winograd domain, each of the alpha x alpha positions
+/// is multiplied with the transformed filter by one GEMM over the channels,
+/// computed by \p matmul, and the products are transformed back.
+template <size_t M, const float (&BT)[M + 2][M + 2],
+          const float (&AT)[M][M + 2], libjit_matmul_f_fn matmul>
+void libjit_conv_winograd_f_task(void *ctx, size_t begin, size_t end) {
+  constexpr size_t alpha = M + 2;
+  const ConvWinogradArgs &args = *static_cast<const ConvWinogradArgs *>(ctx);
+  const size_t *outWdims = args.outWdims;
+  const size_t *inWdims = args.inWdims;
+  size_t C = inWdims[3];
+  size_t D = outWdims[3];
+  size_t maxCD = MAX(C, D);
+
+  // The slot of scratch memory holds the transformed input
+  // V[alpha * alpha][block][C], the products P[alpha * alpha][block][D], the
+  // temporaries of the transforms, 2 * alpha * alpha * max(C, D) floats, and a
+  // row of C zeros standing for the padding.
+  size_t vSize = alpha * alpha * winogradTileBlock * C;
+  size_t pSize = alpha * alpha * winogradTileBlock * D;
+  size_t tmpSize = 2 * alpha * alpha * maxCD;
+
+  size_t mDims[] = {0, D};
+  size_t vDims[] = {0, C};
+  size_t uDims[] = {C, D};
+  const float *x[alpha][alpha];
+
+  for (size_t task = begin; task < end; task++) {
+    float *V = args.scratchW + task * args.slotSize;
+    float *P = V + vSize;
+    float *tmp = P + pSize;
+    float *zeros = tmp + tmpSize;
+    memset(zeros, 0, C * sizeof(float));
+
+    size_t numTiles = args.tilesH * args.tilesW;
+    size_t blockBegin = args.numBlocks * task / args.numTasks;
+    size_t blockEnd = args.numBlocks * (task + 1) / args.numTasks;
+    for (size_t t0 = blockBegin * winogradTileBlock;
+         t0 < MIN(blockEnd * winogradTileBlock, numTiles);
+         t0 += winogradTileBlock) {
+      size_t blockSize = MIN(winogradTileBlock, numTiles - t0);
+
+      // Transform the input tiles: V = B^T * d * B.
+      for (size_t t = 0; t < blockSize; t++) {
+        ssize_t x0 = (ssize_t)(((t0 + t) / args.tilesW) * M) - args.padT;
+        ssize_t y0 = (ssize_t)(((t0 + t) % args.tilesW) * M) - args.padL;
+        for (size_t i = 0; i < alpha; i++) {
+          for (size_t j = 0; j < alpha; j++) {
+            ssize_t ix = x0 + i;
+            ssize_t iy = y0 + j;
+            bool inside = ix >= 0 && iy >= 0 && ix < (ssize_t)inWdims[1] &&
+                          iy < (ssize_t)inWdims[2];
+            x[i][j] = inside ? &args.inW[libjit_getXYZW(inWdims, args.n, ix,
+                                                        iy, 0)]
+                             : zeros;
+          }
+        }
+        libjit_winograd_transform<alpha, alpha>(
+            &V[t * C], winogradTileBlock * C, x, BT, tmp, C);
+      }
+
+      // Multiply each position of the block with the transformed filter.
+      mDims[0] = blockSize;
+      vDims[0] = blockSize;
+      for (size_t p = 0; p < alpha * alpha; p++) {
+        matmul(&P[p * winogradTileBlock * D], &V[p * winogradTileBlock * C],
+               &args.filterW[p * C * D], mDims, vDims, uDims);
+      }
+
+      // Transform the products back, y = A^T * m * A, and add the bias.
+      for (size_t t = 0; t < blockSize; t++) {
+        size_t ox = ((t0 + t) / args.tilesW) * M;
+        size_t oy = ((t0 + t) % args.tilesW) * M;
+        for (size_t i = 0; i < alpha; i++) {
+          for (size_t j = 0; j < alpha; j++) {
+            x[i][j] = &P[((i * alpha + j) * winogradTileBlock + t) * D];
+          }
+        }
+        libjit_winograd_transform<M, alpha>(tmp, D, x, AT, tmp + M * M * D,
+                                            D);
+        for (size_t i = 0; i < M && ox + i < outWdims[1]; i++) {
+          for (size_t j = 0; j < M && oy + j < outWdims[2]; j++) {
+            float *out = &args.outW[libjit_getXYZW(outWdims, args.n, ox + i,
+                                                   oy + j, 0)];
+            const float *res = &tmp[(i * M + j) * D];
+            for (size_t d = 0; d < D; d++) {
+              out[d] = res[d] + args.biasW[d];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/// Arguments of the depthwise convolution kernels, shared by their parallel
+/// tasks. The filter was transposed to [KH, KW, D] at compile time, so that the
+/// weights applied to neighbouring output channels are contiguous, like the
+/// channels of the input and output in NHWC.
+template <typename ElemTy, typename FilterTy>
+struct ConvDepthwiseArgs {
+  ElemTy *outW;
+  const ElemTy *inW;
+  const FilterTy *filterT;
+  const size_t *outWdims;
+  const size_t *inWdims;
+  const size_t *kernelSizes;
+  const size_t *strides;
+  const size_t *pads;
+  size_t dilation;
+  /// The number of output channels computed from each input channel.
+  size_t multiplier;
+};
+
+/// Arguments of libjit_conv_depthwise_i8, shared by its parallel tasks.
+struct ConvDepthwiseI8Args : ConvDepthwiseArgs<int8_t, int32_t> {
+  const int32_t *biasW;
+  int32_t outOffset;
+  int32_t inOffset;
+  int32_t biasOffset;
+  int32_t biasPre;
+  int32_t biasPost;
+  int32_t biasScale;
+  int32_t outPre;
+  int32_t outPost;
+  int32_t outScale;
+};
+
+/// The number of output channels accumulated together by the quantized
+/// depthwise kernel, whose accumulators live on the stack.
+constexpr size_t depthwiseChunk = 256;
+
+/// Accumulates into \p acc the products of the input pixel \p in with the
+/// filter weights \p f for the output channels [\p d0, \p d1) of a depthwise
+/// convolution, where each input channel feeds \p multiplier consecutive
+/// output channels. \p acc and \p f start at channel \p d0. \p inOffset is
+/// subtracted from the input.
+template <typename AccTy, typename InTy, typename FilterTy>
+void libjit_conv_depthwise_pixel(AccTy *acc, const InTy *in,
+                                 const FilterTy *f, size_t d0, size_t d1,
+                                 size_t multiplier, AccTy inOffset) {
+  if (multiplier == 1) {
+    for (size_t d = d0; d < d1; d++) {
+      acc[d - d0] += ((AccTy)in[d] - inOffset) * f[d - d0];
+    }
+    return;
+  }
+  for (size_t d = d0; d < d1; d++) {
+    acc[d - d0] += ((AccTy)in[d / multiplier] - inOffset) * f[d - d0];
+  }
+}
+
+/// Accumulates into \p acc the output channels [\p d0, \p d1) of the output
+/// pixel (\p x, \p y) of the sample \p n of the depthwise convolution
+/// described by \p args.
+template <typename AccTy, typename ElemTy, typename FilterTy>
+void libjit_conv_depthwise_sum(AccTy *acc,
+                               const ConvDepthwiseArgs<ElemTy, FilterTy> &args,
+                               size_t n, size_t x, size_t y, size_t d0,
+                               size_t d1, AccTy inOffset) {
+  const size_t *inWdims = args.inWdims;
+  size_t D = args.outWdims[3];
+  size_t kernel_h = args.kernelSizes[0];
+  size_t kernel_w = args.kernelSizes[1];
+  ssize_t x0 = (ssize_t)(x * args.strides[0]) - (ssize_t)args.pads[0];
+  ssize_t y0 = (ssize_t)(y * args.strides[1]) - (ssize_t)args.pads[1];
+
+  // For each element in the convolution-filter:
+  for (size_t fx = 0; fx < kernel_h; fx++) {
+    ssize_t ix = x0 + fx * args.dilation;
+    if (ix < 0 || ix >= (ssize_t)inWdims[1]) {
+      continue;
+    }
+    for (size_t fy = 0; fy < kernel_w; fy++) {
+      ssize_t iy = y0 + fy * args.dilation;
+      // Ignore index access out of the input (this is due to padding).
+      if (iy < 0 || iy >= (ssize_t)inWdims[2]) {
+        continue;
+      }
+      const ElemTy *in =
+          &args.inW[libjit_getXYZW(inWdims, n, (size_t)ix, (size_t)iy, 0)];
+      const FilterTy *f = &args.filterT[(fx * kernel_w + fy) * D + d0];
+      libjit_conv_depthwise_pixel(acc, in, f, d0, d1, args.multiplier,
+                                  inOffset);
+    }
+  }
+}
+
+/// Computes the output rows [\p begin, \p end) of the float depthwise
+/// convolution described by \p ctx. Row r is the row r % H of the sample
+/// r / H, where H is the output height.
+void libjit_conv_depthwise_f_task(void *ctx, size_t begin, size_t end) {
+  const auto &args =
+      *static_cast<const ConvDepthwiseArgs<float, float> *>(ctx);
+  const size_t *outWdims = args.outWdims;
+  for (size_t r = begin; r < end; r++) {
+    size_t n = r / outWdims[1];
+    size_t x = r % outWdims[1];
+    for (size_t y = 0; y < outWdims[2]; y++) {
+      // The output pixel was initialized with the bias, accumulate into it.
+      float *out = &args.outW[libjit_getXYZW(outWdims, n, x, y, 0)];
+      libjit_conv_depthwise_sum<float>(out, args, n, x, y, 0, outWdims[3], 0);
+    }
+  }
+}
+
+/// Computes the output rows [\p begin, \p end) of the quantized depthwise
+/// convolution described by \p ctx. The channels of each output pixel are
+/// accumulated in chunks of depthwiseChunk.
+void libjit_conv_depthwise_i8_task(void *ctx, size_t begin, size_t end) {
+  const auto &args = *static_cast<const ConvDepthwiseI8Args *>(ctx);
+  const size_t *outWdims = args.outWdims;
+  size_t D = outWdims[3];
+  int32_t sum[depthwiseChunk];
+  for (size_t r = begin; r < end; r++) {
+    size_t n = r / outWdims[1];
+    size_t x = r % outWdims[1];
+    for (size_t y = 0; y < outWdims[2]; y++) {
+      int8_t *out = &args.outW[libjit_getXYZW(outWdims, n, x, y, 0)];
+      for (size_t d0 = 0; d0 < D; d0 += depthwiseChunk) {
+        size_t d1 = MIN(d0 + depthwiseChunk, D);
+        for (size_t d = d0; d < d1; d++) {
+          // Scale the bias to match the scale of the matrix multiplication.
+          sum[d - d0] = libjit_scale_i32i8(args.biasW[d] - args.biasOffset,
+                                           args.biasPre, args.biasPost,
+                                           args.biasScale, 0);
+        }
+        libjit_conv_depthwise_sum<int32_t>(sum, args, n, x, y, d0, d1,
+                                           args.inOffset);
+        for (size_t d = d0; d < d1; d++) {
+          // Scale the result back to the expected destination scale.
+          int32_t scaledSum =
+              libjit_scale_i32i8(sum[d - d0], args.outPre, args.outPost,
+                                 args.outScale, args.outOffset);
+          out[d] = libjit_clip(scaledSum);
+        }
+      }
+    }
+  }
+}
+
+/// Computes the convolution with a 3x3 kernel, unit strides and a single group
+/// of \p inW by the Winograd F(MxM, 3x3) algorithm, where M is \p tileSize (2
+/// or 4). \p filterW is the filter already transformed into the Winograd
+/// domain, G * g * G^T, with the layout [alpha, alpha, C, D] where alpha is M +
+/// 2. \p scratchW is scratch memory of \p scratchWdims = [slots, slotSize],
+/// allocated by the CPU backend with one slot per task of
+/// libjit_conv_winograd_f_task. The GEMMs are computed by \p matmul.
+template <libjit_matmul_f_fn matmul>
+void libjit_conv_winograd_f_impl(float *outW, const float *inW,
+                                 const float *filterW, const float *biasW,
+                                 float *scratchW, const size_t *outWdims,
+                                 const size_t *inWdims,
+                                 const size_t *filterWdims,
+                                 const size_t *scratchWdims,
+                                 const size_t *pads, size_t tileSize) {
+  size_t tilesH = (outWdims[1] + tileSize - 1) / tileSize;
+  size_t tilesW = (outWdims[2] + tileSize - 1) / tileSize;
+  size_t numBlocks =
+      (tilesH * tilesW + winogradTileBlock - 1) / winogradTileBlock;
+  size_t work = tilesH * tilesW * filterWdims[0] * filterWdims[1] *
+                filterWdims[2] * filterWdims[3];
+  ConvWinogradArgs args;
+  args.outW = outW;
+  args.inW = inW;
+  args.filterW = filterW;
+  args.biasW = biasW;
+  args.outWdims = outWdims;
+  args.inWdims = inWdims;
+  args.scratchW = scratchW;
+  args.slotSize = scratchWdims[1];
+  args.padT = pads[0];
+  args.padL = pads[1];
+  args.tilesH = tilesH;
+  args.tilesW = tilesW;
+  args.numBlocks = numBlocks;
+  args.numTasks = MIN(numBlocks, scratchWdims[0]);
+  auto task = (tileSize == 2)
+                  ? &libjit_conv_winograd_f_task<2, libjit_winograd2_BT,
+                                                 libjit_winograd2_AT, matmul>
+                  : &libjit_conv_winograd_f_task<4, libjit_winograd4_BT,
+                                                 libjit_winograd4_AT, matmul>;
+
+  // For each input in the batch:
+  for (size_t n = 0; n < inWdims[0]; n++) {
+    // Split the blocks of output tiles across threads.
+    args.n = n;
+    libjit_parallel_run(args.numTasks, work, task, &args);
+  } // For each N, the sample in the batch.
+}
+
 } // namespace
 
 extern "C" {
+
 void libjit_convDKKC8_f(float *outW, const float *inW, const float *filterW,
                         const float *biasW, const size_t *outWdims,
                         const size_t *inWdims, const size_t *filterWdims,
@@ -261,15 +968,28 @@ void libjit_convDKKC8_f(float *outW, const float *inW, const float *filterW,
                         const size_t *strides, const size_t *pads, size_t group,
                         unsigned pixelScanFirst, unsigned numDepthRegs,
                         unsigned sizeGroupY, unsigned depthStrips) {
-  size_t inChannels = inWdims[3];
-  size_t outChannels = outWdims[3];
-  size_t inCperG = inChannels / group;
-  size_t outCperG = outChannels / group;
-
-  // Select the order in which we iterate over the pixels in the picture.
-  auto eachPixelConv =
-      (pixelScanFirst ? &libjit_convDKKC8_foreach_xy_pixels_filter
-                      : &libjit_convDKKC8_foreach_xy_filter_pixels);
+  size_t outCperG = outWdims[3] / group;
+  size_t blockSize = 8 * numDepthRegs * depthStrips;
+  size_t numBlocks = group * ((outCperG + blockSize - 1) / blockSize);
+  size_t work = outWdims[1] * outWdims[2] * outWdims[3] * filterWdims[1] *
+                filterWdims[2] * filterWdims[3];
+  ConvDKKC8Args args;
+  args.outW = outW;
+  args.inW = inW;
+  args.filterW = filterW;
+  args.biasW = biasW;
+  args.outWdims = outWdims;
+  args.inWdims = inWdims;
+  args.filterWdims = filterWdims;
+  args.biasWdims = biasWdims;
+  args.kernelSizes = kernelSizes;
+  args.strides = strides;
+  args.pads = pads;
+  args.group = group;
+  args.pixelScanFirst = pixelScanFirst;
+  args.numDepthRegs = numDepthRegs;
+  args.sizeGroupY = sizeGroupY;
+  args.depthStrips = depthStrips;
 
   // For each input in the batch:
   for (size_t n = 0; n < inWdims[0]; n++) {
@@ -278,24 +998,10 @@ void libjit_convDKKC8_f(float *outW, const float *inW, const float *filterW,
     // Later we will accumulate values into this slice.
     libjit_conv_init_output_with_bias(n, outW, biasW, outWdims, biasWdims);
 
-    // For each group of input channels:
-    for (size_t g = 0; g < group; g++) {
-
-      // For each output channel, process [numDepthRegs x float8] elements.
-      size_t startChannelIndex = g * outCperG;
-      size_t endChannelIndex = (g + 1) * outCperG;
-      for (size_t d = startChannelIndex; d < endChannelIndex;
-           d += 8 * numDepthRegs * depthStrips) {
-
-        // Perform the convolution for each pixel.
-        eachPixelConv(n, d, numDepthRegs, depthStrips, sizeGroupY, inCperG,
-                      outW, inW, filterW, biasW, outWdims, inWdims, filterWdims,
-                      biasWdims, kernelSizes, strides, pads, g,
-                      endChannelIndex);
-
-      } // For each D (the depth, or the output channel).
-    }   // for each G, the group
-  }     // For each N, the sample in the batch.
+    // Split the blocks of output channels of all groups across threads.
+    args.n = n;
+    libjit_parallel_run(numBlocks, work, &libjit_convDKKC8_f_task, &args);
+  } // For each N, the sample in the batch.
 }
 
 void libjit_convolution_f(float *outW, const float *inW, const float *filterW,
@@ -304,26 +1010,22 @@ void libjit_convolution_f(float *outW, const float *inW, const float *filterW,
                           const size_t *biasWdims, const size_t *kernelSizes,
                           const size_t *strides, const size_t *pads,
                           size_t group, unsigned depthUnroll, size_t dilation) {
-  size_t inChannels = inWdims[3];
-  size_t outChannels = outWdims[3];
-  size_t inCperG = inChannels / group;
-  size_t outCperG = outChannels / group;
-
-  // The output dims are calculated already from all of the pads,
-  // therefore we only need the top and left pads here to control the starting
-  // position.
-  size_t pad_t = pads[0];
-  size_t pad_l = pads[1];
-  size_t stride_h = strides[0];
-  size_t stride_w = strides[1];
-  size_t kernel_h = kernelSizes[0];
-  size_t kernel_w = kernelSizes[1];
-  // The size of the input-channel tile. High channel count allow for SIMD
-  // parallelism but create register pressure. Low channel count reduces the
-  // memory pressure and allows things to fit in cache, but require additional
-  // compute (horizontal add) to sum the values in the block. This value is a
-  // compromise between the two.
-  constexpr unsigned cbSize = 512;
+  size_t numBlocks = outWdims[3] / depthUnroll;
+  size_t work = outWdims[1] * outWdims[2] * outWdims[3] * filterWdims[1] *
+                filterWdims[2] * filterWdims[3];
+  ConvolutionArgs args;
+  args.outW = outW;
+  args.inW = inW;
+  args.filterW = filterW;
+  args.outWdims = outWdims;
+  args.inWdims = inWdims;
+  args.filterWdims = filterWdims;
+  args.kernelSizes = kernelSizes;
+  args.strides = strides;
+  args.pads = pads;
+  args.group = group;
+  args.depthUnroll = depthUnroll;
+  args.dilation = dilation;
 
   // For each input in the batch:
   for (size_t n = 0; n < inWdims[0]; n++) {
@@ -332,91 +1034,49 @@ void libjit_convolution_f(float *outW, const float *inW, const float *filterW,
     // Later we will accumulate values into this slice.
     libjit_conv_init_output_with_bias(n, outW, biasW, outWdims, biasWdims);
 
-    // For each group of input channels:
-    for (size_t g = 0; g < group; g++) {
-      // Process the body of the loop in tiles of "channel-block".
-      for (size_t cb = 0; cb < inCperG; cb += cbSize) {
-
-        // For each output channel in the group. Process 'depthUnroll' output
-        // layers together.
-        for (size_t d = g * outCperG; d < (g + 1) * outCperG;
-             d += depthUnroll) {
-
-          // For each element in the convolution-filter:
-          for (size_t fx = 0; fx < kernel_h; fx++) {
-            for (size_t fy = 0; fy < kernel_w; fy++) {
-
-              // For each convolution 'jump' in the input tensor:
-              for (size_t outx = 0; outx < outWdims[1]; outx++) {
-                for (size_t outy = 0; outy < outWdims[2]; outy++) {
-
-                  // Process 'depthUnroll' output pixels at once. Each scalar
-                  // here represents the convolution sum for one (x,y) point in
-                  // the output. We process the same pixel for different output
-                  // channel (D) values. The compiler should perform scalar
-                  // replacement of aggregates and split this tiny array to
-                  // registers.
-                  float sum[depthUnroll];
-                  for (unsigned i = 0; i < depthUnroll; i++) {
-                    sum[i] = 0;
-                  }
-
-                  // Calculate the specific input x,y that we process in this
-                  // iteration.
-                  ssize_t inx =
-                      (ssize_t)outx * stride_h - pad_t + fx * dilation;
-                  ssize_t iny =
-                      (ssize_t)outy * stride_w - pad_l + fy * dilation;
-
-                  // Ignore index access below zero (this is due to padding).
-                  if (inx < 0 || iny < 0 || inx >= (ssize_t)inWdims[1] ||
-                      iny >= (ssize_t)inWdims[2]) {
-                    continue;
-                  }
+    // Split the blocks of output channels of all groups across threads.
+    args.n = n;
+    libjit_parallel_run(numBlocks, work, &libjit_convolution_f_task, &args);
+  } // For each N, the sample in the batch.
+}
 
-                  // Calculate the indices into the Filter and Input buffers.
-                  size_t inIdx = libjit_getXYZW(inWdims, n, (size_t)inx,
-                                                (size_t)iny, g * inCperG);
-                  size_t filterIdx = libjit_getXYZW(filterWdims, d, fx, fy, 0);
-                  size_t sliceSize =
-                      filterWdims[1] * filterWdims[2] * filterWdims[3];
-
-                  // Perform the heart of the convolution, 4 elements at a time
-                  // to reduce register pressure.
-                  for (size_t fd = cb, e = MIN(cb + cbSize, inCperG); fd < e;
-                       fd++) {
-                    float in = inW[inIdx + fd];
-                    for (unsigned i = 0; i < MIN(4, depthUnroll); i++) {
-                      sum[i] += filterW[filterIdx + (sliceSize * i) + fd] * in;
-                    }
-                  }
+/// Computes the convolution with a 3x3 kernel, unit strides and a single group
+/// by the Winograd F(MxM, 3x3) algorithm, see libjit_conv_winograd_f_impl.
+void libjit_conv_winograd_f(float *outW, const float *inW,
+                            const float *filterW, const float *biasW,
+                            float *scratchW, const size_t *outWdims,
+                            const size_t *inWdims, const size_t *filterWdims,
+                            const size_t *scratchWdims, const size_t *pads,
+                            size_t tileSize) {
+  libjit_conv_winograd_f_impl<libjit_matmul_f>(
+      outW, inW, filterW, biasW, scratchW, outWdims, inWdims, filterWdims,
+      scratchWdims, pads, tileSize);
+}
 
-                  // And run the innermost loop again for the second group of
-                  // depth slices:
-                  if (depthUnroll > 4) {
-                    for (size_t fd = cb, e = MIN(cb + cbSize, inCperG); fd < e;
-                         fd++) {
-                      float in = inW[inIdx + fd];
-                      for (unsigned i = 4; i < MIN(8, depthUnroll); i++) {
-                        sum[i] +=
-                            filterW[filterIdx + (sliceSize * i) + fd] * in;
-                      }
-                    }
-                  }
+/// Variant of libjit_conv_winograd_f for CPUs supporting AVX2 and FMA.
+void libjit_conv_winograd_f_avx2(float *outW, const float *inW,
+                                 const float *filterW, const float *biasW,
+                                 float *scratchW, const size_t *outWdims,
+                                 const size_t *inWdims,
+                                 const size_t *filterWdims,
+                                 const size_t *scratchWdims,
+                                 const size_t *pads, size_t tileSize) {
+  libjit_conv_winograd_f_impl<libjit_matmul_f_avx2>(
+      outW, inW, filterW, biasW, scratchW, outWdims, inWdims, filterWdims,
+      scratchWdims, pads, tileSize);
+}
 
-                  // Store the results to the output buffer.
-                  for (unsigned i = 0; i < depthUnroll; i++) {
-                    outW[libjit_getXYZW(outWdims, n, outx, outy, d + i)] +=
-                        sum[i];
-                  }
-                }
-              }
-            } // For each Y in the filter.
-          }   // For each X in the filter.
-        }     // For each D (the depth, or the output channel).
-      }       // For each block in the input channel.
-    }         // For each group in the input channel.
-  }           // For each N, the sample in the batch.
+/// Variant of libjit_conv_winograd_f for CPUs supporting AVX-512F.
+void libjit_conv_winograd_f_avx512(float *outW, const float *inW,
+                                   const float *filterW, const float *biasW,
+                                   float *scratchW, const size_t *outWdims,
+                                   const size_t *inWdims,
+                                   const size_t *filterWdims,
+                                   const size_t *scratchWdims,
+                                   const size_t *pads, size_t tileSize) {
+  libjit_conv_winograd_f_impl<libjit_matmul_f_avx512>(
+      outW, inW, filterW, biasW, scratchW, outWdims, inWdims, filterWdims,
+      scratchWdims, pads, tileSize);
 }
 
 void libjit_convolution_i8(int8_t *outW, const int8_t *inW,
@@ -430,92 +1090,113 @@ void libjit_convolution_i8(int8_t *outW, const int8_t *inW,
                            int32_t biasPost, int32_t biasScale, int32_t outPre,
                            int32_t outPost, int32_t outScale,
                            unsigned depthUnroll, size_t dilation) {
-  size_t inChannels = inWdims[3];
-  size_t outChannels = outWdims[3];
-  size_t inCperG = inChannels / group;
-  size_t outCperG = outChannels / group;
-  size_t pad_t = pads[0];
-  size_t pad_l = pads[1];
-  size_t stride_h = strides[0];
-  size_t stride_w = strides[1];
-  size_t kernel_h = kernelSizes[0];
-  size_t kernel_w = kernelSizes[1];
+  size_t numBlocks = outWdims[3] / depthUnroll;
+  size_t work = outWdims[1] * outWdims[2] * outWdims[3] * filterWdims[1] *
+                filterWdims[2] * filterWdims[3];
+  ConvolutionI8Args args;
+  args.outW = outW;
+  args.inW = inW;
+  args.filterW = filterW;
+  args.biasW = biasW;
+  args.outWdims = outWdims;
+  args.inWdims = inWdims;
+  args.filterWdims = filterWdims;
+  args.kernelSizes = kernelSizes;
+  args.strides = strides;
+  args.pads = pads;
+  args.group = group;
+  args.outOffset = outOffset;
+  args.inOffset = inOffset;
+  args.filterOffset = filterOffset;
+  args.biasOffset = biasOffset;
+  args.biasPre = biasPre;
+  args.biasPost = biasPost;
+  args.biasScale = biasScale;
+  args.outPre = outPre;
+  args.outPost = outPost;
+  args.outScale = outScale;
+  args.depthUnroll = depthUnroll;
+  args.dilation = dilation;
+
   // For each input in the batch:
   for (size_t n = 0; n < inWdims[0]; n++) {
-    // For each group of input channels:
-    for (size_t g = 0; g < group; g++) {
-
-      // For each output channel in the group. Process 'depthUnroll' output
-      // layers together.
-      for (size_t d = g * outCperG; d < (g + 1) * outCperG; d += depthUnroll) {
-        // For each convolution 'jump' in the input tensor:
-        ssize_t x = -(ssize_t)pad_t;
-        for (size_t ax = 0; ax < outWdims[1]; x += stride_h, ax++) {
-          ssize_t y = -(ssize_t)pad_l;
-          for (size_t ay = 0; ay < outWdims[2]; y += stride_w, ay++) {
-            int32_t sum[depthUnroll];
-
-            for (unsigned i = 0; i < depthUnroll; i++) {
-              // Scale the bias to match the scale of the matrix multiplication.
-              sum[i] = libjit_scale_i32i8((int32_t)biasW[d + i] - biasOffset,
-                                          biasPre, biasPost, biasScale, 0);
-            }
-
-            // For each element in the convolution-filter:
-            for (size_t fx = 0; fx < kernel_h; fx++) {
-              for (size_t fy = 0; fy < kernel_w; fy++) {
-                ssize_t ox = x + fx * dilation;
-                ssize_t oy = y + fy * dilation;
-
-                // Ignore index access below zero (this is due to padding).
-                if (ox < 0 || oy < 0 || ox >= (ssize_t)inWdims[1] ||
-                    oy >= (ssize_t)inWdims[2]) {
-                  continue;
-                }
-
-                // Calculate the indices into the Filter and Input buffers.
-                size_t inIdx = libjit_getXYZW(inWdims, n, (size_t)ox,
-                                              (size_t)oy, g * inCperG);
-                size_t filterIdx = libjit_getXYZW(filterWdims, d, fx, fy, 0);
-                size_t sliceSize =
-                    filterWdims[1] * filterWdims[2] * filterWdims[3];
-
-                // Perform the innermost loop of the convolution using 4 vector
-                // registers.
-                for (size_t fd = 0; fd < inCperG; fd++) {
-                  int32_t in = inW[inIdx + fd] - inOffset;
-                  for (unsigned i = 0; i < MIN(4, depthUnroll); i++) {
-                    sum[i] += (filterW[filterIdx + (sliceSize * i) + fd] -
-                               filterOffset) *
-                              in;
-                  }
-                }
+    // Split the blocks of output channels of all groups across threads.
+    args.n = n;
+    libjit_parallel_run(numBlocks, work, &libjit_convolution_i8_task, &args);
+  } // N
+}
 
-                // And perform the innermost loop again with 4 more registers.
-                if (depthUnroll > 4)
-                  for (size_t fd = 0; fd < inCperG; fd++) {
-                    int32_t in = inW[inIdx + fd] - inOffset;
-                    for (unsigned i = 4; i < MIN(8, depthUnroll); i++) {
-                      sum[i] += (filterW[filterIdx + (sliceSize * i) + fd] -
-                                 filterOffset) *
-                                in;
-                    }
-                  }
-              }
-            }
+/// Computes the depthwise convolution of \p inW, whose group count equals its
+/// number of channels C. Each input channel c feeds the D / C consecutive
+/// output channels starting at c * D / C. \p filterT is the filter transposed
+/// to [KH, KW, D] by the CPU backend.
+void libjit_conv_depthwise_f(float *outW, const float *inW,
+                             const float *filterT, const float *biasW,
+                             const size_t *outWdims, const size_t *inWdims,
+                             const size_t *biasWdims,
+                             const size_t *kernelSizes, const size_t *strides,
+                             const size_t *pads, size_t dilation) {
+  size_t D = outWdims[3];
+  size_t numRows = outWdims[0] * outWdims[1];
+  size_t work = numRows * outWdims[2] * D * kernelSizes[0] * kernelSizes[1];
+
+  ConvDepthwiseArgs<float, float> args;
+  args.outW = outW;
+  args.inW = inW;
+  args.filterT = filterT;
+  args.outWdims = outWdims;
+  args.inWdims = inWdims;
+  args.kernelSizes = kernelSizes;
+  args.strides = strides;
+  args.pads = pads;
+  args.dilation = dilation;
+  args.multiplier = D / inWdims[3];
+
+  // Initialize the output with the bias, the rows accumulate into it.
+  for (size_t n = 0; n < inWdims[0]; n++) {
+    libjit_conv_init_output_with_bias(n, outW, biasW, outWdims, biasWdims);
+  }
+  // Split the output rows of all the samples across threads.
+  libjit_parallel_run(numRows, work, &libjit_conv_depthwise_f_task, &args);
+}
 
-            for (unsigned i = 0; i < depthUnroll; i++) {
-              // Scale the result back to the expected destination scale.
-              int32_t scaledSum = libjit_scale_i32i8(sum[i], outPre, outPost,
-                                                     outScale, outOffset);
-              outW[libjit_getXYZW(outWdims, n, ax, ay, d + i)] =
-                  libjit_clip(scaledSum);
-            }
-          } // W
-        }   // H
-      }     // C
-    }       // G
-  }         // N
+/// Quantized version of libjit_conv_depthwise_f. The weights of \p filterT
+/// were widened to 32 bits with the offset of the filter subtracted.
+void libjit_conv_depthwise_i8(
+    int8_t *outW, const int8_t *inW, const int32_t *filterT,
+    const int32_t *biasW, const size_t *outWdims, const size_t *inWdims,
+    const size_t *biasWdims, const size_t *kernelSizes, const size_t *strides,
+    const size_t *pads, int32_t outOffset, int32_t inOffset,
+    int32_t biasOffset, int32_t biasPre, int32_t biasPost, int32_t biasScale,
+    int32_t outPre, int32_t outPost, int32_t outScale, size_t dilation) {
+  size_t D = outWdims[3];
+  size_t numRows = outWdims[0] * outWdims[1];
+  size_t work = numRows * outWdims[2] * D * kernelSizes[0] * kernelSizes[1];
+
+  ConvDepthwiseI8Args args;
+  args.outW = outW;
+  args.inW = inW;
+  args.filterT = filterT;
+  args.outWdims = outWdims;
+  args.inWdims = inWdims;
+  args.kernelSizes = kernelSizes;
+  args.strides = strides;
+  args.pads = pads;
+  args.dilation = dilation;
+  args.multiplier = D / inWdims[3];
+  args.biasW = biasW;
+  args.outOffset = outOffset;
+  args.inOffset = inOffset;
+  args.biasOffset = biasOffset;
+  args.biasPre = biasPre;
+  args.biasPost = biasPost;
+  args.biasScale = biasScale;
+  args.outPre = outPre;
+  args.outPost = outPost;
+  args.outScale = outScale;
+
+  // Split the output rows of all the samples across threads.
+  libjit_parallel_run(numRows, work, &libjit_conv_depthwise_i8_task, &args);
 }
 
 void libjit_convolution_grad_f(float *inG, const float *outG, const float *inW,
@@ -28,9 +28,11 @@ typedef SSIZE_T ssize_t;
 #if defined(__clang__)
 using float4 = float __attribute__((ext_vector_type(4)));
 using float8 = float __attribute__((ext_vector_type(8)));
+using float16 = float __attribute__((ext_vector_type(16)));
 #elif defined(__GNUC__) || defined(__GNUG__)
 using float4 = float __attribute__((vector_size(16)));
 using float8 = float __attribute__((vector_size(32)));
+using float16 = float __attribute__((vector_size(64)));
 #endif
 
 /// Loads a simd float8 value from \p ptr.
@@ -124,6 +126,43 @@ inline int32_t libjit_scale_i32i8(int32_t input, int32_t pre, int32_t post,
   return ((((input >> pre) * scale) + rtn) >> post) + offset;
 }
 
+/// A task run by libjit_parallel_for. It processes the iterations [\p begin,
+/// \p end) of a loop, \p ctx holds the arguments of the kernel.
+typedef void (*libjit_parallel_task)(void *ctx, size_t begin, size_t end);
+
+extern "C" {
+/// \returns the number of threads that libjit_parallel_for splits work
+/// across. libjit provides a serial fallback, the JIT binds this to the
+/// intra-op thread pool of the CPU device running the function.
+size_t libjit_parallel_num_threads();
+
+/// Run \p task over the iterations [0, \p numIterations). The iterations are
+/// split in contiguous ranges which may be processed concurrently. Returns once
+/// all of them have been processed. libjit provides a serial fallback, the JIT
+/// binds this to the intra-op thread pool of the CPU device running the
+/// function.
+void libjit_parallel_for(size_t numIterations, libjit_parallel_task task,
+                         void *ctx);
+}
+
+/// Operators performing less multiply-accumulates than this are not split
+/// across threads, waking up the workers would cost more than it saves.
+constexpr size_t libjit_parallel_min_work = 1 << 16;
+
+/// Run \p task over the iterations [0, \p numIterations) of a kernel doing \p
+/// work multiply-accumulates. The task is called directly when the work is too
+/// small to be split or when no other thread is available, which lets LLVM
+/// inline it and specialize it for the constant arguments of the kernel.
+inline void libjit_parallel_run(size_t numIterations, size_t work,
+                                libjit_parallel_task task, void *ctx) {
+  if (numIterations < 2 || work < libjit_parallel_min_work ||
+      libjit_parallel_num_threads() < 2) {
+    task(ctx, 0, numIterations);
+    return;
+  }
+  libjit_parallel_for(numIterations, task, ctx);
+}
+
 #ifdef _WIN32
 #define libjit_aligned_malloc(p, a, s)                                         \
   (((*(p)) = _aligned_malloc((s), (a))), *(p) ? 0 : errno)
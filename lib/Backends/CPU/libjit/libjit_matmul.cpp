@@ -35,16 +35,71 @@ void libjit_matmul_odd(int m, int n, int k, const float *a, int lda,
   }
 }
 
-/// Number of registers to use for rows of A in the dot-product kernel.
-constexpr int regsA = 4;
-/// Number of registers to use for columns of B in the dot-product kernel.
-constexpr int regsB = 3;
+/// Function attributes compiling a kernel for an instruction set extension
+/// when libjit is built natively. The JIT replaces them with the features of
+/// its target machine, which CPULLVMIRGen checks before calling the kernel.
+#if defined(__x86_64__) || defined(__i386__)
+#define LIBJIT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define LIBJIT_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define LIBJIT_TARGET_AVX2
+#define LIBJIT_TARGET_AVX512
+#endif
 
-/// Number of rows of A to process in the kernel.  Vector loads are used for A,
-/// so we load eight times as many floats as we use registers.
-constexpr int mr = regsA * 8;
-/// Number of columns of B to process in the kernel.
-constexpr int nr = regsB;
+/// Helpers are inlined into the kernel of each instruction set, so that they
+/// are compiled with its features.
+#define LIBJIT_KERNEL_INLINE inline __attribute__((always_inline))
+
+// GCC notes that the helpers returning AVX-512 vectors have a different ABI
+// without AVX-512. They are always inlined into kernels compiled with it.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+/// Register-blocked dot-product microkernel. It computes an mr x nr block of C
+/// with \p RegsA vector registers of type \p VecTy for rows of A and \p RegsB
+/// registers for columns of B.
+template <typename VecTy, size_t RegsA, size_t RegsB> struct MatMulKernel {
+  using Vec = VecTy;
+  /// Number of floats in a vector register.
+  static constexpr size_t width = sizeof(VecTy) / sizeof(float);
+  /// Number of registers to use for rows of A in the dot-product kernel.
+  static constexpr size_t regsA = RegsA;
+  /// Number of registers to use for columns of B in the dot-product kernel.
+  static constexpr size_t regsB = RegsB;
+  /// Number of rows of A to process in the kernel.  Vector loads are used for
+  /// A, so we load width times as many floats as we use registers.
+  static constexpr size_t mr = regsA * width;
+  /// Number of columns of B to process in the kernel.
+  static constexpr size_t nr = regsB;
+
+  /// Perform an unaligned load of a vector from a float pointer.
+  static LIBJIT_KERNEL_INLINE VecTy load(const float *p) {
+    VecTy res;
+    memcpy(&res, p, sizeof(VecTy));
+    return res;
+  }
+  /// Perform an unaligned store to a float pointer.
+  static LIBJIT_KERNEL_INLINE void store(float *p, VecTy v) {
+    memcpy(p, &v, sizeof(VecTy));
+  }
+  /// Perform an unaligned addition to a float pointer.
+  static LIBJIT_KERNEL_INLINE void add(float *p, VecTy v) {
+    store(p, load(p) + v);
+  }
+  /// Broadcast the input value to a vector.
+  static LIBJIT_KERNEL_INLINE VecTy broadcast(float v) {
+    return v - (VecTy){0};
+  }
+};
+
+/// Portable kernel, a 32x3 block held in 12 accumulators of 8 floats.
+using GenericKernel = MatMulKernel<float8, 4, 3>;
+/// AVX2 kernel, a 16x6 block. The 16 ymm registers hold 12 accumulators, two
+/// vectors of A and a broadcast element of B, and FMA merges the multiply-add.
+using AVX2Kernel = MatMulKernel<float8, 2, 6>;
+/// AVX-512 kernel, a 32x12 block held in 24 of the 32 zmm registers.
+using AVX512Kernel = MatMulKernel<float16, 2, 12>;
 
 /// Blocking parameters for the outer kernel.  We multiply mc x kc blocks of A
 /// with kc x nc panels of B (this approach is referred to as `gebp` in the
@@ -58,19 +113,22 @@ constexpr int nc = 4096;
 /// can be fairly large.
 constexpr int pack_threshold = 1024;
 
-/// Compute a RAxRB block of C using a vectorized dot product, where RA is the
-/// number of registers to load from matrix A, and RB is the number of registers
-/// to load from matrix B.
-template <size_t regsA, size_t regsB>
-void libjit_matmul_dot(size_t k, const float *a, size_t lda, const float *b,
-                       size_t ldb, float *c, size_t ldc) {
-  float8 csum[regsA][regsB] = {{0.0}};
+/// Compute a mr x nr block of C using a vectorized dot product, where mr and
+/// nr are given by the microkernel \p KernelTy.
+template <typename KernelTy>
+LIBJIT_KERNEL_INLINE void libjit_matmul_dot(size_t k, const float *a,
+                                            size_t lda, const float *b,
+                                            size_t ldb, float *c, size_t ldc) {
+  constexpr size_t regsA = KernelTy::regsA;
+  constexpr size_t regsB = KernelTy::regsB;
+  constexpr size_t width = KernelTy::width;
+  typename KernelTy::Vec csum[regsA][regsB] = {{0.0}};
   for (size_t p = 0; p < k; p++) {
     // Perform the DOT product.
     for (size_t ai = 0; ai < regsA; ai++) {
-      float8 aa = LoaduFloat8(&A(ai * 8, p));
+      auto aa = KernelTy::load(&A(ai * width, p));
       for (size_t bi = 0; bi < regsB; bi++) {
-        float8 bb = BroadcastFloat8(B(p, bi));
+        auto bb = KernelTy::broadcast(B(p, bi));
         csum[ai][bi] += aa * bb;
       }
     }
@@ -79,25 +137,31 @@ void libjit_matmul_dot(size_t k, const float *a, size_t lda, const float *b,
   // Accumulate the results into C.
   for (size_t bi = 0; bi < regsB; bi++) {
     for (size_t ai = 0; ai < regsA; ai++) {
-      AdduFloat8(&C(ai * 8, bi), csum[ai][bi]);
+      KernelTy::add(&C(ai * width, bi), csum[ai][bi]);
     }
   }
 }
 
 /// Similar to libjit_matmul_dot, but assumes that \p a and \p b have been
 /// packed using z-ordering.
-template <size_t regsA, size_t regsB>
-void libjit_matmul_zdot(size_t k, const float *a, size_t lda, const float *b,
-                        size_t ldb, float *c, size_t ldc) {
-  float8 csum[regsA][regsB] = {{0.0}};
+template <typename KernelTy>
+LIBJIT_KERNEL_INLINE void libjit_matmul_zdot(size_t k, const float *a,
+                                             size_t lda, const float *b,
+                                             size_t ldb, float *c,
+                                             size_t ldc) {
+  constexpr size_t regsA = KernelTy::regsA;
+  constexpr size_t regsB = KernelTy::regsB;
+  constexpr size_t width = KernelTy::width;
+  using Vec = typename KernelTy::Vec;
+  Vec csum[regsA][regsB] = {{0.0}};
 
   for (size_t p = 0; p < k; p++) {
     // Perform the DOT product.
-    float8 *aptr = (float8 *)&A(0, p);
+    Vec *aptr = (Vec *)&A(0, p);
     for (size_t ai = 0; ai < regsA; ai++) {
-      float8 aa = *aptr++;
+      Vec aa = *aptr++;
       for (size_t bi = 0; bi < regsB; bi++) {
-        float8 bb = BroadcastFloat8(*(b + bi));
+        Vec bb = KernelTy::broadcast(*(b + bi));
         csum[ai][bi] += aa * bb;
       }
     }
@@ -107,23 +171,26 @@ void libjit_matmul_zdot(size_t k, const float *a, size_t lda, const float *b,
   // Accumulate the results into C.
   for (size_t bi = 0; bi < regsB; bi++) {
     for (size_t ai = 0; ai < regsA; ai++) {
-      AdduFloat8(&C(ai * 8, bi), csum[ai][bi]);
+      KernelTy::add(&C(ai * width, bi), csum[ai][bi]);
     }
   }
 }
 
 /// Pack matrix \p a into matrix \p a_to using a z-ordering, so that the
 /// dot-product kernel can stride sequentially through memory.
-template <size_t regsA>
-void pack_matrix_a(size_t m, size_t k, const float *a, size_t lda,
-                   float *a_to) {
-  for (size_t i = 0; i < m - mr + 1; i += mr) {
+template <typename KernelTy>
+LIBJIT_KERNEL_INLINE void pack_matrix_a(size_t m, size_t k, const float *a,
+                                        size_t lda, float *a_to) {
+  constexpr size_t mr = KernelTy::mr;
+  constexpr size_t width = KernelTy::width;
+  for (size_t i = 0; i + mr <= m; i += mr) {
     for (size_t j = 0; j < k; j++) {
       const float *a_ij_pntr = &A(i, j);
-      for (size_t ai = 0; ai < regsA; ai++) {
-        StoreuFloat8(a_to + 8 * ai, LoaduFloat8(a_ij_pntr + 8 * ai));
+      for (size_t ai = 0; ai < KernelTy::regsA; ai++) {
+        KernelTy::store(a_to + width * ai,
+                        KernelTy::load(a_ij_pntr + width * ai));
       }
-      a_to += 8 * regsA;
+      a_to += mr;
     }
   }
 }
@@ -131,12 +198,13 @@ void pack_matrix_a(size_t m, size_t k, const float *a, size_t lda,
 /// Pack matrix \p b into matrix \p b_to using a z-ordering, so that the
 /// dot-product kernel can stride sequentially through memory, rather than
 /// reading from `regsB` separate columns.
-template <size_t regsB>
-void pack_matrix_b(size_t n, size_t k, const float *b, size_t ldb,
-                   float *b_to) {
-  for (int j = 0; j < int(n) - nr + 1; j += nr) {
+template <typename KernelTy>
+LIBJIT_KERNEL_INLINE void pack_matrix_b(size_t n, size_t k, const float *b,
+                                        size_t ldb, float *b_to) {
+  constexpr size_t nr = KernelTy::nr;
+  for (size_t j = 0; j + nr <= n; j += nr) {
     for (size_t i = 0; i < k; i++) {
-      for (size_t bi = 0; bi < regsB; bi++) {
+      for (size_t bi = 0; bi < nr; bi++) {
         *b_to++ = B(i, j + bi);
       }
     }
@@ -147,34 +215,43 @@ void pack_matrix_b(size_t n, size_t k, const float *b, size_t ldb,
 /// because packed matrices need to be more more sensitive to cache locality,
 /// and N strides over the B matrix, which is very large and will blow out the
 /// cache.
-void libjit_matmul_inner_packed(int m, int n, int k, const float *packedA,
-                                const float *packedB, float *c, int ldc) {
+template <typename KernelTy>
+LIBJIT_KERNEL_INLINE void
+libjit_matmul_inner_packed(int m, int n, int k, const float *packedA,
+                           const float *packedB, float *c, int ldc) {
+  constexpr int mr = KernelTy::mr;
+  constexpr int nr = KernelTy::nr;
   for (int j = 0; j < n - nr + 1; j += nr) {
     for (int i = 0; i < m - mr + 1; i += mr) {
-      libjit_matmul_zdot<regsA, regsB>(k, &packedA[i * k], mr, &packedB[j * k],
-                                       k, &C(i, j), ldc);
+      libjit_matmul_zdot<KernelTy>(k, &packedA[i * k], mr, &packedB[j * k], k,
+                                   &C(i, j), ldc);
     }
   }
 }
 
 /// Inner kernel for non-packed matrices.  In these cases N is small, so it
 /// tends to be beneficial to retain locality in the A matrix.
-void libjit_matmul_inner_unpacked(int m, int n, int k, const float *a, int lda,
-                                  const float *b, int ldb, float *c, int ldc) {
+template <typename KernelTy>
+LIBJIT_KERNEL_INLINE void
+libjit_matmul_inner_unpacked(int m, int n, int k, const float *a, int lda,
+                             const float *b, int ldb, float *c, int ldc) {
+  constexpr int mr = KernelTy::mr;
+  constexpr int nr = KernelTy::nr;
   for (int i = 0; i < m - mr + 1; i += mr) {
     for (int j = 0; j < n - nr + 1; j += nr) {
-      libjit_matmul_dot<regsA, regsB>(k, &A(i, 0), lda, &B(0, j), ldb, &C(i, j),
-                                      ldc);
+      libjit_matmul_dot<KernelTy>(k, &A(i, 0), lda, &B(0, j), ldb, &C(i, j),
+                                  ldc);
     }
   }
 }
 
 /// Compute a portion of C one block at a time.  Handle ragged edges with calls
 /// to a slow but general helper.
-template <bool pack>
-void libjit_matmul_inner(int m, int n, int k, const float *a, int lda,
-                         const float *b, int ldb, float *c, int ldc,
-                         float *packedB) {
+template <typename KernelTy, bool pack>
+LIBJIT_KERNEL_INLINE void libjit_matmul_inner(int m, int n, int k,
+                                              const float *a, int lda,
+                                              const float *b, int ldb, float *c,
+                                              int ldc, float *packedB) {
   // The tiling scheme naturally divides the input matrices into 2 parts each;
   // one tiled section, and three "ragged" edges.
   //
@@ -185,22 +262,24 @@ void libjit_matmul_inner(int m, int n, int k, const float *a, int lda,
   // --------------------    -------
   //
   // We can process this as 4 separate matrix multiplications.  A00*B00 is the
-  // perfectly-tiled portion, which we handly with a 4x16 dot-product kernel.
-  // The ragged edges are (ideally) less critical, so we handle them with a call
-  // to a general matrix-multiplication for odd sizes.
+  // perfectly-tiled portion, which we handly with a mr x nr dot-product
+  // kernel. The ragged edges are (ideally) less critical, so we handle them
+  // with a call to a general matrix-multiplication for odd sizes.
+  constexpr int mr = KernelTy::mr;
+  constexpr int nr = KernelTy::nr;
   float packedA[m * k] __attribute__((aligned(64)));
   if (pack) {
-    pack_matrix_a<regsA>(m, k, &A(0, 0), lda, packedA);
+    pack_matrix_a<KernelTy>(m, k, &A(0, 0), lda, packedA);
   }
 
   if (pack) {
-    libjit_matmul_inner_packed(m, n, k, packedA, packedB, c, ldc);
+    libjit_matmul_inner_packed<KernelTy>(m, n, k, packedA, packedB, c, ldc);
   } else {
-    libjit_matmul_inner_unpacked(m, n, k, a, lda, b, ldb, c, ldc);
+    libjit_matmul_inner_unpacked<KernelTy>(m, n, k, a, lda, b, ldb, c, ldc);
   }
 
-  size_t i = (m / mr) * mr;
-  size_t j = (n / nr) * nr;
+  int i = (m / mr) * mr;
+  int j = (n / nr) * nr;
   if (i < m) {
     libjit_matmul_odd(m - i, j, k, &A(i, 0), lda, &B(0, 0), ldb, &C(i, 0), ldc);
   }
@@ -221,13 +300,13 @@ void libjit_matmul_inner(int m, int n, int k, const float *a, int lda,
 /// \p c is a \p m x \p n column-major matrix.
 /// \p lda, \p ldb, and \p ldc are the leading dimensions of A, B, and C,
 /// respectively.
-template <bool pack>
-void __attribute__((noinline))
+template <typename KernelTy, bool pack>
+LIBJIT_KERNEL_INLINE void
 libjit_matmul_outer(size_t m, size_t n, size_t k, const float *a, size_t lda,
                     const float *b, size_t ldb, float *c, size_t ldc) {
   float *packedB = nullptr;
   if (pack) {
-    libjit_aligned_malloc((void **)&packedB, 64, kc * nc);
+    libjit_aligned_malloc((void **)&packedB, 64, kc * nc * sizeof(float));
   }
 
   for (size_t p = 0; p < k; p += kc) {
@@ -235,12 +314,13 @@ libjit_matmul_outer(size_t m, size_t n, size_t k, const float *a, size_t lda,
     for (size_t j = 0; j < n; j += nc) {
       size_t jb = MIN(n - j, nc);
       if (pack) {
-        pack_matrix_b<regsB>(jb, pb, &B(p, j), ldb, packedB);
+        pack_matrix_b<KernelTy>(jb, pb, &B(p, j), ldb, packedB);
       }
       for (size_t i = 0; i < m; i += mc) {
         size_t ib = MIN(m - i, mc);
-        libjit_matmul_inner<pack>(ib, jb, pb, &A(i, p), lda, &B(p, j), ldb,
-                                  &C(i, j), ldc, packedB);
+        libjit_matmul_inner<KernelTy, pack>(ib, jb, pb, &A(i, p), lda,
+                                            &B(p, j), ldb, &C(i, j), ldc,
+                                            packedB);
       }
     }
   }
@@ -254,19 +334,47 @@ libjit_matmul_outer(size_t m, size_t n, size_t k, const float *a, size_t lda,
 #undef B
 #undef A
 
-} // namespace
+/// Signature of the outer kernel of an instruction set, \p pack selects
+/// whether A and B are packed.
+typedef void (*MatMulOuterFn)(bool pack, size_t m, size_t n, size_t k,
+                              const float *a, size_t lda, const float *b,
+                              size_t ldb, float *c, size_t ldc);
 
-extern "C" {
+/// Outer kernels of each instruction set. They are kept out of line so that
+/// their body is compiled with the features of the instruction set.
+#define LIBJIT_MATMUL_OUTER(NAME, KERNEL, TARGET)                              \
+  TARGET void __attribute__((noinline))                                        \
+  NAME(bool pack, size_t m, size_t n, size_t k, const float *a, size_t lda,    \
+       const float *b, size_t ldb, float *c, size_t ldc) {                     \
+    if (pack) {                                                                \
+      libjit_matmul_outer<KERNEL, true>(m, n, k, a, lda, b, ldb, c, ldc);      \
+    } else {                                                                   \
+      libjit_matmul_outer<KERNEL, false>(m, n, k, a, lda, b, ldb, c, ldc);     \
+    }                                                                          \
+  }
+LIBJIT_MATMUL_OUTER(libjit_matmul_outer_generic, GenericKernel, )
+LIBJIT_MATMUL_OUTER(libjit_matmul_outer_avx2, AVX2Kernel, LIBJIT_TARGET_AVX2)
+LIBJIT_MATMUL_OUTER(libjit_matmul_outer_avx512, AVX512Kernel,
+                    LIBJIT_TARGET_AVX512)
+#undef LIBJIT_MATMUL_OUTER
 
-/// Performs the matrix multiplication c = a * b, where c, a, and b are
-/// row-major matrices.
-/// \p c is a m x n matrix, so \p cDims = {m, n}
-/// \p a is a m x k matrix, so \p aDims = {m, k}
-/// \p b is a k x n matrix, so \p bDims = {k, n}
-void libjit_matmul_f(float *c, const float *a, const float *b,
-                     const size_t *cDims, const size_t *aDims,
-                     const size_t *bDims) {
-  memset(c, 0, cDims[0] * cDims[1] * sizeof(float));
+/// Arguments of libjit_matmul_f, shared by its parallel tasks.
+struct MatMulArgs {
+  float *c;
+  const float *a;
+  const float *b;
+  const size_t *cDims;
+  const size_t *aDims;
+  const size_t *bDims;
+};
+
+/// Computes the blocks of nr rows [\p begin, \p end) of the matrix
+/// multiplication described by \p ctx with the microkernel \p KernelTy.
+template <typename KernelTy, MatMulOuterFn outer>
+void libjit_matmul_f_task(void *ctx, size_t begin, size_t end) {
+  const MatMulArgs &args = *static_cast<const MatMulArgs *>(ctx);
+  size_t rowBegin = begin * KernelTy::nr;
+  size_t rowEnd = MIN(end * KernelTy::nr, args.cDims[0]);
   // Call the matrix multiplication routine with appropriate dimensions and
   // leading dimensions. The "leading dimension" for a row-major matrix is equal
   // to the number of columns in the matrix.  For a, this is k; for b and c,
@@ -278,34 +386,265 @@ void libjit_matmul_f(float *c, const float *a, const float *b,
   //
   // The matrix multiplication routine is heavily inspired by:
   // https://github.com/flame/how-to-optimize-gemm
-  int m = cDims[1];
-  int n = cDims[0];
-  int k = aDims[1];
-  bool pack = m >= pack_threshold;
-  if (pack) {
-    libjit_matmul_outer<true>(m, n, k, b, bDims[1], a, aDims[1], c, cDims[1]);
-  } else {
-    libjit_matmul_outer<false>(m, n, k, b, bDims[1], a, aDims[1], c, cDims[1]);
+  int m = args.cDims[1];
+  int n = rowEnd - rowBegin;
+  int k = args.aDims[1];
+  const float *a = args.a + rowBegin * args.aDims[1];
+  float *c = args.c + rowBegin * args.cDims[1];
+  outer(m >= pack_threshold, m, n, k, args.b, args.bDims[1], a, args.aDims[1],
+        c, args.cDims[1]);
+}
+
+/// Performs the matrix multiplication c = a * b with the microkernel
+/// \p KernelTy, see libjit_matmul_f.
+template <typename KernelTy, MatMulOuterFn outer>
+void libjit_matmul_f_impl(float *c, const float *a, const float *b,
+                          const size_t *cDims, const size_t *aDims,
+                          const size_t *bDims) {
+  memset(c, 0, cDims[0] * cDims[1] * sizeof(float));
+  // Split the rows of c across threads in blocks of nr rows, the number of rows
+  // handled by the dot-product kernel, so that only the last block is ragged.
+  size_t numBlocks = (cDims[0] + KernelTy::nr - 1) / KernelTy::nr;
+  MatMulArgs args{c, a, b, cDims, aDims, bDims};
+  libjit_parallel_run(numBlocks, cDims[0] * cDims[1] * aDims[1],
+                      &libjit_matmul_f_task<KernelTy, outer>, &args);
+}
+
+/// Number of rows of A processed together by the int8 micro-kernel.
+constexpr size_t i8mr = 4;
+/// Number of columns of the output processed together by the int8
+/// micro-kernel, the width of the panels W is packed into.
+constexpr size_t i8nr = 4;
+
+/// Arguments of the int8 matrix multiplication out = A * transpose(W), where
+/// A is a m x k matrix and W is a n x k matrix, or its k x n transpose. Column
+/// j of the output uses the offset, bias and requantization parameters at
+/// index j * paramsStride, a stride of zero shares a single set of parameters
+/// across all columns.
+struct QGemmArgs {
+  int8_t *out;
+  const int8_t *a;
+  const int8_t *w;
+  size_t m;
+  size_t n;
+  size_t k;
+  int32_t aOffset;
+  const int32_t *wOffsets;
+  /// Optional per column bias, added to the accumulators after being scaled by
+  /// biasPre, biasPost and biasScale.
+  const int32_t *bias;
+  int32_t biasOffset;
+  const int32_t *biasPre;
+  const int32_t *biasPost;
+  const int32_t *biasScale;
+  const int32_t *outPre;
+  const int32_t *outPost;
+  const int32_t *outScale;
+  int32_t outOffset;
+  size_t paramsStride;
+  /// W packed by libjit_qgemm_pack_w into panels of i8nr columns, each column
+  /// stored contiguously along k. The last panel is padded with zeros.
+  const int8_t *packedW;
+  /// The sums along k of the columns of the packed panels.
+  const int32_t *wSums;
+};
+
+/// \returns the number of panels of i8nr columns W is packed into.
+inline size_t libjit_qgemm_panels(const QGemmArgs &args) {
+  return (args.n + i8nr - 1) / i8nr;
+}
+
+/// Packs W, a k x n matrix if \p TransW, otherwise a n x k matrix, into the
+/// panels \p packedW and their column sums \p wSums. Once packed, the
+/// micro-kernel streams the i8nr columns of a panel along k.
+template <bool TransW>
+void libjit_qgemm_pack_w(const QGemmArgs &args, int8_t *packedW,
+                         int32_t *wSums) {
+  size_t k = args.k;
+  for (size_t panel = 0, e = libjit_qgemm_panels(args); panel < e; panel++) {
+    int8_t *dst = packedW + panel * k * i8nr;
+    int32_t *sums = wSums + panel * i8nr;
+    for (size_t jj = 0; jj < i8nr; jj++) {
+      size_t j = panel * i8nr + jj;
+      int32_t sum = 0;
+      for (size_t p = 0; p < k; p++) {
+        int8_t w = 0;
+        if (j < args.n) {
+          w = TransW ? args.w[p * args.n + j] : args.w[j * k + p];
+        }
+        dst[jj * k + p] = w;
+        sum += w;
+      }
+      sums[jj] = sum;
+    }
+  }
+}
+
+/// Computes the MR x i8nr output tile at row \p i of the multiplication
+/// described by \p args with the packed panel \p panel of W, given the sums
+/// \p aSums of the MR rows of A. The rows of A are biased by 128 into uint8,
+/// so that each of the MR x i8nr accumulators is a dot product along k of
+/// u8 x s8 products widened to 32 bits. The vectorizer turns these reductions
+/// into the widening multiply-adds (vpdpbusd with VNNI, pmaddwd otherwise),
+/// reading each row of A and column of W once per tile. The offsets are
+/// applied once per output with
+/// Sum((a - aOff) * (w - wOff)) =
+///   Sum(a * w) - wOff * Sum(a) - aOff * Sum(w) + k * aOff * wOff,
+/// where a and aOff include the bias, followed by the requantization.
+template <size_t MR>
+void libjit_qgemm_tile(const QGemmArgs &args, const int32_t *aSums, size_t i,
+                       size_t panel) {
+  size_t k = args.k;
+  const int8_t *a = args.a + i * k;
+  const int8_t *w = args.packedW + panel * k * i8nr;
+  int32_t acc[MR][i8nr] = {{0}};
+  for (size_t p = 0; p < k; p++) {
+    for (size_t ii = 0; ii < MR; ii++) {
+      int32_t av = uint8_t(a[ii * k + p] ^ 0x80);
+      for (size_t jj = 0; jj < i8nr; jj++) {
+        acc[ii][jj] += av * int32_t(w[jj * k + p]);
+      }
+    }
+  }
+
+  int32_t aOffset = args.aOffset + 128;
+  size_t j = panel * i8nr;
+  size_t cols = MIN(i8nr, args.n - j);
+  for (size_t jj = 0; jj < cols; jj++) {
+    size_t param = (j + jj) * args.paramsStride;
+    int32_t wOffset = args.wOffsets[param];
+    // The terms are computed in 64 bits, the result wraps like the int32
+    // accumulation of the products with the offsets applied.
+    int64_t correction = int64_t(k) * aOffset * wOffset -
+                         int64_t(aOffset) * args.wSums[j + jj];
+    if (args.bias) {
+      correction += libjit_scale_i32i8(args.bias[j + jj] - args.biasOffset,
+                                       args.biasPre[param],
+                                       args.biasPost[param],
+                                       args.biasScale[param], 0);
+    }
+    for (size_t ii = 0; ii < MR; ii++) {
+      int32_t sum = int32_t(uint32_t(
+          acc[ii][jj] - int64_t(wOffset) * aSums[ii] + correction));
+      int32_t s =
+          libjit_scale_i32i8(sum, args.outPre[param], args.outPost[param],
+                             args.outScale[param], args.outOffset);
+      args.out[(i + ii) * args.n + j + jj] = libjit_clip(s);
+    }
+  }
+}
+
+/// Computes the rows [\p i, \p i + MR) of the multiplication described by
+/// \p args.
+template <size_t MR> void libjit_qgemm_rows(const QGemmArgs &args, size_t i) {
+  int32_t aSums[MR];
+  for (size_t ii = 0; ii < MR; ii++) {
+    const int8_t *a = args.a + (i + ii) * args.k;
+    int32_t sum = 0;
+    for (size_t p = 0; p < args.k; p++) {
+      sum += uint8_t(a[p] ^ 0x80);
+    }
+    aSums[ii] = sum;
+  }
+
+  for (size_t panel = 0, e = libjit_qgemm_panels(args); panel < e; panel++) {
+    libjit_qgemm_tile<MR>(args, aSums, i, panel);
+  }
+}
+
+/// Computes the blocks of i8mr rows [\p begin, \p end) of the multiplication
+/// described by \p ctx.
+void libjit_qgemm_task(void *ctx, size_t begin, size_t end) {
+  const QGemmArgs &args = *static_cast<const QGemmArgs *>(ctx);
+  size_t rowEnd = MIN(end * i8mr, args.m);
+  size_t i = begin * i8mr;
+  for (; i + i8mr <= rowEnd; i += i8mr) {
+    libjit_qgemm_rows<i8mr>(args, i);
+  }
+  for (; i < rowEnd; i++) {
+    libjit_qgemm_rows<1>(args, i);
   }
 }
 
+/// Runs the multiplication described by \p args, split across threads in
+/// blocks of i8mr rows. W is a k x n matrix if \p TransW. It is packed once,
+/// with its column sums, into an aligned buffer shared by all the rows.
+template <bool TransW> void libjit_qgemm(QGemmArgs &args) {
+  size_t panels = libjit_qgemm_panels(args);
+  size_t sumsSize = panels * i8nr * sizeof(int32_t);
+  char *packed = nullptr;
+  libjit_aligned_malloc((void **)&packed, 64,
+                        sumsSize + panels * i8nr * args.k);
+  int32_t *wSums = reinterpret_cast<int32_t *>(packed);
+  int8_t *packedW = reinterpret_cast<int8_t *>(packed + sumsSize);
+  libjit_qgemm_pack_w<TransW>(args, packedW, wSums);
+  args.packedW = packedW;
+  args.wSums = wSums;
+
+  size_t numBlocks = (args.m + i8mr - 1) / i8mr;
+  libjit_parallel_run(numBlocks, args.m * args.n * args.k, &libjit_qgemm_task,
+                      &args);
+  libjit_aligned_free(packed);
+}
+
+} // namespace
+
+extern "C" {
+
+/// Performs the matrix multiplication c = a * b, where c, a, and b are
+/// row-major matrices.
+/// \p c is a m x n matrix, so \p cDims = {m, n}
+/// \p a is a m x k matrix, so \p aDims = {m, k}
+/// \p b is a k x n matrix, so \p bDims = {k, n}
+void libjit_matmul_f(float *c, const float *a, const float *b,
+                     const size_t *cDims, const size_t *aDims,
+                     const size_t *bDims) {
+  libjit_matmul_f_impl<GenericKernel, libjit_matmul_outer_generic>(
+      c, a, b, cDims, aDims, bDims);
+}
+
+/// Variant of libjit_matmul_f for CPUs supporting AVX2 and FMA.
+void libjit_matmul_f_avx2(float *c, const float *a, const float *b,
+                          const size_t *cDims, const size_t *aDims,
+                          const size_t *bDims) {
+  libjit_matmul_f_impl<AVX2Kernel, libjit_matmul_outer_avx2>(c, a, b, cDims,
+                                                             aDims, bDims);
+}
+
+/// Variant of libjit_matmul_f for CPUs supporting AVX-512F.
+void libjit_matmul_f_avx512(float *c, const float *a, const float *b,
+                            const size_t *cDims, const size_t *aDims,
+                            const size_t *bDims) {
+  libjit_matmul_f_impl<AVX512Kernel, libjit_matmul_outer_avx512>(
+      c, a, b, cDims, aDims, bDims);
+}
+
 void libjit_matmul_i8(int8_t *outW, const int8_t *lhsW, const int8_t *rhsW,
                       const size_t *outWdims, const size_t *lhsWdims,
                       const size_t *rhsWdims, int32_t outOffset,
                       int32_t lhsOffset, int32_t rhsOffset, int32_t outPre,
                       int32_t outPost, int32_t outScale) {
-  for (size_t x = 0; x < outWdims[0]; x++) {
-    for (size_t y = 0; y < outWdims[1]; y++) {
-      int32_t sum = 0;
-      for (size_t i = 0; i < lhsWdims[1]; i++) {
-        int32_t lhs = lhsW[libjit_getXY(lhsWdims, x, i)] - lhsOffset;
-        int32_t rhs = rhsW[libjit_getXY(rhsWdims, i, y)] - rhsOffset;
-        sum += lhs * rhs;
-      }
-      int32_t s = libjit_scale_i32i8(sum, outPre, outPost, outScale, outOffset);
-      outW[libjit_getXY(outWdims, x, y)] = libjit_clip(s);
-    }
-  }
+  // rhs is the k x n transpose of the W operand of the kernel.
+  QGemmArgs args;
+  args.out = outW;
+  args.a = lhsW;
+  args.w = rhsW;
+  args.m = outWdims[0];
+  args.n = rhsWdims[1];
+  args.k = lhsWdims[1];
+  args.aOffset = lhsOffset;
+  args.wOffsets = &rhsOffset;
+  args.bias = nullptr;
+  args.biasOffset = 0;
+  args.biasPre = nullptr;
+  args.biasPost = nullptr;
+  args.biasScale = nullptr;
+  args.outPre = &outPre;
+  args.outPost = &outPost;
+  args.outScale = &outScale;
+  args.outOffset = outOffset;
+  args.paramsStride = 0;
+  libjit_qgemm</*TransW*/ true>(args);
 }
 
 void libjit_rowwise_quantized_fc_i8(
@@ -315,28 +654,29 @@ void libjit_rowwise_quantized_fc_i8(
     const int32_t *outPost, const int32_t *outScale, const size_t *outWdims,
     const size_t *inWdims, const size_t *weightsWdims, const size_t *biasWdims,
     size_t rowNum, int32_t outOffset, int32_t inOffset, int32_t biasOffset) {
-  size_t in_w = inWdims[1];
-  size_t out_h = outWdims[0];
-  size_t out_w = outWdims[1];
-
   // In rowwise quantized FC, weights is not pretransposed : I * Tranpose(W) +
   // B. out(i, j) = in(i, 0) * weights(j, 0) + in(i, 1) * weights(j, 1) + ... +
   //                in(i, k) * weights(j, k) + bias(j);
-  for (size_t i = 0; i < out_h; i++) {
-    for (size_t j = 0; j < out_w; j++) {
-      int32_t sum = 0;
-      for (size_t k = 0; k < in_w; k++) {
-        int32_t W = weightsW[libjit_getXY(weightsWdims, j, k)];
-        int32_t I = inW[libjit_getXY(inWdims, i, k)];
-        sum += (W - weightsOffsets[j]) * (I - inOffset);
-      }
-      int32_t B = libjit_scale_i32i8(biasW[j] - biasOffset, biasPre[j],
-                                     biasPost[j], biasScale[j], 0);
-      sum += B;
-      int32_t scaledSum = libjit_scale_i32i8(sum, outPre[j], outPost[j],
-                                             outScale[j], outOffset);
-      outW[libjit_getXY(outWdims, i, j)] = libjit_clip(scaledSum);
-    }
-  }
+  // Each row of weights has its own offset and output scale.
+  QGemmArgs args;
+  args.out = outW;
+  args.a = inW;
+  args.w = weightsW;
+  args.m = outWdims[0];
+  args.n = outWdims[1];
+  args.k = inWdims[1];
+  args.aOffset = inOffset;
+  args.wOffsets = weightsOffsets;
+  args.bias = biasW;
+  args.biasOffset = biasOffset;
+  args.biasPre = biasPre;
+  args.biasPost = biasPost;
+  args.biasScale = biasScale;
+  args.outPre = outPre;
+  args.outPost = outPost;
+  args.outScale = outScale;
+  args.outOffset = outOffset;
+  args.paramsStride = 1;
+  libjit_qgemm</*TransW*/ false>(args);
 }
 }
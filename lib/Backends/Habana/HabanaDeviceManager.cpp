@@ -338,6 +338,7 @@ void HabanaDeviceManager::runFunctionImpl(RunIdentifierTy runId,
   deviceBindings->setIOBuffer(ioBufferPool->get());
   ctx->setDeviceBindings(std::move(deviceBindings));
 
+  auto executeStart = std::chrono::steady_clock::now();
   auto executeErr = function->execute(ctx.get());
   if (executeErr) {
     trEvent.addArg("error", "execute() failed");
@@ -348,7 +349,7 @@ void HabanaDeviceManager::runFunctionImpl(RunIdentifierTy runId,
 
   // Give the handle to the wait thread pool to wait on and call the callback
   // for.
-  waitPool_->submit([this, runId, function, ioBufferPool,
+  waitPool_->submit([this, runId, function, ioBufferPool, executeStart,
                      functionName = std::move(functionName),
                      ctx = std::move(ctx),
                      resultCB = std::move(resultCB)]() mutable {
@@ -368,6 +369,7 @@ void HabanaDeviceManager::runFunctionImpl(RunIdentifierTy runId,
     std::unique_ptr<HabanaIOBuffer> ioBuffer =
         static_cast<HabanaBindings *>(ctx->getDeviceBindings())->getIOBuffer();
     TRACE_EVENT_END(ctx->getTraceContext(), TraceLevel::RUNTIME, "wait");
+    ctx->setExecutionTime(std::chrono::steady_clock::now() - executeStart);
 
     // Notify anything waiting for a topo switch.
     {
@@ -89,7 +89,11 @@ void InterpreterDeviceManager::addNetworkImpl(const Module *module,
     }
   }
 
-  if (usedMemoryBytes_ + functionCost_ > maxMemoryBytes_) {
+  uint64_t allocationSize = 0;
+  for (const auto &func : functions) {
+    allocationSize += func.second->getRuntimeBundle().getDeviceMemorySize();
+  }
+  if (usedMemoryBytes_ + allocationSize > maxMemoryBytes_) {
     readyCB(module, MAKE_ERR(GlowErr::ErrorCode::RUNTIME_OUT_OF_DEVICE_MEMORY,
                              "Failed to add network: not enough memory"));
     return;
@@ -101,8 +105,8 @@ void InterpreterDeviceManager::addNetworkImpl(const Module *module,
       func.second->collectConstants(module);
     }
     functions_.emplace(func.first, func.second);
-    usedMemoryBytes_ += functionCost_; // TODO:: static moduleSize
   }
+  usedMemoryBytes_ += allocationSize;
 
   assert(usedMemoryBytes_ <= maxMemoryBytes_);
 
@@ -114,8 +118,10 @@ void InterpreterDeviceManager::evictNetworkImpl(std::string functionName,
                                                 EvictFunctionCBTy evictCB) {
   DCHECK(evictCB != nullptr);
 
-  if (functions_.erase(functionName)) {
-    usedMemoryBytes_ -= functionCost_; // TODO: static moduleSize
+  auto it = functions_.find(functionName);
+  if (it != functions_.end()) {
+    usedMemoryBytes_ -= it->second->getRuntimeBundle().getDeviceMemorySize();
+    functions_.erase(it);
   } else {
     evictCB(functionName,
             MAKE_ERR(GlowErr::ErrorCode::RUNTIME_NET_NOT_FOUND,
@@ -147,7 +153,9 @@ void InterpreterDeviceManager::runFunctionImpl(
   CompiledFunction *func = funcIt->second;
 
   // Run that function.
+  auto executeStart = std::chrono::steady_clock::now();
   auto executeErr = func->execute(context.get());
+  context->setExecutionTime(std::chrono::steady_clock::now() - executeStart);
 
   // End the TraceEvent early to avoid time in the CB.
   TRACE_EVENT_SCOPE_END_NAMED(dmRun);
@@ -19,6 +19,8 @@
 #include "glow/Backends/QueueBackedDeviceManager.h"
 #include "glow/Runtime/StatsExporter.h"
 
+#include <atomic>
+
 namespace glow {
 namespace runtime {
 
@@ -33,12 +35,9 @@ class InterpreterDeviceManager : public QueueBackedDeviceManager {
   /// constant.
   uint64_t maxMemoryBytes_{0};
 
-  /// Amount of memory used by all models.
-  uint64_t usedMemoryBytes_{0};
-
-  /// Static memory cost of the InterpreterFunction.
-  /// This is very arbitrary for the Interpreter backend.
-  const uint64_t functionCost_{1};
+  /// Amount of memory used by all models, the sum of the memory sizes of the
+  /// RuntimeBundles of their functions. Atomic as it is read from any thread.
+  std::atomic<uint64_t> usedMemoryBytes_{0};
 
   /// String constant for logging number of in-use devices.
   static constexpr const char *kDevicesUsedInterpreter =
@@ -1332,6 +1332,30 @@ llvm::Error ONNXModelWriter::writeCPUConvDKKC8(const CPUConvDKKC8Node *node,
   return writeAllWithNode("CPUConvDKKC8", node, proto);
 }
 
+llvm::Error
+ONNXModelWriter::writeCPUConvWinograd(const CPUConvWinogradNode *node,
+                                      GraphType &graph) {
+  auto *proto = graph.add_node();
+  // Add dictionary entries.
+  addValueAttribute(proto, "pads", node->getPads());
+  addValueAttribute(proto, "tile_size", node->getTileSize());
+
+  return writeAllWithNode("CPUConvWinograd", node, proto);
+}
+
+llvm::Error
+ONNXModelWriter::writeCPUConvDepthwise(const CPUConvDepthwiseNode *node,
+                                       GraphType &graph) {
+  auto *proto = graph.add_node();
+  // Add dictionary entries.
+  addValueAttribute(proto, "kernel_shape", node->getKernels());
+  addValueAttribute(proto, "strides", node->getStrides());
+  addValueAttribute(proto, "pads", node->getPads());
+  addValueAttribute(proto, "dilation", node->getDilation());
+
+  return writeAllWithNode("CPUConvDepthwise", node, proto);
+}
+
 #endif // GLOW_WITH_CPU
 
 #ifdef GLOW_WITH_OPENCL
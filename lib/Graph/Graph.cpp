@@ -454,6 +454,7 @@ TypeRef Module::uniqueTypeWithNewShape(TypeRef T, llvm::ArrayRef<size_t> dims) {
 }
 
 TypeRef Module::uniqueType(const Type &T) {
+  std::lock_guard<std::mutex> lock(typesLock_);
   for (auto &tp : types_) {
     if (T.isEqual(tp)) {
       return &tp;
@@ -21,7 +21,9 @@ using namespace glow;
 
 namespace {
 llvm::cl::OptionCategory graphSchedulerCat("Graph Scheduler Options");
+} // namespace
 
+/// Hashed by the LLVM backends in the key of their compile cache.
 llvm::cl::opt<SchedulerKind> graphScheduler(
     llvm::cl::desc("Scheduler to use:"),
     llvm::cl::values(clEnumValN(SchedulerKind::ChildMemSizeBased,
@@ -32,7 +34,6 @@ llvm::cl::opt<SchedulerKind> graphScheduler(
                                 "Use TopologicalSortBased")),
     llvm::cl::init(SchedulerKind::ChildMemSizeBased),
     llvm::cl::cat(graphSchedulerCat));
-} // namespace
 
 namespace glow {
 Scheduler *createScheduler(SchedulerKind schedulerKind, Function &G,
@@ -67,6 +67,7 @@ void AllocationsInfo::allocateWeightVars(const IRFunction *F) {
     auto numBytes = w->getSizeInBytes();
     size_t addr = mutableWeightVarsAllocator.allocate(numBytes, w);
     allocatedAddress_[w] = addr;
+    placeholderSlots_[w] = it - contiguousPlaceholders.begin();
   }
 
   // Remember that max required memory size for each kind of weights.
@@ -42,3 +42,15 @@ llvm::cl::list<std::string> llvmCompilerOptions(
     "llvm-compiler-opt",
     llvm::cl::desc("Options to pass to the external LLVM compiler"),
     llvm::cl::ZeroOrMore);
+
+llvm::cl::opt<bool> llvmInterOpParallelism(
+    "llvm-inter-op-parallelism",
+    llvm::cl::desc("Run independent instructions of JIT'ed functions "
+                   "concurrently on the intra-op threads of the device"),
+    llvm::cl::init(false), llvm::cl::cat(getLLVMBackendCat()));
+
+llvm::cl::opt<std::string> llvmCompileCacheDir(
+    "llvm-compile-cache-dir",
+    llvm::cl::desc("Directory caching the functions compiled by the LLVM "
+                   "backends across processes, no caching if empty"),
+    llvm::cl::init(""), llvm::cl::cat(getLLVMBackendCat()));
@@ -40,5 +40,13 @@ extern llvm::cl::list<std::string> llvmTargetFeatures;
 extern llvm::cl::opt<std::string> llvmCompiler;
 /// Set of options to pass to the external LLVM compiler.
 extern llvm::cl::list<std::string> llvmCompilerOptions;
+/// Whether JIT'ed functions run independent instructions concurrently.
+extern llvm::cl::opt<bool> llvmInterOpParallelism;
+/// Directory of the on-disk cache of compiled functions.
+extern llvm::cl::opt<std::string> llvmCompileCacheDir;
+/// Whether debug information is emitted for the JIT'ed code. Used as -g.
+extern llvm::cl::opt<bool> emitDebugInfo;
+/// Whether the kernels called with constant dimensions are specialized.
+extern llvm::cl::opt<bool> jitSpecializeDims;
 
 #endif // GLOW_LLVMIRCODEGEN_COMMANDLINE_H
@@ -0,0 +1,245 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompileCache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <glog/logging.h>
+
+#include <cstring>
+
+using namespace glow;
+using namespace glow::runtime;
+
+namespace {
+/// Identifies the format of the .bundle files.
+constexpr const char kBundleMagic[8] = {'G', 'L', 'O', 'W', 'R', 'B', '0', '1'};
+
+/// Appends the bytes of POD values and strings to a string.
+class BundleWriter {
+  std::string data_;
+
+public:
+  BundleWriter() { data_.append(kBundleMagic, sizeof(kBundleMagic)); }
+
+  template <typename T> void write(T value) {
+    data_.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void write(llvm::StringRef str) {
+    write<uint64_t>(str.size());
+    data_.append(str.data(), str.size());
+  }
+
+  llvm::StringRef getData() const { return data_; }
+};
+
+/// Reads the values written by BundleWriter, failing on truncated data.
+class BundleReader {
+  llvm::StringRef data_;
+
+public:
+  explicit BundleReader(llvm::StringRef data) : data_(data) {}
+
+  /// \returns true if the data starts with the magic of the format.
+  bool readMagic() {
+    llvm::StringRef magic(kBundleMagic, sizeof(kBundleMagic));
+    if (!data_.startswith(magic)) {
+      return false;
+    }
+    data_ = data_.drop_front(sizeof(kBundleMagic));
+    return true;
+  }
+
+  template <typename T> bool read(T &value) {
+    if (data_.size() < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value, data_.data(), sizeof(T));
+    data_ = data_.drop_front(sizeof(T));
+    return true;
+  }
+
+  bool read(std::string &str) {
+    uint64_t size;
+    if (!read(size) || data_.size() < size) {
+      return false;
+    }
+    str = data_.take_front(size).str();
+    data_ = data_.drop_front(size);
+    return true;
+  }
+
+  /// \returns true if all the data was read.
+  bool done() const { return data_.empty(); }
+};
+
+/// Serializes \p bundle, except its constants.
+void writeBundle(BundleWriter &W, const RuntimeBundle &bundle) {
+  W.write<uint64_t>(bundle.getConstantWeightSize());
+  W.write<uint64_t>(bundle.getMutableWeightSize());
+  W.write<uint64_t>(bundle.getActivationsSize());
+  const auto &symbolTable = bundle.getSymbolTable();
+  W.write<uint64_t>(symbolTable.size());
+  for (const auto &symbol : symbolTable) {
+    const auto &info = symbol.second;
+    W.write(llvm::StringRef(symbol.first));
+    W.write<uint64_t>(info.size);
+    W.write<uint64_t>(info.offset);
+    W.write<uint64_t>(info.index);
+    W.write<uint8_t>(info.input);
+    W.write<uint8_t>(info.output);
+    W.write<uint8_t>(static_cast<uint8_t>(info.symbolCategory));
+    const Type &T = info.type;
+    W.write<uint8_t>(static_cast<uint8_t>(T.getElementType()));
+    W.write<uint8_t>(T.dims().size());
+    for (auto dim : T.dims()) {
+      W.write<uint64_t>(dim);
+    }
+    W.write<float>(T.isQuantizedType() ? T.getScale() : 0);
+    W.write<int32_t>(T.isQuantizedType() ? T.getOffset() : 0);
+  }
+}
+
+/// Deserializes a RuntimeBundle written by writeBundle. \returns nullptr if
+/// the data is malformed.
+std::unique_ptr<RuntimeBundle> readBundle(BundleReader &R) {
+  uint64_t constantWeightSize, mutableWeightSize, activationsSize, numSymbols;
+  if (!R.read(constantWeightSize) || !R.read(mutableWeightSize) ||
+      !R.read(activationsSize) || !R.read(numSymbols)) {
+    return nullptr;
+  }
+
+  SymbolTableTy symbolTable;
+  for (uint64_t i = 0; i < numSymbols; i++) {
+    std::string name;
+    uint64_t size, offset, index;
+    uint8_t input, output, category, elemKind, numDims;
+    if (!R.read(name) || !R.read(size) || !R.read(offset) || !R.read(index) ||
+        !R.read(input) || !R.read(output) || !R.read(category) ||
+        !R.read(elemKind) || !R.read(numDims) ||
+        numDims > max_tensor_dimensions) {
+      return nullptr;
+    }
+    std::vector<size_t> dims(numDims);
+    for (auto &dim : dims) {
+      uint64_t value;
+      if (!R.read(value)) {
+        return nullptr;
+      }
+      dim = value;
+    }
+    float scale;
+    int32_t typeOffset;
+    if (!R.read(scale) || !R.read(typeOffset)) {
+      return nullptr;
+    }
+
+    RuntimeSymbolInfo info;
+    info.size = size;
+    info.offset = offset;
+    info.index = index;
+    info.input = input;
+    info.output = output;
+    info.symbolCategory = static_cast<SymbolCategory>(category);
+    auto kind = static_cast<ElemKind>(elemKind);
+    info.type = isQuantizedElemKind(kind) ? Type(kind, dims, scale, typeOffset)
+                                          : Type(kind, dims);
+    symbolTable.emplace(std::move(name), std::move(info));
+  }
+  if (!R.done()) {
+    return nullptr;
+  }
+  return llvm::make_unique<RuntimeBundle>(symbolTable, constantWeightSize,
+                                          mutableWeightSize, activationsSize);
+}
+} // namespace
+
+std::string CompileCache::getPath(llvm::StringRef key,
+                                  llvm::StringRef ext) const {
+  llvm::SmallString<128> path(dir_);
+  llvm::sys::path::append(path, key + ext);
+  return path.str().str();
+}
+
+bool CompileCache::writeFile(llvm::StringRef key, llvm::StringRef ext,
+                             llvm::StringRef data) const {
+  int fd;
+  llvm::SmallString<128> tmpPath;
+  if (auto EC = llvm::sys::fs::createUniqueFile(
+          getPath(key, (ext + ".%%%%%%.tmp").str()), fd, tmpPath)) {
+    LOG(WARNING) << "Cannot create a file in compile cache " << dir_ << ": "
+                 << EC.message();
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, /* shouldClose */ true);
+    os << data;
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(tmpPath);
+      LOG(WARNING) << "Cannot write " << tmpPath.str().str();
+      return false;
+    }
+  }
+  if (auto EC = llvm::sys::fs::rename(tmpPath, getPath(key, ext))) {
+    llvm::sys::fs::remove(tmpPath);
+    LOG(WARNING) << "Cannot rename " << tmpPath.str().str() << ": "
+                 << EC.message();
+    return false;
+  }
+  return true;
+}
+
+bool CompileCache::load(llvm::StringRef key,
+                        std::unique_ptr<llvm::MemoryBuffer> &object,
+                        std::unique_ptr<RuntimeBundle> &bundle) const {
+  // The bundle is written last, it is only present for complete entries.
+  auto bundleOrErr = llvm::MemoryBuffer::getFile(getPath(key, ".bundle"));
+  if (!bundleOrErr) {
+    return false;
+  }
+  BundleReader R((*bundleOrErr)->getBuffer());
+  if (!R.readMagic() || !(bundle = readBundle(R))) {
+    LOG(WARNING) << "Ignoring malformed compile cache entry " << key.str();
+    return false;
+  }
+  auto objectOrErr = llvm::MemoryBuffer::getFile(getPath(key, ".o"));
+  if (!objectOrErr) {
+    bundle.reset();
+    return false;
+  }
+  object = std::move(*objectOrErr);
+  return true;
+}
+
+bool CompileCache::store(llvm::StringRef key, llvm::MemoryBufferRef object,
+                         const RuntimeBundle &bundle) const {
+  if (auto EC = llvm::sys::fs::create_directories(dir_)) {
+    LOG(WARNING) << "Cannot create compile cache " << dir_ << ": "
+                 << EC.message();
+    return false;
+  }
+  BundleWriter W;
+  writeBundle(W, bundle);
+  return writeFile(key, ".o", object.getBuffer()) &&
+         writeFile(key, ".bundle", W.getData());
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GLOW_LLVMIRCODEGEN_COMPILECACHE_H
+#define GLOW_LLVMIRCODEGEN_COMPILECACHE_H
+
+#include "glow/Backend/BackendUtils.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <string>
+
+namespace glow {
+
+/// On-disk cache of the functions compiled by the LLVMBackend. An entry is
+/// addressed by a key hashing everything the machine code depends on, and
+/// holds the object file of the function and its RuntimeBundle without the
+/// constants, in the files <key>.o and <key>.bundle of the cache directory.
+/// Entries are written to temporary files and renamed into place, so that
+/// processes sharing the directory never read a partial entry.
+class CompileCache final {
+public:
+  /// Creates a cache stored in directory \p dir, created if missing.
+  explicit CompileCache(llvm::StringRef dir) : dir_(dir) {}
+
+  /// \returns the object file and RuntimeBundle of entry \p key in \p object
+  /// and \p bundle. \returns false if the entry is missing or unreadable.
+  bool load(llvm::StringRef key, std::unique_ptr<llvm::MemoryBuffer> &object,
+            std::unique_ptr<runtime::RuntimeBundle> &bundle) const;
+
+  /// Stores \p object and \p bundle as entry \p key. \returns false if the
+  /// entry could not be written, the cache is then left unchanged.
+  bool store(llvm::StringRef key, llvm::MemoryBufferRef object,
+             const runtime::RuntimeBundle &bundle) const;
+
+private:
+  /// \returns the path of the file of entry \p key with extension \p ext.
+  std::string getPath(llvm::StringRef key, llvm::StringRef ext) const;
+
+  /// Writes \p data to the file of entry \p key with extension \p ext.
+  /// \returns false on failure.
+  bool writeFile(llvm::StringRef key, llvm::StringRef ext,
+                 llvm::StringRef data) const;
+
+  /// The directory of the cache.
+  std::string dir_;
+};
+
+} // namespace glow
+
+#endif // GLOW_LLVMIRCODEGEN_COMPILECACHE_H
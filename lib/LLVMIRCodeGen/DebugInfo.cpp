@@ -34,8 +34,6 @@ using llvm::DISubprogram;
 using llvm::dyn_cast;
 using llvm::isa;
 
-extern llvm::cl::opt<bool> emitDebugInfo;
-
 void LLVMIRGen::setCurrentDebugLocation(llvm::IRBuilder<> &builder,
                                         const glow::Instruction *I) {
   if (!emitDebugInfo)
@@ -369,6 +367,19 @@ void LLVMIRGen::emitDebugGlobalVariableForValue(const Value *val) {
   auto offset = allocationsInfo_.allocatedAddress_[val];
   // Get the value of the global var.
   ops.push_back(llvm::dwarf::DW_OP_deref);
+  // If Placeholders are bound through an address table, the global var holds
+  // the address of the table. Load the base address of the Placeholder from
+  // its slot and make the offset relative to it.
+  if (usePlaceholderAddressTable_ &&
+      memoryAreaKind == MemoryAreaKind::MutableWeightsMemoryArea) {
+    auto *origin = getOrigin(val);
+    ops.push_back(llvm::dwarf::DW_OP_constu);
+    ops.push_back(allocationsInfo_.placeholderSlots_.lookup(origin) *
+                  (getLibjitSizeTWidth() / 8));
+    ops.push_back(llvm::dwarf::DW_OP_plus);
+    ops.push_back(llvm::dwarf::DW_OP_deref);
+    offset -= allocationsInfo_.allocatedAddress_[origin];
+  }
   // Add the offset to the value of the global var to get the address of the
   // logical debug variable being created.
   ops.push_back(llvm::dwarf::DW_OP_constu);
@@ -34,16 +34,17 @@ using llvm::cast;
 using llvm::dyn_cast;
 using llvm::isa;
 
-namespace {
 /// Perform function specialization with constant arguments taking into account
 /// only dimensions, but not the buffer addresses. This allows for faster JIT
 /// compilation and the does degrade performance.
-static llvm::cl::opt<bool>
+llvm::cl::opt<bool>
     jitSpecializeDims("jit-specialize",
                       llvm::cl::desc("Create specialized functions for "
                                      "operations with constant dimensions"),
                       llvm::cl::init(true), llvm::cl::cat(getLLVMBackendCat()));
 
+namespace {
+
 STATISTIC(NumSpecializations, "Number of created specializations");
 STATISTIC(NumSharedSpecializations, "Number of shared specializations");
 
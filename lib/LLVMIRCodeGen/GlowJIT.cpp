@@ -165,6 +165,17 @@ GlowJIT::ModuleHandle GlowJIT::addModule(std::unique_ptr<llvm::Module> M) {
   return K;
 }
 
+GlowJIT::ModuleHandle
+GlowJIT::addObject(std::unique_ptr<MemoryBuffer> object) {
+  auto K = ES_.allocateVModule();
+  cantFail(objectLayer_.addObject(K, std::move(object)));
+  return K;
+}
+
+std::unique_ptr<MemoryBuffer> GlowJIT::compileModule(Module &M) {
+  return SimpleCompiler(TM_)(M);
+}
+
 void GlowJIT::removeModule(GlowJIT::ModuleHandle H) {
   cantFail(compileLayer_.removeModule(H));
 }
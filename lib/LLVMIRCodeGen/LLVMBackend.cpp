@@ -17,22 +17,41 @@
 #include "glow/LLVMIRCodeGen/LLVMBackend.h"
 #include "BundleSaver.h"
 #include "CommandLine.h"
+#include "CompileCache.h"
 #include "glow/LLVMIRCodeGen/LLVMCompiledFunction.h"
+#include "glow/LLVMIRCodeGen/ParallelSchedule.h"
 
 #include "glow/Backend/BackendUtils.h"
 #include "glow/Graph/Graph.h"
 #include "glow/Graph/PlaceholderBindings.h"
 #include "glow/IR/Instrs.h"
 #include "glow/Optimizer/IROptimizer/IROptimizer.h"
+#include "glow/Runtime/StatsExporter.h"
 #include "glow/Support/Debug.h"
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/SHA1.h"
 
 using namespace glow;
 
+namespace glow {
+enum class SchedulerKind;
+} // namespace glow
+
+/// Options of the IR generation and optimization, which change the compiled
+/// code.
+extern llvm::cl::opt<bool> optimizeIR;
+extern llvm::cl::opt<bool> instrumentDebug;
+extern llvm::cl::list<std::string> instrumentDebugOnly;
+extern llvm::cl::opt<bool> reuseActivationsMemory;
+extern llvm::cl::opt<SchedulerKind> graphScheduler;
+
 namespace {
 
 //===----------------------------------------------------------------------===//
@@ -59,8 +78,10 @@ LLVMBackend::LLVMBackend() {
 /// Emit the entry point for JIT called "jitmain".
 /// Function has the following API:
 ///   void jitmain(uint8_t *baseConstantWeightVars,
-///                uint8_t *baseInOutWeightVars,
-///                nuint8_t *baseActivations);
+///                uint8_t **placeholderAddrs,
+///                uint8_t *baseActivations);
+/// where placeholderAddrs holds the base address of each Placeholder, indexed
+/// by the Placeholder index in the RuntimeBundle.
 void LLVMBackend::emitJitMain(LLVMIRGen &irgen) const {
   AllocationsInfo &allocationsInfo = irgen.getAllocationsInfo();
   llvm::Type *voidTy = llvm::Type::getVoidTy(irgen.getLLVMContext());
@@ -105,8 +126,25 @@ LLVMBackend::compileIR(std::unique_ptr<IRFunction> IR) const {
 
 std::unique_ptr<CompiledFunction>
 LLVMBackend::compileIRWithoutConstants(IRFunction *IR) const {
+  return compileIRToFunction(IR, /* cache */ nullptr, "");
+}
+
+std::unique_ptr<CompiledFunction>
+LLVMBackend::compileIRToFunction(IRFunction *IR, const CompileCache *cache,
+                                 llvm::StringRef cacheKey) const {
   AllocationsInfo allocationsInfo;
   std::unique_ptr<LLVMIRGen> irgen = createIRGen(IR, allocationsInfo);
+  // Address Placeholders through a table so that the compiled function can
+  // bind input and output tensors in place.
+  irgen->setUsePlaceholderAddressTable(true);
+  // Let the kernels split work across the intra-op threads of the device.
+  irgen->setUseHostParallelRuntime(useHostParallelRuntime());
+  // Group independent instructions into stages before the instructions are
+  // numbered and the activations are allocated.
+  if (llvmInterOpParallelism) {
+    ParallelSchedule::reorder(IR);
+    irgen->setUseInterOpParallelism(true);
+  }
   llvm::SmallVector<std::string, 8> targetFeatures(llvmTargetFeatures.begin(),
                                                    llvmTargetFeatures.end());
   irgen->initTargetMachine(getTarget(), getArch(), getCPU(), targetFeatures,
@@ -119,21 +157,130 @@ LLVMBackend::compileIRWithoutConstants(IRFunction *IR) const {
   emitJitMain(*irgen);
   // Emit the code for the body of the entry function.
   irgen->performCodeGen();
-  // Hand over the module to JIT for the machine code generation.
-  auto JIT = llvm::make_unique<llvm::orc::GlowJIT>(irgen->getTargetMachine());
-  JIT->addModule(irgen->borrowModule());
   // Build runtimeBundle object containing offsets and allocation sizes.
   MemoryAllocator constantAllocator("ConstantWeights", 0);
   MemoryAllocator placeholderAllocator("Placeholders", 0);
   MemoryAllocator activationsAllocator("Activations", 0);
   auto runtimeInfo = runtime::RuntimeBundle::create(
       *IR, constantAllocator, placeholderAllocator, activationsAllocator);
-  return createCompiledFunction(std::move(JIT), std::move(runtimeInfo));
+  // Hand over the module to JIT for the machine code generation.
+  auto JIT = llvm::make_unique<llvm::orc::GlowJIT>(irgen->getTargetMachine());
+  if (cache) {
+    // Generate the object file separately to keep a copy of it.
+    auto object = JIT->compileModule(*irgen->borrowModule());
+    cache->store(cacheKey, object->getMemBufferRef(), runtimeInfo);
+    JIT->addObject(std::move(object));
+  } else {
+    JIT->addModule(irgen->borrowModule());
+  }
+  auto function =
+      createCompiledFunction(std::move(JIT), std::move(runtimeInfo));
+  static_cast<LLVMCompiledFunction *>(function.get())
+      ->resolvePlaceholders(IR->getGraph()->getParent());
+  return function;
+}
+
+std::string LLVMBackend::getCompileCacheKey(
+    const Function *F, const BackendOptions &opts,
+    const llvm::TargetMachine &TM) const {
+  std::string desc;
+  llvm::raw_string_ostream os(desc);
+  os << "glow-llvm-compile-cache-1\n"
+     << LLVM_VERSION_STRING << "\n"
+     << getBackendName() << "\n"
+     << TM.getTargetTriple().str() << "\n"
+     << TM.getTargetCPU() << "\n"
+     << TM.getTargetFeatureString() << "\n"
+     << int(TM.getRelocationModel()) << "\n"
+     << shouldShareBuffers() << llvmInterOpParallelism << "\n";
+  for (const auto &opt : opts.backendSpecificOpts) {
+    os << opt.first << "=" << opt.second << "\n";
+  }
+  // The command line options changing the IR or the generated code.
+  os << "g=" << emitDebugInfo << "\n"
+     << "jit-specialize=" << jitSpecializeDims << "\n"
+     << "llvm-compiler=" << llvmCompiler << "\n"
+     << "llvm-compiler-opt=" << llvm::join(llvmCompilerOptions, ",") << "\n"
+     << "optimize-ir=" << optimizeIR << "\n"
+     << "instrument-debug=" << instrumentDebug << "\n"
+     << "instrument-debug-only=" << llvm::join(instrumentDebugOnly, ",")
+     << "\n"
+     << "reuse-activation-memory-allocations=" << reuseActivationsMemory
+     << "\n"
+     << "scheduler=" << int(graphScheduler.getValue()) << "\n";
+  describeCodegenOptions(os);
+  F->dump(os);
+  llvm::SetVector<const Constant *> constants;
+  for (const auto &N : F->getNodes()) {
+    for (unsigned i = 0, e = N.getNumInputs(); i < e; i++) {
+      if (auto *S = llvm::dyn_cast<Storage>(N.getNthInput(i).getNode())) {
+        os << S->getName() << ": " << *S->getType() << "\n";
+      }
+      if (auto *C = llvm::dyn_cast<Constant>(N.getNthInput(i).getNode())) {
+        constants.insert(C);
+      }
+    }
+  }
+
+  llvm::SHA1 hasher;
+  hasher.update(os.str());
+  // Codegen may fold the payload of a Constant into the code, e.g. the scales
+  // of RowwiseQuantizedFullyConnected.
+  for (const Constant *C : constants) {
+    const Tensor &payload = C->getPayload();
+    hasher.update(
+        llvm::StringRef(payload.getUnsafePtr(), payload.getSizeInBytes()));
+  }
+  hasher.update(getLibjitBitcode());
+  return llvm::toHex(hasher.result(), /* LowerCase */ true);
+}
+
+std::unique_ptr<CompiledFunction>
+LLVMBackend::compileWithCache(Function *F, const BackendOptions &opts) const {
+  llvm::SmallVector<std::string, 8> targetFeatures(llvmTargetFeatures.begin(),
+                                                   llvmTargetFeatures.end());
+  auto TM = LLVMIRGen::createTargetMachine(getTarget(), getArch(), getCPU(),
+                                           targetFeatures,
+                                           llvm::CodeModel::Model::Large);
+  CompileCache cache(llvmCompileCacheDir);
+  std::string key = getCompileCacheKey(F, opts, *TM);
+
+  std::unique_ptr<CompiledFunction> function;
+  std::unique_ptr<llvm::MemoryBuffer> object;
+  std::unique_ptr<runtime::RuntimeBundle> bundle;
+  if (cache.load(key, object, bundle)) {
+    Stats()->incrementCounter(kCompileCacheHits);
+    // The JIT only relocates the cached machine code.
+    auto JIT = llvm::make_unique<llvm::orc::GlowJIT>(*TM);
+    JIT->addObject(std::move(object));
+    function = createCompiledFunction(std::move(JIT), std::move(*bundle));
+    static_cast<LLVMCompiledFunction *>(function.get())
+        ->resolvePlaceholders(F->getParent());
+  } else {
+    Stats()->incrementCounter(kCompileCacheMisses);
+    auto IR = generateAndOptimizeIR(F, *this, shouldShareBuffers());
+    function = compileIRToFunction(IR.get(), &cache, key);
+  }
+
+  if (opts.collectConstants) {
+    static_cast<LLVMCompiledFunction *>(function.get())
+        ->collectConstants(F->getParent());
+  }
+  return function;
 }
 
 llvm::Expected<std::unique_ptr<CompiledFunction>>
 LLVMBackend::compile(Function *F, const BackendOptions &opts) const {
   TraceInfo traceInfo = buildManualTraceInfo(F);
+  // Instrumented functions are not cached, the instrumentation rewrites their
+  // IR.
+  if (!llvmCompileCacheDir.empty() && !opts.autoInstrument) {
+    auto compiledFunc = compileWithCache(F, opts);
+    compiledFunc->setTraceInfo(std::move(traceInfo));
+    return llvm::Expected<std::unique_ptr<CompiledFunction>>(
+        std::move(compiledFunc));
+  }
+
   auto IR = generateAndOptimizeIR(F, *this, shouldShareBuffers());
 
   if (opts.autoInstrument) {
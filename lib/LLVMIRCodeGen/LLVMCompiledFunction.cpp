@@ -16,6 +16,7 @@
 #include "glow/LLVMIRCodeGen/LLVMCompiledFunction.h"
 
 #include "glow/Graph/PlaceholderBindings.h"
+#include "glow/Runtime/StatsExporter.h"
 #include "glow/Support/Compiler.h"
 #include "glow/Support/Memory.h"
 
@@ -24,41 +25,161 @@ using namespace glow;
 LLVMCompiledFunction::LLVMCompiledFunction(
     std::unique_ptr<llvm::orc::GlowJIT> JIT,
     runtime::RuntimeBundle &&runtimeBundle)
-    : CompiledFunction(std::move(runtimeBundle)), JIT_(std::move(JIT)) {}
+    : CompiledFunction(std::move(runtimeBundle)), JIT_(std::move(JIT)) {
+  // Resolve the entry point once, the JIT'ed module does not change anymore.
+  auto sym = JIT_->findSymbol("jitmain");
+  DCHECK(sym) << "Unable to JIT the code!";
+  if (auto address = sym.getAddress()) {
+    jitmain_ = reinterpret_cast<JitFuncType>(address.get());
+  } else {
+    llvm::consumeError(address.takeError());
+  }
+
+  // Build the dense Placeholder table, indexed by the Placeholder index.
+  for (const auto &symbol : runtimeBundle_.getSymbolTable()) {
+    const auto &info = symbol.second;
+    if (info.symbolCategory != runtime::SymbolCategory::Placeholder) {
+      continue;
+    }
+    if (info.index >= placeholderSlots_.size()) {
+      placeholderSlots_.resize(info.index + 1);
+    }
+    // The keys of the symbol table outlive the function.
+    placeholderSlots_[info.index] = {info.offset, info.size, symbol.first};
+  }
+}
+
+LLVMCompiledFunction::~LLVMCompiledFunction() {
+  size_t bytes = runtimeBundle_.getActivationsSize() +
+                 runtimeBundle_.getMutableWeightSize();
+  for (auto &buffers : bufferPool_) {
+    alignedFree(buffers.activations);
+    alignedFree(buffers.mutableWeights);
+    Stats()->incrementCounter(kBufferPoolBytes, -int64_t(bytes));
+  }
+}
+
+LLVMCompiledFunction::ExecutionBuffers LLVMCompiledFunction::acquireBuffers() {
+  {
+    std::lock_guard<std::mutex> lock(bufferPoolLock_);
+    if (!bufferPool_.empty()) {
+      ExecutionBuffers buffers = std::move(bufferPool_.back());
+      bufferPool_.pop_back();
+      Stats()->incrementCounter(kBufferPoolHits);
+      return buffers;
+    }
+  }
+
+  ExecutionBuffers buffers;
+  if (runtimeBundle_.getActivationsSize() != 0) {
+    buffers.activations = (uint8_t *)alignedAlloc(
+        runtimeBundle_.getActivationsSize(), TensorAlignment);
+  }
+  if (runtimeBundle_.getMutableWeightSize() != 0) {
+    buffers.mutableWeights = (uint8_t *)alignedAlloc(
+        runtimeBundle_.getMutableWeightSize(), TensorAlignment);
+  }
+  // By default every Placeholder lives in the mutable weights block.
+  buffers.placeholderAddrs.resize(placeholderSlots_.size());
+  for (size_t i = 0, e = placeholderSlots_.size(); i < e; i++) {
+    buffers.placeholderAddrs[i] =
+        buffers.mutableWeights + placeholderSlots_[i].offset;
+  }
+  Stats()->incrementCounter(kBufferPoolMisses);
+  Stats()->incrementCounter(kBufferPoolBytes,
+                            runtimeBundle_.getActivationsSize() +
+                                runtimeBundle_.getMutableWeightSize());
+  return buffers;
+}
+
+void LLVMCompiledFunction::releaseBuffers(ExecutionBuffers buffers) {
+  std::lock_guard<std::mutex> lock(bufferPoolLock_);
+  bufferPool_.push_back(std::move(buffers));
+}
 
 void LLVMCompiledFunction::collectConstants(const Module *module) {
   runtimeBundle_.collectConstants(module);
 }
 
-void LLVMCompiledFunction::loadPlaceholders(
-    PlaceholderBindings *bindings, uint8_t *baseMutableWeightVarsAddress) {
-  // Copy Placeholders into allocated memory.
+void LLVMCompiledFunction::resolvePlaceholders(const Module *module) {
   auto &symbolTable = runtimeBundle_.getSymbolTable();
+  for (const auto *PH : module->getPlaceholders()) {
+    auto it = symbolTable.find(PH->getName());
+    if (it == symbolTable.end() ||
+        it->second.symbolCategory != runtime::SymbolCategory::Placeholder) {
+      continue;
+    }
+    placeholderIndices_[PH] = it->second.index;
+  }
+  placeholdersResolved_ = true;
+}
+
+bool LLVMCompiledFunction::getPlaceholderIndex(const Placeholder *PH,
+                                               size_t &index) const {
+  if (placeholdersResolved_) {
+    // The Placeholder resolved at this address may have been freed and its
+    // memory reused by another one, hence the check of the name.
+    auto it = placeholderIndices_.find(PH);
+    if (it != placeholderIndices_.end() &&
+        placeholderSlots_[it->second].name == PH->getName()) {
+      index = it->second;
+      return true;
+    }
+  }
+  // Placeholders of another Module are matched to the compiled ones by name.
+  auto &symbolTable = runtimeBundle_.getSymbolTable();
+  auto it = symbolTable.find(PH->getName());
+  if (it == symbolTable.end() ||
+      it->second.symbolCategory != runtime::SymbolCategory::Placeholder) {
+    return false;
+  }
+  index = it->second.index;
+  return true;
+}
+
+/// \returns true if the payload of \p T can be used in place as the storage of
+/// a Placeholder of \p size bytes.
+static bool canBindInPlace(const Tensor *T, size_t size) {
+  return T->getSizeInBytes() == size && T->getUnpaddedSizeInBytes() == size &&
+         (size_t)T->getUnsafePtr() % TensorAlignment == 0;
+}
+
+void LLVMCompiledFunction::loadPlaceholders(PlaceholderBindings *bindings,
+                                            ExecutionBuffers &buffers) {
+  // Point the address table at the bound tensors. Tensors which cannot be used
+  // in place are copied into the mutable weights block.
   for (auto PH : bindings->pairs()) {
-    auto it = symbolTable.find(PH.first->getName());
-    if (it == symbolTable.end()) {
+    size_t index;
+    if (!getPlaceholderIndex(PH.first, index)) {
       continue;
     }
-    auto symbolInfo = it->second;
+    const auto &slot = placeholderSlots_[index];
     auto payload = PH.second->getUnsafePtr();
-    auto addr = symbolInfo.offset;
+    if (canBindInPlace(PH.second, slot.size)) {
+      buffers.placeholderAddrs[index] = (uint8_t *)payload;
+      continue;
+    }
     auto numBytes = PH.second->getUnpaddedSizeInBytes();
     // copy PH to allocated memory.
-    memcpy(baseMutableWeightVarsAddress + addr, payload, numBytes);
+    memcpy(buffers.mutableWeights + slot.offset, payload, numBytes);
   }
 }
 
-void LLVMCompiledFunction::updatePlaceholders(
-    PlaceholderBindings *bindings, uint8_t *baseMutableWeightVarsAddress) {
-  // Copy placeholders from device back into bindings.
-  auto &symbolTable = runtimeBundle_.getSymbolTable();
+void LLVMCompiledFunction::updatePlaceholders(PlaceholderBindings *bindings,
+                                              ExecutionBuffers &buffers) {
+  // Copy placeholders that were not bound in place from device back into
+  // bindings, and reset the address table for the next run.
   for (auto PH : bindings->pairs()) {
-    auto it = symbolTable.find(PH.first->getName());
-    if (it == symbolTable.end()) {
+    size_t index;
+    if (!getPlaceholderIndex(PH.first, index)) {
+      continue;
+    }
+    auto payload = buffers.mutableWeights + placeholderSlots_[index].offset;
+    auto &slot = buffers.placeholderAddrs[index];
+    if (slot != payload) {
+      slot = payload;
       continue;
     }
-    auto symbolInfo = it->second;
-    auto payload = baseMutableWeightVarsAddress + symbolInfo.offset;
     auto numBytes = PH.second->getUnpaddedSizeInBytes();
     auto addr = PH.second->getUnsafePtr();
     // copy PH from allocated memory.
@@ -67,59 +188,41 @@ void LLVMCompiledFunction::updatePlaceholders(
 }
 
 llvm::Error LLVMCompiledFunction::execute(ExecutionContext *context) {
-  uint8_t *baseActivationsAddress{nullptr};
-
-  /// Base address for Mutable weights memory block, Inputs and Outputs.
-  uint8_t *baseMutableWeightVarsAddress{nullptr};
+  auto *traceContext = context->getTraceContext();
+  if (!jitmain_) {
+    RETURN_ERR("Error getting address");
+  }
 
+  ExecutionBuffers buffers;
   {
     TRACE_EVENT_SCOPE(context, TraceLevel::RUNTIME, "allocBuffers");
-    if (runtimeBundle_.getActivationsSize() != 0) {
-      baseActivationsAddress = (uint8_t *)alignedAlloc(
-          runtimeBundle_.getActivationsSize(), TensorAlignment);
-    }
-
-    if (runtimeBundle_.getMutableWeightSize() != 0) {
-      baseMutableWeightVarsAddress = (uint8_t *)alignedAlloc(
-          runtimeBundle_.getMutableWeightSize(), TensorAlignment);
-    }
+    buffers = acquireBuffers();
   }
 
+  auto loadStart = std::chrono::steady_clock::now();
   {
     TRACE_EVENT_SCOPE(context, TraceLevel::RUNTIME, "loadPlaceholders");
-    loadPlaceholders(context->getPlaceholderBindings(),
-                     baseMutableWeightVarsAddress);
+    loadPlaceholders(context->getPlaceholderBindings(), buffers);
   }
+  auto loadTime = std::chrono::steady_clock::now() - loadStart;
 
-  auto *traceContext = context->getTraceContext();
-  TRACE_EVENT_SCOPE_NAMED(traceContext, TraceLevel::RUNTIME,
-                          "findJitmainSymbol", fjEvent);
-  auto sym = JIT_->findSymbol("jitmain");
-  DCHECK(sym) << "Unable to JIT the code!";
-  using JitFuncType =
-      void (*)(uint8_t * constantWeightVars, uint8_t * mutableWeightVars,
-               uint8_t * activations);
-  auto address = sym.getAddress();
-  if (address) {
-    JitFuncType funcPtr = reinterpret_cast<JitFuncType>(address.get());
-    TRACE_EVENT_SCOPE_END_NAMED(fjEvent);
+  {
     TRACE_EVENT_SCOPE(traceContext, TraceLevel::RUNTIME, "execute");
-    funcPtr(runtimeBundle_.getConstants(), baseMutableWeightVarsAddress,
-            baseActivationsAddress);
-  } else {
-    RETURN_ERR("Error getting address");
+    jitmain_(runtimeBundle_.getConstants(), buffers.placeholderAddrs.data(),
+             buffers.activations);
   }
 
+  auto updateStart = std::chrono::steady_clock::now();
   {
     TRACE_EVENT_SCOPE(context, TraceLevel::RUNTIME, "updatePlaceholders");
-    updatePlaceholders(context->getPlaceholderBindings(),
-                       baseMutableWeightVarsAddress);
+    updatePlaceholders(context->getPlaceholderBindings(), buffers);
   }
+  context->setCopyTimes(loadTime,
+                        std::chrono::steady_clock::now() - updateStart);
 
   {
     TRACE_EVENT_SCOPE(context, TraceLevel::RUNTIME, "freeBuffers");
-    alignedFree(baseMutableWeightVarsAddress);
-    alignedFree(baseActivationsAddress);
+    releaseBuffers(std::move(buffers));
   }
 
   {
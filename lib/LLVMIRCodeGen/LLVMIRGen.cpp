@@ -19,6 +19,7 @@
 #include "CommandLine.h"
 #include "glow/LLVMIRCodeGen/AllocationsInfo.h"
 #include "glow/LLVMIRCodeGen/LLVMBackend.h"
+#include "glow/LLVMIRCodeGen/ParallelSchedule.h"
 
 #include "glow/Graph/Graph.h"
 #include "glow/IR/IRUtils.h"
@@ -103,7 +104,7 @@ LLVMIRGen::LLVMIRGen(const IRFunction *F, AllocationsInfo &allocationsInfo,
     : F_(F), allocationsInfo_(allocationsInfo), mainEntryName_(mainEntryName),
       libjitBC_(libjitBC) {}
 
-void LLVMIRGen::initTargetMachine(
+std::unique_ptr<llvm::TargetMachine> LLVMIRGen::createTargetMachine(
     llvm::StringRef target, llvm::StringRef arch, llvm::StringRef cpu,
     const llvm::SmallVectorImpl<std::string> &targetFeatures,
     llvm::CodeModel::Model codeModel) {
@@ -112,20 +113,29 @@ void LLVMIRGen::initTargetMachine(
   llvm::InitializeAllAsmPrinters();
   llvm::InitializeAllAsmParsers();
 
+  std::unique_ptr<llvm::TargetMachine> TM;
   if (target.empty()) {
-    TM_.reset(llvm::EngineBuilder()
-                  .setCodeModel(codeModel)
-                  .setRelocationModel(relocModel)
-                  .selectTarget(llvm::Triple(), arch, getHostCpuName(),
-                                getMachineAttributes()));
+    TM.reset(llvm::EngineBuilder()
+                 .setCodeModel(codeModel)
+                 .setRelocationModel(relocModel)
+                 .selectTarget(llvm::Triple(), arch, getHostCpuName(),
+                               getMachineAttributes()));
   } else {
-    TM_.reset(
+    TM.reset(
         llvm::EngineBuilder()
             .setCodeModel(codeModel)
             .setRelocationModel(relocModel)
             .selectTarget(llvm::Triple(target), arch, cpu, targetFeatures));
   }
-  assert(TM_ && "Could not initialize the target machine");
+  assert(TM && "Could not initialize the target machine");
+  return TM;
+}
+
+void LLVMIRGen::initTargetMachine(
+    llvm::StringRef target, llvm::StringRef arch, llvm::StringRef cpu,
+    const llvm::SmallVectorImpl<std::string> &targetFeatures,
+    llvm::CodeModel::Model codeModel) {
+  TM_ = createTargetMachine(target, arch, cpu, targetFeatures, codeModel);
 }
 
 llvm::StringRef LLVMIRGen::getBundleName() const { return bundleName_; }
@@ -190,6 +200,16 @@ void LLVMIRGen::initCodeGen() {
   llmodule_ = loadStandardLibrary(&ctx_, "libjit.bc", libjitBC_);
   CHECK(llmodule_.get()) << "Unable to load the JIT library.";
 
+  // Drop the serial fallback of the parallel runtime, the calls are then
+  // resolved against the host process when the module is JIT'ed.
+  if (useHostParallelRuntime_) {
+    for (auto name : {"libjit_parallel_num_threads", "libjit_parallel_for"}) {
+      if (auto *F = llmodule_->getFunction(name)) {
+        F->deleteBody();
+      }
+    }
+  }
+
   // By default, LLVM would emit some diagnostics, remarks, etc. It is fine for
   // a static compiler, but not necessary for a JIT. Let's disable it by
   // providing a dummy diagnostics handler, that does not emit anything.
@@ -257,7 +277,12 @@ void LLVMIRGen::performCodeGen() {
   auto *func = builder_->GetInsertBlock()->getParent();
   loadBaseAddresses(*builder_);
 
-  generateLLVMIRForModule(*builder_);
+  // Stage functions carry no debug scopes, debug builds stay sequential.
+  if (useInterOpParallelism_ && !emitDebugInfo) {
+    generateParallelLLVMIRForModule(*builder_);
+  } else {
+    generateLLVMIRForModule(*builder_);
+  }
 
   // Terminate the function.
   builder_->CreateRetVoid();
@@ -356,6 +381,27 @@ llvm::Value *LLVMIRGen::emitValueAddress(llvm::IRBuilder<> &builder,
   assert(allocationsInfo_.valueNumbers_.count(val));
   auto &kindAndValue = allocationsInfo_.valueNumbers_[val];
 
+  // When Placeholders are bound through an address table, load the base
+  // address of the Placeholder backing this value from its slot and add the
+  // offset of the value inside of it (non-zero for tensor views).
+  if (usePlaceholderAddressTable_ &&
+      kindAndValue.first == AllocationsInfo::ValueKind::MutableWeight) {
+    auto *origin = getOrigin(val);
+    assert(allocationsInfo_.placeholderSlots_.count(origin) &&
+           "Placeholder slot was not allocated");
+    auto slotIdx = llvm::ConstantInt::get(
+        sizeTTy, allocationsInfo_.placeholderSlots_.lookup(origin));
+    auto *table = builder.CreateIntToPtr(baseMutableWeightVarsAddr_,
+                                         sizeTTy->getPointerTo());
+    auto slotAddr = builder.CreateGEP(sizeTTy, table, slotIdx);
+    auto baseAddr = builder.CreateLoad(sizeTTy, slotAddr);
+    auto offsetValue = llvm::ConstantInt::get(
+        sizeTTy, allocationsInfo_.allocatedAddress_.lookup(val) -
+                     allocationsInfo_.allocatedAddress_.lookup(origin));
+    llvm::Value *addr = builder.CreateAdd(baseAddr, offsetValue);
+    return builder.CreateIntToPtr(addr, T);
+  }
+
   // Get the required base address.
   llvm::Value *baseAddrValue = nullptr;
   switch (kindAndValue.first) {
@@ -792,6 +838,41 @@ static bool isOverlappingWithAnyBundleBufferOperands(
   return false;
 }
 
+/// \returns true if the data parallel instruction \p I can be appended to the
+/// data-parallel kernel \p bundle.
+static bool
+isBundleCompatible(AllocationsInfo &allocationsInfo,
+                   llvm::SmallVectorImpl<const Instruction *> &bundle,
+                   const Instruction *I) {
+  // Check if the current instruction is shape compatible with the bundle.
+  if (!bundle.empty()) {
+    auto val = I->getOperand(0).first;
+    auto bundleVal = bundle.back()->getOperand(0).first;
+    // Check if shapes have the same amount of elements.
+    if (val->size() != bundleVal->size()) {
+      return false;
+    }
+  }
+
+  // Check all mutated operands of the current instruction. Their memory
+  // regions should not have a non-exact overlap with any operands of the
+  // bundled instructions. In case this condition does not hold, the current
+  // instruction cannot be included into the data-parallel bundle, because
+  // overlapping operand buffers are not data parallel.
+  for (auto op : I->getOperands()) {
+    // Skip non-mutated operands.
+    if (op.second == OperandKind::In)
+      continue;
+    // If the mutated operand buffer overlaps with any buffer already used by
+    // the bundle, the current instruction cannot become a part of the bundle.
+    if (isOverlappingWithAnyBundleBufferOperands(allocationsInfo, bundle,
+                                                 op.first)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void LLVMIRGen::generateLLVMIRForModule(llvm::IRBuilder<> &builder) {
   // Go over the instructions and try to group them into bundles.
   auto &instrs = F_->getInstrs();
@@ -816,36 +897,9 @@ void LLVMIRGen::generateLLVMIRForModule(llvm::IRBuilder<> &builder) {
 
     // This is a data parallel instruction.
 
-    // Check if the current instruction is shape compatible with the bundle.
-    bool isBundleCompatible = true;
-    if (!bundle.empty()) {
-      auto val = I.getOperand(0).first;
-      auto bundleVal = bundle.back()->getOperand(0).first;
-      // Check if shapes have the same amount of elements.
-      isBundleCompatible = val->size() == bundleVal->size();
-    }
-
-    // Check all mutated operands of the current instruction. Their memory
-    // regions should not have a non-exact overlap with any operands of the
-    // bundled instructions. In case this condition does not hold, the current
-    // instruction cannot be included into the data-parallel bundle, because
-    // overlapping operand buffers are not data parallel.
-    for (auto op : I.getOperands()) {
-      // Skip non-mutated operands.
-      if (op.second == OperandKind::In)
-        continue;
-      // If the mutated operand buffer overlaps with any buffer already used by
-      // the bundle, the current instruction cannot become a part of the bundle.
-      if (isOverlappingWithAnyBundleBufferOperands(allocationsInfo_, bundle,
-                                                   op.first)) {
-        isBundleCompatible = false;
-        break;
-      }
-    }
-
     // If the instruction cannot be added to the current bundle, emit the kernel
     // for the current bundle and start a new bundle.
-    if (!isBundleCompatible) {
+    if (!isBundleCompatible(allocationsInfo_, bundle, &I)) {
       emitDataParallelKernel(builder, bundle);
       bundle.clear();
     }
@@ -856,6 +910,135 @@ void LLVMIRGen::generateLLVMIRForModule(llvm::IRBuilder<> &builder) {
   emitDataParallelKernel(builder, bundle);
 }
 
+void LLVMIRGen::generateParallelLLVMIRForModule(llvm::IRBuilder<> &builder) {
+  ParallelSchedule schedule(*F_);
+
+  // Data parallel instructions are cheap, keep bundling them on the calling
+  // thread. The other instructions of a stage run concurrently once the
+  // pending bundle has been flushed.
+  llvm::SmallVector<const Instruction *, 32> bundle;
+  for (const auto &stage : schedule.getStages()) {
+    llvm::SmallVector<const Instruction *, 8> tasks;
+    for (const auto *I : stage) {
+      if (!canBePartOfDataParallelKernel(I)) {
+        tasks.push_back(I);
+        continue;
+      }
+      if (!isBundleCompatible(allocationsInfo_, bundle, I)) {
+        emitDataParallelKernel(builder, bundle);
+        bundle.clear();
+      }
+      bundle.push_back(I);
+    }
+    if (tasks.empty()) {
+      continue;
+    }
+    emitDataParallelKernel(builder, bundle);
+    bundle.clear();
+    if (tasks.size() == 1) {
+      generateLLVMIRForInstr(builder, tasks.front());
+    } else {
+      emitParallelStage(builder, tasks);
+    }
+  }
+
+  emitDataParallelKernel(builder, bundle);
+}
+
+void LLVMIRGen::emitParallelStage(llvm::IRBuilder<> &builder,
+                                  llvm::ArrayRef<const Instruction *> stage) {
+  auto *parallelFor = getFunction("parallel_for");
+  auto *taskTy = llvm::cast<llvm::FunctionType>(
+      parallelFor->getFunctionType()->getParamType(1)->getPointerElementType());
+  auto *int8PtrTy = llvm::Type::getInt8PtrTy(ctx_);
+  auto *sizeTTy = builder.getIntNTy(getLibjitSizeTWidth());
+  auto *sizeTPtrTy = sizeTTy->getPointerTo();
+
+  // The task gets the base addresses of the entry function through its
+  // context, in the order of the entry function parameters.
+  auto *ctxTy = llvm::ArrayType::get(int8PtrTy, 4);
+  auto &mainEntryBB = builder.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> allocaBuilder(&mainEntryBB, mainEntryBB.begin());
+  llvm::Value *ctxAddr = allocaBuilder.CreateAlloca(ctxTy);
+  llvm::Value *bases[] = {baseConstantWeightVarsAddr_,
+                          baseMutableWeightVarsAddr_, baseActivationsAddr_};
+  for (unsigned i = 0; i < 3; i++) {
+    builder.CreateStore(builder.CreateIntToPtr(bases[i], int8PtrTy),
+                        builder.CreateConstGEP2_32(ctxTy, ctxAddr, 0, i));
+  }
+  builder.CreateStore(builder.CreateBitCast(offsetsArray_, int8PtrTy),
+                      builder.CreateConstGEP2_32(ctxTy, ctxAddr, 0, 3));
+
+  auto *taskFunc =
+      llvm::Function::Create(taskTy, llvm::Function::InternalLinkage,
+                             "libjit_stage", llmodule_.get());
+  auto argIt = taskFunc->arg_begin();
+  llvm::Value *taskCtx = &*argIt++;
+  llvm::Value *begin = &*argIt++;
+  llvm::Value *end = &*argIt;
+
+  // Generate the instructions against the base addresses loaded from the
+  // context. The addresses of the entry function are restored afterwards.
+  auto *entryBB = llvm::BasicBlock::Create(ctx_, "entry", taskFunc);
+  llvm::IRBuilder<> taskBuilder(entryBB);
+  llvm::Value *taskBases =
+      taskBuilder.CreateBitCast(taskCtx, ctxTy->getPointerTo());
+  auto loadBase = [&](unsigned i) {
+    return taskBuilder.CreateLoad(
+        int8PtrTy, taskBuilder.CreateConstGEP2_32(ctxTy, taskBases, 0, i));
+  };
+  auto *savedConstantWeightVarsAddr = baseConstantWeightVarsAddr_;
+  auto *savedMutableWeightVarsAddr = baseMutableWeightVarsAddr_;
+  auto *savedActivationsAddr = baseActivationsAddr_;
+  auto *savedOffsetsArray = offsetsArray_;
+  baseConstantWeightVarsAddr_ =
+      taskBuilder.CreatePtrToInt(loadBase(0), sizeTTy);
+  baseMutableWeightVarsAddr_ =
+      taskBuilder.CreatePtrToInt(loadBase(1), sizeTTy);
+  baseActivationsAddr_ = taskBuilder.CreatePtrToInt(loadBase(2), sizeTTy);
+  offsetsArray_ = taskBuilder.CreateBitCast(loadBase(3), sizeTPtrTy);
+
+  // for (i = begin; i < end; i++) switch (i) { case k: <stage[k]> }
+  auto *headerBB = llvm::BasicBlock::Create(ctx_, "header", taskFunc);
+  auto *dispatchBB = llvm::BasicBlock::Create(ctx_, "dispatch", taskFunc);
+  auto *latchBB = llvm::BasicBlock::Create(ctx_, "latch", taskFunc);
+  auto *exitBB = llvm::BasicBlock::Create(ctx_, "exit", taskFunc);
+  taskBuilder.CreateBr(headerBB);
+
+  taskBuilder.SetInsertPoint(headerBB);
+  auto *idx = taskBuilder.CreatePHI(sizeTTy, 2);
+  idx->addIncoming(begin, entryBB);
+  taskBuilder.CreateCondBr(taskBuilder.CreateICmpULT(idx, end), dispatchBB,
+                           exitBB);
+
+  taskBuilder.SetInsertPoint(dispatchBB);
+  auto *dispatch = taskBuilder.CreateSwitch(idx, latchBB, stage.size());
+  for (size_t i = 0, e = stage.size(); i < e; i++) {
+    auto *caseBB = llvm::BasicBlock::Create(ctx_, "task", taskFunc, latchBB);
+    dispatch->addCase(llvm::ConstantInt::get(sizeTTy, i), caseBB);
+    taskBuilder.SetInsertPoint(caseBB);
+    generateLLVMIRForInstr(taskBuilder, stage[i]);
+    taskBuilder.CreateBr(latchBB);
+  }
+
+  taskBuilder.SetInsertPoint(latchBB);
+  auto *next = taskBuilder.CreateAdd(idx, llvm::ConstantInt::get(sizeTTy, 1));
+  idx->addIncoming(next, latchBB);
+  taskBuilder.CreateBr(headerBB);
+
+  taskBuilder.SetInsertPoint(exitBB);
+  taskBuilder.CreateRetVoid();
+
+  baseConstantWeightVarsAddr_ = savedConstantWeightVarsAddr;
+  baseMutableWeightVarsAddr_ = savedMutableWeightVarsAddr;
+  baseActivationsAddr_ = savedActivationsAddr;
+  offsetsArray_ = savedOffsetsArray;
+
+  auto *numTasks = llvm::ConstantInt::get(sizeTTy, stage.size());
+  createCall(builder, parallelFor,
+             {numTasks, taskFunc, builder.CreateBitCast(ctxAddr, int8PtrTy)});
+}
+
 void LLVMIRGen::generateLLVMIRForDataParallelInstr(
     llvm::IRBuilder<> &builder, const glow::Instruction *I,
     llvm::Function *kernel, llvm::DenseMap<Value *, int> &bufferToArgNum,
@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "glow/LLVMIRCodeGen/ParallelSchedule.h"
+#include "glow/IR/IR.h"
+#include "glow/IR/IRUtils.h"
+#include "glow/IR/Instrs.h"
+
+using namespace glow;
+using llvm::cast;
+using llvm::dyn_cast;
+using llvm::isa;
+
+/// \returns true if \p I only manages memory and does not run any code.
+static bool isMemoryInstr(const Instruction *I) {
+  return isa<AllocActivationInst>(I) || isa<DeallocActivationInst>(I) ||
+         isa<TensorViewInst>(I);
+}
+
+/// \returns true if \p I has side effects beyond its operands, such that it
+/// must stay ordered with respect to all other instructions.
+static bool isBarrier(const Instruction *I) {
+  return isa<TraceEventInst>(I) || isa<DebugPrintInst>(I);
+}
+
+ParallelSchedule::ParallelSchedule(const IRFunction &F) {
+  // Stage of the last instruction writing each buffer.
+  llvm::DenseMap<const Value *, size_t> lastWrite;
+  // Latest stage of the instructions reading each buffer since the last write.
+  llvm::DenseMap<const Value *, size_t> lastRead;
+  // Stages of the first and last instructions using each activation.
+  llvm::DenseMap<const Value *, std::pair<size_t, size_t>> liveStages;
+  // No instruction may be scheduled before this stage.
+  size_t minStage = 0;
+
+  for (const auto &I : F.getInstrs()) {
+    if (isMemoryInstr(&I)) {
+      continue;
+    }
+
+    // Place the instruction right after the last stage it depends on. Any
+    // access must follow the last write, writes must also follow the reads.
+    size_t stage = isBarrier(&I) ? stages_.size() : minStage;
+    for (const auto &op : I.getOperands()) {
+      auto *origin = getOrigin(op.first);
+      auto writeIt = lastWrite.find(origin);
+      if (writeIt != lastWrite.end()) {
+        stage = std::max(stage, writeIt->second + 1);
+      }
+      auto readIt = lastRead.find(origin);
+      if (op.second != OperandKind::In && readIt != lastRead.end()) {
+        stage = std::max(stage, readIt->second + 1);
+      }
+    }
+    if (isBarrier(&I)) {
+      minStage = stage + 1;
+    }
+
+    if (stage >= stages_.size()) {
+      stages_.resize(stage + 1);
+    }
+    stages_[stage].push_back(&I);
+
+    for (const auto &op : I.getOperands()) {
+      auto *origin = getOrigin(op.first);
+      if (op.second != OperandKind::In) {
+        lastWrite[origin] = stage;
+        lastRead.erase(origin);
+      } else {
+        auto &read = lastRead[origin];
+        read = std::max(read, stage);
+      }
+      if (isa<AllocActivationInst>(origin)) {
+        auto it = liveStages.insert({origin, {stage, stage}}).first;
+        it->second.first = std::min(it->second.first, stage);
+        it->second.second = std::max(it->second.second, stage);
+      }
+    }
+  }
+
+  // Allocate activations in the stage of their first use and tensor views
+  // along with their origin. Deallocate activations after their last use.
+  for (const auto &I : F.getInstrs()) {
+    if (!isMemoryInstr(&I)) {
+      continue;
+    }
+    const Value *origin = &I;
+    if (auto *TVI = dyn_cast<TensorViewInst>(&I)) {
+      origin = getOrigin(TVI);
+    } else if (auto *DAI = dyn_cast<DeallocActivationInst>(&I)) {
+      origin = DAI->getAlloc();
+    }
+    auto it = liveStages.find(origin);
+    if (it == liveStages.end()) {
+      memoryInstrStages_[&I] = 0;
+    } else if (isa<DeallocActivationInst>(&I)) {
+      memoryInstrStages_[&I] = it->second.second;
+    } else {
+      memoryInstrStages_[&I] = it->second.first;
+    }
+  }
+}
+
+void ParallelSchedule::reorder(IRFunction *F) {
+  ParallelSchedule schedule(*F);
+  size_t numStages = std::max<size_t>(schedule.stages_.size(), 1);
+  std::vector<std::vector<Instruction *>> allocs(numStages);
+  std::vector<std::vector<Instruction *>> deallocs(numStages);
+  for (auto &I : F->getInstrs()) {
+    if (!isMemoryInstr(&I)) {
+      continue;
+    }
+    size_t stage = schedule.memoryInstrStages_[&I];
+    // Tensor views follow the allocations in program order, so the view of an
+    // allocation hoisted to the same stage is still placed after it.
+    if (isa<DeallocActivationInst>(&I)) {
+      deallocs[stage].push_back(&I);
+    } else {
+      allocs[stage].push_back(&I);
+    }
+  }
+
+  // Take all of the instructions out of the function and put them back stage
+  // by stage.
+  std::vector<Instruction *> order;
+  for (size_t stage = 0; stage < numStages; stage++) {
+    order.insert(order.end(), allocs[stage].begin(), allocs[stage].end());
+    if (stage < schedule.stages_.size()) {
+      for (auto *I : schedule.stages_[stage]) {
+        order.push_back(const_cast<Instruction *>(I));
+      }
+    }
+    order.insert(order.end(), deallocs[stage].begin(), deallocs[stage].end());
+  }
+  assert(order.size() == F->getInstrs().size() &&
+         "Every instruction must be scheduled");
+  for (auto *I : order) {
+    F->removeInstruction(I);
+    F->insertInstruction(I);
+  }
+}
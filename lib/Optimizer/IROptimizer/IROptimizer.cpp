@@ -35,22 +35,24 @@
 
 #define DEBUG_TYPE "ir-optimizer"
 
-namespace {
-static llvm::cl::opt<bool>
+/// Options changing the optimized IR, which the LLVM backends hash in the key
+/// of their compile cache.
+llvm::cl::opt<bool>
     instrumentDebug("instrument-debug",
                     llvm::cl::desc("Instrument the IR for debugging"),
                     llvm::cl::init(false), llvm::cl::Hidden);
 
-static llvm::cl::list<std::string> instrumentDebugOnly(
+llvm::cl::list<std::string> instrumentDebugOnly(
     "instrument-debug-only",
     llvm::cl::desc(
         "Instrument the IR for debugging, but only the listed instructions"),
     llvm::cl::CommaSeparated, llvm::cl::Hidden);
 
-static llvm::cl::opt<bool> optimizeIR("optimize-ir",
-                                      llvm::cl::desc("Enable IR optimizations"),
-                                      llvm::cl::init(true), llvm::cl::Hidden);
+llvm::cl::opt<bool> optimizeIR("optimize-ir",
+                               llvm::cl::desc("Enable IR optimizations"),
+                               llvm::cl::init(true), llvm::cl::Hidden);
 
+namespace {
 static llvm::cl::opt<bool> dumpIR("dump-ir",
                                   llvm::cl::desc("Prints IR to stdout"));
 } // namespace
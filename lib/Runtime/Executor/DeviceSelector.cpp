@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "glow/Runtime/Executor/DeviceSelector.h"
+
+#include <glog/logging.h>
+
+#include <limits>
+#include <random>
+
+using namespace glow;
+using namespace glow::runtime;
+
+namespace {
+/// Weight of the previous average in the latency moving average, out of 8.
+constexpr uint64_t kLatencyHistoryWeight = 7;
+} // namespace
+
+void DeviceLatencies::record(size_t index, std::chrono::nanoseconds latency) {
+  // Concurrent updates may drop a sample, which only slows the average down.
+  uint64_t sample = latency.count();
+  uint64_t previous = latencyNs_[index].load();
+  latencyNs_[index] =
+      previous == 0
+          ? sample
+          : (previous * kLatencyHistoryWeight + sample) /
+                (kLatencyHistoryWeight + 1);
+}
+
+DeviceManager *DeviceSelector::getDevice(DeviceIDTy id) const {
+  auto it = deviceManagers_.find(id);
+  return it == deviceManagers_.end() ? nullptr : it->second.get();
+}
+
+unsigned DeviceSelector::getInflight(DeviceIDTy id) const {
+  auto *device = getDevice(id);
+  return device ? device->getNumInflightRuns() : 0;
+}
+
+size_t DeviceSelector::acquire(DAGNode *node,
+                               const DeviceLatencies &latencies) {
+  const auto &devices = node->deviceIDs;
+  DCHECK(!devices.empty()) << "Node " << node->name << " has no device";
+  DCHECK_EQ(latencies.size(), devices.size());
+
+  size_t index = 0;
+  if (devices.size() == 1) {
+    index = 0;
+  } else if (policy_ == DeviceSelectionPolicy::RoundRobin) {
+    index = (node->currentDeviceIdx.fetch_add(1) + 1) % devices.size();
+  } else if (policy_ == DeviceSelectionPolicy::PowerOfTwoChoices) {
+    static thread_local std::minstd_rand rng(std::random_device{}());
+    size_t first = rng() % devices.size();
+    size_t second = (first + 1 + rng() % (devices.size() - 1)) % devices.size();
+    index = getInflight(devices[second]) < getInflight(devices[first])
+                ? second
+                : first;
+  } else {
+    // Until every device finished a run, compare the runs in flight only.
+    bool measured = policy_ == DeviceSelectionPolicy::LatencyWeighted;
+    for (size_t i = 0, e = devices.size(); measured && i < e; i++) {
+      measured = latencies.get(i) != 0;
+    }
+    // Scan from a rotating start so that the ties are spread round-robin.
+    size_t start = node->currentDeviceIdx.fetch_add(1);
+    uint64_t bestCost = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0, e = devices.size(); i < e; i++) {
+      size_t candidate = (start + i) % e;
+      uint64_t inflight = getInflight(devices[candidate]);
+      // The latencies only count the execution of a run, so the runs in flight
+      // and the new one each add one latency to the time the new one ends.
+      uint64_t cost =
+          measured ? (inflight + 1) * latencies.get(candidate) : inflight;
+      if (cost < bestCost) {
+        index = candidate;
+        bestCost = cost;
+      }
+    }
+  }
+
+  if (auto *device = getDevice(devices[index])) {
+    device->addInflightRun();
+  }
+  return index;
+}
+
+void DeviceSelector::release(const DAGNode *node, size_t index,
+                             DeviceLatencies &latencies,
+                             std::chrono::nanoseconds executionTime) {
+  if (auto *device = getDevice(node->deviceIDs[index])) {
+    DCHECK_GT(device->getNumInflightRuns(), 0)
+        << "Device " << node->deviceIDs[index] << " has no run";
+    device->removeInflightRun();
+  }
+  if (executionTime.count() > 0) {
+    latencies.record(index, executionTime);
+  }
+}
@@ -17,6 +17,7 @@
 #include "glow/Runtime/Executor/ThreadPoolExecutor.h"
 #include "glow/Backends/DeviceManager.h"
 #include "glow/ExecutionContext/ExecutionContext.h"
+#include "glow/Runtime/StatsExporter.h"
 
 #include <queue>
 #include <unordered_set>
@@ -56,101 +57,250 @@ void InflightBarrier::wait() {
   cv_.wait(lock, [&] { return count_ == 0; });
 }
 
-ExecutionState::ExecutionState(RunIdentifierTy id, const DAGNode *root,
-                               ThreadExecutor *executor,
-                               std::unique_ptr<ExecutionContext> resultContext,
-                               ResultCBTy doneCb)
-    : runId_(id), cb_(doneCb), resultCtx_(std::move(resultContext)),
-      inflightNodes_(0), module_(root->module), root_(root),
-      executor_(executor) {
-  DCHECK(cb_ != nullptr);
+ExecutionPlan::ExecutionPlan(const DAGNode *root)
+    : module_(root->module),
+      poolBuffersKey_("glow.executor.tensorpool." + root->name + ".buffers"),
+      poolAllocsKey_("glow.executor.tensorpool." + root->name + ".allocs"),
+      poolInlineAllocsKey_("glow.executor.tensorpool." + root->name +
+                           ".inline_allocs") {
+  // The histograms are released with the plan, see releaseHistograms().
+  auto getHistogram = [this](std::string key) {
+    histogramKeys_.push_back(std::move(key));
+    return Stats()->getHistogram(histogramKeys_.back());
+  };
+  dispatchTime_ = getHistogram("glow.executor." + root->name + ".dispatch_us");
+
+  // Number the nodes in breadth-first order.
+  std::unordered_map<const DAGNode *, unsigned> numbers;
+  std::unordered_set<Placeholder *> inputs;
+  std::unordered_set<Placeholder *> outputs;
+  std::queue<DAGNode *> bfsQueue;
+  auto visit = [&](DAGNode *node) {
+    auto it = numbers.find(node);
+    if (it != numbers.end()) {
+      return it->second;
+    }
+    unsigned number = nodes_.size();
+    numbers[node] = number;
+    std::string prefix = "glow.executor." + root->name + "." + node->name;
+    nodes_.push_back(
+        {node, unsigned(node->parents.size()), {}, {},
+         llvm::make_unique<DeviceLatencies>(node->deviceIDs.size()),
+         getHistogram(prefix + ".device_us"),
+         getHistogram(prefix + ".copy_in_us"),
+         getHistogram(prefix + ".copy_out_us")});
+    bfsQueue.push(node);
+    return number;
+  };
+
+  for (auto *node : root->children) {
+    rootNodes_.push_back(visit(node));
+  }
+
+  while (!bfsQueue.empty()) {
+    DAGNode *node = bfsQueue.front();
+    bfsQueue.pop();
+    unsigned number = numbers[node];
+
+    // Resolve the Placeholders of the symbol table once, the runs bind them.
+    const SymbolTableTy &symbolTable = node->runtimeBundle->getSymbolTable();
+    std::vector<Placeholder *> placeholders;
+    for (const auto &symbolPair : symbolTable) {
+      if (symbolPair.second.symbolCategory == SymbolCategory::Placeholder) {
+        auto *PH = module_->getPlaceholderByName(symbolPair.first);
+        DCHECK(PH) << "Placeholder: " << symbolPair.first
+                   << " is not in the module";
+        placeholders.push_back(PH);
+        if (symbolPair.second.input) {
+          inputs.insert(PH);
+        }
+        if (symbolPair.second.output) {
+          outputs.insert(PH);
+        }
+      }
+    }
+    nodes_[number].placeholders = std::move(placeholders);
+
+    for (auto *child : node->children) {
+      unsigned childNumber = visit(child);
+      nodes_[number].children.push_back(childNumber);
+    }
+  }
+
+  // The tensors output by a node and input of another one are passed between
+  // partitions, the callers usually do not bind them.
+  for (const auto &node : nodes_) {
+    for (auto *PH : node.placeholders) {
+      if (inputs.count(PH) && outputs.count(PH) &&
+          std::find(intermediates_.begin(), intermediates_.end(), PH) ==
+              intermediates_.end()) {
+        intermediates_.push_back(PH);
+      }
+    }
+  }
 }
 
-void ExecutionState::init() {
-  // Create a queue for the breadth-first traversal through the graph.
-  std::queue<const DAGNode *> bfsQueue;
+ExecutionPlan::~ExecutionPlan() = default;
 
-  // Place the root nodes in the queue.
-  for (const auto &node : root_->children) {
-    bfsQueue.push(node);
+void ExecutionPlan::releaseHistograms() {
+  for (const auto &key : histogramKeys_) {
+    Stats()->releaseHistogram(key);
   }
+  histogramKeys_.clear();
+}
 
-  auto *resultTraceContext = resultCtx_->getTraceContext();
+void ExecutionPlan::reserveIntermediates(size_t runs) {
+  for (auto *PH : intermediates_) {
+    intermediateTensorPool_.reserve(PH->getType(), runs);
+  }
+  exportStats();
+}
 
-  // Breadth-first search.
-  while (!bfsQueue.empty()) {
-    // Get the next node in the BFS queue.
-    const DAGNode *node = bfsQueue.front();
-    bfsQueue.pop();
+void ExecutionPlan::exportStats() {
+  const auto &stats = intermediateTensorPool_.getStats();
+  // The runs only change the statistics when the pool allocates tensors,
+  // which stops once it holds the tensors of the concurrent runs.
+  uint64_t allocs = stats.totalAllocs;
+  if (exportedAllocs_.load() == allocs) {
+    return;
+  }
+  exportedAllocs_ = allocs;
+  Stats()->setCounter(poolBuffersKey_, stats.currentBuffers);
+  Stats()->setCounter(poolAllocsKey_, stats.totalAllocs);
+  Stats()->setCounter(poolInlineAllocsKey_, stats.inlineAllocs);
+}
 
-    // Make a counter for the number of node parents done.
-    nodeParentsDone_[node] = 0;
+std::shared_ptr<ExecutionState> ExecutionPlan::acquireState() {
+  std::unique_ptr<ExecutionState> state;
+  {
+    std::lock_guard<std::mutex> lock(freeStatesLock_);
+    if (!freeStates_.empty()) {
+      state = std::move(freeStates_.back());
+      freeStates_.pop_back();
+    }
+  }
+  if (!state) {
+    state = llvm::make_unique<ExecutionState>(*this);
+  }
+
+  // The state returns to the pool when the last reference of the run is gone,
+  // the plan is kept alive until then.
+  auto plan = shared_from_this();
+  return std::shared_ptr<ExecutionState>(
+      state.release(), [plan](ExecutionState *state) {
+        state->reset();
+        std::lock_guard<std::mutex> lock(plan->freeStatesLock_);
+        plan->freeStates_.emplace_back(state);
+      });
+}
 
-    // Make an (empty) input context for the node.
-    auto nodeInputCtx = llvm::make_unique<ExecutionContext>();
+ExecutionState::ExecutionState(ExecutionPlan &plan)
+    : plan_(plan),
+      nodeParentsDone_(new std::atomic<unsigned>[plan.getNodes().size()]),
+      inputCtxs_(plan.getNodes().size()) {}
+
+void ExecutionState::init(RunIdentifierTy id,
+                          std::unique_ptr<ExecutionContext> resultContext,
+                          ResultCBTy doneCb) {
+  runId_ = id;
+  resultCtx_ = std::move(resultContext);
+  cb_ = std::move(doneCb);
+  DCHECK(cb_ != nullptr);
+  inflightNodes_ = 0;
 
-    if (resultTraceContext) {
-      nodeInputCtx->setTraceContext(
-          llvm::make_unique<TraceContext>(resultTraceContext->getTraceLevel()));
+  auto *resultTraceContext = resultCtx_->getTraceContext();
+  auto *resultBindings = resultCtx_->getPlaceholderBindings();
+  const auto &nodes = plan_.getNodes();
+  for (size_t i = 0, e = nodes.size(); i < e; i++) {
+    // Make a counter for the number of node parents done.
+    nodeParentsDone_[i] = 0;
+
+    // Reuse the input context of the node, scheduled like the run.
+    auto &nodeInputCtx = inputCtxs_[i];
+    if (!nodeInputCtx) {
+      nodeInputCtx = llvm::make_unique<ExecutionContext>();
+    }
+    nodeInputCtx->copySchedulingFrom(*resultCtx_);
+
+    // Reuse the TraceContext of the node, whose events were merged into the
+    // result of the previous run.
+    auto *nodeTraceContext = nodeInputCtx->getTraceContext();
+    if (!resultTraceContext) {
+      if (nodeTraceContext) {
+        nodeInputCtx->setTraceContext(nullptr);
+      }
+    } else if (!nodeTraceContext) {
+      nodeInputCtx->setTraceContext(llvm::make_unique<TraceContext>(
+          resultTraceContext->getTraceLevel()));
+    } else {
+      nodeTraceContext->getTraceEvents().clear();
+      nodeTraceContext->getThreadNames().clear();
+      nodeTraceContext->setTraceLevel(resultTraceContext->getTraceLevel());
     }
 
     auto nodeInputPhBindings = nodeInputCtx->getPlaceholderBindings();
 
-    // Get the symbol table for the node.
-    const SymbolTableTy &symbolTable = node->runtimeBundle->getSymbolTable();
-
     // Create Placeholders for the symbols of all intermediate nodes. These are
     // not in the ExecutionContext passed to Executor::run, so they must be
     // created by the Executor.
-    auto *resultBindings = resultCtx_->getPlaceholderBindings();
-    for (const auto &symbolPair : symbolTable) {
-      const auto &symbolName = symbolPair.first;
-      const auto &symbolInfo = symbolPair.second;
-
-      if (symbolInfo.symbolCategory == SymbolCategory::Placeholder) {
-        auto *PH = resultBindings->getPlaceholderByName(symbolName);
-        if (!PH) {
-          PH = module_->getPlaceholderByName(symbolName);
-          DCHECK(PH) << "Placeholder: " << symbolName
-                     << " is not in the module";
-
-          // allocate into the resultBindings because they have the longest
-          // lifetime.
-          resultBindings->insert(PH,
-                                 intermediateTensorPool_.get(PH->getType()));
-          intermediatePlaceholders_.push_back(PH);
-        }
-
-        nodeInputPhBindings->insert(
-            PH, resultBindings->get(PH)->getUnowned(PH->dims()));
+    for (auto *modulePH : nodes[i].placeholders) {
+      // The caller usually binds the Module's Placeholders, only fall back to
+      // a lookup by name otherwise.
+      Placeholder *PH = modulePH;
+      if (!resultBindings->count(PH)) {
+        PH = resultBindings->getPlaceholderByName(modulePH->getName());
+      }
+      if (!PH) {
+        PH = modulePH;
+        // allocate into the resultBindings because they have the longest
+        // lifetime.
+        resultBindings->insert(
+            PH, plan_.getIntermediateTensorPool().get(PH->getType()));
+        intermediatePlaceholders_.push_back(PH);
       }
-    }
-
-    // Insert the prepared ExecutionContext into the input contexts map.
-    inputCtxs_.insert(std::make_pair(node, std::move(nodeInputCtx)));
 
-    // Push all unvisited children onto the BFS queue.
-    for (const auto &child : node->children) {
-      // Use nodeParentsDone_ as a set of nodes that have been visited already
-      // to avoid visiting a node more than once.
-      if (!nodeParentsDone_.count(child)) {
-        bfsQueue.push(child);
+      // Bind the Module's Placeholder to the caller's tensor, so that the
+      // backends find it without a lookup by name. The unowned tensor of the
+      // previous run is pointed to it.
+      Tensor unowned = resultBindings->get(PH)->getUnowned(modulePH->dims());
+      if (Tensor *T = nodeInputPhBindings->get(modulePH)) {
+        *T = std::move(unowned);
+      } else {
+        nodeInputPhBindings->insert(modulePH, std::move(unowned));
       }
     }
   }
   initialized_ = true;
 }
 
-std::unique_ptr<ExecutionContext>
-ExecutionState::getUniqueNodeContextPtr(const DAGNode *node) {
-  // The input PlaceholderBindings for the node should have been created in the
-  // constructor.
-  auto ctxIt = inputCtxs_.find(node);
+void ExecutionState::reset() {
+  DCHECK(intermediatePlaceholders_.empty())
+      << "Intermediate placeholders should have been removed";
+  plan_.exportStats();
+  cb_ = nullptr;
+  resultCtx_.reset();
+  initialized_ = false;
+  // Drop the error of a run whose callback was not called.
+  llvm::consumeError(errContainer_.get());
+}
 
-  DCHECK(ctxIt != inputCtxs_.end())
-      << "Input bindings not found but should exist!";
+std::unique_ptr<ExecutionContext>
+ExecutionState::getUniqueNodeContextPtr(unsigned node) {
+  // The input PlaceholderBindings for the node should have been created in
+  // init().
+  DCHECK(inputCtxs_[node]) << "Input bindings not found but should exist!";
+  return std::move(inputCtxs_[node]);
+}
 
-  return std::move(ctxIt->second);
+void ExecutionState::recycleNodeContext(unsigned node,
+                                        std::unique_ptr<ExecutionContext> ctx) {
+  // The bindings and the TraceContext, still used by the caller, are reused by
+  // init().
+  ctx->setDeviceBindings(nullptr);
+  ctx->setCopyTimes(std::chrono::nanoseconds::zero(),
+                    std::chrono::nanoseconds::zero());
+  ctx->setExecutionTime(std::chrono::nanoseconds::zero());
+  inputCtxs_[node] = std::move(ctx);
 }
 
 void ExecutionState::incrementInflightNodes(unsigned increment) {
@@ -171,19 +321,12 @@ bool ExecutionState::decrementInflightNodes(unsigned decrement) {
   return (previousValue == decrement);
 }
 
-bool ExecutionState::incrementNodeParentsDone(const DAGNode *node,
+bool ExecutionState::incrementNodeParentsDone(unsigned node,
                                               unsigned increment) {
-  // Get the parents done counter for the node. It should have
-  // been created in the constructor.
-  auto it = nodeParentsDone_.find(node);
-
-  DCHECK(it != nodeParentsDone_.end())
-      << "Node parents done counter should exist but not found!";
-
   // fetch_add must be used here so that the function returns true to only
   // one caller.
-  unsigned numParents = (node->parents).size();
-  unsigned previousValue = (it->second).fetch_add(increment);
+  unsigned numParents = plan_.getNodes()[node].numParents;
+  unsigned previousValue = nodeParentsDone_[node].fetch_add(increment);
   unsigned newValue = previousValue + increment;
 
   // The new value of the counter cannot exceed the number of parents that
@@ -242,6 +385,7 @@ void ThreadPoolExecutor::run(const DAGNode *root,
 
   TRACE_EVENT_SCOPE(context->getTraceContext(), TraceLevel::RUNTIME,
                     "ThreadPoolExecutor::run");
+  auto readyTime = std::chrono::steady_clock::now();
 
   // Don't process new requests if the executor is shutting down.
   if (shuttingDown_) {
@@ -252,6 +396,15 @@ void ThreadPoolExecutor::run(const DAGNode *root,
     return;
   }
 
+  // Drop the request early if it can no longer complete in time.
+  if (context->isDeadlineExceeded()) {
+    cb(runId,
+       MAKE_ERR(GlowErr::ErrorCode::RUNTIME_DEADLINE_EXCEEDED,
+                "The deadline of the request passed before it ran"),
+       std::move(context));
+    return;
+  }
+
   // If list of roots is empty, there is nothing to do. Give back the
   // bindings so the caller can reuse it.
   if (!root) {
@@ -259,10 +412,9 @@ void ThreadPoolExecutor::run(const DAGNode *root,
     return;
   }
 
-  std::shared_ptr<ExecutionState> executionState =
-      std::make_shared<ExecutionState>(runId, root, threadPool_.getExecutor(),
-                                       std::move(context), std::move(cb));
-  executionState->init();
+  auto plan = getPlan(root);
+  std::shared_ptr<ExecutionState> executionState = plan->acquireState();
+  executionState->init(runId, std::move(context), std::move(cb));
 
   // Execute all child nodes of root.
 
@@ -270,41 +422,86 @@ void ThreadPoolExecutor::run(const DAGNode *root,
   // done here instead of inside executeDAGNode() so that a node can be
   // executed while placeholders are being propagated for the next node without
   // the callback for that node deleting the execution state.
-  auto numChildren = (root->children).size();
+  const auto &rootNodes = plan->getRootNodes();
+  auto numChildren = rootNodes.size();
   executionState->incrementInflightNodes(numChildren);
   inflightBarrier_.increment(numChildren);
 
-  for (auto const &node : root->children) {
+  for (auto node : rootNodes) {
     // Execute the node.
-    executeDAGNode(executionState, node);
+    executeDAGNode(executionState, node, readyTime);
   }
 }
 
+void ThreadPoolExecutor::prepare(const DAGNode *root, size_t concurrentRuns) {
+  getPlan(root)->reserveIntermediates(concurrentRuns);
+}
+
+void ThreadPoolExecutor::release(const DAGNode *root) {
+  std::shared_ptr<ExecutionPlan> plan;
+  {
+    std::lock_guard<std::shared_timed_mutex> lock(plansLock_);
+    auto it = plans_.find(root);
+    if (it == plans_.end()) {
+      return;
+    }
+    plan = std::move(it->second);
+    plans_.erase(it);
+  }
+  // The runs of root are over, the histograms are not recorded into anymore.
+  plan->releaseHistograms();
+}
+
+std::shared_ptr<ExecutionPlan>
+ThreadPoolExecutor::getPlan(const DAGNode *root) {
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(plansLock_);
+    auto it = plans_.find(root);
+    if (it != plans_.end()) {
+      return it->second;
+    }
+  }
+
+  // Concurrent first runs may build the plan twice, only one is kept.
+  auto plan = std::make_shared<ExecutionPlan>(root);
+  std::lock_guard<std::shared_timed_mutex> lock(plansLock_);
+  return plans_.emplace(root, std::move(plan)).first->second;
+}
+
 void ThreadPoolExecutor::executeDAGNode(
-    std::shared_ptr<ExecutionState> executionState, DAGNode *node) {
+    std::shared_ptr<ExecutionState> executionState, unsigned nodeNumber,
+    std::chrono::steady_clock::time_point readyTime) {
   TRACE_EVENT_SCOPE(executionState->getRawResultContextPtr()->getTraceContext(),
                     TraceLevel::RUNTIME, "ThreadPoolExecutor::executeDAGNode");
   DCHECK(executionState->initialized_) << "Run state must be initialized";
   // If execution has already failed due to another node, don't bother running
   // this one.
   if (executionState->getErrorContainer().containsErr()) {
-    // Mark the node as no longer executing.
-    executionState->decrementInflightNodes();
-    inflightBarrier_.decrement();
+    finishNodeWithoutRun(executionState, llvm::Error::success());
+    return;
+  }
+
+  // Don't run the remaining nodes of a request whose deadline passed.
+  if (executionState->getRawResultContextPtr()->isDeadlineExceeded()) {
+    finishNodeWithoutRun(
+        executionState,
+        MAKE_ERR(GlowErr::ErrorCode::RUNTIME_DEADLINE_EXCEEDED,
+                 "The deadline of the request passed before it ran"));
     return;
   }
 
-  auto currentDevice = node->getNextDevice();
+  const auto &planNode = executionState->getPlan().getNodes()[nodeNumber];
+  DAGNode *node = planNode.node;
+  size_t deviceIndex = deviceSelector_.acquire(node, *planNode.latencies);
   // Get the DeviceManager that can run the node.
-  auto deviceManagerIt = deviceManagers_.find(currentDevice);
+  auto deviceManagerIt = deviceManagers_.find(node->deviceIDs[deviceIndex]);
 
   if (deviceManagerIt == deviceManagers_.end()) {
-    // Mark the node as no longer executing.
-    executionState->getErrorContainer().set(
+    deviceSelector_.release(node, deviceIndex, *planNode.latencies);
+    finishNodeWithoutRun(
+        executionState,
         MAKE_ERR(GlowErr::ErrorCode::RUNTIME_DEVICE_NOT_FOUND,
                  "Cannot find the DeviceManager specified."));
-    executionState->decrementInflightNodes();
-    inflightBarrier_.decrement();
     return;
   }
 
@@ -312,28 +509,81 @@ void ThreadPoolExecutor::executeDAGNode(
 
   // Get the PlaceholderBindings containing all of the inputs for the node.
   std::unique_ptr<ExecutionContext> nodeCtx =
-      executionState->getUniqueNodeContextPtr(node);
+      executionState->getUniqueNodeContextPtr(nodeNumber);
 
   // Run the node using the DeviceManager.
+  auto startTime = std::chrono::steady_clock::now();
+  executionState->getPlan().getDispatchTime()->recordMicroseconds(
+      startTime - readyTime);
   deviceManager->runFunction(
       node->name, std::move(nodeCtx),
-      [this, executionState,
-       node](RunIdentifierTy id, llvm::Error err,
-             std::unique_ptr<ExecutionContext> resultCtx) {
-        // Immediately move the handling of the result onto this run's executor
-        // to avoid doing work on the DeviceManager thread.
-        executionState->getExecutor()->submit(
-            [this, executionState, node, err = std::move(err),
+      [this, executionState, nodeNumber, deviceIndex, &planNode,
+       startTime](RunIdentifierTy id, llvm::Error err,
+                  std::unique_ptr<ExecutionContext> resultCtx) {
+        auto doneTime = std::chrono::steady_clock::now();
+        auto deviceTime = err ? std::chrono::nanoseconds::zero()
+                              : doneTime - startTime;
+        // The selector weighs the devices by the execution time alone, the
+        // time the run waited on the device is already counted by its runs
+        // in flight.
+        deviceSelector_.release(planNode.node, deviceIndex,
+                                *planNode.latencies,
+                                err ? std::chrono::nanoseconds::zero()
+                                    : resultCtx->getExecutionTime());
+        if (!err) {
+          planNode.deviceTime->recordMicroseconds(deviceTime);
+          // Only some backends report the time of their copies.
+          if (resultCtx->getInputCopyTime().count() != 0 ||
+              resultCtx->getOutputCopyTime().count() != 0) {
+            planNode.inputCopyTime->recordMicroseconds(
+                resultCtx->getInputCopyTime());
+            planNode.outputCopyTime->recordMicroseconds(
+                resultCtx->getOutputCopyTime());
+          }
+        }
+        // Immediately move the handling of the result onto the thread pool
+        // to avoid doing work on the DeviceManager thread. The results of a
+        // run with the default priority go to the shared work of the pool,
+        // so that an idle worker picks them up instead of waiting behind the
+        // results of other runs.
+        auto key = resultCtx->getWorkPriority();
+        threadPool_.submit(
+            [this, executionState, nodeNumber, doneTime, err = std::move(err),
              ctx = std::move(resultCtx)]() mutable {
               this->handleDeviceManagerResult(executionState, std::move(err),
-                                              std::move(ctx), node);
-            });
+                                              std::move(ctx), nodeNumber,
+                                              doneTime);
+            },
+            key);
       });
 }
 
+void ThreadPoolExecutor::finishRun(ExecutionState &executionState) {
+  // Remove the intermediate placeholders so we don't leak them to the caller.
+  executionState.removeIntermediatePlaceholders();
+
+  // If there are no nodes inflight, that means all nodes are done. Call
+  // the callback and erase the state information.
+  ResultCBTy cb = executionState.getCallback();
+  DCHECK(cb != nullptr);
+  cb(executionState.getRunId(), executionState.getErrorContainer().get(),
+     executionState.getUniqueResultContextPtr());
+}
+
+void ThreadPoolExecutor::finishNodeWithoutRun(
+    std::shared_ptr<ExecutionState> executionState, llvm::Error err) {
+  executionState->getErrorContainer().set(std::move(err));
+  // Mark the node as no longer executing, it may have been the last one.
+  if (executionState->decrementInflightNodes()) {
+    finishRun(*executionState);
+  }
+  inflightBarrier_.decrement();
+}
+
 void ThreadPoolExecutor::handleDeviceManagerResult(
     std::shared_ptr<ExecutionState> executionState, llvm::Error err,
-    std::unique_ptr<ExecutionContext> ctx, const DAGNode *node) {
+    std::unique_ptr<ExecutionContext> ctx, unsigned node,
+    std::chrono::steady_clock::time_point doneTime) {
 
   // If executionState is null, that means that the object was deleted
   // while a node was executing. That should never happen.
@@ -351,7 +601,7 @@ void ThreadPoolExecutor::handleDeviceManagerResult(
   // If the DeviceManager executed the node, propagate its output Placeholders
   // to its children or the result PlaceholderBindings as appropriate.
   if (runWasSuccess) {
-    for (auto &child : node->children) {
+    for (auto child : executionState->getPlan().getNodes()[node].children) {
       // Execute any child that has no parent nodes left to execute.
       bool childReadyToExecute =
           executionState->incrementNodeParentsDone(child);
@@ -359,7 +609,7 @@ void ThreadPoolExecutor::handleDeviceManagerResult(
         // Mark the node as "inflight" (i.e. currently executing).
         executionState->incrementInflightNodes();
         inflightBarrier_.increment();
-        executeDAGNode(executionState, child);
+        executeDAGNode(executionState, child, doneTime);
       }
     }
   }
@@ -375,16 +625,12 @@ void ThreadPoolExecutor::handleDeviceManagerResult(
     executionState->insertIntoTraceContext(traceContext);
   }
 
+  // Keep the context of the node for the next run. The result context may be
+  // handed to the callback below, this one is no longer used.
+  executionState->recycleNodeContext(node, std::move(ctx));
+
   if (noNodesInflight) {
-    // Remove the intermediate placeholders so we don't leak them to the caller.
-    executionState->removeIntermediatePlaceholders();
-
-    // If there are no nodes inflight, that means all nodes are done. Call
-    // the callback and erase the state information.
-    ResultCBTy cb = executionState->getCallback();
-    DCHECK(cb != nullptr);
-    cb(executionState->getRunId(), executionState->getErrorContainer().get(),
-       executionState->getUniqueResultContextPtr());
+    finishRun(*executionState);
   }
 
   // Decrement the inflight barrier for the executor keeping track of all
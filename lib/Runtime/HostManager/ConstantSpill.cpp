@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "glow/Runtime/HostManager/ConstantSpill.h"
+#include "glow/Graph/Nodes.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#include <fstream>
+
+using namespace glow;
+using namespace runtime;
+
+llvm::Expected<std::unique_ptr<ConstantSpill>>
+ConstantSpill::create(const Module &module, llvm::StringRef dir) {
+  std::unique_ptr<ConstantSpill> spill(new ConstantSpill());
+  llvm::SmallString<128> path;
+  std::error_code EC;
+  if (dir.empty()) {
+    EC = llvm::sys::fs::createTemporaryFile("glow-constants", "bin", path);
+  } else {
+    llvm::SmallString<128> model(dir);
+    llvm::sys::path::append(model, "glow-constants-%%%%%%%%.bin");
+    EC = llvm::sys::fs::createUniqueFile(model, path);
+  }
+  RETURN_ERR_IF_NOT(!EC, "Failed to create a file for the constants: " +
+                             EC.message());
+  spill->path_ = path.str();
+
+  std::ofstream file(spill->path_, std::ios::binary | std::ios::trunc);
+  uint64_t offset = 0;
+  for (const Constant *C : module.getConstants()) {
+    const Tensor &payload = C->getPayload();
+    file.write(payload.getUnsafePtr(), payload.getSizeInBytes());
+    spill->offsets_[C] = offset;
+    offset += payload.getSizeInBytes();
+  }
+  file.close();
+  RETURN_ERR_IF_NOT(file, "Failed to write the constants to " + spill->path_);
+  return llvm::Expected<std::unique_ptr<ConstantSpill>>(std::move(spill));
+}
+
+ConstantSpill::~ConstantSpill() { llvm::sys::fs::remove(path_); }
+
+llvm::Error ConstantSpill::restore(llvm::ArrayRef<Constant *> constants) const {
+  std::ifstream file(path_, std::ios::binary);
+  RETURN_ERR_IF_NOT(file, "Failed to open the constants in " + path_);
+  for (Constant *C : constants) {
+    auto it = offsets_.find(C);
+    RETURN_ERR_IF_NOT(it != offsets_.end(),
+                      "Constant " + C->getName().str() + " was not spilled");
+    // The stripped payload keeps its type and a released buffer, which a
+    // reset would reuse, so a new tensor takes its place.
+    Tensor payload(C->getPayload().getType());
+    file.seekg(it->second);
+    file.read(payload.getUnsafePtr(), payload.getSizeInBytes());
+    RETURN_ERR_IF_NOT(file, "Failed to read constant " + C->getName().str() +
+                                " from " + path_);
+    C->getPayloadMutable() = std::move(payload);
+  }
+  return llvm::Error::success();
+}
@@ -0,0 +1,349 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "glow/Runtime/HostManager/DynamicBatcher.h"
+#include "glow/Graph/Nodes.h"
+#include "glow/Graph/PlaceholderBindings.h"
+#include "glow/Runtime/StatsExporter.h"
+#include "glow/Support/Error.h"
+
+#include <glog/logging.h>
+
+#include <cstring>
+
+using namespace glow;
+using namespace runtime;
+
+namespace {
+/// \returns the number of rows bound by \p bindings if they are batchable:
+/// every tensor has the type of its Placeholder except for dimension 0, all
+/// tensors have the same number of rows, and no more than the common dimension
+/// 0 of the Placeholders, which is returned in \p batchSize. \returns 0 if the
+/// bindings are not batchable.
+size_t getBatchedRows(const PlaceholderBindings &bindings, size_t &batchSize) {
+  size_t rows = 0;
+  batchSize = 0;
+  for (const auto &PH : bindings.pairs()) {
+    auto PT = PH.first->getType();
+    const Type &T = PH.second->getType();
+    if (PT->dims().empty() || T.dims().size() != PT->dims().size()) {
+      return 0;
+    }
+    std::vector<size_t> dims(PT->dims().begin(), PT->dims().end());
+    dims[0] = T.dims()[0];
+    if (!T.isEqual(Type::newShape(*PT, dims))) {
+      return 0;
+    }
+    if (batchSize == 0) {
+      batchSize = PT->dims()[0];
+      rows = dims[0];
+    } else if (batchSize != PT->dims()[0] || rows != dims[0]) {
+      return 0;
+    }
+  }
+  return rows <= batchSize ? rows : 0;
+}
+
+/// \returns true if \p A and \p B bind the same Placeholders.
+bool bindSamePlaceholders(const PlaceholderBindings &A,
+                          const PlaceholderBindings &B) {
+  if (A.pairs().size() != B.pairs().size()) {
+    return false;
+  }
+  for (const auto &PH : A.pairs()) {
+    if (!B.count(PH.first)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// The error of a batch, from which each of its requests gets its own copy.
+struct BatchError {
+  std::string fileName;
+  size_t lineNumber{0};
+  std::string message;
+  GlowErr::ErrorCode ec{GlowErr::ErrorCode::RUNTIME_ERROR};
+
+  /// Takes the first error of \p err, keeping its code and location if it is
+  /// a GlowErr. \returns false if \p err is a success.
+  bool take(llvm::Error err) {
+    bool failed = false;
+    llvm::handleAllErrors(
+        std::move(err),
+        [&](const GlowErr &E) {
+          if (!failed) {
+            fileName = E.getFileName();
+            lineNumber = E.getLineNumber();
+            message = E.getMessage();
+            ec = E.getErrorCode();
+          }
+          failed = true;
+        },
+        [&](const llvm::ErrorInfoBase &E) {
+          if (!failed) {
+            fileName = __FILE__;
+            lineNumber = __LINE__;
+            message = E.message();
+          }
+          failed = true;
+        });
+    return failed;
+  }
+
+  /// \returns a new error equal to the one taken.
+  llvm::Error make() const {
+    return llvm::make_error<GlowErr>(fileName, lineNumber, message, ec);
+  }
+};
+} // namespace
+
+DynamicBatcher::DynamicBatcher(DispatchFnTy dispatch)
+    : dispatch_(std::move(dispatch)) {
+  thread_ = std::thread([this]() { run(); });
+}
+
+DynamicBatcher::~DynamicBatcher() {
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void DynamicBatcher::enable(llvm::StringRef name,
+                            std::chrono::microseconds maxDelay,
+                            OutputsTy outputs) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto &state = networks_[name];
+  state.maxDelay = maxDelay;
+  state.outputs = std::make_shared<const OutputsTy>(std::move(outputs));
+}
+
+void DynamicBatcher::disable(llvm::StringRef name) {
+  Batch batch;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = networks_.find(name);
+    if (it == networks_.end()) {
+      return;
+    }
+    batch = takeBatch(it->second);
+    networks_.erase(it);
+  }
+  if (!batch.requests.empty()) {
+    dispatchBatch(name, std::move(batch));
+  }
+}
+
+bool DynamicBatcher::isEnabled(llvm::StringRef name) {
+  std::lock_guard<std::mutex> lock(lock_);
+  return networks_.count(name);
+}
+
+bool DynamicBatcher::submit(llvm::StringRef name, RunIdentifierTy runID,
+                            std::unique_ptr<ExecutionContext> &context,
+                            ResultCBTy &callback) {
+  size_t batchSize;
+  size_t rows = getBatchedRows(*context->getPlaceholderBindings(), batchSize);
+  if (rows == 0) {
+    return false;
+  }
+
+  // At most two batches are dispatched: the pending one if the request can not
+  // join it, and the one of the request if it is full.
+  Batch flushed;
+  Batch full;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = networks_.find(name);
+    if (it == networks_.end()) {
+      return false;
+    }
+    auto &state = it->second;
+    auto &pending = state.pending;
+    if (!pending.requests.empty() &&
+        (pending.rows + rows > pending.batchSize ||
+         !bindSamePlaceholders(
+             *pending.requests.front().context->getPlaceholderBindings(),
+             *context->getPlaceholderBindings()))) {
+      flushed = takeBatch(state);
+    }
+    if (pending.requests.empty()) {
+      pending.batchSize = batchSize;
+      pending.deadline = std::chrono::steady_clock::now() + state.maxDelay;
+      cv_.notify_all();
+    }
+    pending.requests.push_back(
+        {runID, std::move(context), std::move(callback), pending.rows});
+    pending.rows += rows;
+    if (pending.rows == pending.batchSize) {
+      full = takeBatch(state);
+    }
+  }
+
+  if (!flushed.requests.empty()) {
+    dispatchBatch(name, std::move(flushed));
+  }
+  if (!full.requests.empty()) {
+    dispatchBatch(name, std::move(full));
+  }
+  return true;
+}
+
+void DynamicBatcher::flush() {
+  std::vector<std::pair<std::string, Batch>> batches;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto &network : networks_) {
+      if (!network.second.pending.requests.empty()) {
+        batches.emplace_back(network.first(), takeBatch(network.second));
+      }
+    }
+  }
+  for (auto &batch : batches) {
+    dispatchBatch(batch.first, std::move(batch.second));
+  }
+
+  // Wait for the batching thread to hand its expired batches over too.
+  std::unique_lock<std::mutex> lock(lock_);
+  cv_.wait(lock, [this]() { return dispatching_ == 0; });
+}
+
+DynamicBatcher::Batch DynamicBatcher::takeBatch(NetworkState &state) {
+  Batch batch = std::move(state.pending);
+  batch.outputs = state.outputs;
+  state.pending = Batch();
+  return batch;
+}
+
+void DynamicBatcher::run() {
+  std::unique_lock<std::mutex> lock(lock_);
+  while (!stop_) {
+    // Dispatch the expired batches and find the earliest pending deadline.
+    auto now = std::chrono::steady_clock::now();
+    auto wakeup = std::chrono::steady_clock::time_point::max();
+    std::vector<std::pair<std::string, Batch>> expired;
+    for (auto &network : networks_) {
+      auto &pending = network.second.pending;
+      if (pending.requests.empty()) {
+        continue;
+      }
+      if (pending.deadline <= now) {
+        expired.emplace_back(network.first(), takeBatch(network.second));
+      } else {
+        wakeup = std::min(wakeup, pending.deadline);
+      }
+    }
+
+    if (!expired.empty()) {
+      dispatching_++;
+      lock.unlock();
+      for (auto &batch : expired) {
+        dispatchBatch(batch.first, std::move(batch.second));
+      }
+      lock.lock();
+      dispatching_--;
+      cv_.notify_all();
+      continue;
+    }
+
+    if (wakeup == std::chrono::steady_clock::time_point::max()) {
+      cv_.wait(lock);
+    } else {
+      cv_.wait_until(lock, wakeup);
+    }
+  }
+}
+
+void DynamicBatcher::dispatchBatch(llvm::StringRef name, Batch batch) {
+  DCHECK(!batch.requests.empty());
+  Stats()->addTimeSeriesValue(kBatchRows, batch.rows);
+  Stats()->addTimeSeriesValue(kBatchRequests, batch.requests.size());
+
+  // A batch of a single request of full size runs as is.
+  if (batch.requests.size() == 1 && batch.rows == batch.batchSize) {
+    auto &request = batch.requests.front();
+    auto runID = request.runID;
+    auto callback = std::move(request.callback);
+    dispatch_(name, std::move(request.context),
+              [runID, callback](RunIdentifierTy, llvm::Error err,
+                                std::unique_ptr<ExecutionContext> context) {
+                callback(runID, std::move(err), std::move(context));
+              });
+    return;
+  }
+
+  // Concatenate the rows of the requests, zeroing the unused ones. The batch
+  // runs with the most urgent priority class and deadline of its requests.
+  auto merged = llvm::make_unique<ExecutionContext>();
+  merged->copySchedulingFrom(*batch.requests.front().context);
+  for (const auto &request : batch.requests) {
+    merged->setPriority(
+        std::min(merged->getPriority(), request.context->getPriority()));
+    merged->setDeadline(
+        std::min(merged->getDeadline(), request.context->getDeadline()));
+  }
+  auto *mergedBindings = merged->getPlaceholderBindings();
+  for (const auto &PH :
+       batch.requests.front().context->getPlaceholderBindings()->pairs()) {
+    Tensor *T = mergedBindings->allocate(PH.first);
+    size_t rowBytes = T->getSizeInBytes() / batch.batchSize;
+    for (const auto &request : batch.requests) {
+      Tensor *src = request.context->getPlaceholderBindings()->get(PH.first);
+      std::memcpy(T->getUnsafePtr() + request.offset * rowBytes,
+                  src->getUnsafePtr(), src->getSizeInBytes());
+    }
+    std::memset(T->getUnsafePtr() + batch.rows * rowBytes, 0,
+                (batch.batchSize - batch.rows) * rowBytes);
+  }
+
+  // Split the results back to the requests. The callback is shared by the
+  // copies of the std::function, hence the shared_ptr.
+  auto requests =
+      std::make_shared<std::vector<Request>>(std::move(batch.requests));
+  auto outputs = batch.outputs;
+  dispatch_(name, std::move(merged),
+            [requests, outputs](RunIdentifierTy, llvm::Error err,
+                                std::unique_ptr<ExecutionContext> context) {
+              BatchError batchErr;
+              bool failed = batchErr.take(std::move(err));
+              auto *bindings = context->getPlaceholderBindings();
+              for (auto &request : *requests) {
+                if (failed) {
+                  request.callback(request.runID, batchErr.make(),
+                                   std::move(request.context));
+                  continue;
+                }
+                for (const auto &PH :
+                     request.context->getPlaceholderBindings()->pairs()) {
+                  if (!outputs->count(PH.first)) {
+                    continue;
+                  }
+                  Tensor *T = bindings->get(PH.first);
+                  size_t rowBytes =
+                      PH.second->getSizeInBytes() / PH.second->dims()[0];
+                  std::memcpy(PH.second->getUnsafePtr(),
+                              T->getUnsafePtr() + request.offset * rowBytes,
+                              PH.second->getSizeInBytes());
+                }
+                request.callback(request.runID, llvm::Error::success(),
+                                 std::move(request.context));
+              }
+            });
+}
@@ -20,16 +20,21 @@
 #include "glow/Optimizer/GraphOptimizer/GraphOptimizer.h"
 #include "glow/Partitioner/Partitioner.h"
 #include "glow/Runtime/Executor/ThreadPoolExecutor.h"
+#include "glow/Runtime/HostManager/DynamicBatcher.h"
 #include "glow/Runtime/Provisioner/Provisioner.h"
 #include "glow/Runtime/RuntimeTypes.h"
+#include "glow/Runtime/StatsExporter.h"
+#include "glow/Support/Memory.h"
 #include "glow/Support/Support.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/CommandLine.h"
 
 #include <glog/logging.h>
 
 #include <future>
 #include <queue>
+#include <set>
 
 using namespace glow;
 using namespace runtime;
@@ -42,6 +47,33 @@ llvm::cl::opt<std::string> loadBackendSpecificOptionsOpt(
     llvm::cl::desc("Load backend-specific options for compilation."),
     llvm::cl::value_desc("options.yaml"), llvm::cl::Optional,
     llvm::cl::cat(hostManagerCat));
+
+/// \returns an estimate of the device memory used by the networks of
+/// \p module: the aligned size of its constants and placeholders.
+uint64_t estimateDeviceMemory(const Module &module) {
+  uint64_t size = 0;
+  for (const auto *C : module.getConstants()) {
+    size += alignedSize(C->getType()->getSizeInBytes(), TensorAlignment);
+  }
+  for (const auto *PH : module.getPlaceholders()) {
+    size += alignedSize(PH->getType()->getSizeInBytes(), TensorAlignment);
+  }
+  return size;
+}
+
+/// Evicts function \p name from \p device, waiting for the eviction.
+llvm::Error evictFromDevice(DeviceManager &device, llvm::StringRef name) {
+  std::promise<void> removeNetwork;
+  auto done = removeNetwork.get_future();
+  std::unique_ptr<llvm::Error> removeErr;
+  device.evictNetwork(
+      name, [&removeNetwork, &removeErr](std::string name, llvm::Error err) {
+        removeErr = llvm::make_unique<llvm::Error>(std::move(err));
+        removeNetwork.set_value();
+      });
+  done.get();
+  return std::move(*DCHECK_NOTNULL(removeErr.get()));
+}
 } // namespace
 
 HostManager::HostManager(const HostConfig &hostConfig) : config_(hostConfig) {}
@@ -65,7 +97,7 @@ llvm::Expected<DAG &> HostManager::getNetworkDAG(llvm::StringRef network) {
   if (it == networks_.end()) {
     return MAKE_ERR(GlowErr::ErrorCode::RUNTIME_ERROR, "Network not found.");
   }
-  return it->second.dag;
+  return it->second.active->dag;
 }
 
 llvm::Error
@@ -84,8 +116,15 @@ HostManager::init(std::vector<std::unique_ptr<DeviceConfig>> configs) {
 
     deviceCount++;
   }
-  provisioner_.reset(new Provisioner(devices_));
-  executor_.reset(new ThreadPoolExecutor(devices_, config_.executorThreads));
+  provisioner_.reset(new Provisioner(devices_, config_.maxCompileThreads));
+  executor_.reset(new ThreadPoolExecutor(devices_, config_.executorThreads,
+                                         config_.deviceSelectionPolicy));
+  batcher_.reset(new DynamicBatcher(
+      [this](llvm::StringRef name, std::unique_ptr<ExecutionContext> context,
+             ResultCBTy callback) {
+        runNetworkImpl(name, std::move(context), std::move(callback),
+                       /* allowBatching */ false);
+      }));
 
   return llvm::Error::success();
 }
@@ -95,6 +134,15 @@ HostManager::~HostManager() { llvm::toString(clearHost()); }
 llvm::Error HostManager::addNetwork(std::unique_ptr<Module> module,
                                     CompilationContext &cctx,
                                     bool saturateHost) {
+  // Make room for the network before the partitioner looks at the memory of
+  // the devices. The estimate leaves out the activations, so a lack of memory
+  // is only reported by the provisioner.
+  if (config_.enableNetworkResidency) {
+    std::lock_guard<std::mutex> residencyLock(residencyLock_);
+    llvm::consumeError(
+        evictIdleNetworks({}, estimateDeviceMemory(*module)));
+  }
+
   std::lock_guard<std::mutex> networkLock(networkLock_);
   auto functions = module->getFunctions();
   for (auto &F : functions) {
@@ -107,6 +155,60 @@ llvm::Error HostManager::addNetwork(std::unique_ptr<Module> module,
     }
   }
 
+  DAGListTy nodeList;
+  ASSIGN_VALUE_OR_RETURN_ERR(nodeList,
+                             partitionNetwork(*module, cctx, saturateHost));
+
+  std::lock_guard<std::mutex> provisionLock(provisionLock_);
+  if (cctx.precisionConfig.quantMode == QuantizationMode::Profile) {
+    // Since for profiling the provisioner will be reset, we only allow one
+    // network in one HM.
+    RETURN_ERR_IF_NOT(networks_.size() == 0,
+                      "For quantization profiling flow, there can't be other "
+                      "registered networks before this one");
+    // For profiling, we use CPU backend. Overwrite Provisioner and Executor to
+    // force the network is compiled and run in profilingBackend.
+    // backend.
+    size_t devicesNum = devices_.size();
+    for (size_t i = 0; i < devicesNum; i++) {
+      auto name = devices_[i]->getDeviceConfig().name;
+      auto config = llvm::make_unique<DeviceConfig>(profilingBackend, name);
+      devices_[i] = std::unique_ptr<DeviceManager>(
+          DeviceManager::createDeviceManager(*config));
+      RETURN_IF_ERR(devices_[i]->init());
+    }
+    provisioner_.reset(new Provisioner(devices_, config_.maxCompileThreads));
+    executor_.reset(new ThreadPoolExecutor(devices_, config_.executorThreads,
+                                           config_.deviceSelectionPolicy));
+  }
+
+  RETURN_IF_ERR(provisioner_->provision(nodeList, *module, cctx));
+
+  // Clear constants contents from the module then put it in a
+  // shared_ptr to be shared between all of the networks created from each
+  // function in the module.
+  auto constants = stripModule(*module);
+  auto sharedModule = std::shared_ptr<Module>(std::move(module));
+
+  for (auto &node : nodeList) {
+    auto networkData = llvm::make_unique<NetworkData>();
+    networkData->dag = std::move(node);
+    networkData->module = sharedModule;
+    networkData->constants = constants;
+    networkData->latencyKey = strFormat("glow.hostmanager.%s.v0.latency_us",
+                                        networkData->dag.root->name.c_str());
+    initNetworkStats(*networkData, networkData->dag.root->name);
+    executor_->prepare(networkData->dag.root.get(),
+                       config_.expectedConcurrentRuns);
+    networks_[networkData->dag.root->name].active = std::move(networkData);
+  }
+
+  return llvm::Error::success();
+}
+
+llvm::Expected<DAGListTy>
+HostManager::partitionNetwork(Module &module, CompilationContext &cctx,
+                              bool saturateHost) {
   // Load backend-specific options if specified.
   if (!loadBackendSpecificOptionsOpt.empty()) {
     if (cctx.backendOpts.backendSpecificOpts.size() != 0) {
@@ -128,52 +230,357 @@ llvm::Error HostManager::addNetwork(std::unique_ptr<Module> module,
   }
   // Perform a round of target-independent graph optimizations. This helps the
   // partitioner to do its job more efficiently.
-  for (Function *F : module->getFunctions()) {
+  for (Function *F : module.getFunctions()) {
     RETURN_IF_ERR(optimizeFunctionBeforeLowering(F, cctx));
   }
-  Partitioner partitioner(module.get(), deviceInfo, saturateHost);
+  Partitioner partitioner(&module, deviceInfo, saturateHost);
   DAGListTy nodeList;
   ASSIGN_VALUE_OR_RETURN_ERR(nodeList, partitioner.partition(cctx));
+  return nodeList;
+}
 
-  if (cctx.precisionConfig.quantMode == QuantizationMode::Profile) {
-    // Since for profiling the provisioner will be reset, we only allow one
-    // network in one HM.
-    RETURN_ERR_IF_NOT(networks_.size() == 0,
-                      "For quantization profiling flow, there can't be other "
-                      "registered networks before this one");
-    // For profiling, we use CPU backend. Overwrite Provisioner and Executor to
-    // force the network is compiled and run in profilingBackend.
-    // backend.
-    size_t devicesNum = devices_.size();
-    for (size_t i = 0; i < devicesNum; i++) {
-      auto name = devices_[i]->getDeviceConfig().name;
-      auto config = llvm::make_unique<DeviceConfig>(profilingBackend, name);
-      devices_[i] = std::unique_ptr<DeviceManager>(
-          DeviceManager::createDeviceManager(*config));
-      RETURN_IF_ERR(devices_[i]->init());
+llvm::Error HostManager::addNetworkVersion(std::unique_ptr<Module> module,
+                                           CompilationContext &cctx,
+                                           bool saturateHost) {
+  RETURN_ERR_IF_NOT(cctx.precisionConfig.quantMode != QuantizationMode::Profile,
+                    "Networks can not be versioned in the profiling flow");
+
+  // Reserve the new versions, then compile them without holding networkLock_
+  // so that the current versions keep running the requests.
+  std::vector<std::string> names;
+  std::vector<unsigned> versionNumbers;
+  {
+    std::lock_guard<std::mutex> networkLock(networkLock_);
+    for (auto *F : module->getFunctions()) {
+      auto it = networks_.find(F->getName());
+      if (it == networks_.end()) {
+        return MAKE_ERR(
+            GlowErr::ErrorCode::RUNTIME_NET_NOT_FOUND,
+            llvm::formatv("Failed to add a version: no network called {0}",
+                          F->getName())
+                .str());
+      }
+      if (it->second.candidate || it->second.compilingVersion) {
+        return MAKE_ERR(
+            GlowErr::ErrorCode::RUNTIME_NET_BUSY,
+            llvm::formatv("Failed to add a version: network {0} already has "
+                          "a candidate version",
+                          F->getName())
+                .str());
+      }
+    }
+    for (auto *F : module->getFunctions()) {
+      auto &versions = networks_[F->getName()];
+      versions.compilingVersion = true;
+      names.push_back(F->getName());
+      versionNumbers.push_back(versions.nextVersion++);
     }
-    provisioner_.reset(new Provisioner(devices_));
-    executor_.reset(new ThreadPoolExecutor(devices_, config_.executorThreads));
   }
 
-  RETURN_IF_ERR(provisioner_->provision(nodeList, *module, cctx));
+  // The versions are compiled under their own names, so that the functions
+  // of both versions can coexist on the devices and in the provisioner.
+  std::unordered_map<std::string, size_t> versionIndices;
+  auto functions = module->getFunctions();
+  size_t index = 0;
+  for (auto *F : functions) {
+    F->setName(strFormat("%s__v%u", names[index].c_str(),
+                         versionNumbers[index]));
+    versionIndices[F->getName()] = index++;
+  }
 
-  // Clear constants contents from the module then put it in a
-  // shared_ptr to be shared between all of the networks created from each
-  // function in the module.
-  module->strip();
+  DAGListTy nodeList;
+  auto compileErr = [&]() -> llvm::Error {
+    ASSIGN_VALUE_OR_RETURN_ERR(nodeList,
+                               partitionNetwork(*module, cctx, saturateHost));
+    std::lock_guard<std::mutex> provisionLock(provisionLock_);
+    return provisioner_->provision(nodeList, *module, cctx);
+  }();
+
+  std::lock_guard<std::mutex> networkLock(networkLock_);
+  for (const auto &name : names) {
+    networks_[name].compilingVersion = false;
+  }
+  RETURN_IF_ERR(std::move(compileErr));
+
+  auto constants = stripModule(*module);
   auto sharedModule = std::shared_ptr<Module>(std::move(module));
 
   for (auto &node : nodeList) {
-    auto &networkData = networks_[(node.root)->name];
-    networkData.dag = std::move(node);
-    networkData.module = sharedModule;
+    size_t i = versionIndices[node.root->name];
+    auto networkData = llvm::make_unique<NetworkData>();
+    networkData->dag = std::move(node);
+    networkData->module = sharedModule;
+    networkData->constants = constants;
+    networkData->version = versionNumbers[i];
+    networkData->latencyKey = strFormat("glow.hostmanager.%s.v%u.latency_us",
+                                        names[i].c_str(), versionNumbers[i]);
+    initNetworkStats(*networkData, names[i]);
+    networkData->measureLatency = true;
+    executor_->prepare(networkData->dag.root.get(),
+                       config_.expectedConcurrentRuns);
+    // removeNetwork refuses to remove a network while a version compiles.
+    auto &versions = networks_.find(names[i])->second;
+    versions.active->measureLatency = true;
+    versions.candidate = std::move(networkData);
+  }
+
+  return llvm::Error::success();
+}
+
+llvm::Error HostManager::setNetworkMirrorPercent(llvm::StringRef networkName,
+                                                 unsigned percent) {
+  RETURN_ERR_IF_NOT(percent <= 100,
+                    "Cannot mirror more than 100% of the requests");
+  std::lock_guard<std::mutex> networkLock(networkLock_);
+  auto it = networks_.find(networkName);
+  if (it == networks_.end() || !it->second.candidate) {
+    return MAKE_ERR(
+        GlowErr::ErrorCode::RUNTIME_NET_NOT_FOUND,
+        llvm::formatv("Network {0} has no candidate version", networkName)
+            .str());
+  }
+  it->second.mirrorPercent = percent;
+  return llvm::Error::success();
+}
+
+llvm::Error HostManager::promoteNetworkVersion(llvm::StringRef networkName) {
+  std::unique_ptr<NetworkData> previous;
+  {
+    std::lock_guard<std::mutex> networkLock(networkLock_);
+    auto it = networks_.find(networkName);
+    if (it == networks_.end() || !it->second.candidate) {
+      return MAKE_ERR(
+          GlowErr::ErrorCode::RUNTIME_NET_NOT_FOUND,
+          llvm::formatv("Network {0} has no candidate version", networkName)
+              .str());
+    }
+    auto &versions = it->second;
+    previous = std::move(versions.active);
+    versions.active = std::move(versions.candidate);
+    versions.active->measureLatency = false;
+    versions.mirrorPercent = 0;
+  }
+  return retireNetwork(std::move(previous));
+}
+
+llvm::Error HostManager::discardNetworkVersion(llvm::StringRef networkName) {
+  std::unique_ptr<NetworkData> candidate;
+  {
+    std::lock_guard<std::mutex> networkLock(networkLock_);
+    auto it = networks_.find(networkName);
+    if (it == networks_.end() || !it->second.candidate) {
+      return llvm::Error::success();
+    }
+    auto &versions = it->second;
+    candidate = std::move(versions.candidate);
+    versions.active->measureLatency = false;
+    versions.mirrorPercent = 0;
+  }
+  return retireNetwork(std::move(candidate));
+}
+
+llvm::Expected<unsigned>
+HostManager::getNetworkVersion(llvm::StringRef networkName) {
+  std::lock_guard<std::mutex> networkLock(networkLock_);
+  auto it = networks_.find(networkName);
+  if (it == networks_.end()) {
+    return MAKE_ERR(
+        GlowErr::ErrorCode::RUNTIME_NET_NOT_FOUND,
+        llvm::formatv("Function {0} not found", networkName).str());
+  }
+  return it->second.active->version;
+}
+
+llvm::Error HostManager::retireNetwork(std::unique_ptr<NetworkData> network) {
+  {
+    std::unique_lock<std::mutex> networkLock(networkLock_);
+    network->retired = true;
+    drainCV_.wait(networkLock, [&network] { return network->refcount == 0; });
+  }
+  // The residency manager may still be unloading the network.
+  std::lock_guard<std::mutex> residencyLock(residencyLock_);
+  auto err = evictNetwork(*network);
+  network.reset();
+  return err;
+}
+
+llvm::Error HostManager::evictNetwork(NetworkData &network) {
+  executor_->release(network.dag.root.get());
+  // The networks evicted by the residency manager are not on their devices.
+  auto err = network.resident ? unloadNetwork(network) : llvm::Error::success();
+  // Also remove compiledFunction from Provisioner.
+  std::lock_guard<std::mutex> provisionLock(provisionLock_);
+  for (auto &node : network.dag.nodes) {
+    provisioner_->removeFunction(node->name);
+  }
+  return err;
+}
+
+llvm::Error HostManager::unloadNetwork(NetworkData &network) {
+  OneErrOnly err;
+  for (auto &node : network.dag.nodes) {
+    for (auto device : node->deviceIDs) {
+      err.set(evictFromDevice(*devices_[device], node->name));
+    }
+  }
+  std::lock_guard<std::mutex> provisionLock(provisionLock_);
+  for (auto &node : network.dag.nodes) {
+    provisioner_->freeConstants(node->name);
+  }
+  return err.get();
+}
+
+llvm::Error
+HostManager::evictIdleNetworks(const std::map<DeviceIDTy, uint64_t> &required,
+                               uint64_t totalRequired) {
+  while (true) {
+    std::set<DeviceIDTy> lacking;
+    uint64_t totalAvailable = 0;
+    for (auto &device : devices_) {
+      uint64_t available = device.second->getAvailableMemory();
+      totalAvailable += available;
+      auto it = required.find(device.first);
+      if (it != required.end() && available < it->second) {
+        lacking.insert(device.first);
+      }
+    }
+    bool lackingTotal = totalAvailable < totalRequired;
+    if (lacking.empty() && !lackingTotal) {
+      return llvm::Error::success();
+    }
+
+    // Pick the least recently used idle network loaded where memory lacks.
+    // Networks with versions in flight are left alone.
+    NetworkData *victim = nullptr;
+    {
+      std::lock_guard<std::mutex> networkLock(networkLock_);
+      for (auto &entry : networks_) {
+        auto &versions = entry.second;
+        NetworkData *network = versions.active.get();
+        if (!network->resident || network->refcount != 0 ||
+            versions.candidate || versions.compilingVersion ||
+            (victim && victim->lastUsed <= network->lastUsed)) {
+          continue;
+        }
+        bool frees = lackingTotal;
+        for (auto &node : network->dag.nodes) {
+          for (auto device : node->deviceIDs) {
+            frees |= lacking.count(device) != 0;
+          }
+        }
+        if (frees) {
+          victim = network;
+        }
+      }
+      // The requests of the victim now wait for residencyLock_ to reload it.
+      if (victim) {
+        victim->resident = false;
+      }
+    }
+    if (!victim) {
+      return MAKE_ERR(GlowErr::ErrorCode::RUNTIME_OUT_OF_DEVICE_MEMORY,
+                      "Not enough device memory and no idle network to "
+                      "evict");
+    }
+    RETURN_IF_ERR(unloadNetwork(*victim));
+    Stats()->incrementCounter(kNetworkEvictions);
+  }
+}
+
+std::shared_ptr<ConstantSpill> HostManager::stripModule(Module &module) {
+  std::shared_ptr<ConstantSpill> constants;
+  if (config_.enableNetworkResidency) {
+    auto spillOrErr =
+        ConstantSpill::create(module, config_.networkResidencyDir);
+    if (!spillOrErr) {
+      LOG(WARNING) << "Keeping the constants in memory: "
+                   << llvm::toString(spillOrErr.takeError());
+      return nullptr;
+    }
+    constants = std::move(*spillOrErr);
+  }
+  module.strip();
+  return constants;
+}
+
+llvm::Error HostManager::reloadNetwork(NetworkData *network) {
+  std::lock_guard<std::mutex> residencyLock(residencyLock_);
+  // A concurrent request may have reloaded the network.
+  if (network->resident) {
+    return llvm::Error::success();
+  }
+
+  auto startTime = std::chrono::steady_clock::now();
+  std::map<DeviceIDTy, uint64_t> required;
+  for (auto &node : network->dag.nodes) {
+    for (auto device : node->deviceIDs) {
+      required[device] +=
+          devices_[device]->getFunctionMemorySize(*node->runtimeBundle);
+    }
+  }
+  RETURN_IF_ERR(evictIdleNetworks(required, 0));
+
+  // Read the constants of the network back for the devices to copy them, and
+  // drop them again once loaded.
+  std::vector<Constant *> constants;
+  if (network->constants) {
+    llvm::SmallPtrSet<Constant *, 16> seen;
+    for (auto &node : network->dag.nodes) {
+      Function *F = network->module->getFunction(node->name);
+      RETURN_ERR_IF_NOT(F, "No function " + node->name);
+      for (auto &N : F->getNodes()) {
+        for (unsigned i = 0, e = N.getNumInputs(); i < e; i++) {
+          auto *C = llvm::dyn_cast<Constant>(N.getNthInput(i).getNode());
+          if (C && seen.insert(C).second) {
+            constants.push_back(C);
+          }
+        }
+      }
+    }
+  }
+  auto stripConstants = [&constants]() {
+    for (auto *C : constants) {
+      C->clearPayload();
+    }
+  };
+
+  std::vector<std::pair<std::string, DeviceIDTy>> loaded;
+  auto loadErr = [&]() -> llvm::Error {
+    if (network->constants) {
+      RETURN_IF_ERR(network->constants->restore(constants));
+    }
+    for (auto &node : network->dag.nodes) {
+      for (auto device : node->deviceIDs) {
+        std::lock_guard<std::mutex> provisionLock(provisionLock_);
+        RETURN_IF_ERR(provisioner_->loadFunction(node->name, device,
+                                                 *network->module));
+        loaded.emplace_back(node->name, device);
+      }
+    }
+    return llvm::Error::success();
+  }();
+  stripConstants();
+  if (loadErr) {
+    // Leave the network evicted, so that the next request retries.
+    for (auto &function : loaded) {
+      llvm::consumeError(
+          evictFromDevice(*devices_[function.second], function.first));
+    }
+    return loadErr;
   }
 
+  network->resident = true;
+  Stats()->incrementCounter(kNetworkReloads);
+  Stats()->addTimeSeriesValue(
+      kReloadLatencyUs, std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - startTime)
+                            .count());
   return llvm::Error::success();
 }
 
 llvm::Error HostManager::removeNetwork(llvm::StringRef networkName) {
+  // The residency manager may be unloading the network.
+  std::lock_guard<std::mutex> residencyLock(residencyLock_);
   std::lock_guard<std::mutex> networkLock(networkLock_);
   auto networkIterator = networks_.find(networkName);
   if (networkIterator == networks_.end()) {
@@ -181,32 +588,32 @@ llvm::Error HostManager::removeNetwork(llvm::StringRef networkName) {
   }
 
   // Issue an error as there are outstanding runs for the network
-  if (networkIterator->second.refcount != 0) {
+  auto &versions = networkIterator->second;
+  if (versions.active->refcount != 0 ||
+      (versions.candidate && versions.candidate->refcount != 0)) {
     return MAKE_ERR(GlowErr::ErrorCode::RUNTIME_NET_BUSY,
                     llvm::formatv("Cannot remove the network {0}, as there are "
                                   "still outstanding runs",
                                   networkName)
                         .str());
   }
+  if (versions.compilingVersion) {
+    return MAKE_ERR(GlowErr::ErrorCode::RUNTIME_NET_BUSY,
+                    llvm::formatv("Cannot remove the network {0}, as a new "
+                                  "version of it is being compiled",
+                                  networkName)
+                        .str());
+  }
 
   OneErrOnly err;
-  auto &nodes = networkIterator->second.dag.nodes;
-  for (auto &node : nodes) {
-    for (auto device : node->deviceIDs) {
-      std::promise<void> removeNetwork;
-      auto done = removeNetwork.get_future();
-      std::unique_ptr<llvm::Error> removeErr;
-      devices_[device]->evictNetwork(
-          node->name,
-          [&removeNetwork, &removeErr](std::string name, llvm::Error err) {
-            removeErr = llvm::make_unique<llvm::Error>(std::move(err));
-            removeNetwork.set_value();
-          });
-      done.get();
-      err.set(std::move(*DCHECK_NOTNULL(removeErr.get())));
-    }
-    // Also remove compiledFunction from Provisioner.
-    provisioner_->removeFunction(node->name);
+  err.set(evictNetwork(*versions.active));
+  if (versions.candidate) {
+    err.set(evictNetwork(*versions.candidate));
+  }
+  // networkName may be the key of the entry, as in clearHost().
+  releaseNetworkStats(networkName);
+  if (batcher_) {
+    batcher_->disable(networkName);
   }
   networks_.erase(networkIterator);
 
@@ -219,6 +626,25 @@ bool HostManager::networkAdded(llvm::StringRef networkName) {
 }
 
 llvm::Error HostManager::clearHost() {
+  // Run the pending batches before the executor stops accepting requests.
+  if (batcher_) {
+    batcher_->flush();
+  }
+
+  // Refuse the queued requests, they would otherwise be admitted as the
+  // inflight ones finish.
+  std::deque<QueuedRequest> queued;
+  {
+    std::lock_guard<std::mutex> queueLock(queueLock_);
+    for (auto &request : queue_) {
+      dequeued(request);
+    }
+    queued.swap(queue_);
+  }
+  for (auto &request : queued) {
+    refuseRequest(std::move(request), "The HostManager is shutting down.");
+  }
+
   // shutdown the executor, blocking on any current inflight and prevent new
   // requests from being serviced.
   executor_->shutdown();
@@ -267,23 +693,74 @@ llvm::Error HostManager::runNetworkBlocking(llvm::StringRef networkName,
   return std::move(*DCHECK_NOTNULL(runErr.get()));
 }
 
+llvm::Error HostManager::enableDynamicBatching(llvm::StringRef networkName,
+                                               size_t maxDelayUs) {
+  std::lock_guard<std::mutex> networkLock(networkLock_);
+  auto it = networks_.find(networkName);
+  if (it == networks_.end()) {
+    return MAKE_ERR(
+        GlowErr::ErrorCode::RUNTIME_NET_NOT_FOUND,
+        llvm::formatv("Function {0} not found", networkName).str());
+  }
+
+  // Only the outputs of the network are copied back to the batched requests.
+  auto *network = it->second.active.get();
+  DynamicBatcher::OutputsTy outputs;
+  for (const auto &node : network->dag.nodes) {
+    for (const auto &symbol : node->runtimeBundle->getSymbolTable()) {
+      if (symbol.second.symbolCategory == SymbolCategory::Placeholder &&
+          symbol.second.output) {
+        outputs.insert(network->module->getPlaceholderByName(symbol.first));
+      }
+    }
+  }
+  batcher_->enable(networkName, std::chrono::microseconds(maxDelayUs),
+                   std::move(outputs));
+  return llvm::Error::success();
+}
+
+void HostManager::disableDynamicBatching(llvm::StringRef networkName) {
+  if (batcher_) {
+    batcher_->disable(networkName);
+  }
+}
+
 RunIdentifierTy
 HostManager::runNetwork(llvm::StringRef networkName,
                         std::unique_ptr<ExecutionContext> context,
                         ResultCBTy callback) {
+  return runNetworkImpl(networkName, std::move(context), std::move(callback),
+                        /* allowBatching */ true);
+}
+
+RunIdentifierTy
+HostManager::runNetworkImpl(llvm::StringRef networkName,
+                            std::unique_ptr<ExecutionContext> context,
+                            ResultCBTy callback, bool allowBatching) {
   DCHECK(callback != nullptr);
 
   TRACE_EVENT_SCOPE(context->getTraceContext(), TraceLevel::RUNTIME,
                     "HostManager::runNetwork");
+  auto arrivalTime = std::chrono::steady_clock::now();
   auto currentRun = totalRequestCount_++;
 
   NetworkData *network = nullptr;
+  NetworkData *mirror = nullptr;
   {
     std::lock_guard<std::mutex> networkLock(networkLock_);
     auto it = networks_.find(networkName);
     if (it != networks_.end()) {
-      network = &it->second;
+      auto &versions = it->second;
+      network = versions.active.get();
       network->refcount++;
+      network->lastUsed = ++useClock_;
+      // Spread the mirrored requests evenly over the requests.
+      if (versions.candidate && versions.mirrorPercent != 0 &&
+          (versions.requestCount++ * versions.mirrorPercent) % 100 <
+              versions.mirrorPercent) {
+        mirror = versions.candidate.get();
+        mirror->refcount++;
+      }
     }
   }
 
@@ -296,36 +773,236 @@ HostManager::runNetwork(llvm::StringRef networkName,
     return currentRun;
   }
 
-  size_t activeRequestCount = activeRequestCount_++;
-  if (activeRequestCount >= config_.maxActiveRequests) {
-    activeRequestCount_--;
-    network->refcount--;
-    callback(
-        currentRun,
-        MAKE_ERR(GlowErr::ErrorCode::RUNTIME_REQUEST_REFUSED,
-                 strFormat("The number of allowed requests has been exceeded. "
-                           "active requests: %lu allowed requests: %zu",
-                           activeRequestCount, config_.maxActiveRequests)),
-        std::move(context));
-    return currentRun;
+  // Networks evicted by the residency manager are loaded back first.
+  if (!network->resident) {
+    if (auto err = reloadNetwork(network)) {
+      if (mirror) {
+        releaseNetwork(mirror);
+      }
+      releaseNetwork(network);
+      callback(currentRun, std::move(err), std::move(context));
+      return currentRun;
+    }
   }
 
-  executor_->run(networks_[networkName].dag.root.get(), std::move(context),
-                 currentRun,
-                 [this, callback, name = networkName.str()](
+  // A batched request holds its reference on the network until its batch is
+  // done, the batch itself takes another one when it runs.
+  if (allowBatching && batcher_) {
+    ResultCBTy batchedCallback =
+        [this, callback, network](RunIdentifierTy runID, llvm::Error err,
+                                  std::unique_ptr<ExecutionContext> context) {
+          releaseNetwork(network);
+          callback(runID, std::move(err), std::move(context));
+        };
+    if (batcher_->submit(networkName, currentRun, context, batchedCallback)) {
+      // The batch is mirrored when it runs.
+      if (mirror) {
+        releaseNetwork(mirror);
+      }
+      return currentRun;
+    }
+  }
+
+  // Copy the context of a mirrored request before it is handed over.
+  std::unique_ptr<ExecutionContext> mirrorContext;
+  if (mirror) {
+    mirrorContext = llvm::make_unique<ExecutionContext>(context->clone());
+  }
+
+  std::vector<QueuedRequest> expired;
+  bool admitted = false;
+  bool queued = false;
+  size_t activeRequestCount;
+  {
+    std::lock_guard<std::mutex> queueLock(queueLock_);
+    popExpiredRequests(expired);
+    activeRequestCount = activeRequestCount_;
+    // Queued requests go first, only admit this one directly if none wait.
+    if (queue_.empty() && activeRequestCount < config_.maxActiveRequests) {
+      activeRequestCount_++;
+      admitted = true;
+    } else if (queue_.size() < config_.maxQueuedRequests &&
+               (config_.maxQueuedRequestsPerNetwork == 0 ||
+                network->queuedRequests <
+                    config_.maxQueuedRequestsPerNetwork)) {
+      network->queuedRequests++;
+      queue_.push_back({network, networkName.str(), std::move(context),
+                        callback, currentRun, std::chrono::steady_clock::now(),
+                        arrivalTime});
+      queued = true;
+    }
+    Stats()->setCounter(kQueueDepth, queue_.size());
+  }
+
+  for (auto &request : expired) {
+    refuseRequest(std::move(request),
+                  "The request waited too long in the admission queue.");
+  }
+
+  if (admitted) {
+    dispatchRun(network, networkName, std::move(context), currentRun,
+                std::move(callback), arrivalTime);
+  } else if (!queued) {
+    refuseRequest(
+        {network, networkName.str(), std::move(context), std::move(callback),
+         currentRun, std::chrono::steady_clock::now(), arrivalTime},
+        strFormat("The number of allowed requests has been exceeded. "
+                  "active requests: %lu allowed requests: %zu queued "
+                  "requests: %zu",
+                  activeRequestCount, config_.maxActiveRequests,
+                  config_.maxQueuedRequests));
+  }
+
+  if (mirror) {
+    mirrorRun(mirror, networkName, std::move(mirrorContext), currentRun);
+  }
+  return currentRun;
+}
+
+void HostManager::initNetworkStats(NetworkData &network,
+                                   llvm::StringRef name) {
+  network.requestLatency = Stats()->getHistogram(
+      strFormat("glow.hostmanager.%s.latency_us", name.str().c_str()));
+  network.queueWait = Stats()->getHistogram(
+      strFormat("glow.hostmanager.%s.queue_wait_us", name.str().c_str()));
+}
+
+void HostManager::releaseNetworkStats(llvm::StringRef name) {
+  Stats()->releaseHistogram(
+      strFormat("glow.hostmanager.%s.latency_us", name.str().c_str()));
+  Stats()->releaseHistogram(
+      strFormat("glow.hostmanager.%s.queue_wait_us", name.str().c_str()));
+}
+
+void HostManager::dispatchRun(
+    NetworkData *network, llvm::StringRef networkName,
+    std::unique_ptr<ExecutionContext> context, RunIdentifierTy runID,
+    ResultCBTy callback, std::chrono::steady_clock::time_point arrivalTime) {
+  auto startTime = std::chrono::steady_clock::now();
+  executor_->run(network->dag.root.get(), std::move(context), runID,
+                 [this, network, callback, startTime, arrivalTime,
+                  name = networkName.str()](
                      RunIdentifierTy runID, llvm::Error err,
                      std::unique_ptr<ExecutionContext> context) {
-                   {
-                     std::lock_guard<std::mutex> networkLock(networkLock_);
-                     auto it = networks_.find(name);
-                     if (it != networks_.end()) {
-                       it->second.refcount--;
-                     }
+                   auto endTime = std::chrono::steady_clock::now();
+                   if (network->measureLatency) {
+                     Stats()->addTimeSeriesValue(
+                         network->latencyKey,
+                         std::chrono::duration_cast<std::chrono::microseconds>(
+                             endTime - startTime)
+                             .count());
                    }
+                   if (arrivalTime !=
+                       std::chrono::steady_clock::time_point::max()) {
+                     network->requestLatency->recordMicroseconds(endTime -
+                                                                 arrivalTime);
+                   }
+                   // network may be evicted once released.
+                   releaseNetwork(network);
                    TRACE_EVENT_INSTANT(context->getTraceContext(),
                                        TraceLevel::RUNTIME, "finish_" + name);
                    callback(runID, std::move(err), std::move(context));
                    --activeRequestCount_;
+                   drainQueue();
                  });
-  return currentRun;
+}
+
+void HostManager::mirrorRun(NetworkData *network, llvm::StringRef networkName,
+                            std::unique_ptr<ExecutionContext> context,
+                            RunIdentifierTy runID) {
+  // Mirrored requests only take free active request slots, they never delay
+  // the requests of the active versions.
+  bool admitted = false;
+  {
+    std::lock_guard<std::mutex> queueLock(queueLock_);
+    if (queue_.empty() && activeRequestCount_ < config_.maxActiveRequests) {
+      activeRequestCount_++;
+      admitted = true;
+    }
+  }
+  if (!admitted) {
+    Stats()->incrementCounter(kMirrorsSkipped);
+    releaseNetwork(network);
+    return;
+  }
+
+  Stats()->incrementCounter(kMirroredRequests);
+  // The mirrored runs are not counted in the latency of the requests.
+  dispatchRun(network, networkName, std::move(context), runID,
+              [](RunIdentifierTy, llvm::Error err,
+                 std::unique_ptr<ExecutionContext>) {
+                if (errToBool(std::move(err))) {
+                  Stats()->incrementCounter(kMirrorErrors);
+                }
+              },
+              std::chrono::steady_clock::time_point::max());
+}
+
+void HostManager::releaseNetwork(NetworkData *network) {
+  // The lock orders the release with retireNetwork(), which deletes the
+  // network once its last run is released.
+  std::lock_guard<std::mutex> networkLock(networkLock_);
+  if (--network->refcount == 0 && network->retired) {
+    drainCV_.notify_all();
+  }
+}
+
+void HostManager::refuseRequest(QueuedRequest request, llvm::StringRef msg) {
+  releaseNetwork(request.network);
+  Stats()->incrementCounter(kRequestsRefused);
+  request.callback(
+      request.runID,
+      MAKE_ERR(GlowErr::ErrorCode::RUNTIME_REQUEST_REFUSED, msg.str()),
+      std::move(request.context));
+}
+
+void HostManager::dequeued(const QueuedRequest &request) {
+  request.network->queuedRequests--;
+  auto wait = std::chrono::steady_clock::now() - request.enqueueTime;
+  Stats()->addTimeSeriesValue(
+      kQueueWaitUs,
+      std::chrono::duration_cast<std::chrono::microseconds>(wait).count());
+  request.network->queueWait->recordMicroseconds(wait);
+}
+
+void HostManager::popExpiredRequests(std::vector<QueuedRequest> &expired) {
+  // The queue is sorted by arrival time, the expired requests are in front.
+  auto deadline = std::chrono::steady_clock::now() -
+                  std::chrono::milliseconds(config_.maxQueueWaitMs);
+  while (!queue_.empty() && queue_.front().enqueueTime < deadline) {
+    dequeued(queue_.front());
+    expired.push_back(std::move(queue_.front()));
+    queue_.pop_front();
+    Stats()->incrementCounter(kQueueTimeouts);
+  }
+}
+
+void HostManager::drainQueue() {
+  std::vector<QueuedRequest> expired;
+  std::vector<QueuedRequest> admitted;
+  {
+    std::lock_guard<std::mutex> queueLock(queueLock_);
+    if (queue_.empty()) {
+      return;
+    }
+    popExpiredRequests(expired);
+    while (!queue_.empty() &&
+           activeRequestCount_ < config_.maxActiveRequests) {
+      activeRequestCount_++;
+      dequeued(queue_.front());
+      admitted.push_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+    Stats()->setCounter(kQueueDepth, queue_.size());
+  }
+
+  for (auto &request : expired) {
+    refuseRequest(std::move(request),
+                  "The request waited too long in the admission queue.");
+  }
+  for (auto &request : admitted) {
+    dispatchRun(request.network, request.networkName,
+                std::move(request.context), request.runID,
+                std::move(request.callback), request.arrivalTime);
+  }
 }
@@ -19,10 +19,16 @@
 #include "glow/Backend/CompiledFunction.h"
 #include "glow/Graph/Graph.h"
 #include "glow/Support/Debug.h"
+#include "glow/Support/ThreadPool.h"
+
+#include "llvm/ADT/StringSet.h"
+
+#include <glog/logging.h>
 
 #include <future>
 #include <map>
 #include <queue>
+#include <thread>
 
 using namespace glow;
 using namespace runtime;
@@ -45,7 +51,9 @@ auto sortMostMemory = [](const std::pair<DeviceIDTy, uint64_t> &a,
 };
 } // namespace
 
-Provisioner::Provisioner(DeviceManagerMapTy &devices) {
+Provisioner::Provisioner(DeviceManagerMapTy &devices,
+                         unsigned maxCompileThreads)
+    : maxCompileThreads_(maxCompileThreads) {
   llvm::SmallSet<std::string, 10> used;
   for (auto &device : devices) {
     devices_.push_back(device.second.get());
@@ -94,40 +102,116 @@ llvm::Error Provisioner::provision(DAGListTy &networks, Module &module,
   // copy operation.
   cctx.backendOpts.collectConstants = false;
 
+  // Gather the functions not compiled before, once each, in the order of the
+  // logical devices. A function is compiled for the first node naming it.
+  struct CompileJob {
+    DAGNode *node;
+    Backend *backend;
+    std::unique_ptr<CompiledFunction> compiled;
+    std::unique_ptr<llvm::Error> err;
+  };
+  std::vector<CompileJob> jobs;
+  llvm::StringSet<> scheduled;
+  for (auto &device : logicalDevices) {
+    for (auto &node : device.second) {
+      if (functions_.count(node->name) ||
+          !scheduled.insert(node->name).second) {
+        continue;
+      }
+      Backend *backend = nullptr;
+      for (auto &candidate : backends_) {
+        if (candidate->getBackendName() == node->backendName) {
+          backend = candidate.get();
+          break;
+        }
+      }
+      RETURN_ERR_IF_NOT(backend, "No backend " + node->backendName +
+                                     " for function " + node->name);
+      jobs.push_back({node, backend, nullptr, nullptr});
+    }
+  }
+
+  // Compile the functions concurrently, each job writing only its own slot so
+  // that the results do not depend on the order in which the jobs finish. The
+  // only state of the shared module the backends modify is its list of types,
+  // which Module::uniqueType guards.
+  auto compile = [&module, &cctx](CompileJob &job) {
+    // Copy BackendOptions and add the compiler hints for this function.
+    auto options = cctx.backendOpts;
+    options.backendHints = job.node->backendHints;
+    Function *function = module.getFunction(job.node->name);
+    auto compiledOrErr = job.backend->compile(function, options);
+    if (compiledOrErr) {
+      job.compiled = std::move(*compiledOrErr);
+    } else {
+      job.err = llvm::make_unique<llvm::Error>(compiledOrErr.takeError());
+    }
+  };
+  unsigned numThreads = std::min<size_t>(getCompileThreads(), jobs.size());
+  if (numThreads > 1) {
+    ThreadPool pool(numThreads);
+    std::vector<std::future<void>> done;
+    done.reserve(jobs.size());
+    for (auto &job : jobs) {
+      done.push_back(pool.submit([&compile, &job]() { compile(job); }));
+    }
+    for (auto &future : done) {
+      future.wait();
+    }
+  } else {
+    for (auto &job : jobs) {
+      compile(job);
+    }
+  }
+
+  // Report the failure of the first job in order, logging the other ones.
+  llvm::Error firstErr = llvm::Error::success();
+  bool failed = false;
+  for (auto &job : jobs) {
+    if (!job.err) {
+      continue;
+    }
+    if (!failed) {
+      firstErr = std::move(*job.err);
+      failed = true;
+    } else {
+      LOG(ERROR) << "Failed to compile " << job.node->name << ": "
+                 << llvm::toString(std::move(*job.err));
+    }
+  }
+  RETURN_IF_ERR(firstErr);
+  for (auto &job : jobs) {
+    job.node->runtimeBundle =
+        llvm::make_unique<RuntimeBundle>(job.compiled->getRuntimeBundle());
+    functions_.emplace(job.node->name, std::move(job.compiled));
+  }
+
   std::vector<std::pair<DeviceIDTy, uint64_t>> logicalDeviceSize;
   std::map<DeviceIDTy, std::string> logicalDeviceBackendName;
   std::map<DeviceIDTy, FunctionMapTy> functionMaps;
-  // Compile functions and calculate required memory for each logical device.
-  for (auto &device : logicalDevices) {
+  // \returns the memory the functions of \p logicalID use on \p device.
+  auto getRequiredMemory = [&](DeviceIDTy logicalID,
+                               const DeviceManager &device) {
     uint64_t totalMemory = 0;
+    for (auto &node : logicalDevices[logicalID]) {
+      totalMemory += device.getFunctionMemorySize(*node->runtimeBundle);
+    }
+    return totalMemory;
+  };
+  // Calculate required memory for each logical device, as charged by the
+  // first device of its backend.
+  for (auto &device : logicalDevices) {
     auto nodeBackendName = (device.second[0])->backendName;
     FunctionMapTy functionMap;
     for (auto &node : device.second) {
-      // Only compile if we haven't compiled before. If we have previously
-      // compiled the function reuse it.
-      auto it = functions_.find(node->name);
-      if (it == functions_.end()) {
-        // Copy BackendOptions and add the compiler hints for this function.
-        auto options = cctx.backendOpts;
-        options.backendHints = node->backendHints;
-
-        Function *function = module.getFunction(node->name);
-        for (size_t i = 0, e = backends_.size(); i < e; i++) {
-          if (backends_[i]->getBackendName() == nodeBackendName) {
-            auto compiledOrErr = backends_[i]->compile(function, options);
-            if (!compiledOrErr) {
-              return compiledOrErr.takeError();
-            }
-            auto compiled = std::move(*compiledOrErr);
-            node->runtimeBundle =
-                llvm::make_unique<RuntimeBundle>(compiled->getRuntimeBundle());
-            functions_.emplace(node->name, std::move(compiled));
-            break;
-          }
-        }
-      }
       functionMap.emplace(node->name, functions_[node->name].get());
-      totalMemory += node->runtimeBundle->getConstantWeightSize();
+    }
+    uint64_t totalMemory = 0;
+    for (auto *deviceManager : devices_) {
+      if (deviceManager->getBackendName() == nodeBackendName) {
+        totalMemory = getRequiredMemory(device.first, *deviceManager);
+        break;
+      }
     }
     logicalDeviceSize.push_back(std::make_pair(device.first, totalMemory));
     logicalDeviceBackendName[device.first] = nodeBackendName;
@@ -158,15 +242,17 @@ llvm::Error Provisioner::provision(DAGListTy &networks, Module &module,
       DeviceIDTy deviceID = deviceMemory[j].first;
       if (devices_[deviceID]->getBackendName() == backendName) {
         startPos[backendName] = j + 1;
+        DeviceIDTy logicalID = logicalDeviceSize[i].first;
+        uint64_t requiredMemory =
+            getRequiredMemory(logicalID, *devices_[deviceID]);
         RETURN_ERR_IF_NOT(
-            logicalDeviceSize[i].second < deviceMemory[j].second,
+            requiredMemory < deviceMemory[j].second,
             llvm::formatv("Not enough memory to provision functions "
                           "onto devices. Need {0} bytes, have {1}.",
-                          logicalDeviceSize[i].second, deviceMemory[j].second)
+                          requiredMemory, deviceMemory[j].second)
                 .str());
 
         // Load functions on device.
-        DeviceIDTy logicalID = logicalDeviceSize[i].first;
         std::promise<void> addPromise;
         auto ready = addPromise.get_future();
         std::unique_ptr<llvm::Error> addErr;
@@ -189,6 +275,43 @@ llvm::Error Provisioner::provision(DAGListTy &networks, Module &module,
   return llvm::Error::success();
 };
 
+unsigned Provisioner::getCompileThreads() const {
+  if (maxCompileThreads_) {
+    return maxCompileThreads_;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
 void Provisioner::removeFunction(llvm::StringRef name) {
   functions_.erase(name);
 }
+
+llvm::Error Provisioner::loadFunction(llvm::StringRef name, DeviceIDTy device,
+                                      const Module &module) {
+  auto it = functions_.find(name);
+  RETURN_ERR_IF_NOT(it != functions_.end(),
+                    "No compiled function " + name.str());
+  RETURN_ERR_IF_NOT(device < devices_.size(),
+                    "No device " + std::to_string(device));
+
+  FunctionMapTy functionMap;
+  functionMap.emplace(name, it->second.get());
+  std::promise<void> addPromise;
+  auto ready = addPromise.get_future();
+  std::unique_ptr<llvm::Error> addErr;
+  devices_[device]->addNetwork(
+      &module, std::move(functionMap),
+      [&addErr, &addPromise](const Module *, llvm::Error err) {
+        addErr = llvm::make_unique<llvm::Error>(std::move(err));
+        addPromise.set_value();
+      });
+  ready.wait();
+  return std::move(*DCHECK_NOTNULL(addErr.get()));
+}
+
+void Provisioner::freeConstants(llvm::StringRef name) {
+  auto it = functions_.find(name);
+  if (it != functions_.end()) {
+    it->second->getRuntimeBundle().freeConstants();
+  }
+}
@@ -16,10 +16,78 @@
 
 #include "glow/Runtime/StatsExporter.h"
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 namespace glow {
 
+unsigned Histogram::getBucket(uint64_t value) {
+  if (value < kNumExactBuckets) {
+    return value;
+  }
+  // The three bits following the most significant one pick the sub-bucket.
+  unsigned msb = llvm::Log2_64(value);
+  unsigned shift = msb - 3;
+  return kNumExactBuckets + (msb - 4) * kSubBuckets +
+         ((value >> shift) & (kSubBuckets - 1));
+}
+
+uint64_t Histogram::getBucketUpperBound(unsigned bucket) {
+  if (bucket < kNumExactBuckets) {
+    return bucket;
+  }
+  // The inverse of getBucket(), shift being the position of the most
+  // significant bit minus 3.
+  unsigned index = bucket - kNumExactBuckets;
+  unsigned shift = index / kSubBuckets + 1;
+  uint64_t lower = uint64_t(kSubBuckets + index % kSubBuckets) << shift;
+  return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void Histogram::record(uint64_t value) {
+  buckets_[getBucket(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max && !max_.compare_exchange_weak(max, value)) {
+    // max was reloaded by the failed exchange.
+  }
+}
+
+uint64_t Histogram::getPercentile(double percentile) const {
+  // Count the buckets themselves, count_ may be ahead of them.
+  uint64_t total = 0;
+  for (const auto &bucket : buckets_) {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = std::max<uint64_t>(
+      1, std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100 * total));
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < kNumBuckets; i++) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return std::min(getBucketUpperBound(i), getMax());
+    }
+  }
+  return getMax();
+}
+
+void Histogram::clear() {
+  for (auto &bucket : buckets_) {
+    bucket = 0;
+  }
+  count_ = 0;
+  sum_ = 0;
+  max_ = 0;
+}
+
 void StatsExporterRegistry::registerStatsExporter(StatsExporter *exporter) {
   exporters_.push_back(exporter);
 }
@@ -44,6 +112,36 @@ void StatsExporterRegistry::incrementCounter(llvm::StringRef key,
   }
 }
 
+Histogram *StatsExporterRegistry::getHistogram(llvm::StringRef key) {
+  std::lock_guard<std::mutex> lock(histogramsLock_);
+  auto &histogram = histograms_[key];
+  if (!histogram) {
+    histogram = llvm::make_unique<Histogram>();
+  }
+  return histogram.get();
+}
+
+void StatsExporterRegistry::exportHistograms() {
+  std::lock_guard<std::mutex> lock(histogramsLock_);
+  for (const auto &histogram : histograms_) {
+    for (auto const &exporter : exporters_) {
+      exporter->exportHistogram(histogram.getKey(), *histogram.getValue());
+    }
+  }
+}
+
+void StatsExporterRegistry::releaseHistogram(llvm::StringRef key) {
+  std::lock_guard<std::mutex> lock(histogramsLock_);
+  auto it = histograms_.find(key);
+  if (it == histograms_.end()) {
+    return;
+  }
+  for (auto const &exporter : exporters_) {
+    exporter->exportHistogram(key, *it->getValue());
+  }
+  histograms_.erase(it);
+}
+
 StatsExporterRegistry *Stats() {
   static auto *stats = new StatsExporterRegistry();
   return stats;
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "glow/Support/ThreadAffinity.h"
+#include "glow/Support/ThreadPool.h"
+
+#include "llvm/ADT/SmallVector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace glow {
+
+namespace {
+/// \returns the path of the sysfs directory of NUMA node \p node.
+std::string getNUMANodePath(unsigned node) {
+  return "/sys/devices/system/node/node" + std::to_string(node);
+}
+
+/// Parses \p str as an unsigned into \p value. \returns false on failure.
+bool parseUnsigned(llvm::StringRef str, unsigned &value) {
+  return !str.trim().getAsInteger(10, value);
+}
+} // namespace
+
+llvm::Expected<std::vector<unsigned>> parseCPUList(llvm::StringRef list) {
+  std::vector<unsigned> cpus;
+  llvm::SmallVector<llvm::StringRef, 8> ranges;
+  list.trim().split(ranges, ',', /* MaxSplit */ -1, /* KeepEmpty */ false);
+  for (auto range : ranges) {
+    unsigned first, last;
+    auto bounds = range.split('-');
+    if (!parseUnsigned(bounds.first, first)) {
+      return MAKE_ERR("Invalid CPU list: " + list.str());
+    }
+    last = first;
+    bool isRange = range.find('-') != llvm::StringRef::npos;
+    if (isRange && !parseUnsigned(bounds.second, last)) {
+      return MAKE_ERR("Invalid CPU list: " + list.str());
+    }
+    if (last < first) {
+      return MAKE_ERR("Invalid CPU range " + range.str());
+    }
+    for (unsigned cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  if (cpus.empty()) {
+    return MAKE_ERR("Empty CPU list");
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+llvm::Expected<std::vector<unsigned>> getNUMANodeCPUs(unsigned node) {
+  std::ifstream file(getNUMANodePath(node) + "/cpulist");
+  std::string list;
+  if (!std::getline(file, list)) {
+    return MAKE_ERR("Cannot read the CPUs of NUMA node " +
+                    std::to_string(node));
+  }
+  return parseCPUList(list);
+}
+
+unsigned getNUMANodeCount() {
+  unsigned count = 0;
+  while (std::ifstream(getNUMANodePath(count) + "/cpulist")) {
+    count++;
+  }
+  return std::max(count, 1u);
+}
+
+llvm::Error setCurrentThreadAffinity(llvm::ArrayRef<unsigned> cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    RETURN_ERR_IF_NOT(cpu < CPU_SETSIZE, "Invalid CPU " + std::to_string(cpu));
+    CPU_SET(cpu, &set);
+  }
+  int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  RETURN_ERR_IF_NOT(res == 0, "Cannot set the affinity of a thread, error " +
+                                  std::to_string(res));
+  return llvm::Error::success();
+#else
+  return MAKE_ERR("Thread affinity is not supported on this platform");
+#endif
+}
+
+llvm::Error setThreadPoolAffinity(ThreadPool &pool,
+                                  llvm::ArrayRef<unsigned> cpus) {
+  std::atomic<unsigned> failures{0};
+  auto done = pool.runOnAllThreads([cpus, &failures]() {
+    if (errToBool(setCurrentThreadAffinity(cpus))) {
+      failures++;
+    }
+  });
+  done.wait();
+  RETURN_ERR_IF_NOT(failures == 0, "Cannot set the affinity of " +
+                                       std::to_string(failures) +
+                                       " threads of a pool");
+  return llvm::Error::success();
+}
+
+} // namespace glow
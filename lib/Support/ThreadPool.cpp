@@ -17,9 +17,20 @@
 
 namespace glow {
 
+namespace {
+/// The pool and index of the worker running on this thread, if any, so that
+/// the work items it submits go to its own ring.
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local unsigned currentWorker = 0;
+} // namespace
+
 ThreadExecutor::ThreadExecutor()
     : shouldStop_(false), worker_([this]() { threadPoolWorkerMain(); }) {}
 
+ThreadExecutor::ThreadExecutor(ThreadPool *pool, unsigned index)
+    : shouldStop_(false), pool_(pool), index_(index),
+      worker_([this]() { threadPoolWorkerMain(); }) {}
+
 ThreadExecutor::~ThreadExecutor() { stop(true); }
 
 void ThreadExecutor::stop(bool block) {
@@ -38,17 +49,26 @@ void ThreadExecutor::stop(bool block) {
 }
 
 void ThreadExecutor::threadPoolWorkerMain() {
+  if (pool_) {
+    currentPool = pool_;
+    currentWorker = index_;
+  }
+
   std::unique_lock<std::mutex> lock(workQueueMtx_, std::defer_lock);
 
   while (!shouldStop_) {
     // Lock the lock after processing a work item.
     lock.lock();
 
-    // If work queue is empty, wait to be signalled when
-    // a work item is submitted.
-    while (workQueue_.empty() && !shouldStop_) {
+    // If there is no work item for this thread, wait to be signalled when
+    // one is submitted. sleeping_ is set before checking the pool's work so
+    // that either ThreadPool::wakeWorker sees it or this thread sees the work.
+    sleeping_ = true;
+    while (workQueue_.empty() && !shouldStop_ &&
+           !(pool_ && pool_->hasWork())) {
       queueNotEmpty_.wait(lock);
     }
+    sleeping_ = false;
 
     // If shouldStop_ was set to false while the thread
     // was asleep, break out of the main loop.
@@ -56,32 +76,52 @@ void ThreadExecutor::threadPoolWorkerMain() {
       break;
     }
 
-    // Pop a work item from the queue, and make sure to unlock
-    // the lock before processing it.
-    auto workItem = std::move(workQueue_.front());
-    workQueue_.pop();
+    // The work items of this thread in the default priority class go first,
+    // then the shared ones, which all have the default key, then the work
+    // items of this thread with a lower priority.
+    if (!workQueue_.empty() &&
+        (workQueue_.top().key.priority == 0 || !pool_ || !pool_->hasWork())) {
+      // Pop a work item from the queue, and make sure to unlock
+      // the lock before processing it.
+      auto workItem = std::move(workQueue_.top().task);
+      workQueue_.pop();
+      lock.unlock();
+
+      // Process work item.
+      workItem();
+      continue;
+    }
     lock.unlock();
 
-    // Process work item.
-    workItem();
+    std::packaged_task<void(void)> workItem;
+    if (pool_->takeWork(index_, workItem)) {
+      workItem();
+    }
   }
 }
 
 std::future<void>
-ThreadExecutor::submit(std::packaged_task<void(void)> &&task) {
+ThreadExecutor::submit(std::packaged_task<void(void)> &&task,
+                       const WorkPriority &key) {
   std::unique_lock<std::mutex> lock(workQueueMtx_);
   auto future = task.get_future();
-  workQueue_.push(std::move(task));
+  workQueue_.push({key, nextSequence_++, std::move(task)});
   lock.unlock();
   queueNotEmpty_.notify_one();
   return future;
 }
 
 ThreadPool::ThreadPool(unsigned numWorkers) {
+  // Create the rings before the workers start looking at them.
+  rings_.reserve(numWorkers);
+  for (unsigned i = 0; i < numWorkers; i++) {
+    rings_.emplace_back(new WorkerRing());
+  }
+
   // Intialize all workers and make each one run threadPoolWorkerMain.
-  workers_.reserve(kNumWorkers);
+  workers_.reserve(numWorkers);
   for (unsigned i = 0; i < numWorkers; i++) {
-    workers_.push_back(new ThreadExecutor());
+    workers_.push_back(new ThreadExecutor(this, i));
   }
 }
 
@@ -100,9 +140,79 @@ void ThreadPool::stop(bool block) {
   }
 }
 
-std::future<void> ThreadPool::submit(std::packaged_task<void(void)> &&task) {
-  ThreadExecutor *ex = getExecutor();
-  return ex->submit(std::move(task));
+std::future<void> ThreadPool::submit(std::packaged_task<void(void)> &&task,
+                                     const WorkPriority &key) {
+  // Prioritized work items are ordered by the queue of a single worker.
+  if (key.priority != 0 ||
+      key.deadline != std::chrono::steady_clock::time_point::max()) {
+    return getExecutor()->submit(std::move(task), key);
+  }
+
+  auto future = task.get_future();
+
+  // A worker keeps the work it submits, it is likely the next to be idle.
+  // The count of a ring is incremented first so that it never underestimates
+  // the number of work items in the ring.
+  bool fromWorker = currentPool == this;
+  size_t first = fromWorker ? currentWorker : nextRing_++ % rings_.size();
+  for (;;) {
+    for (size_t i = 0, e = rings_.size(); i < e; i++) {
+      size_t index = (first + i) % e;
+      WorkerRing &ring = *rings_[index];
+      ring.pendingWork++;
+      if (ring.ring.push(task)) {
+        wakeWorker(index);
+        return future;
+      }
+      ring.pendingWork--;
+    }
+    if (fromWorker || workers_[first]->shouldStop_) {
+      break;
+    }
+    // All the rings are full. Other threads wait for the workers to drain
+    // them, which keeps the work items in submission order.
+    std::this_thread::yield();
+  }
+
+  // A worker waiting for the rings could wait for itself, and the rings of a
+  // stopped pool are not drained: fall back to the queue of a worker. The
+  // future of task is already taken, so it is wrapped.
+  workers_[first]->submit([task = std::move(task)]() mutable { task(); });
+  return future;
+}
+
+bool ThreadPool::takeWork(unsigned index,
+                          std::packaged_task<void(void)> &task) {
+  for (size_t i = 0, e = rings_.size(); i < e; i++) {
+    WorkerRing &ring = *rings_[(index + i) % e];
+    if (ring.pendingWork.load() != 0 && ring.ring.pop(task)) {
+      ring.pendingWork--;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::hasWork() const {
+  for (const auto &ring : rings_) {
+    if (ring->pendingWork.load() != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::wakeWorker(unsigned index) {
+  for (size_t i = 0, e = workers_.size(); i < e; i++) {
+    ThreadExecutor *worker = workers_[(index + i) % e];
+    if (worker->sleeping_) {
+      // Taking the lock makes sure the worker is either waiting or has not yet
+      // checked for work.
+      std::lock_guard<std::mutex> lock(worker->workQueueMtx_);
+      worker->queueNotEmpty_.notify_one();
+      return;
+    }
+  }
 }
 
 } // namespace glow
@@ -13,6 +13,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <cstdlib>
 #include <random>
 
@@ -27,16 +28,26 @@ extern void libjit_convolution_f(float *outW, const float *inW, const float *fil
                      const size_t *inWdims, const size_t *filterWdims, 
                      const size_t *biasWdims, const size_t *kernelSizes, 
                      const size_t *strides, const size_t *pads, 
-                     size_t group, unsigned depthUnroll);
+                     size_t group, unsigned depthUnroll, size_t dilation);
+extern void libjit_conv_winograd_f(float *outW, const float *inW,
+                                   const float *filterW, const float *biasW,
+                                   float *scratchW, const size_t *outWdims,
+                                   const size_t *inWdims,
+                                   const size_t *filterWdims,
+                                   const size_t *scratchWdims,
+                                   const size_t *pads, size_t tileSize);
 }
 
-/// Benchmark a convolution with specified parameters on square inputs.
+/// Benchmark a convolution with specified parameters on square inputs. When
+/// winogradTile is not zero the convolution is computed by Winograd
+/// F(winogradTile x winogradTile, 3x3) instead of the direct algorithm.
 class ConvBench : public Benchmark {
   /// Matrices
   std::vector<float> outW;
   std::vector<float> inW;
   std::vector<float> filterW;
   std::vector<float> biasW;
+  std::vector<float> scratchW;
 
   /// Dimensions
   // [batch, h, w, channels]
@@ -44,6 +55,8 @@ class ConvBench : public Benchmark {
   size_t inWdims[4];
   // [outputChannels, h, w, inputChannels]
   size_t filterWdims[4];
+  // [slots, slotSize], the scratch memory of the Winograd transforms.
+  size_t scratchWdims[2];
 
   /// Parameters
   size_t kernelSizes[2];
@@ -51,13 +64,14 @@ class ConvBench : public Benchmark {
   size_t pads[2];
   size_t group;
   unsigned depthUnroll;
-
+  size_t winogradTile;
 
 public:
   ConvBench(size_t inputBatch, size_t inputEdgeSize, size_t inputChannels, size_t filterMultiplier, 
-            size_t kernelSize, size_t stride, size_t pad, size_t group)
+            size_t kernelSize, size_t stride, size_t pad, size_t group,
+            size_t winogradTile)
       : kernelSizes{kernelSize, kernelSize}, strides{stride, stride}, 
-      pads{pad, pad}, group(group) {
+      pads{pad, pad}, group(group), winogradTile(winogradTile) {
 
         inWdims[0] = inputBatch;  
         inWdims[1] = inputEdgeSize;
@@ -76,18 +90,38 @@ public:
         outWdims[3] = filterWdims[0];
 
         depthUnroll = (((outWdims[3] / group) % 8) == 0) ? 8 : 1; 
+
+        // The Winograd filter is transformed to [alpha, alpha, C, D]. Its
+        // values do not matter for timing, so it is only randomized.
+        if (winogradTile) {
+          size_t alpha = winogradTile + 2;
+          filterWdims[0] = alpha;
+          filterWdims[1] = alpha;
+          filterWdims[2] = inWdims[3];
+          filterWdims[3] = outWdims[3];
+          // A single slot, the benchmark runs on one thread. Its layout is
+          // computed by the CPU backend, see CPUBackend::generateInst.
+          size_t C = inWdims[3];
+          size_t D = outWdims[3];
+          scratchWdims[0] = 1;
+          scratchWdims[1] = alpha * alpha * 32 * (C + D) +
+                            2 * alpha * alpha * std::max(C, D) + C;
+        }
       }
 
   virtual void setup() override {
     size_t outSize = mapMult(outWdims, 4);
     size_t inSize = mapMult(inWdims, 4);
     size_t filterSize = mapMult(filterWdims, 4);
-    size_t biasSize = filterWdims[0];
+    size_t biasSize = outWdims[3];
 
     outW.resize(outSize);
     inW.resize(inSize);
     filterW.resize(filterSize);
     biasW.resize(biasSize);
+    if (winogradTile) {
+      scratchW.resize(scratchWdims[0] * scratchWdims[1]);
+    }
 
     randomize(inSize, inW.data());
     randomize(filterSize, filterW.data());
@@ -95,10 +129,16 @@ public:
   }
 
   virtual void run() override {
+    if (winogradTile) {
+      libjit_conv_winograd_f(outW.data(), inW.data(), filterW.data(),
+                             biasW.data(), scratchW.data(), outWdims, inWdims,
+                             filterWdims, scratchWdims, pads, winogradTile);
+      return;
+    }
     // biasWDims isn't used in libjit_convolution_f, so we're passing NULL.
     libjit_convolution_f(outW.data(), inW.data(), filterW.data(), biasW.data(), 
                          outWdims, inWdims, filterWdims, NULL, 
-                         kernelSizes, strides, pads, group, depthUnroll);
+                         kernelSizes, strides, pads, group, depthUnroll, 1);
   }
 
   virtual void teardown() override {}
@@ -123,7 +163,8 @@ private:
 
 int main() {
   constexpr int reps = 10;
-  printf("inputBatch, inputEdgeSize, inputChannels, filterMultiplier, kernelSize, stride, pad, group, bestInSeconds\n");
+  printf("inputBatch, inputEdgeSize, inputChannels, filterMultiplier, "
+         "kernelSize, stride, pad, group, winogradTile, bestInSeconds\n");
 
   for (size_t inputBatch : {1, 3}) {
     for (size_t inputEdgeSize : {7, 56, 224}) {
@@ -137,12 +178,21 @@ int main() {
               for (size_t group : {1, 112}) {
                 if (inputChannels % group != 0)
                   continue;
-                ConvBench b(inputBatch, inputEdgeSize, inputChannels,
-                            filterMultiplier, kernelSize, stride, pad, group);
-                auto time = bench(&b, reps);
-                printf("%zu, %zu, %zu, %zu, %zu, %zu, %zu, %zu, %f\n",
-                       inputBatch, inputEdgeSize, inputChannels,
-                       filterMultiplier, kernelSize, stride, pad, group, time);
+                // Compare the direct convolution (0) with Winograd on the
+                // shapes it supports.
+                for (size_t winogradTile : {0, 2, 4}) {
+                  if (winogradTile &&
+                      (kernelSize != 3 || stride != 1 || group != 1))
+                    continue;
+                  ConvBench b(inputBatch, inputEdgeSize, inputChannels,
+                              filterMultiplier, kernelSize, stride, pad, group,
+                              winogradTile);
+                  auto time = bench(&b, reps);
+                  printf("%zu, %zu, %zu, %zu, %zu, %zu, %zu, %zu, %zu, %f\n",
+                         inputBatch, inputEdgeSize, inputChannels,
+                         filterMultiplier, kernelSize, stride, pad, group,
+                         winogradTile, time);
+                } // winogradTile
               }   // group
             }     // stride
           }       // kernelSize
@@ -13,8 +13,10 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <cstdint>
 #include <cstdlib>
 #include <random>
+#include <vector>
 
 #include "Bench.h"
 
@@ -25,6 +27,43 @@ extern "C" {
 extern void libjit_matmul_f(float *c, const float *a, const float *b,
                             const size_t *cDims, const size_t *aDims,
                             const size_t *bDims);
+extern void libjit_matmul_f_avx2(float *c, const float *a, const float *b,
+                                 const size_t *cDims, const size_t *aDims,
+                                 const size_t *bDims);
+extern void libjit_matmul_f_avx512(float *c, const float *a, const float *b,
+                                   const size_t *cDims, const size_t *aDims,
+                                   const size_t *bDims);
+extern void libjit_matmul_i8(int8_t *outW, const int8_t *lhsW,
+                             const int8_t *rhsW, const size_t *outWdims,
+                             const size_t *lhsWdims, const size_t *rhsWdims,
+                             int32_t outOffset, int32_t lhsOffset,
+                             int32_t rhsOffset, int32_t outPre,
+                             int32_t outPost, int32_t outScale);
+}
+
+/// Signature of the libjit matrix multiplication kernels.
+using MatMulFn = void (*)(float *, const float *, const float *,
+                          const size_t *, const size_t *, const size_t *);
+
+/// A matrix multiplication kernel variant of libjit.
+struct GemmKernel {
+  const char *name;
+  MatMulFn fn;
+  /// Whether the host CPU can run this kernel.
+  bool supported;
+};
+
+/// \returns the kernel variants of libjit_matmul_f.
+static std::vector<GemmKernel> getKernels() {
+  std::vector<GemmKernel> kernels{{"generic", libjit_matmul_f, true}};
+#if defined(__x86_64__) || defined(__i386__)
+  kernels.push_back({"avx2", libjit_matmul_f_avx2,
+                     __builtin_cpu_supports("avx2") &&
+                         __builtin_cpu_supports("fma")});
+  kernels.push_back({"avx512", libjit_matmul_f_avx512,
+                     bool(__builtin_cpu_supports("avx512f"))});
+#endif
+  return kernels;
 }
 
 /// Benchmark an (m x k) * (k x n) = (m x n) matrix multiplication.
@@ -39,9 +78,12 @@ class GemmBench : public Benchmark {
   size_t bDims[2];
   size_t cDims[2];
 
+  /// Kernel under test.
+  MatMulFn kernel;
+
 public:
-  GemmBench(size_t m, size_t n, size_t k)
-      : aDims{m, k}, bDims{k, n}, cDims{m, n} {}
+  GemmBench(size_t m, size_t n, size_t k, MatMulFn kernel)
+      : aDims{m, k}, bDims{k, n}, cDims{m, n}, kernel(kernel) {}
 
   void setup() override {
     size_t m = cDims[0];
@@ -56,7 +98,7 @@ public:
   }
 
   void run() override {
-    libjit_matmul_f(c.data(), a.data(), b.data(), cDims, aDims, bDims);
+    kernel(c.data(), a.data(), b.data(), cDims, aDims, bDims);
   }
 
   void teardown() override {}
@@ -75,9 +117,53 @@ private:
   }
 };
 
+/// Benchmark an (m x k) * (k x n) = (m x n) int8 matrix multiplication, which
+/// packs the k x n operand on every run like the quantized MatMul and FC.
+class QGemmBench : public Benchmark {
+  /// Matrices.
+  std::vector<int8_t> a;
+  std::vector<int8_t> b;
+  std::vector<int8_t> c;
+
+  /// Dimensions expressed in libjit's format.
+  size_t aDims[2];
+  size_t bDims[2];
+  size_t cDims[2];
+
+public:
+  QGemmBench(size_t m, size_t n, size_t k)
+      : aDims{m, k}, bDims{k, n}, cDims{m, n} {}
+
+  void setup() override {
+    std::mt19937 gen;
+    std::uniform_int_distribution<> dis(-128, 127);
+    a.resize(aDims[0] * aDims[1]);
+    b.resize(bDims[0] * bDims[1]);
+    c.resize(cDims[0] * cDims[1]);
+    for (auto &v : a) {
+      v = dis(gen);
+    }
+    for (auto &v : b) {
+      v = dis(gen);
+    }
+  }
+
+  void run() override {
+    libjit_matmul_i8(c.data(), a.data(), b.data(), cDims, aDims, bDims,
+                     /* outOffset */ 0, /* lhsOffset */ -5,
+                     /* rhsOffset */ 3, /* outPre */ 0, /* outPost */ 15,
+                     /* outScale */ 1);
+  }
+
+  void teardown() override {}
+
+  double gops() const { return 2.0 * cDims[0] * cDims[1] * aDims[1] / 1e9; }
+};
+
 int main() {
   constexpr int reps = 100;
-  printf("outX, outY, lhsX, lhsY, rhsX, rhsY, gflops/s, \n");
+  auto kernels = getKernels();
+  printf("kernel,  outX, outY, lhsX, lhsY, rhsX, rhsY, gflops/s, \n");
 
   for (int i = 0; i < 2; i++) {
     for (int j = 0; j < 2; j++) {
@@ -90,12 +176,26 @@ int main() {
           size_t n = j ? 32 : x;
           size_t k = p ? 32 : x;
 
-          GemmBench b(m, n, k);
-          auto time = bench(&b, reps);
-          printf("%4zu, %-4zu,   %4zu, %-4zu,   %4zu,  %-4zu,   %5.2lf\n", m, n,
-                 m, k, k, n, b.gflops() / time);
+          for (const auto &kernel : kernels) {
+            if (!kernel.supported) {
+              continue;
+            }
+            GemmBench b(m, n, k, kernel.fn);
+            auto time = bench(&b, reps);
+            printf("%-7s, %4zu, %-4zu,   %4zu, %-4zu,   %4zu,  %-4zu,   "
+                   "%5.2lf\n",
+                   kernel.name, m, n, m, k, k, n, b.gflops() / time);
+          }
         }
       }
     }
   }
+
+  // The int8 kernel, in giga operations per second.
+  for (size_t x = 32; x <= 1024; x += 32) {
+    QGemmBench b(x, x, x);
+    auto time = bench(&b, reps);
+    printf("%-7s, %4zu, %-4zu,   %4zu, %-4zu,   %4zu,  %-4zu,   %5.2lf\n",
+           "int8", x, x, x, x, x, x, b.gops() / time);
+  }
 }
@@ -20,10 +20,14 @@
 #include "glow/Optimizer/GraphOptimizer/GraphOptimizer.h"
 #include "glow/Runtime/Executor/ThreadPoolExecutor.h"
 #include "glow/Runtime/HostManager/HostManager.h"
+#include "glow/Support/ThreadAffinity.h"
 
 #include "CPUBackend.h"
 
+#include <atomic>
+#include <functional>
 #include <future>
+#include <thread>
 
 using namespace glow;
 using namespace glow::runtime;
@@ -88,12 +92,17 @@ using namespace glow::runtime;
 /// functions in \p mod using \p backend and adding them to the DeviceManager
 /// instance. A reference to the configured DeviceManager instance is returned
 /// in \p deviceManager, and all CompiledFunctions creating during compilation
-/// are returned in \p deviceManagerFunctions.
+/// are returned in \p deviceManagerFunctions. The DeviceConfig of the
+/// DeviceManager holds \p parameters. If set, \p prepareFunctions is called
+/// with the compiled functions before they are added to the DeviceManager.
 void setUpDeviceManagerCommon(
     benchmark::State &state, std::unique_ptr<Backend> &backend,
     std::unique_ptr<Module> &mod, std::unique_ptr<DeviceManager> &deviceManager,
     std::unordered_map<std::string, std::unique_ptr<CompiledFunction>>
-        &deviceManagerFunctions) {
+        &deviceManagerFunctions,
+    const llvm::StringMap<std::string> &parameters = {},
+    const std::function<void(const FunctionMapTy &)> &prepareFunctions =
+        nullptr) {
 
   // Check that the backend is valid.
   if (!backend) {
@@ -108,9 +117,10 @@ void setUpDeviceManagerCommon(
   }
 
   // Create and initialize the DeviceManager instance.
-  deviceManager =
-      std::unique_ptr<DeviceManager>(DeviceManager::createDeviceManager(
-          DeviceConfig(backend->getBackendName())));
+  DeviceConfig config(backend->getBackendName());
+  config.parameters = parameters;
+  deviceManager = std::unique_ptr<DeviceManager>(
+      DeviceManager::createDeviceManager(config));
   bool error = errToBool(deviceManager->init());
 
   if (error) {
@@ -132,6 +142,10 @@ void setUpDeviceManagerCommon(
         std::make_pair(function->getName(), std::move(compiledFunction)));
   }
 
+  if (prepareFunctions) {
+    prepareFunctions(funcs);
+  }
+
   // Add all compiled functions to the DeviceManager instance.
   std::promise<bool> promise;
   std::future<bool> future = promise.get_future();
@@ -606,6 +620,168 @@ DECLARE_RUNTIME_BENCHMARK(SingleNode, createSingleNodeModule,
 // backend.
 INSTANTIATE_RUNTIME_BENCHMARK(SingleNode, CPUBackend);
 
+//===--------------------------------------------------------------------===//
+//                       CPU Affinity Benchmark                             //
+//===--------------------------------------------------------------------===//
+
+/// Create a module consisting of a single FC operator whose weights do not
+/// fit in the caches, so that its throughput depends on memory locality.
+std::unique_ptr<Module> createLargeFCModule() {
+  auto mod = llvm::make_unique<Module>();
+  auto fn = mod->createFunction("largeFC");
+  PlaceholderBindings bindings;
+
+  auto *input =
+      mod->createPlaceholder(ElemKind::FloatTy, {64, 1024}, "input", false);
+  auto *weights =
+      mod->createPlaceholder(ElemKind::FloatTy, {1024, 4096}, "weights", false);
+  auto *bias = mod->createPlaceholder(ElemKind::FloatTy, {4096}, "bias", false);
+  auto *output =
+      mod->createPlaceholder(ElemKind::FloatTy, {64, 4096}, "output", false);
+
+  auto *fc = fn->createFullyConnected("fc", input, weights, bias);
+  fn->createSave("save", fc, output);
+
+  bindings.allocate(weights)->getHandle().randomize(-1, 1, mod->getPRNG());
+  bindings.allocate(bias)->getHandle().clear(1);
+
+  glow::convertPlaceholdersToConstants(fn, bindings, {input, output});
+
+  return mod;
+}
+
+/// Benchmark of the throughput of one CPU device per NUMA node of the host,
+/// each running kRunsPerDevice requests at a time on its execution slots. The
+/// threads of every device are pinned to the cores of its node if
+/// state.range(0) is 1, and float across the sockets if it is 0. In both
+/// cases the constants of every device are copied by a thread pinned to its
+/// node before the network is added, so only the placement of the threads
+/// and activations differs.
+class CPUAffinityBenchmark : public benchmark::Fixture {
+public:
+  void SetUp(benchmark::State &state) override {
+    bool pinned = state.range(0);
+    unsigned numNodes = getNUMANodeCount();
+    backend_ = llvm::make_unique<CPUBackend>();
+    devices_.resize(numNodes);
+    for (unsigned node = 0; node < numNodes; node++) {
+      auto &device = devices_[node];
+      llvm::StringMap<std::string> parameters;
+      parameters["executionSlots"] = std::to_string(kRunsPerDevice);
+      if (pinned) {
+        parameters["numaNode"] = std::to_string(node);
+      }
+      device.mod = createLargeFCModule();
+      setUpDeviceManagerCommon(
+          state, backend_, device.mod, device.deviceManager, device.functions,
+          parameters, [&](const FunctionMapTy &funcs) {
+            collectConstantsOnNode(state, device.mod.get(), funcs, node);
+          });
+      for (unsigned i = 0; i < kRunsPerDevice; i++) {
+        auto bindings = llvm::make_unique<PlaceholderBindings>();
+        bindings->allocate(device.mod->getPlaceholders());
+        device.contexts.push_back(
+            llvm::make_unique<ExecutionContext>(std::move(bindings)));
+      }
+    }
+  }
+
+  void TearDown(benchmark::State &state) override {
+    for (auto &device : devices_) {
+      if (device.deviceManager) {
+        tearDownDeviceManagerCommon(state, device.deviceManager,
+                                    device.functions);
+      }
+    }
+    devices_.clear();
+    backend_.reset();
+  }
+
+  void runBenchmark(benchmark::State &state) {
+    size_t numRuns = devices_.size() * kRunsPerDevice;
+    for (auto _ : state) {
+      // Run kRunsPerDevice requests on every device and wait for all of them.
+      std::atomic<size_t> pending{numRuns};
+      std::promise<void> promise;
+      std::future<void> future = promise.get_future();
+      for (auto &device : devices_) {
+        for (auto &ctx : device.contexts) {
+          device.deviceManager->runFunction(
+              "largeFC", std::move(ctx),
+              [&promise, &pending, &ctx](
+                  runtime::RunIdentifierTy /*runId*/, llvm::Error err,
+                  std::unique_ptr<ExecutionContext> result) {
+                errToBool(std::move(err));
+                ctx = std::move(result);
+                if (--pending == 0) {
+                  promise.set_value();
+                }
+              });
+        }
+      }
+      future.wait();
+    }
+    state.SetItemsProcessed(state.iterations() * numRuns);
+  }
+
+protected:
+  /// Copies the constants of \p funcs of \p mod from a thread pinned to the
+  /// cores of NUMA node \p node, so that they are allocated on the node.
+  /// Every node keeps its own copy, whether or not the device is pinned.
+  static void collectConstantsOnNode(benchmark::State &state,
+                                     const Module *mod,
+                                     const FunctionMapTy &funcs,
+                                     unsigned node) {
+    bool error = false;
+    std::thread thread([&]() {
+      auto cpusOrErr = getNUMANodeCPUs(node);
+      if (!cpusOrErr) {
+        error = errToBool(cpusOrErr.takeError());
+        return;
+      }
+      error = errToBool(setCurrentThreadAffinity(cpusOrErr.get()));
+      if (error) {
+        return;
+      }
+      for (const auto &func : funcs) {
+        func.second->getRuntimeBundle().collectSharedConstants(mod, node);
+      }
+    });
+    thread.join();
+    if (error) {
+      state.SkipWithError("Unable to pin a thread to the NUMA node!");
+    }
+  }
+
+  /// Number of requests run at a time by every device.
+  static constexpr unsigned kRunsPerDevice{4};
+
+  /// A CPU device, the module and functions it runs and the contexts of its
+  /// requests.
+  struct Device {
+    std::unique_ptr<Module> mod;
+    std::unique_ptr<DeviceManager> deviceManager;
+    std::unordered_map<std::string, std::unique_ptr<CompiledFunction>>
+        functions;
+    std::vector<std::unique_ptr<ExecutionContext>> contexts;
+  };
+
+  /// The backend compiling the functions of the devices.
+  std::unique_ptr<Backend> backend_;
+  /// One device per NUMA node.
+  std::vector<Device> devices_;
+};
+
+BENCHMARK_DEFINE_F(CPUAffinityBenchmark, Throughput)
+(benchmark::State &state) { runBenchmark(state); }
+// Compare the unpinned (0) and pinned (1) devices.
+BENCHMARK_REGISTER_F(CPUAffinityBenchmark, Throughput)
+    ->ArgName("pinned")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
 //===--------------------------------------------------------------------===//
 //                           Benchmark Main                                 //
 //===--------------------------------------------------------------------===//
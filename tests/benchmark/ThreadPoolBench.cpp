@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdio>
+#include <vector>
+
+#include "Bench.h"
+
+#include "glow/Support/ThreadPool.h"
+
+using namespace glow;
+
+/// How work items are handed to the ThreadPool.
+enum class Dispatch {
+  /// Round-robin over the workers through getExecutor(), each work item
+  /// staying on its thread, as the pool used to dispatch.
+  RoundRobin,
+  /// ThreadPool::submit, idle workers stealing the queued work items.
+  Stealing,
+};
+
+static const char *getDispatchName(Dispatch dispatch) {
+  return dispatch == Dispatch::RoundRobin ? "roundrobin" : "stealing";
+}
+
+/// Busy-waits for \p us microseconds.
+static void spin(unsigned us) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+/// Submits \p fn to \p pool with \p dispatch.
+template <typename F>
+static std::future<void> dispatchWork(ThreadPool &pool, Dispatch dispatch,
+                                      F &&fn) {
+  if (dispatch == Dispatch::RoundRobin) {
+    return pool.getExecutor()->submit(std::forward<F>(fn));
+  }
+  return pool.submit(std::forward<F>(fn));
+}
+
+/// Measures the latency of dispatching one empty work item and waiting for
+/// its completion.
+class LatencyBench : public Benchmark {
+  ThreadPool pool_;
+  Dispatch dispatch_;
+  size_t items_;
+
+public:
+  LatencyBench(unsigned threads, Dispatch dispatch, size_t items)
+      : pool_(threads), dispatch_(dispatch), items_(items) {}
+
+  void setup() override {}
+
+  void run() override {
+    for (size_t i = 0; i < items_; i++) {
+      dispatchWork(pool_, dispatch_, []() {}).get();
+    }
+  }
+
+  void teardown() override {}
+};
+
+/// Measures the throughput of a burst of work items, one in \p slowEvery of
+/// them taking \p slowUs microseconds and the others \p fastUs.
+class ThroughputBench : public Benchmark {
+  ThreadPool pool_;
+  Dispatch dispatch_;
+  size_t items_;
+  unsigned fastUs_;
+  unsigned slowUs_;
+  size_t slowEvery_;
+
+public:
+  ThroughputBench(unsigned threads, Dispatch dispatch, size_t items,
+                  unsigned fastUs, unsigned slowUs, size_t slowEvery)
+      : pool_(threads), dispatch_(dispatch), items_(items), fastUs_(fastUs),
+        slowUs_(slowUs), slowEvery_(slowEvery) {}
+
+  void setup() override {}
+
+  void run() override {
+    std::vector<std::future<void>> futures;
+    futures.reserve(items_);
+    for (size_t i = 0; i < items_; i++) {
+      unsigned us = i % slowEvery_ == 0 ? slowUs_ : fastUs_;
+      futures.push_back(dispatchWork(pool_, dispatch_, [us]() { spin(us); }));
+    }
+    for (auto &future : futures) {
+      future.get();
+    }
+  }
+
+  void teardown() override {}
+};
+
+int main() {
+  constexpr size_t reps = 5;
+  constexpr size_t latencyItems = 10000;
+  constexpr size_t burstItems = 20000;
+  const Dispatch dispatches[] = {Dispatch::RoundRobin, Dispatch::Stealing};
+
+  printf("bench,      dispatch,   threads, work,         us/item, "
+         "items/s\n");
+  for (unsigned threads : {1, 4, 8}) {
+    for (auto dispatch : dispatches) {
+      LatencyBench b(threads, dispatch, latencyItems);
+      double time = bench(&b, reps);
+      printf("latency,    %-10s, %7u, empty,        %7.2lf, %9.0lf\n",
+             getDispatchName(dispatch), threads, time * 1e6 / latencyItems,
+             latencyItems / time);
+    }
+
+    struct {
+      const char *name;
+      unsigned fastUs;
+      unsigned slowUs;
+      size_t slowEvery;
+    } loads[] = {
+        {"empty", 0, 0, 1},
+        {"uniform 5us", 5, 5, 1},
+        {"skewed 500us", 2, 500, 64},
+    };
+    for (const auto &load : loads) {
+      for (auto dispatch : dispatches) {
+        ThroughputBench b(threads, dispatch, burstItems, load.fastUs,
+                          load.slowUs, load.slowEvery);
+        double time = bench(&b, reps);
+        printf("throughput, %-10s, %7u, %-12s, %7.2lf, %9.0lf\n",
+               getDispatchName(dispatch), threads, load.name,
+               time * 1e6 / burstItems, burstItems / time);
+      }
+    }
+  }
+}
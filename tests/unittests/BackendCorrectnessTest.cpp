@@ -392,6 +392,44 @@ TEST_P(CPUOnly, convDKKC8Test) {
   EXPECT_TRUE(out1.isEqual(out2));
 }
 
+/// This test targets the Winograd F(4x4, 3x3) optimization. The output is not
+/// a multiple of the tile size.
+TEST_P(CPUOnly, convWinograd4x4Test) {
+  Tensor out1;
+  Tensor out2;
+  inferConvWinograd(&out1, {2, 10, 11, 32}, 24, "CPU");
+  inferConvWinograd(&out2, {2, 10, 11, 32}, 24, "Interpreter");
+  EXPECT_TRUE(out1.isEqual(out2, 0.001));
+}
+
+/// This test targets the depthwise convolution kernel.
+TEST_P(CPUOnly, depthwiseConvTest) {
+  Tensor out1;
+  Tensor out2;
+  inferDepthwiseConv(&out1, /* quantized */ false, "CPU");
+  inferDepthwiseConv(&out2, /* quantized */ false, "Interpreter");
+  EXPECT_TRUE(out1.isEqual(out2, 0.0001));
+}
+
+/// This test targets the quantized depthwise convolution kernel. The backends
+/// may round the requantization differently, allow one quantization step.
+TEST_P(CPUOnly, depthwiseConvQuantizedTest) {
+  Tensor out1;
+  Tensor out2;
+  inferDepthwiseConv(&out1, /* quantized */ true, "CPU");
+  inferDepthwiseConv(&out2, /* quantized */ true, "Interpreter");
+  EXPECT_TRUE(out1.isEqual(out2, 0.06));
+}
+
+/// This test targets the Winograd F(2x2, 3x3) optimization.
+TEST_P(CPUOnly, convWinograd2x2Test) {
+  Tensor out1;
+  Tensor out2;
+  inferConvWinograd(&out1, {1, 5, 7, 16}, 16, "CPU");
+  inferConvWinograd(&out2, {1, 5, 7, 16}, 16, "Interpreter");
+  EXPECT_TRUE(out1.isEqual(out2, 0.0001));
+}
+
 TEST_P(BackendCorrectnessTest, softmaxGradTest) {
   PseudoRNG PRNG;
   std::array<size_t, 2> S{{8, 23}};
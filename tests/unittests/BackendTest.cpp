@@ -15,6 +15,7 @@
  */
 
 #include "glow/Backend/BackendUtils.h"
+#include "glow/Backend/ConstantStore.h"
 #include "glow/ExecutionEngine/ExecutionEngine.h"
 #include "glow/Graph/Graph.h"
 #include "glow/Graph/PlaceholderBindings.h"
@@ -245,6 +246,58 @@ TEST(RuntimeBundle, ContiguousPlaceholder) {
   EXPECT_EQ(flag, true);
 }
 
+/// Test that the bundles of functions with identical constants share a single
+/// block of constants, freed with the last bundle.
+TEST(RuntimeBundle, SharedConstants) {
+  auto createModule = [](float value) {
+    auto mod = llvm::make_unique<Module>();
+    Function *F = mod->createFunction("main");
+    auto *X = mod->createPlaceholder(ElemKind::FloatTy, {16}, "X", false);
+    auto *W = mod->createConstant(ElemKind::FloatTy, {16}, "W");
+    W->getPayloadMutable().getHandle().clear(value);
+    F->createSave("save", F->createAdd("add", X, W));
+    return mod;
+  };
+  std::unique_ptr<Backend> backend(createBackend("Interpreter"));
+  BackendOptions opts;
+  opts.collectConstants = false;
+  auto compile = [&](Module &mod) {
+    auto function =
+        EXIT_ON_ERR(backend->compile(mod.getFunction("main"), opts));
+    function->getRuntimeBundle().collectSharedConstants(&mod);
+    return function;
+  };
+
+  auto *store = runtime::SharedConstants();
+  size_t numBlocks = store->getNumBlocks();
+  auto mod1 = createModule(1);
+  auto mod2 = createModule(1);
+  auto mod3 = createModule(2);
+  auto function1 = compile(*mod1);
+  auto function2 = compile(*mod2);
+  auto function3 = compile(*mod3);
+
+  // The replicas share their constants, the other function does not.
+  auto &bundle1 = function1->getRuntimeBundle();
+  ASSERT_NE(bundle1.getConstants(), nullptr);
+  EXPECT_EQ(bundle1.getConstants(),
+            function2->getRuntimeBundle().getConstants());
+  EXPECT_NE(bundle1.getConstants(),
+            function3->getRuntimeBundle().getConstants());
+  EXPECT_EQ(store->getNumBlocks(), numBlocks + 2);
+
+  // The shared block holds the constants until its last bundle is freed.
+  function1.reset();
+  auto &bundle2 = function2->getRuntimeBundle();
+  const auto &info = bundle2.getSymbolTable().at("W");
+  auto *W = reinterpret_cast<float *>(bundle2.getConstants() + info.offset);
+  EXPECT_EQ(W[15], 1);
+  EXPECT_EQ(store->getNumBlocks(), numBlocks + 2);
+  function2.reset();
+  function3.reset();
+  EXPECT_EQ(store->getNumBlocks(), numBlocks);
+}
+
 TEST_P(BackendTest, simpleInference) {
   Tensor inputs(ElemKind::FloatTy, {1, 32, 32, 3});
   PlaceholderBindings bindings;
@@ -489,6 +542,38 @@ TEST_P(BackendTest, simplePlaceholderValue) {
   EXPECT_TRUE(STensor->isEqual(data));
 }
 
+/// Test that Placeholders are bound correctly when some of the backing tensors
+/// cannot be used in place by the backend, here because they are misaligned.
+TEST_P(BackendTest, misalignedPlaceholderValue) {
+  auto &mod = EE_.getModule();
+  Function *F = mod.createFunction("main");
+  auto *A = mod.createPlaceholder(ElemKind::FloatTy, {4}, "A", false);
+  auto *B = mod.createPlaceholder(ElemKind::FloatTy, {4}, "B", false);
+  auto *add = F->createAdd("add", A, B);
+  auto *S = F->createSave("ret", add);
+
+  // Back A and the result with unowned tensors whose payloads are offset by
+  // one element from an aligned buffer. B uses a regular aligned tensor.
+  Tensor inputStorage(ElemKind::FloatTy, {5});
+  Tensor resultStorage(ElemKind::FloatTy, {5});
+  auto *inputData = reinterpret_cast<float *>(inputStorage.getUnsafePtr()) + 1;
+  auto *resultData =
+      reinterpret_cast<float *>(resultStorage.getUnsafePtr()) + 1;
+
+  PlaceholderBindings bindings;
+  bindings.insert(A, Tensor(inputData, A->getType()));
+  bindings.insert(S->getPlaceholder(),
+                  Tensor(resultData, S->getPlaceholder()->getType()));
+  bindings.get(A)->getHandle() = {1.0, 2.0, 3.0, 4.0};
+  bindings.allocate(B)->getHandle() = {10.0, 20.0, 30.0, 40.0};
+
+  EE_.compile(CompilationMode::Infer);
+  EE_.run(bindings);
+
+  Tensor expected{11.0, 22.0, 33.0, 44.0};
+  EXPECT_TRUE(bindings.get(S->getPlaceholder())->isEqual(expected));
+}
+
 /// Add and compile a network, then add and compile another so that the first
 /// CompiledFunction does not know about every Placeholder in the module.
 TEST_P(BackendTest, compileThenAddNetwork) {
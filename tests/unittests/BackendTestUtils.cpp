@@ -792,6 +792,87 @@ void inferConvDKKC8(Tensor *out, llvm::StringRef kind) {
   out->assign(resultTensor);
 }
 
+void inferConvWinograd(Tensor *out, llvm::ArrayRef<size_t> inputDims,
+                       size_t outChannels, llvm::StringRef kind) {
+  PseudoRNG PRNG;
+  PlaceholderBindings bindings;
+  ExecutionEngine EE(kind);
+  auto &mod = EE.getModule();
+  auto *F = mod.createFunction("main");
+
+  auto *input =
+      mod.createPlaceholder(ElemKind::FloatTy, inputDims, "input", false);
+  bindings.allocate(input)->getHandle().randomize(-1.0, 1.0, PRNG);
+
+  // The filter must be a constant for the CPU backend to transform it.
+  auto *filter = mod.createConstant(
+      ElemKind::FloatTy, {outChannels, 3, 3, inputDims[3]}, "filter");
+  filter->getPayloadMutable().getHandle().randomize(-1.0, 1.0, PRNG);
+  auto *bias = mod.createConstant(ElemKind::FloatTy, {outChannels}, "bias");
+  bias->getPayloadMutable().getHandle().randomize(-1.0, 1.0, PRNG);
+  auto outTy = mod.uniqueType(ElemKind::FloatTy, {inputDims[0], inputDims[1],
+                                                  inputDims[2], outChannels});
+
+  ConvolutionNode *CN = F->createConv("Conv", input, filter, bias, outTy,
+                                      {3, 3}, {1, 1}, {1, 1, 1, 1}, 1);
+  SaveNode *result = F->createSave("save", CN);
+  auto *resultTensor = bindings.allocate(result->getPlaceholder());
+
+  EE.compile(CompilationMode::Infer);
+
+  EE.run(bindings);
+  out->assign(resultTensor);
+}
+
+void inferDepthwiseConv(Tensor *out, bool quantized, llvm::StringRef kind) {
+  PseudoRNG PRNG;
+  PlaceholderBindings bindings;
+  ExecutionEngine EE(kind);
+  auto &mod = EE.getModule();
+  auto *F = mod.createFunction("main");
+
+  // 16 groups of one input channel, each producing two output channels.
+  auto *input = mod.createPlaceholder(ElemKind::FloatTy, {2, 9, 10, 16},
+                                      "input", false);
+  bindings.allocate(input)->getHandle().randomize(-1.0, 1.0, PRNG);
+  NodeValue in = input;
+  Constant *filter;
+  Constant *bias;
+  TypeRef outTy;
+  if (quantized) {
+    in = F->createQuantize(
+        "quantize", input,
+        mod.uniqueType(ElemKind::Int8QTy, {2, 9, 10, 16}, 1.0 / 127, 3));
+    filter = mod.createConstant(ElemKind::Int8QTy, {32, 3, 3, 1}, 1.0 / 127,
+                                -1, "filter");
+    filter->getPayloadMutable().getHandle<int8_t>().randomize(-128, 127, PRNG);
+    bias = mod.createConstant(ElemKind::Int32QTy, {32}, 1.0 / (127 * 127), 0,
+                              "bias");
+    bias->getPayloadMutable().getHandle<int32_t>().randomize(-1000, 1000,
+                                                             PRNG);
+    outTy = mod.uniqueType(ElemKind::Int8QTy, {2, 5, 5, 32}, 0.05, -2);
+  } else {
+    filter = mod.createConstant(ElemKind::FloatTy, {32, 3, 3, 1}, "filter");
+    filter->getPayloadMutable().getHandle().randomize(-1.0, 1.0, PRNG);
+    bias = mod.createConstant(ElemKind::FloatTy, {32}, "bias");
+    bias->getPayloadMutable().getHandle().randomize(-1.0, 1.0, PRNG);
+    outTy = mod.uniqueType(ElemKind::FloatTy, {2, 5, 5, 32});
+  }
+
+  NodeValue conv = F->createConv("conv", in, filter, bias, outTy, {3, 3},
+                                 {2, 2}, {1, 1, 1, 1}, 16);
+  if (quantized) {
+    conv = F->createDequantize("dequantize", conv);
+  }
+  SaveNode *result = F->createSave("save", conv);
+  auto *resultTensor = bindings.allocate(result->getPlaceholder());
+
+  EE.compile(CompilationMode::Infer);
+
+  EE.run(bindings);
+  out->assign(resultTensor);
+}
+
 void trainSoftMaxNet(Tensor *inputs, Tensor *weights, Tensor *bias,
                      Tensor *selected, Tensor *out, llvm::StringRef kind) {
   ExecutionEngine EEI(kind);
@@ -273,6 +273,11 @@ void inferNonSquareStrideConv(Tensor *out, llvm::StringRef kind);
 
 void inferConvDKKC8(Tensor *out, llvm::StringRef kind);
 
+void inferConvWinograd(Tensor *out, llvm::ArrayRef<size_t> inputDims,
+                       size_t outChannels, llvm::StringRef kind);
+
+void inferDepthwiseConv(Tensor *out, bool quantized, llvm::StringRef kind);
+
 void inferSmallConv(Tensor *inputs, Tensor *out, llvm::StringRef kind);
 
 void trainSoftMaxNet(Tensor *inputs, Tensor *weights, Tensor *bias,
@@ -25,6 +25,9 @@
 
 #include "gtest/gtest.h"
 
+#include "llvm/Support/CommandLine.h"
+
+#include <atomic>
 #include <chrono>
 #include <future>
 
@@ -582,21 +585,25 @@ TEST(DeviceManagerTest, AvailableMemory) {
   std::promise<const Module *> promise;
   std::future<const Module *> future;
 
+  // The device has exactly the memory used by one network.
+  auto module = makeBasicModule();
+  auto functions = compileFunctions("CPU", module.get(), backing);
+  uint64_t expectedBytes =
+      backing.back()->getRuntimeBundle().getDeviceMemorySize();
+  ASSERT_GT(expectedBytes, 0);
+
   auto config = DeviceConfig("CPU");
-  config.setDeviceMemory(1);
+  config.setDeviceMemory(expectedBytes);
   CPUDeviceManager cpuCoreDevice(config);
   ASSERT_FALSE(errToBool(cpuCoreDevice.init()));
 
-  uint64_t expectedBytes = 1;
   EXPECT_EQ(cpuCoreDevice.getMaximumMemory(), expectedBytes);
   EXPECT_EQ(cpuCoreDevice.getAvailableMemory(), expectedBytes);
   EXPECT_TRUE(cpuCoreDevice.isMemoryAvailable(expectedBytes));
   EXPECT_FALSE(cpuCoreDevice.isMemoryAvailable(expectedBytes + 1));
 
-  auto module = makeBasicModule();
   std::tie(promise, future) = getFutureHelper<const Module *>();
-  cpuCoreDevice.addNetwork(module.get(),
-                           compileFunctions("CPU", module.get(), backing),
+  cpuCoreDevice.addNetwork(module.get(), functions,
                            [&promise](const Module *module, llvm::Error err) {
                              callbackHelper(promise, module, std::move(err));
                            });
@@ -666,6 +673,263 @@ TEST(DeviceManagerTest, AvailableMemory) {
   EXPECT_EQ(cpuDeviceDefault.getMaximumMemory(), 2000000000);
 }
 
+/// Check that kernels split across intra-op threads compute the same result as
+/// a single-threaded device.
+TEST(DeviceManagerTest, IntraOpThreads) {
+  std::unique_ptr<Module> module = llvm::make_unique<Module>();
+  Function *F = module->createFunction("main");
+  auto *input = module->createPlaceholder(ElemKind::FloatTy, {16, 256},
+                                          "main_input", false);
+  auto *output = module->createPlaceholder(ElemKind::FloatTy, {16, 128},
+                                           "main_output", false);
+  auto *weights = module->createConstant(ElemKind::FloatTy, {256, 128}, "W");
+  weights->getPayloadMutable().getHandle().randomize(-1, 1,
+                                                     module->getPRNG());
+  auto *MM = F->createMatMul("matmul", input, weights);
+  F->createSave("ret", MM, output);
+
+  Tensor inputT(ElemKind::FloatTy, {16, 256});
+  inputT.getHandle().randomize(-1, 1, module->getPRNG());
+
+  std::vector<std::unique_ptr<CompiledFunction>> backing;
+  FunctionMapTy functions = compileFunctions("CPU", module.get(), backing);
+
+  Tensor expected;
+  for (const char *numThreads : {"1", "4"}) {
+    auto config = DeviceConfig("CPU");
+    config.parameters["intraOpThreads"] = numThreads;
+    CPUDeviceManager cpuDevice(config);
+    ASSERT_FALSE(errToBool(cpuDevice.init()));
+
+    std::promise<const Module *> promise;
+    std::future<const Module *> future;
+    std::tie(promise, future) = getFutureHelper<const Module *>();
+    cpuDevice.addNetwork(module.get(), functions,
+                         [&promise](const Module *module, llvm::Error err) {
+                           callbackHelper(promise, module, std::move(err));
+                         });
+    future.wait_for(std::chrono::seconds(2));
+    EXPECT_EQ(future.get(), module.get());
+
+    std::unique_ptr<ExecutionContext> context =
+        llvm::make_unique<ExecutionContext>();
+    context->getPlaceholderBindings()->allocate(module->getPlaceholders());
+    updateInputPlaceholders(*context->getPlaceholderBindings(), {input},
+                            {&inputT});
+
+    std::promise<std::unique_ptr<ExecutionContext>> runPromise;
+    std::future<std::unique_ptr<ExecutionContext>> runFuture;
+    std::tie(runPromise, runFuture) =
+        getFutureHelper<std::unique_ptr<ExecutionContext>>();
+    cpuDevice.runFunction(
+        "main", std::move(context),
+        [&runPromise](RunIdentifierTy, llvm::Error err,
+                      std::unique_ptr<ExecutionContext> context) {
+          callbackHelper(runPromise, std::move(context), std::move(err));
+        });
+    runFuture.wait_for(std::chrono::seconds(2));
+    context = runFuture.get();
+    ASSERT_TRUE(context);
+
+    Tensor *result = context->getPlaceholderBindings()->get(output);
+    ASSERT_TRUE(result);
+    if (expected.getUnsafePtr() == nullptr) {
+      expected = result->clone();
+    } else {
+      EXPECT_TRUE(result->isEqual(expected));
+    }
+    EXPECT_FALSE(errToBool(cpuDevice.stop()));
+  }
+
+  // Invalid thread counts are rejected.
+  auto config = DeviceConfig("CPU");
+  config.parameters["intraOpThreads"] = "four";
+  CPUDeviceManager cpuDevice(config);
+  EXPECT_TRUE(errToBool(cpuDevice.init()));
+}
+
+/// Check that a function whose independent branches run concurrently with
+/// -llvm-inter-op-parallelism computes the same result as the sequential one.
+TEST(DeviceManagerTest, InterOpParallelism) {
+  std::unique_ptr<Module> module = llvm::make_unique<Module>();
+  Function *F = module->createFunction("main");
+  auto *input = module->createPlaceholder(ElemKind::FloatTy, {16, 64},
+                                          "main_input", false);
+  auto *output = module->createPlaceholder(ElemKind::FloatTy, {16, 64},
+                                           "main_output", false);
+  // Four independent branches joined by a tree of adds.
+  std::vector<NodeValue> branches;
+  for (unsigned i = 0; i < 4; i++) {
+    auto *W = module->createConstant(ElemKind::FloatTy, {64, 64},
+                                     "W" + std::to_string(i));
+    W->getPayloadMutable().getHandle().randomize(-1, 1, module->getPRNG());
+    NodeValue branch = F->createMatMul("matmul", input, W);
+    switch (i) {
+    case 0:
+      branch = F->createTanh("tanh", branch);
+      break;
+    case 1:
+      branch = F->createSigmoid("sigmoid", branch);
+      break;
+    case 2:
+      branch = F->createRELU("relu", branch);
+      break;
+    default:
+      break;
+    }
+    branches.push_back(branch);
+  }
+  auto *sum = F->createAdd("add", F->createAdd("add", branches[0], branches[1]),
+                           F->createAdd("add", branches[2], branches[3]));
+  F->createSave("ret", sum, output);
+
+  Tensor inputT(ElemKind::FloatTy, {16, 64});
+  inputT.getHandle().randomize(-1, 1, module->getPRNG());
+
+  auto *interOpOpt = static_cast<llvm::cl::opt<bool> *>(
+      llvm::cl::getRegisteredOptions()["llvm-inter-op-parallelism"]);
+  ASSERT_TRUE(interOpOpt);
+
+  Tensor expected;
+  for (bool interOp : {false, true}) {
+    *interOpOpt = interOp;
+    std::vector<std::unique_ptr<CompiledFunction>> backing;
+    FunctionMapTy functions = compileFunctions("CPU", module.get(), backing);
+    *interOpOpt = false;
+
+    auto config = DeviceConfig("CPU");
+    config.parameters["intraOpThreads"] = "4";
+    CPUDeviceManager cpuDevice(config);
+    ASSERT_FALSE(errToBool(cpuDevice.init()));
+
+    std::promise<const Module *> promise;
+    std::future<const Module *> future;
+    std::tie(promise, future) = getFutureHelper<const Module *>();
+    cpuDevice.addNetwork(module.get(), functions,
+                         [&promise](const Module *module, llvm::Error err) {
+                           callbackHelper(promise, module, std::move(err));
+                         });
+    future.wait_for(std::chrono::seconds(2));
+    EXPECT_EQ(future.get(), module.get());
+
+    std::unique_ptr<ExecutionContext> context =
+        llvm::make_unique<ExecutionContext>();
+    context->getPlaceholderBindings()->allocate(module->getPlaceholders());
+    updateInputPlaceholders(*context->getPlaceholderBindings(), {input},
+                            {&inputT});
+
+    std::promise<std::unique_ptr<ExecutionContext>> runPromise;
+    std::future<std::unique_ptr<ExecutionContext>> runFuture;
+    std::tie(runPromise, runFuture) =
+        getFutureHelper<std::unique_ptr<ExecutionContext>>();
+    cpuDevice.runFunction(
+        "main", std::move(context),
+        [&runPromise](RunIdentifierTy, llvm::Error err,
+                      std::unique_ptr<ExecutionContext> context) {
+          callbackHelper(runPromise, std::move(context), std::move(err));
+        });
+    runFuture.wait_for(std::chrono::seconds(2));
+    context = runFuture.get();
+    ASSERT_TRUE(context);
+
+    Tensor *result = context->getPlaceholderBindings()->get(output);
+    ASSERT_TRUE(result);
+    if (!interOp) {
+      expected = result->clone();
+    } else {
+      EXPECT_TRUE(result->isEqual(expected));
+    }
+    EXPECT_FALSE(errToBool(cpuDevice.stop()));
+  }
+}
+
+/// Check that runs executing concurrently on the execution slots of a CPU
+/// device compute their own results, and that the eviction of their function
+/// waits for them.
+TEST(DeviceManagerTest, ExecutionSlots) {
+  auto module = makeBasicModule();
+  std::vector<std::unique_ptr<CompiledFunction>> backing;
+  FunctionMapTy functions = compileFunctions("CPU", module.get(), backing);
+  const auto &bundle = backing.front()->getRuntimeBundle();
+
+  auto config = DeviceConfig("CPU");
+  config.parameters["executionSlots"] = "3";
+  CPUDeviceManager cpuDevice(config);
+  ASSERT_FALSE(errToBool(cpuDevice.init()));
+
+  std::promise<const Module *> promise;
+  std::future<const Module *> future;
+  std::tie(promise, future) = getFutureHelper<const Module *>();
+  cpuDevice.addNetwork(module.get(), functions,
+                       [&promise](const Module *module, llvm::Error err) {
+                         callbackHelper(promise, module, std::move(err));
+                       });
+  future.wait_for(std::chrono::seconds(2));
+  EXPECT_EQ(future.get(), module.get());
+
+  // Every slot is charged its mutable weights and activations.
+  EXPECT_EQ(cpuDevice.getAvailableMemory(),
+            cpuDevice.getMaximumMemory() - bundle.getConstantWeightSize() -
+                3 * (bundle.getMutableWeightSize() +
+                     bundle.getActivationsSize()));
+
+  constexpr unsigned numRuns = 16;
+  std::vector<std::promise<std::unique_ptr<ExecutionContext>>> runPromises(
+      numRuns);
+  std::atomic<unsigned> finishedRuns{0};
+  for (unsigned i = 0; i < numRuns; i++) {
+    std::unique_ptr<ExecutionContext> context =
+        llvm::make_unique<ExecutionContext>();
+    context->getPlaceholderBindings()->allocate(module->getPlaceholders());
+    Tensor input(ElemKind::FloatTy, {1});
+    input.getHandle().clear(0.1f * i);
+    updateInputPlaceholders(*context->getPlaceholderBindings(),
+                            {module->getPlaceholderByName("main_input")},
+                            {&input});
+
+    auto &runPromise = runPromises[i];
+    cpuDevice.runFunction(
+        "main", std::move(context),
+        [&runPromise, &finishedRuns](RunIdentifierTy, llvm::Error err,
+                                     std::unique_ptr<ExecutionContext> ctx) {
+          finishedRuns++;
+          callbackHelper(runPromise, std::move(ctx), std::move(err));
+        });
+  }
+
+  std::promise<unsigned> evictPromise;
+  std::future<unsigned> evictFuture;
+  std::tie(evictPromise, evictFuture) = getFutureHelper<unsigned>();
+  cpuDevice.evictNetwork(
+      "main", [&evictPromise, &finishedRuns](std::string, llvm::Error err) {
+        callbackHelper(evictPromise, finishedRuns.load(), std::move(err));
+      });
+
+  for (unsigned i = 0; i < numRuns; i++) {
+    auto runFuture = runPromises[i].get_future();
+    runFuture.wait_for(std::chrono::seconds(2));
+    auto context = runFuture.get();
+    ASSERT_TRUE(context);
+    Tensor *result = context->getPlaceholderBindings()->get(
+        module->getPlaceholderByName("main_output"));
+    ASSERT_TRUE(result);
+    EXPECT_NEAR(result->getHandle().raw(0), std::tanh(0.1f * i), 1e-5);
+  }
+
+  // The function is evicted after its runs, which freed its memory.
+  evictFuture.wait_for(std::chrono::seconds(2));
+  EXPECT_EQ(evictFuture.get(), numRuns);
+  EXPECT_EQ(cpuDevice.getAvailableMemory(), cpuDevice.getMaximumMemory());
+
+  EXPECT_FALSE(errToBool(cpuDevice.stop()));
+
+  // At least one slot is required.
+  auto badConfig = DeviceConfig("CPU");
+  badConfig.parameters["executionSlots"] = "0";
+  CPUDeviceManager badDevice(badConfig);
+  EXPECT_TRUE(errToBool(badDevice.init()));
+}
+
 TEST(DeviceManagerTest, DummyDeviceManager) {
   DummyDeviceManager deviceManager{DeviceConfig("Interpreter")};
   ASSERT_FALSE(errToBool(deviceManager.init()));
@@ -30,6 +30,8 @@
 
 #include "gtest/gtest.h"
 
+#include <thread>
+
 using namespace glow;
 
 TEST(Graph, testVariableErasure) {
@@ -48,6 +50,28 @@ TEST(Graph, testVariableErasure) {
 }
 
 /// Check that the clear method completely reset a module.
+/// Check that types uniqued concurrently are still unique.
+TEST(Graph, uniqueTypeConcurrently) {
+  Module M;
+  constexpr unsigned numThreads = 8;
+  constexpr size_t numTypes = 64;
+  std::vector<std::vector<TypeRef>> types(numThreads);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < numThreads; t++) {
+    threads.emplace_back([&M, &types, t]() {
+      for (size_t i = 0; i < numTypes; i++) {
+        types[t].push_back(M.uniqueType(ElemKind::FloatTy, {i + 1, 3}));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (unsigned t = 1; t < numThreads; t++) {
+    EXPECT_EQ(types[t], types[0]);
+  }
+}
+
 TEST(Graph, clear) {
   Module M;
 
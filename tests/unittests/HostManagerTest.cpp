@@ -15,11 +15,18 @@
  */
 
 #include "glow/Runtime/HostManager/HostManager.h"
+#include "glow/Runtime/HostManager/ConstantSpill.h"
 #include "glow/ExecutionContext/ExecutionContext.h"
+#include "glow/Runtime/StatsExporter.h"
 
 #include "gtest/gtest.h"
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+
 #include <future>
+#include <mutex>
+#include <set>
 #include <thread>
 
 using namespace glow;
@@ -217,3 +224,501 @@ TEST_F(HostManagerTest, ConfigureHostManager) {
   EXPECT_TRUE(errToBool(std::move(*DCHECK_NOTNULL(runErr.get()))));
   guard.unlock();
 }
+
+/// Test that requests exceeding maxActiveRequests wait in the admission queue
+/// and run once the active request finishes, and that the queue limits are
+/// enforced.
+TEST_F(HostManagerTest, QueueRequests) {
+  HostConfig config;
+  config.maxActiveRequests = 1;
+  config.maxQueuedRequests = 3;
+  config.maxQueuedRequestsPerNetwork = 1;
+  config.maxQueueWaitMs = 60000;
+  auto hostManager = createHostManager("Interpreter", std::move(config));
+
+  EXPECT_FALSE(errToBool(addNetwork(hostManager.get(), "main")));
+  EXPECT_FALSE(errToBool(addNetwork(hostManager.get(), "other")));
+
+  std::shared_ptr<std::mutex> lock = std::make_shared<std::mutex>();
+  std::unique_lock<std::mutex> guard(*lock);
+
+  // Keep the only active request slot busy until the guard is released.
+  hostManager->runNetwork("main", llvm::make_unique<ExecutionContext>(),
+                          [lock](RunIdentifierTy runID, llvm::Error err,
+                                 std::unique_ptr<ExecutionContext> context_) {
+                            errToBool(std::move(err));
+                            std::unique_lock<std::mutex> guard(*lock);
+                          });
+
+  // One request of each network fits in the queue.
+  std::promise<bool> mainRun;
+  std::promise<bool> otherRun;
+  auto mainDone = mainRun.get_future();
+  auto otherDone = otherRun.get_future();
+  hostManager->runNetwork("main", llvm::make_unique<ExecutionContext>(),
+                          [&mainRun](RunIdentifierTy runID, llvm::Error err,
+                                     std::unique_ptr<ExecutionContext>) {
+                            mainRun.set_value(errToBool(std::move(err)));
+                          });
+  hostManager->runNetwork("other", llvm::make_unique<ExecutionContext>(),
+                          [&otherRun](RunIdentifierTy runID, llvm::Error err,
+                                      std::unique_ptr<ExecutionContext>) {
+                            otherRun.set_value(errToBool(std::move(err)));
+                          });
+
+  // A second queued request of the same network is refused inline.
+  std::unique_ptr<llvm::Error> runErr;
+  hostManager->runNetwork("main", llvm::make_unique<ExecutionContext>(),
+                          [&runErr](RunIdentifierTy runID, llvm::Error err,
+                                    std::unique_ptr<ExecutionContext>) {
+                            runErr =
+                                llvm::make_unique<llvm::Error>(std::move(err));
+                          });
+  EXPECT_TRUE(errToBool(std::move(*DCHECK_NOTNULL(runErr.get()))));
+
+  // Nothing ran yet, then both queued requests run successfully.
+  EXPECT_EQ(mainDone.wait_for(std::chrono::milliseconds(10)),
+            std::future_status::timeout);
+  guard.unlock();
+  EXPECT_FALSE(mainDone.get());
+  EXPECT_FALSE(otherDone.get());
+}
+
+/// Test that requests waiting in the admission queue longer than
+/// maxQueueWaitMs are refused.
+TEST_F(HostManagerTest, QueueTimeout) {
+  HostConfig config;
+  config.maxActiveRequests = 1;
+  config.maxQueuedRequests = 1;
+  config.maxQueueWaitMs = 1;
+  auto hostManager = createHostManager("Interpreter", std::move(config));
+
+  EXPECT_FALSE(errToBool(addNetwork(hostManager.get(), "main")));
+
+  std::shared_ptr<std::mutex> lock = std::make_shared<std::mutex>();
+  std::unique_lock<std::mutex> guard(*lock);
+
+  hostManager->runNetwork("main", llvm::make_unique<ExecutionContext>(),
+                          [lock](RunIdentifierTy runID, llvm::Error err,
+                                 std::unique_ptr<ExecutionContext> context_) {
+                            errToBool(std::move(err));
+                            std::unique_lock<std::mutex> guard(*lock);
+                          });
+
+  std::promise<bool> queuedRun;
+  auto queuedDone = queuedRun.get_future();
+  hostManager->runNetwork("main", llvm::make_unique<ExecutionContext>(),
+                          [&queuedRun](RunIdentifierTy runID, llvm::Error err,
+                                       std::unique_ptr<ExecutionContext>) {
+                            queuedRun.set_value(errToBool(std::move(err)));
+                          });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  guard.unlock();
+  EXPECT_TRUE(queuedDone.get());
+}
+
+/// Add a network named \p name squaring a {batchSize, 2} input to \p manager.
+/// \returns the input and output Placeholders in \p input and \p output.
+static llvm::Error addBatchedNetwork(HostManager *manager, std::string name,
+                                     size_t batchSize, Placeholder *&input,
+                                     Placeholder *&output) {
+  std::unique_ptr<Module> module = llvm::make_unique<Module>();
+  Function *F = module->createFunction(name);
+  input = module->createPlaceholder(ElemKind::FloatTy, {batchSize, 2},
+                                    "X_" + name, false);
+  auto *pow = F->createPow("Pow_" + name, input, 2.0);
+  output = F->createSave("save" + name, pow)->getPlaceholder();
+  CompilationContext cctx;
+  return manager->addNetwork(std::move(module), cctx);
+}
+
+/// Run \p rows rows of the network added by addBatchedNetwork, with inputs
+/// starting at \p first, and \returns the future of the request's outputs.
+static std::future<std::vector<float>>
+runBatchedRequest(HostManager *manager, llvm::StringRef name,
+                  Placeholder *input, Placeholder *output, size_t rows,
+                  float first) {
+  auto context = llvm::make_unique<ExecutionContext>();
+  Tensor X(ElemKind::FloatTy, {rows, 2});
+  auto XH = X.getHandle();
+  for (size_t i = 0, e = XH.size(); i < e; i++) {
+    XH.raw(i) = first + i;
+  }
+  context->getPlaceholderBindings()->insert(input, std::move(X));
+  context->getPlaceholderBindings()->insert(
+      output, Tensor(ElemKind::FloatTy, {rows, 2}));
+
+  auto result = std::make_shared<std::promise<std::vector<float>>>();
+  auto future = result->get_future();
+  manager->runNetwork(
+      name, std::move(context),
+      [result, output](RunIdentifierTy runID, llvm::Error err,
+                       std::unique_ptr<ExecutionContext> context) {
+        EXPECT_FALSE(errToBool(std::move(err)));
+        auto H = context->getPlaceholderBindings()->get(output)->getHandle();
+        std::vector<float> values(H.size());
+        for (size_t i = 0, e = H.size(); i < e; i++) {
+          values[i] = H.raw(i);
+        }
+        result->set_value(std::move(values));
+      });
+  return future;
+}
+
+/// Test that concurrent requests are batched together and get their own
+/// results back.
+TEST_F(HostManagerTest, DynamicBatching) {
+  auto hostManager = createHostManager("Interpreter");
+  Placeholder *input;
+  Placeholder *output;
+  EXPECT_FALSE(errToBool(
+      addBatchedNetwork(hostManager.get(), "main", 4, input, output)));
+  EXPECT_TRUE(errToBool(hostManager->enableDynamicBatching("missing", 1000)));
+  EXPECT_FALSE(errToBool(hostManager->enableDynamicBatching("main", 10000000)));
+
+  // The batch runs once full, without waiting for the delay.
+  std::vector<std::future<std::vector<float>>> results;
+  results.push_back(
+      runBatchedRequest(hostManager.get(), "main", input, output, 1, 0));
+  results.push_back(
+      runBatchedRequest(hostManager.get(), "main", input, output, 2, 10));
+  results.push_back(
+      runBatchedRequest(hostManager.get(), "main", input, output, 1, 20));
+  std::vector<size_t> firsts = {0, 10, 20};
+  for (size_t r = 0; r < results.size(); r++) {
+    ASSERT_EQ(results[r].wait_for(std::chrono::seconds(60)),
+              std::future_status::ready);
+    auto values = results[r].get();
+    for (size_t i = 0; i < values.size(); i++) {
+      float x = firsts[r] + i;
+      EXPECT_FLOAT_EQ(values[i], x * x);
+    }
+  }
+}
+
+/// Test that a batch which does not fill runs after the maximum delay.
+TEST_F(HostManagerTest, DynamicBatchingDelay) {
+  auto hostManager = createHostManager("Interpreter");
+  Placeholder *input;
+  Placeholder *output;
+  EXPECT_FALSE(errToBool(
+      addBatchedNetwork(hostManager.get(), "main", 4, input, output)));
+  EXPECT_FALSE(errToBool(hostManager->enableDynamicBatching("main", 1000)));
+
+  auto result =
+      runBatchedRequest(hostManager.get(), "main", input, output, 3, 1);
+  ASSERT_EQ(result.wait_for(std::chrono::seconds(60)),
+            std::future_status::ready);
+  auto values = result.get();
+  ASSERT_EQ(values.size(), 6);
+  for (size_t i = 0; i < values.size(); i++) {
+    EXPECT_FLOAT_EQ(values[i], (i + 1) * (i + 1));
+  }
+
+  // Batching is disabled with the removal of the network.
+  EXPECT_FALSE(errToBool(hostManager->removeNetwork("main")));
+}
+
+/// Test that the requests of a failed batch get the error code of the batch.
+TEST_F(HostManagerTest, DynamicBatchingError) {
+  auto hostManager = createHostManager("Interpreter");
+  Placeholder *input;
+  Placeholder *output;
+  EXPECT_FALSE(errToBool(
+      addBatchedNetwork(hostManager.get(), "main", 4, input, output)));
+  EXPECT_FALSE(errToBool(hostManager->enableDynamicBatching("main", 1000)));
+
+  // The batch runs with the deadline of its first request, already passed.
+  std::vector<std::future<GlowErr::ErrorCode>> results;
+  for (size_t r = 0; r < 2; r++) {
+    auto context = llvm::make_unique<ExecutionContext>();
+    context->setDeadline(std::chrono::steady_clock::now() -
+                         std::chrono::milliseconds(r == 0 ? 10 : -60000));
+    context->getPlaceholderBindings()->insert(
+        input, Tensor(ElemKind::FloatTy, {1, 2}));
+    context->getPlaceholderBindings()->insert(
+        output, Tensor(ElemKind::FloatTy, {1, 2}));
+    auto result = std::make_shared<std::promise<GlowErr::ErrorCode>>();
+    results.push_back(result->get_future());
+    hostManager->runNetwork(
+        "main", std::move(context),
+        [result](RunIdentifierTy, llvm::Error err,
+                 std::unique_ptr<ExecutionContext>) {
+          auto ec = GlowErr::ErrorCode::UNKNOWN;
+          llvm::handleAllErrors(std::move(err), [&ec](const GlowErr &E) {
+            ec = E.getErrorCode();
+          });
+          result->set_value(ec);
+        });
+  }
+  for (auto &result : results) {
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(60)),
+              std::future_status::ready);
+    EXPECT_EQ(result.get(), GlowErr::ErrorCode::RUNTIME_DEADLINE_EXCEEDED);
+  }
+}
+
+/// Test that a request whose deadline passed is dropped, and that requests
+/// with a priority and a future deadline run.
+TEST_F(HostManagerTest, RequestDeadline) {
+  auto hostManager = createHostManager("Interpreter");
+  EXPECT_FALSE(errToBool(addNetwork(hostManager.get(), "main")));
+
+  auto runWithDeadline = [&hostManager](RequestPriority priority,
+                                        std::chrono::milliseconds deadline) {
+    auto context = llvm::make_unique<ExecutionContext>();
+    context->setPriority(priority);
+    context->setDeadline(std::chrono::steady_clock::now() + deadline);
+    std::promise<bool> runPromise;
+    auto done = runPromise.get_future();
+    hostManager->runNetwork("main", std::move(context),
+                            [&runPromise](RunIdentifierTy, llvm::Error err,
+                                          std::unique_ptr<ExecutionContext>) {
+                              runPromise.set_value(errToBool(std::move(err)));
+                            });
+    return done.get();
+  };
+
+  EXPECT_TRUE(runWithDeadline(RequestPriority::Normal,
+                              std::chrono::milliseconds(-1)));
+  EXPECT_FALSE(runWithDeadline(RequestPriority::High,
+                               std::chrono::milliseconds(60000)));
+  EXPECT_FALSE(runWithDeadline(RequestPriority::Low,
+                               std::chrono::milliseconds(60000)));
+}
+
+/// \returns a module with a network \p name raising Placeholder "X" to the
+/// power \p exponent into Placeholder "out".
+static std::unique_ptr<Module> createPowModule(float exponent,
+                                               llvm::StringRef name = "main") {
+  auto module = llvm::make_unique<Module>();
+  Function *F = module->createFunction(name);
+  auto *X = module->createPlaceholder(ElemKind::FloatTy, {3}, "X", false);
+  auto *out = module->createPlaceholder(ElemKind::FloatTy, {3}, "out", false);
+  F->createSave("save", F->createPow("pow", X, exponent), out);
+  return module;
+}
+
+/// Runs network \p name of \p hostManager on {1, 2, 3}. The request is bound
+/// by Placeholders of its own module, which every version matches by name.
+static std::vector<float> runPowNetwork(HostManager &hostManager,
+                                        llvm::StringRef name = "main") {
+  Module mod;
+  auto *X = mod.createPlaceholder(ElemKind::FloatTy, {3}, "X", false);
+  auto *out = mod.createPlaceholder(ElemKind::FloatTy, {3}, "out", false);
+  PlaceholderBindings bindings;
+  bindings.allocate(X)->getHandle() = {1, 2, 3};
+  auto *outTensor = bindings.allocate(out);
+  EXPECT_FALSE(errToBool(hostManager.runNetworkBlocking(name, bindings)));
+  auto H = outTensor->getHandle();
+  return {H.raw(0), H.raw(1), H.raw(2)};
+}
+
+/// Test that a new version of a network only runs the requests once it is
+/// promoted, and that candidates can be mirrored and discarded.
+TEST_F(HostManagerTest, NetworkVersions) {
+  auto hostManager = createHostManager("CPU");
+  CompilationContext cctx;
+  ASSERT_FALSE(errToBool(hostManager->addNetwork(createPowModule(2), cctx)));
+  std::vector<float> squares = {1, 4, 9};
+  std::vector<float> cubes = {1, 8, 27};
+  EXPECT_EQ(runPowNetwork(*hostManager), squares);
+
+  // The candidate does not run the requests before it is promoted.
+  ASSERT_FALSE(
+      errToBool(hostManager->addNetworkVersion(createPowModule(3), cctx)));
+  EXPECT_TRUE(
+      errToBool(hostManager->addNetworkVersion(createPowModule(4), cctx)));
+  EXPECT_EQ(EXIT_ON_ERR(hostManager->getNetworkVersion("main")), 0u);
+  EXPECT_EQ(runPowNetwork(*hostManager), squares);
+
+  // Mirrored requests return the results of the active version.
+  EXPECT_TRUE(errToBool(hostManager->setNetworkMirrorPercent("main", 101)));
+  ASSERT_FALSE(errToBool(hostManager->setNetworkMirrorPercent("main", 100)));
+  EXPECT_EQ(runPowNetwork(*hostManager), squares);
+
+  ASSERT_FALSE(errToBool(hostManager->promoteNetworkVersion("main")));
+  EXPECT_EQ(EXIT_ON_ERR(hostManager->getNetworkVersion("main")), 1u);
+  EXPECT_EQ(runPowNetwork(*hostManager), cubes);
+  EXPECT_TRUE(errToBool(hostManager->promoteNetworkVersion("main")));
+
+  // A discarded candidate leaves the active version in place.
+  ASSERT_FALSE(
+      errToBool(hostManager->addNetworkVersion(createPowModule(4), cctx)));
+  ASSERT_FALSE(errToBool(hostManager->discardNetworkVersion("main")));
+  EXPECT_EQ(EXIT_ON_ERR(hostManager->getNetworkVersion("main")), 1u);
+  EXPECT_EQ(runPowNetwork(*hostManager), cubes);
+
+  auto other = createPowModule(2);
+  other->getFunctions().front()->setName("other");
+  EXPECT_TRUE(
+      errToBool(hostManager->addNetworkVersion(std::move(other), cctx)));
+  EXPECT_FALSE(errToBool(hostManager->removeNetwork("main")));
+}
+
+/// Records the keys of the histograms exported to it.
+class HistogramKeysExporter : public StatsExporter {
+public:
+  HistogramKeysExporter() { Stats()->registerStatsExporter(this); }
+
+  void addTimeSeriesValue(llvm::StringRef key, double value) override {}
+  void incrementCounter(llvm::StringRef key, int64_t value) override {}
+  void setCounter(llvm::StringRef key, int64_t value) override {}
+
+  void exportHistogram(llvm::StringRef key,
+                       const Histogram &histogram) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    keys_.insert(key.str());
+  }
+
+  /// \returns the keys of the histograms of network \p name and of its
+  /// versions currently in the registry.
+  std::set<std::string> getKeys(llvm::StringRef name) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      keys_.clear();
+    }
+    Stats()->exportHistograms();
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::set<std::string> keys;
+    for (const auto &key : keys_) {
+      if (llvm::StringRef(key).contains(("." + name).str())) {
+        keys.insert(key);
+      }
+    }
+    return keys;
+  }
+
+private:
+  std::set<std::string> keys_;
+  std::mutex mutex_;
+} HistogramKeys;
+
+/// Test that the histograms of a version are released when it is retired,
+/// and those of the network when it is removed.
+TEST_F(HostManagerTest, NetworkHistograms) {
+  auto hostManager = createHostManager("CPU");
+  CompilationContext cctx;
+  ASSERT_FALSE(
+      errToBool(hostManager->addNetwork(createPowModule(2, "hist"), cctx)));
+  runPowNetwork(*hostManager, "hist");
+  auto keys = HistogramKeys.getKeys("hist");
+  EXPECT_EQ(keys.count("glow.hostmanager.hist.latency_us"), 1);
+  EXPECT_EQ(keys.count("glow.executor.hist.dispatch_us"), 1);
+
+  ASSERT_FALSE(errToBool(
+      hostManager->addNetworkVersion(createPowModule(3, "hist"), cctx)));
+  ASSERT_FALSE(errToBool(hostManager->promoteNetworkVersion("hist")));
+  runPowNetwork(*hostManager, "hist");
+  keys = HistogramKeys.getKeys("hist");
+  EXPECT_EQ(keys.count("glow.hostmanager.hist.latency_us"), 1);
+  EXPECT_EQ(keys.count("glow.executor.hist.dispatch_us"), 0);
+  EXPECT_EQ(keys.count("glow.executor.hist__v1.dispatch_us"), 1);
+
+  ASSERT_FALSE(errToBool(hostManager->removeNetwork("hist")));
+  EXPECT_TRUE(HistogramKeys.getKeys("hist").empty());
+}
+
+/// \returns a module with a network \p name multiplying Placeholder "X" by a
+/// Constant of \p factor into Placeholder "out".
+static std::unique_ptr<Module> createScaleModule(float factor,
+                                                 llvm::StringRef name) {
+  auto module = llvm::make_unique<Module>();
+  Function *F = module->createFunction(name);
+  auto *X = module->createPlaceholder(ElemKind::FloatTy, {3}, "X", false);
+  auto *out = module->createPlaceholder(ElemKind::FloatTy, {3}, "out", false);
+  auto *C = module->createConstant(ElemKind::FloatTy, {3}, "factor");
+  C->getPayloadMutable().getHandle().clear(factor);
+  F->createSave("save", F->createMul("mul", X, C), out);
+  return module;
+}
+
+/// \returns the number of files in \p dir.
+static unsigned countFiles(llvm::StringRef dir) {
+  unsigned files = 0;
+  std::error_code EC;
+  for (llvm::sys::fs::directory_iterator it(dir, EC), e; !EC && it != e;
+       it.increment(EC)) {
+    files++;
+  }
+  return files;
+}
+
+/// Test that with residency enabled the networks which do not fit together
+/// on the device are evicted and reloaded on demand, with their constants
+/// read back from the files keeping them.
+TEST_F(HostManagerTest, NetworkResidency) {
+  for (const char *backendName : {"CPU", "Interpreter"}) {
+    SCOPED_TRACE(backendName);
+    // Measure the memory used by a network on the device.
+    uint64_t networkSize;
+    {
+      auto hostManager = createHostManager(backendName);
+      CompilationContext cctx;
+      ASSERT_FALSE(errToBool(
+          hostManager->addNetwork(createScaleModule(2, "a"), cctx)));
+      auto &dag = EXIT_ON_ERR(hostManager->getNetworkDAG("a"));
+      networkSize = dag.nodes.front()->runtimeBundle->getDeviceMemorySize();
+    }
+
+    llvm::SmallString<128> dir;
+    ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("glow-residency", dir));
+    {
+      // The device only fits one of the networks.
+      std::vector<std::unique_ptr<DeviceConfig>> configs;
+      configs.push_back(llvm::make_unique<DeviceConfig>(backendName));
+      configs.back()->setDeviceMemory(networkSize + 1);
+      HostConfig hostConfig;
+      hostConfig.enableNetworkResidency = true;
+      hostConfig.networkResidencyDir = dir.str();
+      HostManager hostManager(std::move(configs), hostConfig);
+
+      CompilationContext cctx;
+      ASSERT_FALSE(
+          errToBool(hostManager.addNetwork(createScaleModule(2, "a"), cctx)));
+      std::vector<float> doubles = {2, 4, 6};
+      std::vector<float> triples = {3, 6, 9};
+      EXPECT_EQ(runPowNetwork(hostManager, "a"), doubles);
+
+      // Adding b evicts a, running each network then evicts the other one.
+      ASSERT_FALSE(
+          errToBool(hostManager.addNetwork(createScaleModule(3, "b"), cctx)));
+      EXPECT_EQ(countFiles(dir), 2);
+      EXPECT_EQ(runPowNetwork(hostManager, "b"), triples);
+      EXPECT_EQ(runPowNetwork(hostManager, "a"), doubles);
+      EXPECT_EQ(runPowNetwork(hostManager, "b"), triples);
+      EXPECT_EQ(runPowNetwork(hostManager, "a"), doubles);
+
+      EXPECT_FALSE(errToBool(hostManager.removeNetwork("a")));
+      EXPECT_FALSE(errToBool(hostManager.removeNetwork("b")));
+    }
+    // The files are removed with their networks.
+    EXPECT_EQ(countFiles(dir), 0);
+    llvm::sys::fs::remove_directories(dir);
+  }
+}
+
+/// Test that the constants of a stripped module are read back from a spill.
+TEST_F(HostManagerTest, ConstantSpill) {
+  auto module = createScaleModule(5, "main");
+  auto *C = module->getConstantByName("factor");
+  ASSERT_TRUE(C);
+  auto spill = EXIT_ON_ERR(ConstantSpill::create(*module, ""));
+  EXPECT_TRUE(llvm::sys::fs::exists(spill->getPath()));
+  module->strip();
+
+  EXPECT_FALSE(errToBool(spill->restore({C})));
+  auto H = C->getPayload().getHandle();
+  EXPECT_EQ(H.raw(0), 5);
+  EXPECT_EQ(H.raw(2), 5);
+
+  // A constant which was not spilled is refused.
+  Module other;
+  auto *otherC = other.createConstant(ElemKind::FloatTy, {3}, "factor");
+  EXPECT_TRUE(errToBool(spill->restore({otherC})));
+
+  std::string path = spill->getPath();
+  spill.reset();
+  EXPECT_FALSE(llvm::sys::fs::exists(path));
+}
@@ -16,11 +16,24 @@
 
 #include "glow/LLVMIRCodeGen/LLVMIRGen.h"
 #include "glow/LLVMIRCodeGen/AllocationsInfo.h"
+#include "glow/LLVMIRCodeGen/ParallelSchedule.h"
 
+#include "glow/Backend/Backend.h"
+#include "glow/ExecutionContext/ExecutionContext.h"
+#include "glow/Graph/Graph.h"
 #include "glow/IR/IR.h"
+#include "glow/IR/IRBuilder.h"
+#include "glow/IR/Instrs.h"
+#include "glow/Runtime/StatsExporter.h"
 
 #include "gtest/gtest.h"
 
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#include <map>
+
 using namespace glow;
 
 #ifndef GLOW_WITH_CPU
@@ -41,3 +54,331 @@ TEST(LLVMIRGen, getEntryName) {
   llvmIRGen.setMainEntryName("");
   EXPECT_EQ(llvmIRGen.getMainEntryName(), "main");
 }
+
+/// Check that independent instructions share a stage and that reordering
+/// hoists the allocations of a stage before all of its instructions.
+TEST(LLVMIRGen, parallelSchedule) {
+  Module mod;
+  Function *F = mod.createFunction("main");
+  IRFunction M(F);
+  {
+    IRBuilder bb(&M);
+    auto *A = bb.createWeightVar(ElemKind::FloatTy, {4, 8}, "A",
+                                 WeightVar::MutabilityKind::Constant);
+    auto *B = bb.createWeightVar(ElemKind::FloatTy, {8, 4}, "B",
+                                 WeightVar::MutabilityKind::Constant);
+    auto *C = bb.createWeightVar(ElemKind::FloatTy, {8, 4}, "C",
+                                 WeightVar::MutabilityKind::Constant);
+    auto *out = bb.createWeightVar(ElemKind::FloatTy, {4, 4}, "out",
+                                   WeightVar::MutabilityKind::Mutable);
+    auto *ty = mod.uniqueType(ElemKind::FloatTy, {4, 4});
+    auto *act1 = bb.createAllocActivationInst("act1", ty);
+    bb.createMatMulInst("mm1", act1, A, B);
+    auto *act2 = bb.createAllocActivationInst("act2", ty);
+    bb.createMatMulInst("mm2", act2, A, C);
+    bb.createElementAddInst("add", out, act1, act2);
+    bb.createDeallocActivationInst("dealloc1", act1);
+    bb.createDeallocActivationInst("dealloc2", act2);
+  }
+
+  ParallelSchedule schedule(M);
+  auto stages = schedule.getStages();
+  ASSERT_EQ(stages.size(), 2);
+  ASSERT_EQ(stages[0].size(), 2);
+  EXPECT_TRUE(llvm::isa<MatMulInst>(stages[0][0]));
+  EXPECT_TRUE(llvm::isa<MatMulInst>(stages[0][1]));
+  ASSERT_EQ(stages[1].size(), 1);
+  EXPECT_TRUE(llvm::isa<ElementAddInst>(stages[1][0]));
+
+  ParallelSchedule::reorder(&M);
+  std::vector<std::string> order;
+  for (const auto &I : M.getInstrs()) {
+    order.push_back(I.getName());
+  }
+  std::vector<std::string> expected = {"act1", "act2",     "mm1",     "mm2",
+                                       "add",  "dealloc1", "dealloc2"};
+  EXPECT_EQ(order, expected);
+  M.verify();
+}
+
+/// Check that a function compiled with -llvm-compile-cache-dir is stored in
+/// the cache, and that the function loaded from the cache computes the same
+/// results.
+TEST(LLVMIRGen, compileCache) {
+  llvm::SmallString<128> dir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("glow-compile-cache", dir));
+  auto *opt = static_cast<llvm::cl::opt<std::string> *>(
+      llvm::cl::getRegisteredOptions()["llvm-compile-cache-dir"]);
+  ASSERT_TRUE(opt);
+  *opt = dir.str().str();
+
+  Module mod;
+  Function *F = mod.createFunction("main");
+  auto *X = mod.createPlaceholder(ElemKind::FloatTy, {4}, "X", false);
+  auto *C = mod.createConstant(ElemKind::FloatTy, {4}, "C");
+  C->getPayloadMutable().getHandle() = {1, 2, 3, 4};
+  auto *save = F->createSave("save", F->createAdd("add", X, C));
+
+  std::unique_ptr<Backend> backend(createBackend("CPU"));
+  std::vector<std::vector<float>> results;
+  for (int run = 0; run < 2; run++) {
+    auto compiled = EXIT_ON_ERR(backend->compile(F));
+    ExecutionContext context;
+    auto *bindings = context.getPlaceholderBindings();
+    bindings->allocate(X)->getHandle() = {10, 20, 30, 40};
+    bindings->allocate(save->getPlaceholder());
+    ASSERT_FALSE(errToBool(compiled->execute(&context)));
+    auto H = bindings->get(save->getPlaceholder())->getHandle();
+    results.push_back({H.raw(0), H.raw(1), H.raw(2), H.raw(3)});
+  }
+  *opt = "";
+
+  std::vector<float> expected = {11, 22, 33, 44};
+  EXPECT_EQ(results[0], expected);
+  EXPECT_EQ(results[1], expected);
+
+  unsigned objects = 0, bundles = 0;
+  std::error_code EC;
+  for (llvm::sys::fs::directory_iterator it(dir, EC), e; !EC && it != e;
+       it.increment(EC)) {
+    auto ext = llvm::sys::path::extension(it->path());
+    objects += ext == ".o";
+    bundles += ext == ".bundle";
+  }
+  EXPECT_EQ(objects, 1);
+  EXPECT_EQ(bundles, 1);
+  llvm::sys::fs::remove_directories(dir);
+}
+
+/// Check that the compile cache tells apart functions that differ only in the
+/// payload of a Constant that codegen folds into the code.
+TEST(LLVMIRGen, compileCacheConstantPayloads) {
+  llvm::SmallString<128> dir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("glow-compile-cache", dir));
+  auto *opt = static_cast<llvm::cl::opt<std::string> *>(
+      llvm::cl::getRegisteredOptions()["llvm-compile-cache-dir"]);
+  ASSERT_TRUE(opt);
+  *opt = dir.str().str();
+
+  std::unique_ptr<Backend> backend(createBackend("CPU"));
+  // Runs a RowwiseQuantizedFullyConnected whose scales are multiplied by
+  // \p scaleFactor after the weights are quantized.
+  auto run = [&](float scaleFactor) {
+    Module mod;
+    Function *F = mod.createFunction("main");
+    auto *X = mod.createPlaceholder(ElemKind::Int8QTy, {1, 4}, 1.0, 0, "X",
+                                    false);
+    auto *W = mod.createConstant(ElemKind::FloatTy, {2, 4}, "W");
+    W->getPayloadMutable().getHandle() = {0, 1, 2, 3, 0, -1, -2, -3};
+    auto *B = mod.createConstant(ElemKind::Int32QTy, {2}, 0.01, 0, "B");
+    B->getPayloadMutable().zero();
+    auto *outTy = mod.uniqueType(ElemKind::Int8QTy, {1, 2}, 1.0, 0);
+    auto *FC = F->createRowwiseQuantizedFullyConnected(
+        "fc", X, W, B, outTy, quantization::Schema::Asymmetric);
+    auto *scales = llvm::cast<Constant>(FC->getScales().getNode());
+    for (auto &scale : scales->getPayloadMutable().getHandle<float>()) {
+      scale *= scaleFactor;
+    }
+    auto *save = F->createSave("save", FC);
+
+    auto compiled = EXIT_ON_ERR(backend->compile(F));
+    ExecutionContext context;
+    auto *bindings = context.getPlaceholderBindings();
+    bindings->allocate(X)->getHandle<int8_t>() = {1, 1, 1, 1};
+    bindings->allocate(save->getPlaceholder());
+    EXIT_ON_ERR(compiled->execute(&context));
+    auto H = bindings->get(save->getPlaceholder())->getHandle<int8_t>();
+    return std::vector<int>{H.raw(0), H.raw(1)};
+  };
+  auto once = run(1);
+  auto twice = run(2);
+  *opt = "";
+
+  EXPECT_NEAR(once[0], 6, 1);
+  EXPECT_NEAR(once[1], -6, 1);
+  EXPECT_NEAR(twice[0], 12, 1);
+  EXPECT_NEAR(twice[1], -12, 1);
+
+  unsigned objects = 0;
+  std::error_code EC;
+  for (llvm::sys::fs::directory_iterator it(dir, EC), e; !EC && it != e;
+       it.increment(EC)) {
+    objects += llvm::sys::path::extension(it->path()) == ".o";
+  }
+  EXPECT_EQ(objects, 2);
+  llvm::sys::fs::remove_directories(dir);
+}
+
+/// Check that changing a command line option which changes the generated code
+/// misses the compile cache.
+TEST(LLVMIRGen, compileCacheOptions) {
+  llvm::SmallString<128> dir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("glow-compile-cache", dir));
+  auto &options = llvm::cl::getRegisteredOptions();
+  auto *opt = static_cast<llvm::cl::opt<std::string> *>(
+      options["llvm-compile-cache-dir"]);
+  auto *specialize =
+      static_cast<llvm::cl::opt<bool> *>(options["jit-specialize"]);
+  auto *winograd = static_cast<llvm::cl::opt<unsigned> *>(
+      options["cpu-winograd-min-channels"]);
+  ASSERT_TRUE(opt && specialize && winograd);
+  *opt = dir.str().str();
+
+  Module mod;
+  Function *F = mod.createFunction("main");
+  auto *X = mod.createPlaceholder(ElemKind::FloatTy, {4}, "X", false);
+  F->createSave("save", F->createAdd("add", X, X));
+  std::unique_ptr<Backend> backend(createBackend("CPU"));
+  auto countObjects = [&dir]() {
+    unsigned objects = 0;
+    std::error_code EC;
+    for (llvm::sys::fs::directory_iterator it(dir, EC), e; !EC && it != e;
+         it.increment(EC)) {
+      objects += llvm::sys::path::extension(it->path()) == ".o";
+    }
+    return objects;
+  };
+
+  EXIT_ON_ERR(backend->compile(F));
+  EXIT_ON_ERR(backend->compile(F));
+  EXPECT_EQ(countObjects(), 1);
+
+  bool specializeValue = *specialize;
+  *specialize = !specializeValue;
+  EXIT_ON_ERR(backend->compile(F));
+  EXPECT_EQ(countObjects(), 2);
+  *specialize = specializeValue;
+
+  unsigned winogradValue = *winograd;
+  *winograd = winogradValue + 1;
+  EXIT_ON_ERR(backend->compile(F));
+  EXPECT_EQ(countObjects(), 3);
+  *winograd = winogradValue;
+
+  *opt = "";
+  llvm::sys::fs::remove_directories(dir);
+}
+
+/// Check that a compiled function binds the Placeholders of another Module,
+/// which are matched to its own Placeholders by name.
+TEST(LLVMIRGen, bindPlaceholdersByName) {
+  Module mod;
+  Function *F = mod.createFunction("main");
+  auto *X = mod.createPlaceholder(ElemKind::FloatTy, {4}, "X", false);
+  auto *save = F->createSave("save", F->createAdd("add", X, X));
+
+  std::unique_ptr<Backend> backend(createBackend("CPU"));
+  auto compiled = EXIT_ON_ERR(backend->compile(F));
+
+  Module other;
+  auto *otherX = other.createPlaceholder(ElemKind::FloatTy, {4}, "X", false);
+  auto *otherSave = other.createPlaceholder(
+      ElemKind::FloatTy, {4}, save->getPlaceholder()->getName(), false);
+  ExecutionContext context;
+  auto *bindings = context.getPlaceholderBindings();
+  bindings->allocate(otherX)->getHandle() = {1, 2, 3, 4};
+  bindings->allocate(otherSave)->zero();
+  ASSERT_FALSE(errToBool(compiled->execute(&context)));
+
+  auto H = bindings->get(otherSave)->getHandle();
+  EXPECT_EQ(H.raw(0), 2);
+  EXPECT_EQ(H.raw(1), 4);
+  EXPECT_EQ(H.raw(2), 6);
+  EXPECT_EQ(H.raw(3), 8);
+}
+
+/// Check that a Placeholder resolved at compile time is no longer bound once
+/// the Module changed it, and that its replacement is.
+TEST(LLVMIRGen, bindChangedPlaceholders) {
+  Module mod;
+  Function *F = mod.createFunction("main");
+  auto *X = mod.createPlaceholder(ElemKind::FloatTy, {4}, "X", false);
+  auto *save = F->createSave("save", F->createAdd("add", X, X));
+
+  std::unique_ptr<Backend> backend(createBackend("CPU"));
+  auto compiled = EXIT_ON_ERR(backend->compile(F));
+
+  // The resolved Placeholder no longer names the input, which is now bound to
+  // the Placeholder of another Module.
+  X->setName("oldX");
+  Module other;
+  auto *newX = other.createPlaceholder(ElemKind::FloatTy, {4}, "X", false);
+  ExecutionContext context;
+  auto *bindings = context.getPlaceholderBindings();
+  bindings->allocate(X)->getHandle() = {-1, -1, -1, -1};
+  bindings->allocate(newX)->getHandle() = {1, 2, 3, 4};
+  bindings->allocate(save->getPlaceholder())->zero();
+  ASSERT_FALSE(errToBool(compiled->execute(&context)));
+
+  auto H = bindings->get(save->getPlaceholder())->getHandle();
+  EXPECT_EQ(H.raw(0), 2);
+  EXPECT_EQ(H.raw(1), 4);
+  EXPECT_EQ(H.raw(2), 6);
+  EXPECT_EQ(H.raw(3), 8);
+}
+
+/// Records the counters of the buffer pool of the compiled functions.
+class BufferPoolStats : public StatsExporter {
+public:
+  BufferPoolStats() { Stats()->registerStatsExporter(this); }
+
+  void addTimeSeriesValue(llvm::StringRef key, double value) override {}
+
+  void incrementCounter(llvm::StringRef key, int64_t value) override {
+    counters[key] += value;
+  }
+
+  void setCounter(llvm::StringRef key, int64_t value) override {
+    counters[key] = value;
+  }
+
+  std::map<std::string, int64_t> counters;
+} PoolStats;
+
+/// Check that the second run of a compiled function reuses the activation
+/// and mutable weight buffers of the first one, and that they are freed with
+/// the function.
+TEST(LLVMIRGen, bufferPoolReuse) {
+  Module mod;
+  Function *F = mod.createFunction("main");
+  auto *X = mod.createPlaceholder(ElemKind::FloatTy, {4}, "X", false);
+  auto *add = F->createAdd("add", X, X);
+  auto *save = F->createSave("save", F->createMul("mul", add, add));
+
+  std::unique_ptr<Backend> backend(createBackend("CPU"));
+  auto compiled = EXIT_ON_ERR(backend->compile(F));
+  const auto &bundle = compiled->getRuntimeBundle();
+  int64_t bufferBytes =
+      bundle.getActivationsSize() + bundle.getMutableWeightSize();
+  ASSERT_GT(bufferBytes, 0);
+
+  ExecutionContext context;
+  auto *bindings = context.getPlaceholderBindings();
+  bindings->allocate(X)->getHandle() = {1, 2, 3, 4};
+  bindings->allocate(save->getPlaceholder());
+
+  auto &hits = PoolStats.counters["glow.llvm.buffer_pool.hits"];
+  auto &misses = PoolStats.counters["glow.llvm.buffer_pool.misses"];
+  auto &bytes = PoolStats.counters["glow.llvm.buffer_pool.bytes"];
+  int64_t hits0 = hits, misses0 = misses, bytes0 = bytes;
+
+  // The first run allocates the buffers.
+  ASSERT_FALSE(errToBool(compiled->execute(&context)));
+  EXPECT_EQ(hits - hits0, 0);
+  EXPECT_EQ(misses - misses0, 1);
+  EXPECT_EQ(bytes - bytes0, bufferBytes);
+
+  // The second run takes them from the pool, no byte is allocated.
+  bindings->get(save->getPlaceholder())->zero();
+  ASSERT_FALSE(errToBool(compiled->execute(&context)));
+  EXPECT_EQ(hits - hits0, 1);
+  EXPECT_EQ(misses - misses0, 1);
+  EXPECT_EQ(bytes - bytes0, bufferBytes);
+
+  auto H = bindings->get(save->getPlaceholder())->getHandle();
+  EXPECT_EQ(H.raw(0), 4);
+  EXPECT_EQ(H.raw(3), 64);
+
+  compiled.reset();
+  EXPECT_EQ(bytes, bytes0);
+}
@@ -948,6 +948,42 @@ TEST_P(OperatorTest, matmul) {
   EXPECT_NEAR(H.at({2, 0}), 95, 0.001);
 }
 
+/// Test a matmul large enough for the CPU kernel to pack its operands, with
+/// a packed panel of B larger than kc * nc bytes.
+TEST_P(OperatorTest, matmulPacked) {
+  constexpr size_t m = 1100;
+  constexpr size_t k = 128;
+  constexpr size_t n = 1024;
+  auto *lhs = mod_.createPlaceholder(ElemKind::FloatTy, {m, k}, "lhs", false);
+  auto *rhs = mod_.createPlaceholder(ElemKind::FloatTy, {k, n}, "rhs", false);
+  auto LH = bindings_.allocate(lhs)->getHandle();
+  auto RH = bindings_.allocate(rhs)->getHandle();
+  for (size_t i = 0, e = LH.size(); i < e; i++) {
+    LH.raw(i) = float(i % 7) - 3;
+  }
+  for (size_t i = 0, e = RH.size(); i < e; i++) {
+    RH.raw(i) = float(i % 5) - 2;
+  }
+
+  auto *R = F_->createMatMul("MM", lhs, rhs);
+  auto *save = F_->createSave("save", R);
+  auto *saveTensor = bindings_.allocate(save->getPlaceholder());
+
+  EE_.compile(CompilationMode::Infer);
+  EE_.run(bindings_);
+
+  auto H = saveTensor->getHandle();
+  for (size_t i = 0; i < m; i += 7) {
+    for (size_t j = 0; j < n; j += 13) {
+      float expected = 0;
+      for (size_t p = 0; p < k; p++) {
+        expected += LH.at({i, p}) * RH.at({p, j});
+      }
+      EXPECT_NEAR(H.at({i, j}), expected, 0.001);
+    }
+  }
+}
+
 /// Test that cloneFunInsideFun works correctly with matmuls.
 TEST_P(OperatorTest, matmul_ParCloneTest10) {
   auto *lhs = mod_.createPlaceholder(ElemKind::FloatTy, {3, 2}, "lhs", false);
@@ -3058,6 +3094,43 @@ TEST_P(OperatorTest, IntMatMul) {
   EXPECT_NEAR(H.at({2, 2}), 58.8, 1.0);
 }
 
+/// Test an int8 MatMul whose sizes are not multiples of the tiles and packed
+/// panels of the CPU kernel, with nonzero offsets on both inputs.
+TEST_P(OperatorTest, IntMatMulRagged) {
+  ENABLED_BACKENDS(Interpreter, CPU);
+
+  constexpr size_t m = 13;
+  constexpr size_t k = 37;
+  constexpr size_t n = 11;
+  auto *lhs = mod_.createPlaceholder(ElemKind::Int8QTy, {m, k}, 0.01, -37,
+                                     "lhs", false);
+  auto *rhs = mod_.createPlaceholder(ElemKind::Int8QTy, {k, n}, 1.0 / 127, -3,
+                                     "rhs", false);
+  TypeRef resTy = mod_.uniqueType(ElemKind::Int8QTy, {m, n}, 0.25, 0);
+  auto LH = bindings_.allocate(lhs)->getHandle<int8_t>();
+  auto RH = bindings_.allocate(rhs)->getHandle<int8_t>();
+  LH.randomize(-128, 127, mod_.getPRNG());
+  RH.randomize(-128, 127, mod_.getPRNG());
+
+  auto *matmul = F_->createMatMul("matmul.q", resTy, lhs, rhs);
+  auto *result = F_->createSave("save", matmul);
+  bindings_.allocate(result->getPlaceholder());
+
+  EE_.compile(CompilationMode::Infer);
+  EE_.run(bindings_);
+
+  auto H = bindings_.get(result->getPlaceholder())->getHandle<int8_t>();
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < n; j++) {
+      double expected = 0;
+      for (size_t p = 0; p < k; p++) {
+        expected += (LH.at({i, p}) + 37) * 0.01 * (RH.at({p, j}) + 3) / 127;
+      }
+      EXPECT_NEAR(H.at({i, j}) * 0.25, expected, 0.25);
+    }
+  }
+}
+
 TEST_P(OperatorTest, IntBatchedArith) {
   ENABLED_BACKENDS(Interpreter, CPU);
 
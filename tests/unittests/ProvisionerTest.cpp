@@ -103,3 +103,106 @@ TEST_F(ProvisionerTest, provisionDagFail) {
   // Expect that there was no Error when provisioning
   EXPECT_TRUE(errToBool(std::move(err)));
 }
+
+TEST_F(ProvisionerTest, provisionDagParallelCompile) {
+  auto mod = setupModule(8);
+  auto networks = setupDAG(2, 3);
+
+  DeviceManagerMapTy devices;
+  for (int i = 0; i < 6; i++) {
+    std::unique_ptr<DeviceManager> device(
+        new CPUDeviceManager(DeviceConfig("CPU")));
+    devices.emplace(i, std::move(device));
+  }
+
+  CompilationContext cctx;
+  auto provisioner = Provisioner(devices, /* maxCompileThreads */ 4);
+  auto err = provisioner.provision(networks, *mod.get(), cctx);
+  EXPECT_FALSE(errToBool(std::move(err)));
+
+  // Every partition was compiled and assigned a device.
+  for (auto &network : networks) {
+    for (auto &node : network.nodes) {
+      EXPECT_NE(node->runtimeBundle, nullptr);
+      EXPECT_FALSE(node->deviceIDs.empty());
+    }
+  }
+}
+
+/// Check that the Provisioner charges a function the per-run memory of every
+/// execution slot of a CPU device.
+TEST_F(ProvisionerTest, provisionExecutionSlots) {
+  auto mod = setupModule(1);
+  // Provisions the function on a device with \p slots execution slots and
+  // \p memory bytes, storing the size of its per-run memory in
+  // \p runMemory and its memory for a single slot in \p slotMemory.
+  // \returns the error message, empty on success.
+  uint64_t runMemory = 0, slotMemory = 0;
+  auto provision = [&](unsigned slots, uint64_t memory) {
+    auto networks = setupDAG(1, 0);
+    auto &node = networks.front().nodes.front();
+    node->logicalDevices = {0};
+    auto config = DeviceConfig("CPU");
+    config.parameters["executionSlots"] = std::to_string(slots);
+    config.setDeviceMemory(memory);
+    std::unique_ptr<DeviceManager> device(new CPUDeviceManager(config));
+    EXIT_ON_ERR(device->init());
+    DeviceManagerMapTy devices;
+    devices.emplace(0, std::move(device));
+
+    CompilationContext cctx;
+    auto provisioner = Provisioner(devices);
+    auto err = provisioner.provision(networks, *mod.get(), cctx);
+    if (node->runtimeBundle) {
+      runMemory = node->runtimeBundle->getMutableWeightSize() +
+                  node->runtimeBundle->getActivationsSize();
+      slotMemory = node->runtimeBundle->getDeviceMemorySize();
+    }
+    return err ? llvm::toString(std::move(err)) : std::string();
+  };
+
+  ASSERT_EQ(provision(1, uint64_t(1) << 32), "");
+  ASSERT_GT(runMemory, 0);
+  // Three slots do not fit in the memory of one slot, which the Provisioner
+  // finds before it adds the function to the device.
+  EXPECT_NE(provision(3, slotMemory + 1).find("Not enough memory to provision"),
+            std::string::npos);
+  EXPECT_EQ(provision(3, slotMemory + 2 * runMemory + 1), "");
+}
+
+/// Check that functions of one module compiled concurrently can add types to
+/// the module, which TopK does for its scratch buffer. Run under TSAN to catch
+/// races on the shared module.
+TEST_F(ProvisionerTest, provisionDagParallelCompileNewTypes) {
+  constexpr unsigned numFunctions = 8;
+  auto mod = llvm::make_unique<Module>();
+  for (unsigned i = 0; i < numFunctions; i++) {
+    auto *F = mod->createFunction("function" + std::to_string(i));
+    auto *X = mod->createPlaceholder(ElemKind::FloatTy, {4, 16 + i}, "X",
+                                     false);
+    auto *topK = F->createTopK("topK", X, 2);
+    F->createSave("values", topK->getValues());
+    F->createSave("indices", topK->getIndices());
+  }
+
+  DAGListTy networks;
+  for (unsigned i = 0; i < numFunctions; i++) {
+    auto root = llvm::make_unique<DAGNode>();
+    auto node = llvm::make_unique<DAGNode>();
+    root->name = "root" + std::to_string(i);
+    root->children.push_back(node.get());
+    node->name = "function" + std::to_string(i);
+    node->logicalDevices = {0};
+    node->backendName = "CPU";
+    DAGNodePtrVec nodes;
+    nodes.push_back(std::move(node));
+    networks.push_back({std::move(root), std::move(nodes)});
+  }
+
+  DeviceManagerMapTy devices;
+  devices.emplace(0, std::unique_ptr<DeviceManager>(
+                         new CPUDeviceManager(DeviceConfig("CPU"))));
+  CompilationContext cctx;
+  auto provisioner = Provisioner(devices, numFunctions);
+  EXPECT_FALSE(errToBool(provisioner.provision(networks, *mod.get(), cctx)));
+}
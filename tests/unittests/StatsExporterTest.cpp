@@ -41,13 +41,20 @@ public:
     counters[key] = value;
   }
 
+  void exportHistogram(llvm::StringRef key,
+                       const Histogram &histogram) override {
+    histogramCounts[key] = histogram.getCount();
+  }
+
   void clear() {
     counters.clear();
     timeSeries.clear();
+    histogramCounts.clear();
   }
 
   std::map<std::string, int64_t> counters;
   std::map<std::string, std::vector<double>> timeSeries;
+  std::map<std::string, uint64_t> histogramCounts;
 } MockStats;
 
 class StatsExporterTest : public ::testing::Test {
@@ -88,3 +95,61 @@ TEST(StatsExporter, Device) {
   }
   EXPECT_EQ(MockStats.counters["glow.devices_used.interpreter"], 0);
 }
+
+TEST(StatsExporter, Histogram) {
+  Histogram H;
+  EXPECT_EQ(H.getCount(), 0);
+  EXPECT_EQ(H.getPercentile(50), 0);
+
+  // Small values have exact buckets.
+  for (uint64_t i = 0; i < 16; i++) {
+    H.record(i);
+  }
+  EXPECT_EQ(H.getCount(), 16);
+  EXPECT_EQ(H.getSum(), 120);
+  EXPECT_EQ(H.getMax(), 15);
+  EXPECT_EQ(H.getPercentile(50), 7);
+  EXPECT_EQ(H.getPercentile(100), 15);
+
+  // Larger values are within the width of their bucket, 1/8 of their power
+  // of two.
+  H.clear();
+  EXPECT_EQ(H.getCount(), 0);
+  for (uint64_t i = 1; i <= 1000; i++) {
+    H.record(i);
+  }
+  EXPECT_EQ(H.getCount(), 1000);
+  EXPECT_EQ(H.getMax(), 1000);
+  EXPECT_NEAR(H.getPercentile(50), 500, 500 / 8);
+  EXPECT_NEAR(H.getPercentile(99), 990, 990 / 8);
+  EXPECT_NEAR(H.getPercentile(99.9), 999, 999 / 8);
+  EXPECT_LE(H.getPercentile(100), 1000);
+
+  H.recordMicroseconds(std::chrono::milliseconds(20));
+  EXPECT_EQ(H.getMax(), 20000);
+}
+
+TEST(StatsExporter, HistogramRegistry) {
+  auto *H = Stats()->getHistogram("glow.test.histogram_us");
+  EXPECT_EQ(H, Stats()->getHistogram("glow.test.histogram_us"));
+  Stats()->addHistogramValue("glow.test.histogram_us", 42);
+  EXPECT_EQ(H->getCount(), 1);
+  EXPECT_EQ(H->getMax(), 42);
+
+  // The exporters see the values recorded so far.
+  Stats()->exportHistograms();
+  EXPECT_EQ(MockStats.histogramCounts["glow.test.histogram_us"], 1);
+  Stats()->addHistogramValue("glow.test.histogram_us", 7);
+  Stats()->exportHistograms();
+  EXPECT_EQ(MockStats.histogramCounts["glow.test.histogram_us"], 2);
+
+  // A released histogram is exported a last time and recreated empty.
+  Stats()->addHistogramValue("glow.test.histogram_us", 1);
+  Stats()->releaseHistogram("glow.test.histogram_us");
+  EXPECT_EQ(MockStats.histogramCounts["glow.test.histogram_us"], 3);
+  MockStats.histogramCounts.clear();
+  Stats()->exportHistograms();
+  EXPECT_EQ(MockStats.histogramCounts.count("glow.test.histogram_us"), 0);
+  EXPECT_EQ(Stats()->getHistogram("glow.test.histogram_us")->getCount(), 0);
+  Stats()->releaseHistogram("glow.test.histogram_us");
+}
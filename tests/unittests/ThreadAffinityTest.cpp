@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "glow/Support/ThreadAffinity.h"
+#include "glow/Support/ThreadPool.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace glow;
+
+/// Verify the parsing of CPU lists in the format of the Linux sysfs.
+TEST(ThreadAffinity, parseCPUList) {
+  auto cpus = EXIT_ON_ERR(parseCPUList("8,0-2, 4-5,1"));
+  EXPECT_EQ(cpus, std::vector<unsigned>({0, 1, 2, 4, 5, 8}));
+  EXPECT_EQ(EXIT_ON_ERR(parseCPUList("3\n")), std::vector<unsigned>({3}));
+
+  for (const char *invalid : {"", "a", "1-", "3-1", "1,,x"}) {
+    EXPECT_TRUE(errToBool(parseCPUList(invalid).takeError())) << invalid;
+  }
+}
+
+#ifdef __linux__
+/// Verify that all the threads of a pool are pinned to the given CPU.
+TEST(ThreadAffinity, threadPool) {
+  // Pin to a CPU the process may run on.
+  cpu_set_t allowed;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+  unsigned cpu = 0;
+  while (!CPU_ISSET(cpu, &allowed)) {
+    cpu++;
+  }
+
+  ThreadPool tp(4);
+  ASSERT_FALSE(errToBool(setThreadPoolAffinity(tp, {cpu})));
+  std::atomic<unsigned> pinned{0};
+  auto done = tp.runOnAllThreads([cpu, &pinned]() {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 &&
+        CPU_COUNT(&set) == 1 && CPU_ISSET(cpu, &set)) {
+      pinned++;
+    }
+  });
+  done.wait();
+  EXPECT_EQ(pinned, 4u);
+}
+#endif // __linux__
@@ -73,14 +73,15 @@ public:
     RunIdentifierTy runId = 0;
     bool successResult = false;
 
-    // Retrieve the registered response for the function if there is one.
-    if (context && resultCB && resultMap_.count(functionName)) {
-      std::unique_ptr<RunFunctionResult> registeredResult =
-          std::move(resultMap_[functionName]);
+    // Retrieve the registered response for the function if there is one. It
+    // is kept for the next runs of the function.
+    auto it = resultMap_.find(functionName);
+    if (context && resultCB && it != resultMap_.end()) {
+      const RunFunctionResult *registeredResult = it->second.get();
 
       // Check that context contains the expected Placeholder-Tensor mappings.
-      std::unique_ptr<ExecutionContext> inputContext =
-          std::move(registeredResult->inputContext);
+      const ExecutionContext *inputContext =
+          registeredResult->inputContext.get();
 
       bool equalInputs = true;
       for (auto &p : inputContext->getPlaceholderBindings()->pairs()) {
@@ -223,6 +224,15 @@ public:
     root_->module = module_.get();
   }
 
+  ExecutorTest(ExecutorTest &&) = default;
+
+  /// Release the DAG from the executor before it is destroyed.
+  ~ExecutorTest() {
+    if (root_) {
+      executor_->release(root_.get());
+    }
+  }
+
   /// Run the test.
   bool run() {
     if (testRun_) {
@@ -266,6 +276,54 @@ public:
     return testPassed;
   }
 
+  /// Run the test \p times times on the same DAG, each time with a copy of
+  /// the inputs. \returns true if all the runs passed.
+  bool runRepeatedly(unsigned times) {
+    for (unsigned i = 0; i < times; i++) {
+      auto input = llvm::make_unique<ExecutionContext>(inputContext_->clone());
+      std::swap(input, inputContext_);
+      testRun_ = false;
+      if (!run()) {
+        return false;
+      }
+      inputContext_ = std::move(input);
+    }
+    return true;
+  }
+
+  /// Runs the DAG on a copy of the inputs with a deadline \p timeout after
+  /// the call. \returns false if the run did not call its callback within
+  /// ten seconds, otherwise sets \p succeeded to the result of the run.
+  bool runWithDeadline(std::chrono::nanoseconds timeout, bool &succeeded) {
+    auto input = llvm::make_unique<ExecutionContext>(inputContext_->clone());
+    input->setDeadline(std::chrono::steady_clock::now() + timeout);
+    // The promise outlives this call if the callback is never called.
+    auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    executor_->run(root_.get(), std::move(input), runId_,
+                   [promise](RunIdentifierTy, llvm::Error err,
+                             std::unique_ptr<ExecutionContext>) {
+                     promise->set_value(!errToBool(std::move(err)));
+                   });
+    if (future.wait_for(std::chrono::seconds(10)) !=
+        std::future_status::ready) {
+      return false;
+    }
+    succeeded = future.get();
+    return true;
+  }
+
+  /// Reserves the resources of \p runs concurrent runs of the DAG.
+  void prepare(size_t runs) { executor_->prepare(root_.get(), runs); }
+
+  /// \returns the statistics of the intermediate tensor pool of the DAG.
+  const TensorPool::Stats &getIntermediatePoolStats() {
+    // The executor keeps the plan until the DAG is released.
+    auto plan =
+        static_cast<ThreadPoolExecutor &>(*executor_).getPlan(root_.get());
+    return plan->getIntermediateTensorPool().getStats();
+  }
+
 private:
   /// The Executor to run the test with.
   std::shared_ptr<Executor> executor_;
@@ -883,6 +941,83 @@ TEST_F(ThreadPoolExecutorTest, MultiNode) {
   EXPECT_TRUE(test.run());
 }
 
+/// Tests that the same multi-node DAG can run several times, reusing the
+/// execution plan and state of its first run.
+TEST_F(ThreadPoolExecutorTest, MultiNodeRepeated) {
+  constexpr RunIdentifierTy testRunId = 10;
+  constexpr DeviceIDTy testDeviceId = 111;
+  constexpr unsigned deviceManagerThreads = 3;
+
+  auto deviceManager = llvm::make_unique<TestDeviceManager>(
+      deviceManagerThreads, DeviceConfig("Interpreter"));
+  deviceManagerMap_.emplace(testDeviceId, std::move(deviceManager));
+
+  // Same DAG as MultiNode.
+  testBuilder_.addNode("alpha", testDeviceId,
+                       /*parents=*/{}, /*inputs=*/{"alphaIn"},
+                       /*outputs=*/{"alphaOut"}, testRunId, true);
+  testBuilder_.addNode("beta", testDeviceId,
+                       /*parents=*/{}, /*inputs=*/{"betaIn"},
+                       /*outputs=*/{"betaOut"}, testRunId, true);
+  testBuilder_.addNode("gamma", testDeviceId,
+                       /*parents=*/{"alpha", "beta"},
+                       /*inputs=*/{"alphaOut", "betaOut"},
+                       /*outputs=*/{"deltaIn", "epsIn"}, testRunId, true);
+  testBuilder_.addNode("delta", testDeviceId,
+                       /*parents=*/{"gamma"}, /*inputs=*/{"deltaIn"},
+                       /*outputs=*/{"deltaOut"}, testRunId, true);
+  testBuilder_.addNode("eps", testDeviceId,
+                       /*parents=*/{"gamma"}, /*inputs=*/{"epsIn"},
+                       /*outputs=*/{"epsOut"}, testRunId, true);
+
+  ExecutorTest test = testBuilder_.emitTest();
+  EXPECT_TRUE(test.runRepeatedly(5));
+}
+
+/// Tests that the intermediate tensors of a DAG reserved before its runs are
+/// reused by all of them instead of being allocated by the runs.
+TEST_F(ThreadPoolExecutorTest, MultiNodeReservedIntermediates) {
+  constexpr RunIdentifierTy testRunId = 10;
+  constexpr DeviceIDTy testDeviceId = 111;
+  constexpr unsigned deviceManagerThreads = 3;
+
+  auto deviceManager = llvm::make_unique<TestDeviceManager>(
+      deviceManagerThreads, DeviceConfig("Interpreter"));
+  deviceManagerMap_.emplace(testDeviceId, std::move(deviceManager));
+
+  // Same DAG as MultiNode, alphaOut, betaOut, deltaIn and epsIn are passed
+  // between its nodes.
+  testBuilder_.addNode("alpha", testDeviceId,
+                       /*parents=*/{}, /*inputs=*/{"alphaIn"},
+                       /*outputs=*/{"alphaOut"}, testRunId, true);
+  testBuilder_.addNode("beta", testDeviceId,
+                       /*parents=*/{}, /*inputs=*/{"betaIn"},
+                       /*outputs=*/{"betaOut"}, testRunId, true);
+  testBuilder_.addNode("gamma", testDeviceId,
+                       /*parents=*/{"alpha", "beta"},
+                       /*inputs=*/{"alphaOut", "betaOut"},
+                       /*outputs=*/{"deltaIn", "epsIn"}, testRunId, true);
+  testBuilder_.addNode("delta", testDeviceId,
+                       /*parents=*/{"gamma"}, /*inputs=*/{"deltaIn"},
+                       /*outputs=*/{"deltaOut"}, testRunId, true);
+  testBuilder_.addNode("eps", testDeviceId,
+                       /*parents=*/{"gamma"}, /*inputs=*/{"epsIn"},
+                       /*outputs=*/{"epsOut"}, testRunId, true);
+
+  ExecutorTest test = testBuilder_.emitTest();
+  test.prepare(2);
+  const auto &stats = test.getIntermediatePoolStats();
+  EXPECT_EQ(stats.totalTypes.load(), 1u);
+  EXPECT_EQ(stats.currentBuffers.load(), 8u);
+  EXPECT_EQ(stats.totalAllocs.load(), 8u);
+
+  EXPECT_TRUE(test.runRepeatedly(5));
+  EXPECT_EQ(stats.currentBuffers.load(), 8u);
+  EXPECT_EQ(stats.totalAllocs.load(), 8u);
+  EXPECT_EQ(stats.inlineAllocs.load(), 0u);
+  EXPECT_EQ(stats.totalReclaims.load(), 20u);
+}
+
 /// Tests that a DAG with a node that fails can run correctly.
 TEST_F(ThreadPoolExecutorTest, MultiNodeWithFailure) {
   constexpr RunIdentifierTy testRunId = 10;
@@ -934,6 +1069,59 @@ TEST_F(ThreadPoolExecutorTest, MultiNodeWithFailure) {
   EXPECT_TRUE(test.run());
 }
 
+/// Tests that runs whose deadline passes right after they were admitted by
+/// Executor::run() still call their callback.
+TEST_F(ThreadPoolExecutorTest, DeadlineAfterAdmission) {
+  constexpr RunIdentifierTy testRunId = 10;
+  constexpr DeviceIDTy testDeviceId = 111;
+  constexpr unsigned deviceManagerThreads = 1;
+
+  auto deviceManager = llvm::make_unique<TestDeviceManager>(
+      deviceManagerThreads, DeviceConfig("Interpreter"));
+  deviceManagerMap_.emplace(testDeviceId, std::move(deviceManager));
+
+  testBuilder_.addNode("net", testDeviceId,
+                       /*parents=*/{}, {"netInput"}, {"netOutput"}, testRunId,
+                       true);
+  ExecutorTest test = testBuilder_.emitTest();
+
+  // Spread the deadlines over the time between the check of run() and the
+  // dispatch of the node, so that some of them expire in between.
+  unsigned succeeded = 0;
+  for (unsigned i = 0; i < 200; i++) {
+    bool success = false;
+    ASSERT_TRUE(test.runWithDeadline(std::chrono::microseconds(i), success))
+        << "Run " << i << " did not call its callback";
+    succeeded += success;
+  }
+  bool success = false;
+  ASSERT_TRUE(test.runWithDeadline(std::chrono::seconds(60), success));
+  EXPECT_TRUE(success);
+  EXPECT_LT(succeeded, 200u);
+}
+
+/// Tests that a run whose only node has no DeviceManager fails and calls its
+/// callback.
+TEST_F(ThreadPoolExecutorTest, MissingDevice) {
+  constexpr RunIdentifierTy testRunId = 10;
+  constexpr DeviceIDTy testDeviceId = 111;
+  constexpr unsigned deviceManagerThreads = 1;
+
+  auto deviceManager = llvm::make_unique<TestDeviceManager>(
+      deviceManagerThreads, DeviceConfig("Interpreter"));
+  deviceManagerMap_.emplace(testDeviceId, std::move(deviceManager));
+
+  testBuilder_.addNode("net", testDeviceId,
+                       /*parents=*/{}, {"netInput"}, {"netOutput"}, testRunId,
+                       true);
+  ExecutorTest test = testBuilder_.emitTest();
+  deviceManagerMap_.erase(testDeviceId);
+
+  bool success = true;
+  ASSERT_TRUE(test.runWithDeadline(std::chrono::seconds(60), success));
+  EXPECT_FALSE(success);
+}
+
 /// Tests that a DAG with nodes spread across multiple devices can run
 /// correctly.
 TEST_F(ThreadPoolExecutorTest, MultiNodeMultiDevice) {
@@ -1103,3 +1291,112 @@ TEST_F(ThreadPoolExecutorTest, ConcurrentMultiNode) {
   // All tests should pass.
   EXPECT_EQ(testsPassed, numConcurrentRuns);
 }
+
+/// \returns a map of \p numDevices TestDeviceManagers, whose runs in flight
+/// are counted by the DeviceSelector tests.
+static DeviceManagerMapTy createSelectorDevices(unsigned numDevices) {
+  DeviceManagerMapTy devices;
+  for (unsigned i = 0; i < numDevices; i++) {
+    devices.emplace(i, llvm::make_unique<TestDeviceManager>(
+                           1, DeviceConfig("Interpreter")));
+  }
+  return devices;
+}
+
+/// Tests that the LeastOutstanding policy sends runs to the idle devices and
+/// spreads the ties round-robin.
+TEST(DeviceSelectorTest, LeastOutstanding) {
+  auto devices = createSelectorDevices(3);
+  DeviceSelector selector(devices, DeviceSelectionPolicy::LeastOutstanding);
+  DAGNode node;
+  node.deviceIDs = {0, 1, 2};
+  DeviceLatencies latencies(3);
+
+  // Idle devices are picked first.
+  std::unordered_set<size_t> picked;
+  for (unsigned i = 0; i < 3; i++) {
+    picked.insert(selector.acquire(&node, latencies));
+  }
+  EXPECT_EQ(picked.size(), 3u);
+
+  // Device 1 finishing its run makes it the least loaded one.
+  selector.release(&node, 1, latencies);
+  EXPECT_EQ(selector.acquire(&node, latencies), 1u);
+  for (auto &device : devices) {
+    EXPECT_EQ(device.second->getNumInflightRuns(), 1u);
+  }
+}
+
+/// Tests that the PowerOfTwoChoices policy never picks the most loaded of two
+/// devices.
+TEST(DeviceSelectorTest, PowerOfTwoChoices) {
+  auto devices = createSelectorDevices(8);
+  DeviceSelector selector(devices, DeviceSelectionPolicy::PowerOfTwoChoices);
+  DAGNode node;
+  node.deviceIDs = {3, 7};
+  DeviceLatencies latencies(2);
+
+  auto &first = *devices[3];
+  auto &second = *devices[7];
+  for (unsigned i = 0; i < 10; i++) {
+    selector.acquire(&node, latencies);
+    EXPECT_LE(first.getNumInflightRuns(), second.getNumInflightRuns() + 1);
+    EXPECT_LE(second.getNumInflightRuns(), first.getNumInflightRuns() + 1);
+  }
+  EXPECT_EQ(first.getNumInflightRuns() + second.getNumInflightRuns(), 10u);
+}
+
+/// Tests that the LatencyWeighted policy favors the faster device once every
+/// device has been measured.
+TEST(DeviceSelectorTest, LatencyWeighted) {
+  auto devices = createSelectorDevices(2);
+  DeviceSelector selector(devices, DeviceSelectionPolicy::LatencyWeighted);
+  DAGNode node;
+  node.deviceIDs = {0, 1};
+  DeviceLatencies latencies(2);
+
+  // Measure both devices, device 1 being 4.5 times slower.
+  auto first = selector.acquire(&node, latencies);
+  auto second = selector.acquire(&node, latencies);
+  EXPECT_NE(first, second);
+  selector.release(&node, 0, latencies, std::chrono::microseconds(100));
+  selector.release(&node, 1, latencies, std::chrono::microseconds(450));
+  EXPECT_EQ(latencies.get(0), 100000u);
+  EXPECT_EQ(latencies.get(1), 450000u);
+
+  // Device 0 takes runs until the fifth one would cost more than one run on
+  // device 1.
+  for (unsigned i = 0; i < 4; i++) {
+    EXPECT_EQ(selector.acquire(&node, latencies), 0u);
+  }
+  EXPECT_EQ(selector.acquire(&node, latencies), 1u);
+}
+
+/// Tests that the latencies are measured by node: a function slow on a
+/// device does not make the device look slow for another function, while
+/// the runs in flight of both count on the device.
+TEST(DeviceSelectorTest, LatencyPerFunction) {
+  auto devices = createSelectorDevices(2);
+  DeviceSelector selector(devices, DeviceSelectionPolicy::LatencyWeighted);
+  DAGNode slow;
+  DAGNode fast;
+  slow.deviceIDs = fast.deviceIDs = {0, 1};
+  DeviceLatencies slowLatencies(2);
+  DeviceLatencies fastLatencies(2);
+
+  // The slow function is slow on device 0 only, the fast one on neither.
+  for (unsigned i = 0; i < 2; i++) {
+    selector.acquire(&slow, slowLatencies);
+    selector.acquire(&fast, fastLatencies);
+  }
+  selector.release(&slow, 0, slowLatencies, std::chrono::microseconds(900));
+  selector.release(&slow, 1, slowLatencies, std::chrono::microseconds(100));
+  selector.release(&fast, 0, fastLatencies, std::chrono::microseconds(100));
+  selector.release(&fast, 1, fastLatencies, std::chrono::microseconds(100));
+
+  EXPECT_EQ(selector.acquire(&slow, slowLatencies), 1u);
+  // Device 1 now has a run in flight, the fast function goes to device 0.
+  EXPECT_EQ(selector.acquire(&fast, fastLatencies), 0u);
+  EXPECT_EQ(devices[0]->getNumInflightRuns(), 1u);
+  EXPECT_EQ(devices[1]->getNumInflightRuns(), 1u);
+}
@@ -154,3 +154,112 @@ TEST(ThreadPool, runOnAllThreads) {
   ASSERT_NE(threadIds[1], threadIds[2]);
   ASSERT_NE(threadIds[2], threadIds[0]);
 }
+
+/// Verify that pending work items run by priority, then deadline, then
+/// submission order.
+TEST(ThreadPool, priorityOrder) {
+  ThreadPool tp(1);
+  auto *ex = tp.getExecutor();
+
+  // Block the thread so that all the following items are pending together.
+  std::promise<void> unblock;
+  auto blocked = unblock.get_future().share();
+  ex->submit([blocked]() { blocked.wait(); });
+
+  auto now = std::chrono::steady_clock::now();
+  auto key = [now](unsigned priority, int deadlineMs) {
+    WorkPriority key;
+    key.priority = priority;
+    if (deadlineMs >= 0) {
+      key.deadline = now + std::chrono::milliseconds(deadlineMs);
+    }
+    return key;
+  };
+
+  std::vector<int> order;
+  std::future<void> last;
+  auto record = [&order](int id) {
+    return [&order, id]() { order.push_back(id); };
+  };
+  last = ex->submit(record(0), key(2, -1));
+  ex->submit(record(1), key(1, 20));
+  ex->submit(record(2), key(1, 10));
+  ex->submit(record(3), key(1, -1));
+  ex->submit(record(4), key(1, 10));
+  ex->submit(record(5));
+
+  unblock.set_value();
+  last.get();
+
+  std::vector<int> expected = {5, 2, 4, 1, 3, 0};
+  EXPECT_EQ(order, expected);
+}
+
+/// Verify that work items queued behind a blocked work item are stolen by the
+/// other workers.
+TEST(ThreadPool, workStealing) {
+  ThreadPool tp(2);
+  constexpr size_t numItems = 100;
+
+  std::promise<void> allDone;
+  auto allDoneFuture = allDone.get_future().share();
+  std::atomic<size_t> done{0};
+
+  // Block one worker until the other work items are done.
+  auto blocker = tp.submit([allDoneFuture]() {
+    allDoneFuture.wait_for(std::chrono::seconds(10));
+  });
+
+  for (size_t i = 0; i < numItems; i++) {
+    tp.submit([&done, &allDone]() {
+      if (++done == numItems) {
+        allDone.set_value();
+      }
+    });
+  }
+
+  EXPECT_EQ(allDoneFuture.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  blocker.get();
+  EXPECT_EQ(done, numItems);
+}
+
+TEST(ThreadPool, submissionOrder) {
+  // More work items than the ring of the single worker holds: the submitter
+  // waits for the ring to drain instead of reordering them.
+  ThreadPool tp(1);
+  constexpr size_t numItems = 5000;
+  std::vector<size_t> order;
+  std::future<void> last;
+  for (size_t i = 0; i < numItems; i++) {
+    last = tp.submit([&order, i]() { order.push_back(i); });
+  }
+  last.get();
+
+  ASSERT_EQ(order.size(), numItems);
+  for (size_t i = 0; i < numItems; i++) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+/// Verify that the prioritized work items submitted to the pool run after its
+/// shared work items of the default priority.
+TEST(ThreadPool, prioritySubmitOrder) {
+  ThreadPool tp(1);
+  std::promise<void> unblock;
+  auto blocked = unblock.get_future().share();
+  tp.submit([blocked]() { blocked.wait(); });
+
+  WorkPriority low;
+  low.priority = 1;
+  std::vector<int> order;
+  auto last = tp.submit([&order]() { order.push_back(0); }, low);
+  tp.submit([&order]() { order.push_back(1); });
+  tp.submit([&order]() { order.push_back(2); });
+
+  unblock.set_value();
+  last.get();
+
+  std::vector<int> expected = {1, 2, 0};
+  EXPECT_EQ(order, expected);
+}
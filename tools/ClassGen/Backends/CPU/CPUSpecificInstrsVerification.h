@@ -33,4 +33,30 @@ void CPUConvDKKC8Inst::verify() const {
          "Invalid Element Type");
 }
 
+void CPUConvWinogradInst::verify() const {
+  assert((getTileSize() == 2 || getTileSize() == 4) && "Invalid tile size");
+  assert(getFilter()->dims()[2] == getSrc()->dims()[3] &&
+         "Invalid filter input channels");
+  assert(getFilter()->dims()[3] == getDest()->dims()[3] &&
+         "Invalid filter output channels");
+  assert(getDest()->getElementType() == getSrc()->getElementType() &&
+         "Invalid Element Type");
+  assert(getDest()->getElementType() == getFilter()->getElementType() &&
+         "Invalid Element Type");
+  assert(getDest()->getElementType() == getBias()->getElementType() &&
+         "Invalid Element Type");
+  assert(getScratch()->getElementType() == ElemKind::FloatTy &&
+         getScratch()->dims().size() == 2 && "Invalid scratch");
+}
+
+void CPUConvDepthwiseInst::verify() const {
+  assert(getDest()->dims()[3] % getSrc()->dims()[3] == 0 &&
+         "Output channels must be a multiple of the input channels.");
+  assert(getFilter()->dims().size() == 3 &&
+         getFilter()->dims()[2] == getDest()->dims()[3] &&
+         "Invalid filter dimensions");
+  assert(getDest()->getElementType() == getSrc()->getElementType() &&
+         "Invalid Element Type");
+}
+
 #endif // GLOW_WITH_CPU
@@ -33,6 +33,33 @@ BB.newNode("CPUConvDKKC8")
     .setDocstring("This is a cpu-specific convolution implementation where the "
                   "filter is transposed to the shape [D/8, K, K, C, 8]");
 
+BB.newNode("CPUConvWinograd")
+    .addInput("Input")
+    .addInput("Filter")
+    .addInput("Bias")
+    .addMember(MemberType::VectorUnsigned, "Pads")
+    .addMember(MemberType::Unsigned, "TileSize")
+    .addResultFromCtorArg()
+    .setDocstring("This is a cpu-specific 3x3 convolution with unit strides "
+                  "and a single group computed by the Winograd "
+                  "F(TileSize x TileSize, 3x3) algorithm. The filter is "
+                  "transformed into the Winograd domain and has the shape "
+                  "[TileSize + 2, TileSize + 2, C, D]");
+
+BB.newNode("CPUConvDepthwise")
+    .addInput("Input")
+    .addInput("Filter")
+    .addInput("Bias")
+    .addMember(MemberType::VectorUnsigned, "Kernels")
+    .addMember(MemberType::VectorUnsigned, "Strides")
+    .addMember(MemberType::VectorUnsigned, "Pads")
+    .addMember(MemberType::Unsigned, "Dilation")
+    .addResultFromCtorArg()
+    .setDocstring("This is a cpu-specific depthwise convolution, with one "
+                  "group per input channel, where the filter is transposed "
+                  "to the shape [K, K, D]. The weights of a quantized filter "
+                  "are widened to Int32QTy with the offset subtracted");
+
 BB.includeBackendSpecificVerification("glow/CPUSpecificNodesVerification.h");
 
 #endif // GLOW_WITH_CPU
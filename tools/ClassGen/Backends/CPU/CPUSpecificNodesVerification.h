@@ -30,4 +30,41 @@ bool CPUConvDKKC8Node::verify() const {
   return expectCompareTrue("Invalid output dimensions", exp, odim, this);
 }
 
+bool CPUConvWinogradNode::verify() const {
+  ShapeNHWC idim(getInput().getType()->dims());
+  ShapeNHWC odim(getResult().getType()->dims());
+  auto outSz = calculateConvPoolOutputDims(idim.h, idim.w, {3, 3}, {1, 1},
+                                           getPads());
+  ShapeNHWC exp(idim.n, outSz.first, outSz.second, getBias().dims()[0]);
+  bool isValid =
+      expectCompareTrue("Invalid output dimensions", exp, odim, this);
+  const unsigned_t tileSizes[] = {2, 4};
+  isValid &= expectCompareTrue("Invalid tile size", getTileSize(),
+                               llvm::makeArrayRef(tileSizes), this);
+  size_t alpha = getTileSize() + 2;
+  const size_t filterDims[] = {alpha, alpha, idim.c, odim.c};
+  isValid &=
+      expectCompareTrue("Invalid filter dimensions", getFilter().dims(),
+                        llvm::makeArrayRef(filterDims), this);
+  return isValid;
+}
+
+bool CPUConvDepthwiseNode::verify() const {
+  ShapeNHWC idim(getInput().getType()->dims());
+  ShapeNHWC odim(getResult().getType()->dims());
+  auto outSz = calculateConvPoolOutputDims(idim.h, idim.w, getKernels(),
+                                           getStrides(), getPads(),
+                                           getDilation());
+  ShapeNHWC exp(idim.n, outSz.first, outSz.second, getBias().dims()[0]);
+  bool isValid =
+      expectCompareTrue("Invalid output dimensions", exp, odim, this);
+  isValid &= expectCompareTrue("Invalid channel multiplier", odim.c % idim.c,
+                               size_t(0), this);
+  const size_t filterDims[] = {getKernels()[0], getKernels()[1], odim.c};
+  isValid &=
+      expectCompareTrue("Invalid filter dimensions", getFilter().dims(),
+                        llvm::makeArrayRef(filterDims), this);
+  return isValid;
+}
+
 #endif // GLOW_WITH_CPU
@@ -18,43 +18,133 @@
 
 #include "PyTorchModelLoader.h"
 
+#include "glow/Runtime/StatsExporter.h"
 #include "glow/Support/Support.h"
 
+#include "llvm/ADT/Hashing.h"
+
+#include <chrono>
+
 namespace glow {
 
-llvm::Error CachingGraphRunner::runGraph(const torch::jit::Node *node,
-                                         torch::jit::Stack &stack) {
-  // If this is the first time this subgraph has been run then create a new
-  // GraphInfo object to store information about it.
+CachingGraphRunner::CachingGraphRunner() {
+  std::vector<std::unique_ptr<runtime::DeviceConfig>> configs;
+  configs.push_back(llvm::make_unique<runtime::DeviceConfig>("Interpreter"));
+  hostManager_ = llvm::make_unique<runtime::HostManager>(std::move(configs));
+}
+
+llvm::Expected<std::vector<CachingGraphRunner::InputMeta>>
+CachingGraphRunner::getInputMeta(at::ArrayRef<torch::jit::IValue> inputs) {
+  std::vector<InputMeta> inputMeta;
+  for (const auto &input : inputs) {
+    RETURN_ERR_IF_NOT(input.isTensor(),
+                      "Expected all Glow fusion group inputs to be tensors.");
+    const auto &t = input.toTensor();
+    const auto sizes = t.sizes();
+    inputMeta.push_back(
+        {t.scalar_type(), std::vector<int64_t>(sizes.begin(), sizes.end())});
+  }
+  return inputMeta;
+}
+
+size_t
+CachingGraphRunner::computeGraphHash(const torch::jit::Node *node,
+                                     const std::vector<InputMeta> &inputMeta) {
+  size_t hash = llvm::hash_value(node);
+  for (const auto &meta : inputMeta) {
+    hash = llvm::hash_combine(
+        hash, static_cast<int>(meta.type),
+        llvm::hash_combine_range(meta.dims.begin(), meta.dims.end()));
+  }
+  return hash;
+}
 
+llvm::Error
+CachingGraphRunner::loadImpl(const torch::jit::Node *node,
+                             at::ArrayRef<torch::jit::IValue> inputs,
+                             PerGlowGraphInfo &info) {
   const std::shared_ptr<torch::jit::Graph> graph = node->g(at::attr::Subgraph);
-  const auto &graphInputs = graph->inputs();
-  const auto numInputs = graphInputs.size();
-  auto inputs = torch::jit::last(stack, numInputs);
-  const char *const functionName = "PyTorchFunction";
 
-  glow::Function *f = nullptr;
-  // Discard compiled function.
-  executionEngine_.setBackendName(executionEngine_.getBackendName());
-  auto &mod = executionEngine_.getModule();
-  f = mod.createFunction(functionName);
-  std::vector<glow::Placeholder *> inputPlaceholders;
-  std::vector<glow::Placeholder *> outputPlaceholders;
+  std::unique_ptr<Module> module = llvm::make_unique<Module>();
+  Function *f = module->createFunction(info.functionName);
 
+  // A previous attempt may have failed after loading some placeholders.
+  info.inputPlaceholders.clear();
+  info.outputPlaceholders.clear();
   RETURN_IF_ERR(PyTorchModelLoader::loadJITGraph(
-      *f, *graph, inputs, inputPlaceholders, outputPlaceholders,
+      *f, *graph, inputs, info.inputPlaceholders, info.outputPlaceholders,
       getPyTorchLoaderSettings()));
 
+  // Placeholders are kept alive by HostManager after it takes ownership of the
+  // Module so the pointers in info stay valid.
+  CompilationContext cctx;
+  return hostManager_->addNetwork(std::move(module), cctx);
+}
+
+llvm::Error CachingGraphRunner::runGraph(const torch::jit::Node *node,
+                                         torch::jit::Stack &stack) {
+  const std::shared_ptr<torch::jit::Graph> graph = node->g(at::attr::Subgraph);
+  const auto numInputs = graph->inputs().size();
+  auto inputs = torch::jit::last(stack, numInputs);
+
+  std::vector<InputMeta> inputMeta;
+  ASSIGN_VALUE_OR_RETURN_ERR(inputMeta, getInputMeta(inputs));
+  size_t hash = computeGraphHash(node, inputMeta);
+
+  // Look up the entry of this subgraph for inputs of these types and shapes,
+  // or add one if this is the first time they are seen.
+  PerGlowGraphInfo *info = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(graphInfoMapMutex_);
+    auto &entries = perGlowGraphInfoMap_[hash];
+    for (auto &entry : entries) {
+      if (entry->node == node && entry->inputMeta == inputMeta) {
+        info = entry.get();
+        break;
+      }
+    }
+    if (!info) {
+      entries.push_back(llvm::make_unique<PerGlowGraphInfo>());
+      info = entries.back().get();
+      info->node = node;
+      info->inputMeta = std::move(inputMeta);
+      info->functionName =
+          strFormat("PyTorchFunction_%zu", numCompiledFunctions_++);
+    }
+  }
+
+  // Load and compile the function outside of graphInfoMapMutex_, so that the
+  // other subgraphs keep running meanwhile. A failed compilation is retried
+  // by the next run.
+  if (info->compiled) {
+    Stats()->incrementCounter(kCacheHits);
+  } else {
+    std::lock_guard<std::mutex> compileLock(info->compileMutex);
+    if (info->compiled) {
+      Stats()->incrementCounter(kCacheHits);
+    } else {
+      Stats()->incrementCounter(kCacheMisses);
+      auto compileStart = std::chrono::steady_clock::now();
+      RETURN_IF_ERR(loadImpl(node, inputs, *info));
+      auto compileEnd = std::chrono::steady_clock::now();
+      Stats()->addTimeSeriesValue(
+          kCompileTimeUs, std::chrono::duration_cast<std::chrono::microseconds>(
+                              compileEnd - compileStart)
+                              .count());
+      info->compiled = true;
+    }
+  }
+
   glow::PlaceholderBindings bindings;
   for (size_t i = 0; i < inputs.size(); ++i) {
-    glow::Placeholder *ph = inputPlaceholders[i];
+    glow::Placeholder *ph = info->inputPlaceholders[i];
     glow::TypeRef ty = ph->getType();
     glow::Tensor t(inputs[i].toTensor().data_ptr(), ty);
     bindings.insert(ph, std::move(t));
   }
 
   std::vector<at::IValue> outputs;
-  for (auto *ph : outputPlaceholders) {
+  for (auto *ph : info->outputPlaceholders) {
     std::vector<int64_t> sizes;
     for (auto size : ph->dims()) {
       sizes.push_back(static_cast<int64_t>(size));
@@ -68,9 +158,7 @@ llvm::Error CachingGraphRunner::runGraph(const torch::jit::Node *node,
     bindings.insert(ph, std::move(t));
   }
 
-  glow::CompilationContext cctx;
-  executionEngine_.compile(cctx);
-  executionEngine_.run(bindings);
+  RETURN_IF_ERR(hostManager_->runNetworkBlocking(info->functionName, bindings));
 
   torch::jit::drop(stack, numInputs);
 
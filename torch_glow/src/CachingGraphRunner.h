@@ -20,24 +20,106 @@
 #include <torch/csrc/jit/custom_operator.h>
 #include <torch/csrc/jit/ir.h>
 
-#include "glow/ExecutionEngine/ExecutionEngine.h"
+#include "glow/Runtime/HostManager/HostManager.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace glow {
 
 /// Responsible for maintaining a mapping from PyTorch subgraphs and their
 /// unique input types to compiled Glow Functions.
 class CachingGraphRunner {
-  /// Glow ExecutionEngine.
-  glow::ExecutionEngine executionEngine_;
+  /// The type and shape of a PyTorch input tensor.
+  struct InputMeta {
+    c10::ScalarType type;
+    std::vector<int64_t> dims;
+
+    bool operator==(const InputMeta &other) const {
+      return type == other.type && dims == other.dims;
+    }
+  };
+
+  /// Information that is stored per-Glow graph for running it using
+  /// HostManager.
+  struct PerGlowGraphInfo {
+    /// The fusion node and the types and shapes of the inputs the Glow
+    /// function is compiled for.
+    const torch::jit::Node *node{nullptr};
+    std::vector<InputMeta> inputMeta;
+
+    /// Input and output placeholders to the Glow function.
+    std::vector<glow::Placeholder *> inputPlaceholders;
+    std::vector<glow::Placeholder *> outputPlaceholders;
+
+    /// Name of the Glow function maintained by HostManager for this subgraph.
+    std::string functionName;
+
+    /// Held while the function is compiled, so that concurrent first runs of
+    /// the subgraph wait for it instead of compiling it again.
+    std::mutex compileMutex;
+
+    /// Set once the function is added to the HostManager, written under
+    /// compileMutex.
+    std::atomic<bool> compiled{false};
+  };
+
+  /// Stats keys exported by the CachingGraphRunner.
+  static constexpr const char *kCacheHits = "glow.torch_glow.cache_hits";
+  static constexpr const char *kCacheMisses = "glow.torch_glow.cache_misses";
+  static constexpr const char *kCompileTimeUs =
+      "glow.torch_glow.compile_time_us";
+
+  /// The HostManager used to store and run Glow graphs. Functions compiled for
+  /// each cached subgraph stay resident here until the runner is destroyed.
+  std::unique_ptr<runtime::HostManager> hostManager_;
+
+  /// Mapping from hash of PyTorch inputs and the fusion node to the
+  /// PerGlowGraphInfos of the Glow functions compiled for them. The entries
+  /// of a hash differ by their node or input types and shapes. Entries are
+  /// never removed, so pointers to them stay valid.
+  std::unordered_map<size_t, std::vector<std::unique_ptr<PerGlowGraphInfo>>>
+      perGlowGraphInfoMap_;
+
+  /// Mutex that protects perGlowGraphInfoMap_, runGraph can be called
+  /// concurrently by PyTorch.
+  std::mutex graphInfoMapMutex_;
+
+  /// Counter used to give each compiled subgraph a unique function name.
+  /// Guarded by graphInfoMapMutex_.
+  size_t numCompiledFunctions_{0};
+
+  /// \returns the types and shapes of \p inputs, which must be tensors.
+  static llvm::Expected<std::vector<InputMeta>>
+  getInputMeta(at::ArrayRef<torch::jit::IValue> inputs);
+
+  /// Given a PyTorch glow::FusionGroup Node \p node and the \p inputMeta of
+  /// the inputs it will be run with, \returns a hash of the node together
+  /// with the types and shapes of the inputs.
+  static size_t computeGraphHash(const torch::jit::Node *node,
+                                 const std::vector<InputMeta> &inputMeta);
+
+  /// Given a PyTorch glow::FusionGroup Node \p node that contains a PyTorch
+  /// subgraph and the \p inputs it will be run with, loads the subgraph as a
+  /// Glow Function named after \p info and adds it to the HostManager. Fills
+  /// in the placeholders of \p info. \returns error on failure.
+  llvm::Error loadImpl(const torch::jit::Node *node,
+                       at::ArrayRef<torch::jit::IValue> inputs,
+                       PerGlowGraphInfo &info);
 
 public:
-  CachingGraphRunner() = default;
+  CachingGraphRunner();
 
   /// Given a PyTorch glow::FusionGroup Node \p node that contains a
   /// PyTorch subgraph and corresponding PyTorch Stack \p stack of inputs, run
   /// that subgraph on those inputs. If this is the first time this node has
-  /// been seen then this first loads it as a Glow Function and compiles.
-  /// \returns error of failure.
+  /// been seen with inputs of these types and shapes then this first loads it
+  /// as a Glow Function and compiles, otherwise the cached compiled function
+  /// is reused. \returns error of failure.
   llvm::Error runGraph(const torch::jit::Node *node, torch::jit::Stack &stack);
 };
 } // namespace glow
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CachingGraphRunner.h"
+#include "glow/Runtime/StatsExporter.h"
+
+#include <torch/csrc/jit/irparser.h>
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <thread>
+
+using namespace glow;
+
+namespace {
+/// Counts the cache hits and misses of the CachingGraphRunners.
+class CacheStatsExporter : public StatsExporter {
+public:
+  CacheStatsExporter() { Stats()->registerStatsExporter(this); }
+
+  void addTimeSeriesValue(llvm::StringRef key, double value) override {}
+
+  void incrementCounter(llvm::StringRef key, int64_t value) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    counters_[key] += value;
+  }
+
+  void setCounter(llvm::StringRef key, int64_t value) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    counters_[key] = value;
+  }
+
+  int64_t hits() { return get("glow.torch_glow.cache_hits"); }
+  int64_t misses() { return get("glow.torch_glow.cache_misses"); }
+
+private:
+  int64_t get(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return counters_[key];
+  }
+
+  std::mutex mutex_;
+  std::map<std::string, int64_t> counters_;
+} cacheStats;
+
+/// \returns a glow::FusionGroup Node of \p graph whose subgraph applies a relu
+/// to its input.
+torch::jit::Node *createReluFusionNode(torch::jit::Graph &graph) {
+  const std::string ir = R"IR(
+    graph(%x : Tensor):
+      %y : Tensor = aten::relu(%x)
+      return (%y))IR";
+  auto subgraph = std::make_shared<torch::jit::Graph>();
+  torch::jit::script::parseIR(ir, subgraph.get());
+  auto *node =
+      graph.create(torch::jit::Symbol::fromQualString("glow::FusionGroup"));
+  node->g_(at::attr::Subgraph, subgraph);
+  return node;
+}
+
+/// Runs \p node of \p runner on a tensor of \p sizes and checks the result.
+void runRelu(CachingGraphRunner &runner, const torch::jit::Node *node,
+             at::IntArrayRef sizes) {
+  auto input = torch::autograd::make_variable(at::randn(sizes));
+  torch::jit::Stack stack{input};
+  ASSERT_FALSE(errToBool(runner.runGraph(node, stack)));
+  ASSERT_EQ(stack.size(), 1);
+  EXPECT_TRUE(stack[0].toTensor().equal(input.relu()));
+}
+} // namespace
+
+/// Test that a subgraph is compiled once per node and input shape.
+TEST(CachingGraphRunnerTest, HitsAndMisses) {
+  CachingGraphRunner runner;
+  torch::jit::Graph graph;
+  auto *node = createReluFusionNode(graph);
+  auto *otherNode = createReluFusionNode(graph);
+  int64_t hits = cacheStats.hits();
+  int64_t misses = cacheStats.misses();
+
+  runRelu(runner, node, {2, 3});
+  EXPECT_EQ(cacheStats.misses() - misses, 1);
+  runRelu(runner, node, {2, 3});
+  EXPECT_EQ(cacheStats.hits() - hits, 1);
+
+  // Another shape or another node is compiled separately.
+  runRelu(runner, node, {3, 2});
+  runRelu(runner, otherNode, {2, 3});
+  EXPECT_EQ(cacheStats.misses() - misses, 3);
+
+  runRelu(runner, node, {2, 3});
+  runRelu(runner, node, {3, 2});
+  runRelu(runner, otherNode, {2, 3});
+  EXPECT_EQ(cacheStats.hits() - hits, 4);
+  EXPECT_EQ(cacheStats.misses() - misses, 3);
+}
+
+/// Test that concurrent first runs of a subgraph compile it once.
+TEST(CachingGraphRunnerTest, ConcurrentFirstRuns) {
+  CachingGraphRunner runner;
+  torch::jit::Graph graph;
+  auto *node = createReluFusionNode(graph);
+  int64_t hits = cacheStats.hits();
+  int64_t misses = cacheStats.misses();
+
+  constexpr unsigned numThreads = 8;
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < numThreads; i++) {
+    threads.emplace_back([&]() { runRelu(runner, node, {4, 4}); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(cacheStats.misses() - misses, 1);
+  EXPECT_EQ(cacheStats.hits() - hits, numThreads - 1);
+}